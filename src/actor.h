@@ -1071,7 +1071,13 @@ public:
 	double			FloatSpeed;
 
 // interaction info
+	enum { NUM_BLOCKSTAMPS = 4 };
 	FBlockNode		*BlockNode;			// links in blocks (if needed)
+	uint64_t		BlockStamps[NUM_BLOCKSTAMPS];	// visited marks for FBlockThingsIterator
+	DVector2		LinkPos;			// what the sector lists were last built for, see LinkToWorld
+	double			LinkRadius, LinkRenderRadius;
+	struct sector_t	*LinkSector;
+	unsigned		LinkPolyUnlinks;
 	struct sector_t	*Sector;
 	subsector_t *		subsector;
 	double			floorz, ceilingz;	// closest together of contacted secs
@@ -0,0 +1,252 @@
+/*
+** actorpool.cpp
+** Per-class memory pools for actors
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stdlib.h>
+#include "actorpool.h"
+#include "actor.h"
+#include "dobject.h"
+#include "c_cvars.h"
+#include "i_system.h"
+#include "stats.h"
+
+// Only affects actors spawned after it is changed.
+CVAR(Bool, actor_pool, true, 0)
+
+//==========================================================================
+//
+// The pool is never destroyed because the garbage collector may still
+// free objects during static destruction.
+//
+//==========================================================================
+
+FActorPool *FActorPool::Instance()
+{
+	static FActorPool *pool = new FActorPool;
+	return pool;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void *FActorPool::Alloc(PClass *cls)
+{
+	if (!actor_pool)
+		return nullptr;
+
+	FClassPool *pool;
+	auto found = Pools.find(cls);
+	if (found == Pools.end())
+	{
+		pool = nullptr;
+		size_t slotsize = (cls->Size + SLOTALIGN - 1) & ~(size_t)(SLOTALIGN - 1);
+		if (cls->IsDescendantOf(RUNTIME_CLASS(AActor)) && slotsize <= BLOCKSIZE / 4)
+		{
+			pool = new FClassPool;
+			pool->SlotSize = slotsize;
+			pool->SlotsPerBlock = unsigned(BLOCKSIZE / slotsize);
+			pool->NumBlocks = 0;
+			pool->NumUsed = 0;
+		}
+		Pools[cls] = pool;
+	}
+	else
+	{
+		pool = found->second;
+	}
+	if (pool == nullptr)
+		return nullptr;
+
+	if (pool->Partial.Size() == 0)
+	{
+		pool->Partial.Push(NewBlock(pool));
+	}
+	FBlock *block = pool->Partial.Last();
+
+	void *mem;
+	if (block->FreeSlots != nullptr)
+	{
+		mem = block->FreeSlots;
+		block->FreeSlots = *(void **)mem;
+	}
+	else
+	{
+		mem = block->Memory + block->Fresh++ * pool->SlotSize;
+	}
+	if (++block->Used == pool->SlotsPerBlock)
+	{
+		pool->Partial.Pop();
+	}
+	pool->NumUsed++;
+	GC::AllocBytes += pool->SlotSize;
+	return mem;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FActorPool::Free(void *mem)
+{
+	auto found = Blocks.find((uintptr_t)mem & ~(uintptr_t)(BLOCKSIZE - 1));
+	if (found == Blocks.end())
+		return false;
+
+	FBlock *block = found->second;
+	FClassPool *pool = block->Owner;
+	assert(pool != nullptr && block->Used > 0);
+
+	*(void **)mem = block->FreeSlots;
+	block->FreeSlots = mem;
+	if (block->Used-- == pool->SlotsPerBlock)
+	{
+		pool->Partial.Push(block);
+	}
+	pool->NumUsed--;
+	GC::AllocBytes -= pool->SlotSize;
+
+	// Keep one block around so that a class that keeps spawning and
+	// destroying a single actor does not hand its block back every time.
+	if (block->Used == 0 && pool->Partial.Size() > 1)
+	{
+		pool->Partial.Delete(pool->Partial.Find(block));
+		ReleaseBlock(block);
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// A pool that still has objects in it is left to its blocks.
+//
+//==========================================================================
+
+void FActorPool::ForgetClasses()
+{
+	for (auto &pair : Pools)
+	{
+		FClassPool *pool = pair.second;
+		if (pool != nullptr && pool->NumUsed == 0)
+		{
+			for (FBlock *block : pool->Partial)
+			{
+				ReleaseBlock(block);
+			}
+			delete pool;
+		}
+	}
+	Pools.clear();
+}
+
+//==========================================================================
+//
+// Blocks are carved out of larger chunks so that they can be aligned
+// without relying on an aligned allocator.
+//
+//==========================================================================
+
+FActorPool::FBlock *FActorPool::NewBlock(FClassPool *pool)
+{
+	if (EmptyBlocks.Size() == 0)
+	{
+		size_t size = CHUNKBLOCKS * BLOCKSIZE + BLOCKSIZE;
+		uint8_t *chunk = (uint8_t *)malloc(size);
+		if (chunk == nullptr)
+		{
+			I_FatalError("Could not allocate %zu bytes for actors", size);
+		}
+		ChunkBytes += size;
+
+		uintptr_t start = ((uintptr_t)chunk + BLOCKSIZE - 1) & ~(uintptr_t)(BLOCKSIZE - 1);
+		for (int i = CHUNKBLOCKS - 1; i >= 0; i--)
+		{
+			FBlock *block = new FBlock;
+			block->Memory = (uint8_t *)(start + i * BLOCKSIZE);
+			block->Owner = nullptr;
+			Blocks[(uintptr_t)block->Memory] = block;
+			EmptyBlocks.Push(block);
+		}
+	}
+
+	FBlock *block;
+	EmptyBlocks.Pop(block);
+	block->Owner = pool;
+	block->FreeSlots = nullptr;
+	block->Fresh = 0;
+	block->Used = 0;
+	pool->NumBlocks++;
+	return block;
+}
+
+void FActorPool::ReleaseBlock(FBlock *block)
+{
+	block->Owner->NumBlocks--;
+	block->Owner = nullptr;
+	EmptyBlocks.Push(block);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FString FActorPool::GetStats()
+{
+	unsigned classes = 0, blocks = 0, actors = 0;
+	size_t used = 0;
+	for (auto &pair : Pools)
+	{
+		if (pair.second != nullptr && pair.second->NumBlocks > 0)
+		{
+			classes++;
+			blocks += pair.second->NumBlocks;
+			actors += pair.second->NumUsed;
+			used += pair.second->NumUsed * pair.second->SlotSize;
+		}
+	}
+	FString out;
+	out.Format("%u actors in %u classes, %u blocks, %.1f/%.1f/%.1f MB used/owned/reserved", actors, classes, blocks,
+		used / (1024.0 * 1024.0), blocks * (double)BLOCKSIZE / (1024.0 * 1024.0), ChunkBytes / (1024.0 * 1024.0));
+	return out;
+}
+
+ADD_STAT(actorpool)
+{
+	return FActorPool::Instance()->GetStats();
+}
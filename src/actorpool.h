@@ -0,0 +1,77 @@
+#ifndef __ACTORPOOL_H
+#define __ACTORPOOL_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include "tarray.h"
+#include "zstring.h"
+
+class PClass;
+
+//==========================================================================
+//
+// Allocates actors from per-class pools of fixed-size blocks instead of
+// taking each one from the general heap. Actors of the same class that
+// are spawned together end up next to each other, so walking the thinker
+// lists touches far fewer scattered cache lines.
+//
+// Blocks are aligned to their size, which lets Free tell a pooled object
+// from a heap allocated one. Empty blocks go back to a shared list and
+// the memory is never returned to the system.
+//
+//==========================================================================
+
+class FActorPool
+{
+public:
+	static FActorPool *Instance();
+
+	// Returns nullptr if the class is not pooled.
+	void *Alloc(PClass *cls);
+
+	// Returns false if the memory does not belong to a pool.
+	bool Free(void *mem);
+
+	// Called when the class objects are deleted.
+	void ForgetClasses();
+
+	FString GetStats();
+
+private:
+	enum
+	{
+		BLOCKSIZE = 32768,
+		CHUNKBLOCKS = 32,
+		SLOTALIGN = 16,
+	};
+
+	struct FClassPool;
+
+	struct FBlock
+	{
+		FClassPool *Owner;		// nullptr while the block is empty
+		uint8_t *Memory;
+		void *FreeSlots;		// Linked through the first word of each free slot
+		unsigned Fresh;			// Slots past this one have never been used
+		unsigned Used;
+	};
+
+	struct FClassPool
+	{
+		size_t SlotSize;
+		unsigned SlotsPerBlock;
+		TArray<FBlock *> Partial;	// Blocks with free slots, the last one is filled first
+		unsigned NumBlocks;
+		unsigned NumUsed;
+	};
+
+	FBlock *NewBlock(FClassPool *pool);
+	void ReleaseBlock(FBlock *block);
+
+	std::unordered_map<PClass *, FClassPool *> Pools;	// nullptr for classes that are not pooled
+	std::unordered_map<uintptr_t, FBlock *> Blocks;
+	TArray<FBlock *> EmptyBlocks;
+	size_t ChunkBytes = 0;
+};
+
+#endif
@@ -217,6 +217,7 @@ void C_DeinitConsole();
 class FBoolCVar : public FBaseCVar
 {
 	friend class FxCVar;
+	friend class FScriptCodeCache;
 public:
 	FBoolCVar (const char *name, bool def, uint32_t flags, void (*callback)(FBoolCVar &)=NULL);
 
@@ -243,6 +244,7 @@ protected:
 class FIntCVar : public FBaseCVar
 {
 	friend class FxCVar;
+	friend class FScriptCodeCache;
 public:
 	FIntCVar (const char *name, int def, uint32_t flags, void (*callback)(FIntCVar &)=NULL);
 
@@ -271,6 +273,7 @@ protected:
 class FFloatCVar : public FBaseCVar
 {
 	friend class FxCVar;
+	friend class FScriptCodeCache;
 public:
 	FFloatCVar (const char *name, float def, uint32_t flags, void (*callback)(FFloatCVar &)=NULL);
 
@@ -298,6 +301,7 @@ protected:
 class FStringCVar : public FBaseCVar
 {
 	friend class FxCVar;
+	friend class FScriptCodeCache;
 public:
 	FStringCVar (const char *name, const char *def, uint32_t flags, void (*callback)(FStringCVar &)=NULL);
 	~FStringCVar ();
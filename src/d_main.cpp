@@ -2664,6 +2664,16 @@ void D_DoomMain (void)
 			StartScreen = NULL;
 			S_Sound (CHAN_BODY, "misc/startupdone", 1, ATTN_NONE);
 
+			if (Args->CheckParm("-precachenodes"))
+			{
+				P_PrecacheNodes();
+				throw CNoRunExit();
+			}
+			if (Args->CheckParm("-benchmark"))
+			{
+				G_RunBenchmark();
+				throw CNoRunExit();
+			}
 			if (Args->CheckParm("-norun") || batchrun)
 			{
 				throw CNoRunExit();
@@ -2802,7 +2812,7 @@ void D_DoomMain (void)
 
 		GC::FullGC();					// perform one final garbage collection after shutdown
 
-		assert(GC::Root == nullptr);
+		assert(GC::Root == nullptr && GC::OldRoot == nullptr);
 
 		restart++;
 		PClass::bShutdown = false;
@@ -52,6 +52,7 @@
 #include "g_levellocals.h"
 #include "types.h"
 #include "i_time.h"
+#include "actorpool.h"
 
 //==========================================================================
 //
@@ -276,7 +277,7 @@ void DObject::InPlaceConstructor (void *mem)
 DObject::DObject ()
 : Class(0), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = GC::NewObjectMark();
 	ObjNext = GC::Root;
 	GCNext = nullptr;
 	GC::Root = this;
@@ -285,7 +286,7 @@ DObject::DObject ()
 DObject::DObject (PClass *inClass)
 : Class(inClass), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = GC::NewObjectMark();
 	ObjNext = GC::Root;
 	GCNext = nullptr;
 	GC::Root = this;
@@ -297,6 +298,20 @@ DObject::DObject (PClass *inClass)
 //
 //==========================================================================
 
+void DObject::FreeMemory(void *mem)
+{
+	if (!FActorPool::Instance()->Free(mem))
+	{
+		M_Free(mem);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 DObject::~DObject ()
 {
 	if (!PClass::bShutdown)
@@ -329,18 +344,24 @@ void DObject::Release()
 {
 	DObject **probe;
 
-	// Unlink this object from the GC list.
-	for (probe = &GC::Root; *probe != NULL; probe = &((*probe)->ObjNext))
+	// Unlink this object from the GC list it is in.
+	bool found = false;
+	for (DObject **list : { &GC::Root, &GC::OldRoot })
 	{
-		if (*probe == this)
+		for (probe = list; *probe != NULL; probe = &((*probe)->ObjNext))
 		{
-			*probe = ObjNext;
-			if (&ObjNext == GC::SweepPos)
+			if (*probe == this)
 			{
-				GC::SweepPos = probe;
+				*probe = ObjNext;
+				if (&ObjNext == GC::SweepPos)
+				{
+					GC::SweepPos = probe;
+				}
+				found = true;
+				break;
 			}
-			break;
 		}
+		if (found) break;
 	}
 
 	// If it's gray, also unlink it from the gray list.
@@ -496,11 +517,14 @@ size_t DObject::StaticPointerSubstitution (DObject *old, DObject *notOld, bool s
 
 	// Go through all objects.
 	i = 0;DObject *last=0;
-	for (probe = GC::Root; probe != NULL; probe = probe->ObjNext)
+	for (DObject *list : { GC::Root, GC::OldRoot })
 	{
-		i++;
-		changed += probe->PointerSubstitution(old, notOld);
-		last = probe;
+		for (probe = list; probe != NULL; probe = probe->ObjNext)
+		{
+			i++;
+			changed += probe->PointerSubstitution(old, notOld);
+			last = probe;
+		}
 	}
 
 	if (scandefaults)
@@ -279,62 +279,59 @@ public:
 
 	void operator delete (void *mem, nonew&)
 	{
-		M_Free(mem);
+		FreeMemory(mem);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		FreeMemory(mem);
 	}
 
+	// Releases memory from PClass::CreateNew, which may come from an actor pool.
+	static void FreeMemory(void *mem);
+
 	// GC fiddling
 
-	// An object is white if either white bit is set.
+	bool IsMarked() const
+	{
+		return (ObjectFlags & OF_MarkBits) == GC::CurrentMark;
+	}
+
+	// An object is white if it was not marked in the current collection.
 	bool IsWhite() const
 	{
-		return !!(ObjectFlags & OF_WhiteBits);
+		return !IsMarked();
 	}
 
 	bool IsBlack() const
 	{
-		return !!(ObjectFlags & OF_Black);
+		return IsMarked() && !(ObjectFlags & OF_Gray);
 	}
 
-	// An object is gray if it isn't white or black.
 	bool IsGray() const
 	{
-		return !(ObjectFlags & OF_MarkBits);
+		return IsMarked() && !!(ObjectFlags & OF_Gray);
 	}
 
-	// An object is dead if it's the other white.
+	// An object is dead if it is still white once marking is done.
 	bool IsDead() const
 	{
-		return !!(ObjectFlags & GC::OtherWhite() & OF_WhiteBits);
-	}
-
-	void ChangeWhite()
-	{
-		ObjectFlags ^= OF_WhiteBits;
-	}
-
-	void MakeWhite()
-	{
-		ObjectFlags = (ObjectFlags & ~OF_MarkBits) | (GC::CurrentWhite & OF_WhiteBits);
+		return GC::State >= GC::GCS_Sweep && !IsMarked() && !(ObjectFlags & OF_Fixed);
 	}
 
 	void White2Gray()
 	{
-		ObjectFlags &= ~OF_WhiteBits;
+		ObjectFlags = (ObjectFlags & ~OF_MarkBits) | GC::CurrentMark | OF_Gray;
 	}
 
 	void Black2Gray()
 	{
-		ObjectFlags &= ~OF_Black;
+		ObjectFlags |= OF_Gray;
 	}
 
 	void Gray2Black()
 	{
-		ObjectFlags |= OF_Black;
+		ObjectFlags &= ~OF_Gray;
 	}
 
 	// Marks all objects pointed to by this one. Returns the (approximate)
@@ -351,7 +348,7 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		FreeMemory (mem);
 	}
 
 	template<typename T, typename... Args>
@@ -382,7 +379,7 @@ class AInventory;//
 // already been processed by the GC.
 static inline void GC::WriteBarrier(DObject *pointing, DObject *pointed)
 {
-	if (pointed != NULL && pointed->IsWhite() && pointing->IsBlack())
+	if (pointed != NULL && State == GCS_Propagate && pointed->IsWhite() && pointing->IsBlack())
 	{
 		Barrier(pointing, pointed);
 	}
@@ -110,6 +110,11 @@
 #define GCSWEEPCOST		10
 #define GCFINALIZECOST	100
 
+// Upper bound for gc_minorcycles. It must stay below the number of distinct
+// mark values, so that a dead old object that has not been swept yet can
+// never look like it was marked in the current collection.
+#define GCMAXMINORCYCLES	100
+
 // TYPES -------------------------------------------------------------------
 
 // This object is responsible for marking sectors during the propagate
@@ -140,6 +145,16 @@ extern DThinker *NextToThink;
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
+// In generational mode, objects that survive two collections are moved to
+// a separate list that only every gc_minorcycles-th collection sweeps.
+// Marking is still done in full every time, because native code stores
+// object pointers without write barriers.
+CUSTOM_CVAR(Bool, gc_generational, false, CVAR_ARCHIVE)
+{
+	GC::ForceMajor = true;
+}
+CVAR(Int, gc_minorcycles, 8, CVAR_ARCHIVE)
+
 namespace GC
 {
 size_t AllocBytes;
@@ -147,19 +162,31 @@ size_t Threshold;
 size_t Estimate;
 DObject *Gray;
 DObject *Root;
+DObject *OldRoot;
 DObject *SoftRoots;
 DObject **SweepPos;
-uint32_t CurrentWhite = OF_White0 | OF_Fixed;
+uint32_t CurrentMark = 1 << OF_MarkShift;
 EGCState State = GCS_Pause;
 int Pause = DEFAULT_GCPAUSE;
 int StepMul = DEFAULT_GCMUL;
 int StepCount;
 size_t Dept;
 bool FinalGC;
+bool ForceMajor;
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 static DSectorMarker *SectorMarker;
+static bool MajorCycle;
+static bool SweepingOld;
+static int MinorCount;
+
+// Pause time statistics
+enum { NUM_PAUSEBUCKETS = 8 };
+static const double PauseLimits[NUM_PAUSEBUCKETS - 1] = { 0.1, 0.25, 0.5, 1, 2, 4, 8 };
+static int PauseBuckets[NUM_PAUSEBUCKETS];
+static double MaxPause;
+static int NumMinorCycles, NumMajorCycles;
 
 // CODE --------------------------------------------------------------------
 
@@ -225,17 +252,34 @@ static size_t PropagateAll()
 static DObject **SweepList(DObject **p, size_t count, size_t *finalize_count)
 {
 	DObject *curr;
-	int deadmask = OtherWhite();
 	size_t finalized = 0;
+	bool promote = gc_generational && !SweepingOld;
 
 	while ((curr = *p) != NULL && count-- > 0)
 	{
-		if ((curr->ObjectFlags ^ OF_WhiteBits) & deadmask)	// not dead?
+		if (curr->ObjectFlags & OF_Fixed)
 		{
-			assert(!curr->IsDead() || (curr->ObjectFlags & OF_Fixed));
-			curr->MakeWhite();	// make it white (for next cycle)
 			p = &curr->ObjNext;
 		}
+		else if (curr->IsMarked())	// not dead?
+		{
+			assert(!curr->IsDead());
+			if (!promote || (curr->ObjectFlags & OF_Rooted))
+			{
+				p = &curr->ObjNext;
+			}
+			else if (!(curr->ObjectFlags & OF_Survivor))
+			{
+				curr->ObjectFlags |= OF_Survivor;
+				p = &curr->ObjNext;
+			}
+			else
+			{ // Survived twice, so move it to the old list.
+				*p = curr->ObjNext;
+				curr->ObjNext = OldRoot;
+				OldRoot = curr;
+			}
+		}
 		else	// must erase 'curr'
 		{
 			assert(curr->IsDead());
@@ -322,6 +366,19 @@ static void MarkRoot()
 {
 	int i;
 
+	// Everything is white again once the mark value changes.
+	CurrentMark += 1 << OF_MarkShift;
+	if ((CurrentMark & OF_MarkBits) == 0)
+	{
+		CurrentMark = 1 << OF_MarkShift;
+	}
+	MajorCycle = !gc_generational || ForceMajor || ++MinorCount >= clamp<int>(gc_minorcycles, 1, GCMAXMINORCYCLES);
+	if (MajorCycle)
+	{
+		MinorCount = 0;
+		ForceMajor = false;
+	}
+
 	Gray = NULL;
 	Mark(StatusBar);
 	M_MarkMenus();
@@ -398,9 +455,10 @@ static void MarkRoot()
 
 static void Atomic()
 {
-	// Flip current white
-	CurrentWhite = OtherWhite();
-	SweepPos = &Root;
+	// The old list is swept first so that objects promoted by this
+	// sweep do not have to be visited again.
+	SweepingOld = MajorCycle;
+	SweepPos = SweepingOld ? &OldRoot : &Root;
 	State = GCS_Sweep;
 	Estimate = AllocBytes;
 }
@@ -438,7 +496,15 @@ static size_t SingleStep()
 		SweepPos = SweepList(SweepPos, GCSWEEPMAX, &finalize_count);
 		if (*SweepPos == NULL)
 		{ // Nothing more to sweep?
-			State = GCS_Finalize;
+			if (SweepingOld)
+			{
+				SweepingOld = false;
+				SweepPos = &Root;
+			}
+			else
+			{
+				State = GCS_Finalize;
+			}
 		}
 		//assert(old >= AllocBytes);
 		Estimate -= MAX<size_t>(0, old - AllocBytes);
@@ -448,6 +514,8 @@ static size_t SingleStep()
 	case GCS_Finalize:
 		State = GCS_Pause;		// end collection
 		Dept = 0;
+		if (MajorCycle) NumMajorCycles++;
+		else NumMinorCycles++;
 		return 0;
 
 	default:
@@ -465,10 +533,30 @@ static size_t SingleStep()
 //
 //==========================================================================
 
+//==========================================================================
+//
+// AddPauseTime
+//
+//==========================================================================
+
+static void AddPauseTime(double ms)
+{
+	int i = 0;
+	while (i < NUM_PAUSEBUCKETS - 1 && ms >= PauseLimits[i])
+	{
+		i++;
+	}
+	PauseBuckets[i]++;
+	MaxPause = MAX(MaxPause, ms);
+}
+
 void Step()
 {
 	size_t lim = (GCSTEPSIZE/100) * StepMul;
 	size_t olim;
+	cycle_t time;
+	time.Reset();
+	time.Clock();
 	if (lim == 0)
 	{
 		lim = (~(size_t)0) / 2;		// no limit
@@ -497,6 +585,8 @@ void Step()
 		SetThreshold();
 	}
 	StepCount++;
+	time.Unclock();
+	AddPauseTime(time.TimeMS());
 }
 
 //==========================================================================
@@ -509,25 +599,34 @@ void Step()
 
 void FullGC()
 {
+	cycle_t time;
+	time.Reset();
+	time.Clock();
 	if (State <= GCS_Propagate)
 	{
-		// Reset sweep mark to sweep all elements (returning them to white)
-		SweepPos = &Root;
-		// Reset other collector lists
+		// Abandon the current mark phase. Starting a new collection
+		// turns everything white again.
+		for (DObject *obj = Gray; obj != NULL; obj = obj->GCNext)
+		{
+			obj->Gray2Black();
+		}
 		Gray = NULL;
-		State = GCS_Sweep;
+		State = GCS_Pause;
 	}
 	// Finish any pending sweep phase
-	while (State != GCS_Finalize)
+	while (State != GCS_Pause)
 	{
 		SingleStep();
 	}
+	ForceMajor = true;
 	MarkRoot();
 	while (State != GCS_Pause)
 	{
 		SingleStep();
 	}
 	SetThreshold();
+	time.Unclock();
+	AddPauseTime(time.TimeMS());
 }
 
 //==========================================================================
@@ -553,12 +652,6 @@ void Barrier(DObject *pointing, DObject *pointed)
 		pointed->GCNext = Gray;
 		Gray = pointed;
 	}
-	// In other states, we can mark the pointing object white so this
-	// barrier won't be triggered again, saving a few cycles in the future.
-	else if (pointing != NULL)
-	{
-		pointing->MakeWhite();
-	}
 }
 
 void DelSoftRootHead()
@@ -608,6 +701,18 @@ void AddSoftRoot(DObject *obj)
 	{
 		probe = &(*probe)->ObjNext;
 	}
+	if (*probe == NULL)
+	{
+		probe = &OldRoot;
+		while (*probe != obj)
+		{
+			probe = &(*probe)->ObjNext;
+		}
+	}
+	if (&obj->ObjNext == SweepPos)
+	{
+		SweepPos = probe;
+	}
 	*probe = (*probe)->ObjNext;
 	obj->ObjNext = SoftRoots->ObjNext;
 	SoftRoots->ObjNext = obj;
@@ -745,6 +850,15 @@ ADD_STAT(gc)
 	{
 		out.AppendFormat("  %zuK", (GC::Dept + 1023) >> 10);
 	}
+	int old = 0;
+	for (DObject *obj = GC::OldRoot; obj != nullptr; obj = obj->ObjNext, old++);
+	out.AppendFormat("\nCycles: %d minor, %d major  Old objects: %d  Max pause: %.2f ms\nPauses:",
+		GC::NumMinorCycles, GC::NumMajorCycles, old, GC::MaxPause);
+	for (int i = 0; i < GC::NUM_PAUSEBUCKETS; i++)
+	{
+		if (i < GC::NUM_PAUSEBUCKETS - 1) out.AppendFormat(" <%g:%d", GC::PauseLimits[i], GC::PauseBuckets[i]);
+		else out.AppendFormat(" >=%g:%d", GC::PauseLimits[i - 1], GC::PauseBuckets[i]);
+	}
 	return out;
 }
 
@@ -777,9 +891,10 @@ CCMD(gc)
 	}
 	else if (stricmp(argv[1], "count") == 0)
 	{
-		int cnt = 0;
+		int cnt = 0, old = 0;
 		for (DObject *obj = GC::Root; obj; obj = obj->ObjNext, cnt++);
-		Printf("%d active objects counted\n", cnt);
+		for (DObject *obj = GC::OldRoot; obj; obj = obj->ObjNext, old++);
+		Printf("%d active objects counted, %d of them old\n", cnt + old, old);
 	}
 	else if (stricmp(argv[1], "pause") == 0)
 	{
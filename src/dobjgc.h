@@ -6,18 +6,14 @@ class FSerializer;
 enum EObjectFlags
 {
 	// GC flags
-	OF_White0			= 1 << 0,		// Object is white (type 0)
-	OF_White1			= 1 << 1,		// Object is white (type 1)
-	OF_Black			= 1 << 2,		// Object is black
+	OF_Survivor			= 1 << 0,		// Object survived a sweep of the young list
+	OF_Gray				= 1 << 2,		// Object is in the gray list
 	OF_Fixed			= 1 << 3,		// Object is fixed (should not be collected)
 	OF_Rooted			= 1 << 4,		// Object is soft-rooted
 	OF_EuthanizeMe		= 1 << 5,		// Object wants to die
 	OF_Cleanup			= 1 << 6,		// Object is now being deleted by the collector
 	OF_YesReallyDelete	= 1 << 7,		// Object is being deleted outside the collector, and this is okay, so don't print a warning
 
-	OF_WhiteBits		= OF_White0 | OF_White1,
-	OF_MarkBits			= OF_WhiteBits | OF_Black,
-
 	// Other flags
 	OF_JustSpawned		= 1 << 8,		// Thinker was spawned this tic
 	OF_SerialSuccess	= 1 << 9,		// For debugging Serialize() calls
@@ -25,6 +21,12 @@ enum EObjectFlags
 	OF_Transient		= 1 << 11,		// Object should not be archived (references to it will be nulled on disk)
 	OF_Spawned			= 1 << 12,      // Thinker was spawned at all (some thinkers get deleted before spawning)
 	OF_Released			= 1 << 13,		// Object was released from the GC system and should not be processed by GC function
+
+	// The collection in which the object was last marked. An object is white
+	// if this is not the current collection, which makes every object white
+	// at once when a new collection starts, without visiting any of them.
+	OF_MarkShift		= 16,
+	OF_MarkBits			= 0xff << OF_MarkShift,
 };
 
 template<class T> class TObjPtr;
@@ -48,11 +50,15 @@ namespace GC
 	// List of gray objects.
 	extern DObject *Gray;
 
-	// List of every object.
+	// List of every young object. New objects are added here.
 	extern DObject *Root;
 
-	// Current white value for potentially-live objects.
-	extern uint32_t CurrentWhite;
+	// List of objects that survived enough collections to be considered old.
+	// In generational mode it is only swept by every few collections.
+	extern DObject *OldRoot;
+
+	// Mark bits of objects that were marked in the current collection.
+	extern uint32_t CurrentMark;
 
 	// Current collector state.
 	extern EGCState State;
@@ -69,10 +75,14 @@ namespace GC
 	// Is this the final collection just before exit?
 	extern bool FinalGC;
 
-	// Current white value for known-dead objects.
-	static inline uint32_t OtherWhite()
+	// Set to make the next collection sweep the old objects too.
+	extern bool ForceMajor;
+
+	// Mark bits for a newly created object. Objects created while sweeping
+	// must survive the sweep, the others start out white.
+	static inline uint32_t NewObjectMark()
 	{
-		return CurrentWhite ^ OF_WhiteBits;
+		return State >= GCS_Sweep ? CurrentMark : 0;
 	}
 
 	// Frees all objects, whether they're dead or not.
@@ -52,6 +52,7 @@
 #include "a_keys.h"
 #include "vm.h"
 #include "types.h"
+#include "actorpool.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -282,6 +283,7 @@ void PClass::StaticShutdown ()
 	// so all meta data must be gone before deleting the actual class objects.
 	for (auto cls : AllClasses)	cls->DestroyMeta(cls->Meta);
 	for (auto cls : AllClasses)	delete cls;
+	FActorPool::Instance()->ForgetClasses();
 	// Unless something went wrong, anything left here should be class and type objects only, which do not own any scripts.
 	bShutdown = true;
 	TypeTable.Clear();
@@ -452,7 +454,9 @@ PClass *PClass::FindClass (FName zaname)
 
 DObject *PClass::CreateNew()
 {
-	uint8_t *mem = (uint8_t *)M_Malloc (Size);
+	uint8_t *mem = (uint8_t *)FActorPool::Instance()->Alloc(this);
+	if (mem == nullptr)
+		mem = (uint8_t *)M_Malloc (Size);
 	assert (mem != nullptr);
 
 	// Set this object's defaults before constructing it.
@@ -463,7 +467,7 @@ DObject *PClass::CreateNew()
 
 	if (ConstructNative == nullptr)
 	{
-		M_Free(mem);
+		DObject::FreeMemory(mem);
 		I_Error("Attempt to instantiate abstract class %s.", TypeName.GetChars());
 	}
 	ConstructNative (mem);
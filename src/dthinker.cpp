@@ -41,10 +41,15 @@
 #include "serializer.h"
 #include "d_player.h"
 #include "vm.h"
+#include "cmdlib.h"
+
+#if !defined(__GNUC__) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#endif
 
 
 static int ThinkCount;
-static cycle_t ThinkCycles;
+cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
 extern int BotWTG;
@@ -489,6 +494,7 @@ void DThinker::RunThinkers ()
 	BotWTG = 0;
 
 	ThinkCycles.Clock();
+	P_StartSightCache();
 
 	if (!profilethinkers)
 	{
@@ -535,9 +541,37 @@ void DThinker::RunThinkers ()
 		profilethinkers = false;
 	}
 
+	P_EndSightCache();
 	ThinkCycles.Unclock();
 }
 
+//==========================================================================
+//
+// Walking the thinker lists stalls on every node and again on the first
+// access to each actor's position, flags and state. Requesting those lines
+// while the previous thinker ticks hides most of that. Prefetching past
+// the end of a thinker that is not an actor is harmless.
+//
+//==========================================================================
+
+CVAR(Bool, think_prefetch, true, 0)
+
+static inline void PrefetchThinker(DThinker *node)
+{
+	const char *p = (const char *)node;
+#if defined(__GNUC__)
+	__builtin_prefetch(p);
+	__builtin_prefetch(p + myoffsetof(AActor, __Pos));
+	__builtin_prefetch(p + myoffsetof(AActor, Vel));
+	__builtin_prefetch(p + myoffsetof(AActor, state));
+#elif defined(_M_IX86) || defined(_M_X64)
+	_mm_prefetch(p, _MM_HINT_T0);
+	_mm_prefetch(p + myoffsetof(AActor, __Pos), _MM_HINT_T0);
+	_mm_prefetch(p + myoffsetof(AActor, Vel), _MM_HINT_T0);
+	_mm_prefetch(p + myoffsetof(AActor, state), _MM_HINT_T0);
+#endif
+}
+
 //==========================================================================
 //
 //
@@ -558,6 +592,8 @@ int DThinker::TickThinkers (FThinkerList *list, FThinkerList *dest)
 	{
 		++count;
 		NextToThink = node->NextThinker;
+		if (think_prefetch)
+			PrefetchThinker(NextToThink);
 		if (node->ObjectFlags & OF_JustSpawned)
 		{
 			// Leave OF_JustSpawn set until after Tick() so the ticker can check it.
@@ -851,6 +887,7 @@ DEFINE_ACTION_FUNCTION(DThinkerIterator, Reinit)
 ADD_STAT (think)
 {
 	FString out;
-	out.Format ("Think time = %04.2f ms - %d thinkers, Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, ActionCycles.TimeMS());
+	out.Format ("Think time = %04.2f ms - %d thinkers (%.2f us each), Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount,
+		ThinkCount > 0 ? ThinkCycles.TimeMS() * 1000. / ThinkCount : 0., ActionCycles.TimeMS());
 	return out;
 }
@@ -36,6 +36,15 @@
 // This also pulls in windows.h
 #include "LzmaDec.h"
 
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <limits.h>
+
 #include "files.h"
 #include "i_system.h"
 #include "templates.h"
@@ -543,6 +552,96 @@ char *MemoryReader::Gets(char *strbuf, int len)
 	return GetsFromBuffer(bufptr, strbuf, len);
 }
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// reads data from a file that is mapped into memory. The mapping is
+// private, so anything writing into a cached lump gets its own copy of
+// the page instead of changing the file.
+//
+//==========================================================================
+
+MappedFileReader::MappedFileReader ()
+: MemoryReader(NULL, 0), MappedBase(NULL), MappedSize(0)
+{
+}
+
+MappedFileReader::~MappedFileReader ()
+{
+	Unmap();
+}
+
+bool MappedFileReader::Map (const char *filename)
+{
+	Unmap();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > LONG_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+
+	// The view keeps the mapping object alive by itself.
+	void *base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if (base == NULL)
+		return false;
+	MappedSize = (size_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0 || (uint64_t)info.st_size > LONG_MAX)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *base = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return false;
+	MappedSize = (size_t)info.st_size;
+#endif
+
+	MappedBase = base;
+	bufptr = (const char *)base;
+	Length = (long)MappedSize;
+	FilePos = 0;
+	return true;
+}
+
+void MappedFileReader::Unmap ()
+{
+	if (MappedBase != NULL)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(MappedBase);
+#else
+		munmap(MappedBase, MappedSize);
+#endif
+		MappedBase = NULL;
+		MappedSize = 0;
+		bufptr = NULL;
+		Length = 0;
+		FilePos = 0;
+	}
+}
+
 //==========================================================================
 //
 // MemoryArrayReader
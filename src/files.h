@@ -371,6 +371,26 @@ protected:
 	const char * bufptr;
 };
 
+// Maps a whole file into memory. Readers for lumps stored uncompressed in it
+// can then point straight into the mapping instead of copying to the heap.
+class MappedFileReader : public MemoryReader
+{
+public:
+	MappedFileReader ();
+	~MappedFileReader ();
+
+	bool Map (const char *filename);
+
+private:
+	MappedFileReader (const MappedFileReader &) = delete;
+	MappedFileReader &operator= (const MappedFileReader &) = delete;
+
+	void Unmap ();
+
+	void *MappedBase;
+	size_t MappedSize;
+};
+
 class MemoryArrayReader : public FileReader
 {
 public:
@@ -0,0 +1,305 @@
+/*
+** g_benchmark.cpp
+** Headless playsim benchmark
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** -benchmark [file.json] runs the playsim without a frame buffer or sound
+** device and writes the time spent in each tic, split by subsystem, along
+** with a checksum of the final game state.
+**
+** -playdemo or -timedemo selects a demo to run until it ends. Otherwise
+** the start map is run with no player input for -benchtics tics. Unless
+** -rngseed is given the random seed is fixed so that runs are repeatable.
+**
+** The subsystem timers are inclusive and may nest: P_TryMove and sight
+** checks are mostly called from thinkers, which in turn run VM code.
+*/
+
+#include <stdio.h>
+#include <limits.h>
+#include "doomstat.h"
+#include "d_net.h"
+#include "d_player.h"
+#include "g_game.h"
+#include "g_level.h"
+#include "g_levellocals.h"
+#include "m_argv.h"
+#include "m_random.h"
+#include "md5.h"
+#include "actor.h"
+#include "s_sound.h"
+#include "stats.h"
+#include "version.h"
+#include "i_system.h"
+#include "dobject.h"
+
+extern cycle_t ThinkCycles, SightCycles, ACSTime, TryMoveCycles, SoundCycles, EffectCycles;
+extern cycle_t VMCycles[10];
+
+// Default length of a run that does not play a demo.
+enum { BENCH_DEFAULTTICS = 60 * TICRATE };
+
+enum
+{
+	BENCH_Total,
+	BENCH_Thinkers,
+	BENCH_VM,
+	BENCH_ACS,
+	BENCH_Sight,
+	BENCH_TryMove,
+	BENCH_Sound,
+	BENCH_Effects,
+	NUM_BENCH
+};
+
+static const char *BenchColumns[NUM_BENCH] =
+{
+	"total", "thinkers", "vm", "acs", "sight", "trymove", "sound", "effects"
+};
+
+struct FBenchTic
+{
+	double Time[NUM_BENCH];
+};
+
+//==========================================================================
+//
+// Hashes everything the playsim is expected to reproduce exactly.
+// Positions are hashed as fixed point so that the result does not
+// depend on how the last bits of a double were rounded.
+//
+//==========================================================================
+
+static FString BenchmarkChecksum()
+{
+	MD5Context md5;
+	auto add = [&](int32_t v) { md5.Update((const uint8_t *)&v, sizeof(v)); };
+
+	add(level.time);
+	add(FRandom::StaticSumSeeds());
+
+	TThinkerIterator<AActor> it;
+	AActor *ac;
+	while ((ac = it.Next()) != nullptr)
+	{
+		const char *name = ac->GetClass()->TypeName.GetChars();
+		md5.Update((const uint8_t *)name, (unsigned)strlen(name));
+		add(FLOAT2FIXED(ac->X()));
+		add(FLOAT2FIXED(ac->Y()));
+		add(FLOAT2FIXED(ac->Z()));
+		add(FLOAT2FIXED(ac->Vel.X));
+		add(FLOAT2FIXED(ac->Vel.Y));
+		add(FLOAT2FIXED(ac->Vel.Z));
+		add(ac->Angles.Yaw.BAMs());
+		add(ac->health);
+		add(ac->sprite);
+		add(ac->frame);
+		add(ac->flags.GetValue());
+		add(ac->flags2.GetValue());
+		add(ac->flags3.GetValue());
+		add(ac->flags4.GetValue());
+		add(ac->flags5.GetValue());
+		add(ac->flags6.GetValue());
+		add(ac->flags7.GetValue());
+		add(ac->flags8.GetValue());
+	}
+	for (auto &sec : level.sectors)
+	{
+		add(FLOAT2FIXED(sec.floorplane.fD()));
+		add(FLOAT2FIXED(sec.ceilingplane.fD()));
+		add(sec.lightlevel);
+	}
+
+	uint8_t digest[16];
+	md5.Final(digest);
+	FString out;
+	for (int i = 0; i < 16; i++)
+	{
+		out.AppendFormat("%02x", digest[i]);
+	}
+	return out;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static FString JsonString(const char *str)
+{
+	if (str == nullptr)
+		return "null";
+
+	FString out = "\"";
+	for (; *str != 0; str++)
+	{
+		unsigned char c = *str;
+		if (c == '"' || c == '\\') out.AppendFormat("\\%c", c);
+		else if (c < 0x20) out.AppendFormat("\\u%04x", c);
+		else out += (char)c;
+	}
+	out += '"';
+	return out;
+}
+
+static bool WriteBenchmark(const char *filename, const char *demo, const TArray<FBenchTic> &tics, const FBenchTic &totals, const FString &checksum)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == nullptr)
+		return false;
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"version\": %s,\n", JsonString(GetVersionString()).GetChars());
+	fprintf(f, "\t\"map\": %s,\n", JsonString(level.MapName).GetChars());
+	fprintf(f, "\t\"demo\": %s,\n", JsonString(demo).GetChars());
+	fprintf(f, "\t\"tics\": %u,\n", tics.Size());
+	fprintf(f, "\t\"checksum\": \"%s\",\n", checksum.GetChars());
+	fprintf(f, "\t\"columns\": [");
+	for (int i = 0; i < NUM_BENCH; i++)
+	{
+		fprintf(f, "%s\"%s\"", i > 0 ? ", " : "", BenchColumns[i]);
+	}
+	fprintf(f, "],\n\t\"totalms\": {");
+	for (int i = 0; i < NUM_BENCH; i++)
+	{
+		fprintf(f, "%s\"%s\": %.4f", i > 0 ? ", " : "", BenchColumns[i], totals.Time[i]);
+	}
+	fprintf(f, "},\n\t\"ticms\": [");
+	for (unsigned t = 0; t < tics.Size(); t++)
+	{
+		fprintf(f, "%s\n\t\t[", t > 0 ? "," : "");
+		for (int i = 0; i < NUM_BENCH; i++)
+		{
+			fprintf(f, "%s%.4f", i > 0 ? ", " : "", tics[t].Time[i]);
+		}
+		fprintf(f, "]");
+	}
+	fprintf(f, "\n\t]\n}\n");
+	return fclose(f) == 0;
+}
+
+//==========================================================================
+//
+// G_RunBenchmark
+//
+// Called by D_DoomMain before the video is set up.
+//
+//==========================================================================
+
+void G_RunBenchmark()
+{
+	const char *filename = Args->CheckValue("-benchmark");
+	if (filename == nullptr) filename = "benchmark.json";
+
+	const char *demo = Args->CheckValue("-playdemo");
+	if (demo == nullptr) demo = Args->CheckValue("-timedemo");
+
+	const char *v = Args->CheckValue("-benchtics");
+	int maxtics = v != nullptr ? atoi(v) : demo != nullptr ? INT_MAX : BENCH_DEFAULTTICS;
+
+	if (demo != nullptr)
+	{
+		singledemo = true;
+		G_DeferedPlayDemo(demo);
+	}
+	else
+	{
+		if (!use_staticrng)
+		{
+			rngseed = staticrngseed = 0;
+			use_staticrng = true;
+		}
+		G_InitNew(startmap, false);
+	}
+
+	TArray<FBenchTic> tics;
+	FBenchTic totals = {};
+	cycle_t ticcycles;
+	bool started = false;
+
+	while ((int)tics.Size() < maxtics)
+	{
+		ThinkCycles.Reset();
+		VMCycles[0].Reset();
+		ACSTime.Reset();
+		SightCycles.Reset();
+		TryMoveCycles.Reset();
+		SoundCycles.Reset();
+		EffectCycles.Reset();
+		ticcycles.Reset();
+
+		memset(&netcmds[consoleplayer][maketic % BACKUPTICS], 0, sizeof(ticcmd_t));
+
+		ticcycles.Clock();
+		G_Ticker();
+		S_UpdateSounds(players[consoleplayer].camera);
+		ticcycles.Unclock();
+
+		gametic++;
+		maketic++;
+		GC::CheckGC();
+		Net_NewMakeTic();
+
+		if (demo != nullptr)
+		{
+			// The first tic also loads the demo's level and is not counted.
+			if (!started)
+			{
+				started = demoplayback;
+				if (!started) break;
+				continue;
+			}
+			if (!demoplayback) break;
+		}
+
+		FBenchTic &tic = tics[tics.Reserve(1)];
+		tic.Time[BENCH_Total] = ticcycles.TimeMS();
+		tic.Time[BENCH_Thinkers] = ThinkCycles.TimeMS();
+		tic.Time[BENCH_VM] = VMCycles[0].TimeMS();
+		tic.Time[BENCH_ACS] = ACSTime.TimeMS();
+		tic.Time[BENCH_Sight] = SightCycles.TimeMS();
+		tic.Time[BENCH_TryMove] = TryMoveCycles.TimeMS();
+		tic.Time[BENCH_Sound] = SoundCycles.TimeMS();
+		tic.Time[BENCH_Effects] = EffectCycles.TimeMS();
+		for (int i = 0; i < NUM_BENCH; i++)
+		{
+			totals.Time[i] += tic.Time[i];
+		}
+	}
+
+	FString checksum = BenchmarkChecksum();
+	if (!WriteBenchmark(filename, demo, tics, totals, checksum))
+	{
+		I_FatalError("Could not write %s", filename);
+	}
+	Printf("Benchmark: %u tics in %.1f ms (%.3f ms/tic), checksum %s\n", tics.Size(), totals.Time[BENCH_Total],
+		tics.Size() > 0 ? totals.Time[BENCH_Total] / tics.Size() : 0., checksum.GetChars());
+}
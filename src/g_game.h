@@ -63,6 +63,9 @@ void G_PlayDemo (char* name);
 void G_TimeDemo (const char* name);
 bool G_CheckDemoStatus (void);
 
+// Only called by startup code. Runs -benchmark without video or sound.
+void G_RunBenchmark ();
+
 void G_WorldDone (void);
 
 void G_Ticker (void);
@@ -184,7 +184,7 @@ void D_LoadWadSettings ()
 			}
 			cmd[i] = 0;
 			conf += i;
-			if (*conf == '\n')
+			if (conf < eof && *conf == '\n')
 			{
 				conf++;
 			}
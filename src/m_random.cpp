@@ -168,8 +168,22 @@ FRandom::FRandom ()
 //==========================================================================
 
 FRandom::FRandom (const char *name)
+: FRandom (CalcCRC32 ((const uint8_t *)name, (unsigned int)strlen (name)), name)
 {
-	NameCRC = CalcCRC32 ((const uint8_t *)name, (unsigned int)strlen (name));
+}
+
+//==========================================================================
+//
+// FRandom - CRC constructor
+//
+// For RNGs of which only the name's CRC is known, such as the ones
+// referenced by cached script code. The name may be NULL.
+//
+//==========================================================================
+
+FRandom::FRandom (uint32_t namecrc, const char *name)
+{
+	NameCRC = namecrc;
 #ifndef NDEBUG
 	initialized = false;
 	Name = name;
@@ -402,6 +416,50 @@ FRandom *FRandom::StaticFindRNG (const char *name)
 	return probe;
 }
 
+//==========================================================================
+//
+// FRandom :: StaticFindRNGByCRC
+//
+// Returns the RNG StaticFindRNG would return for a name with this CRC.
+// If it does not exist yet, it is created if create is set, otherwise
+// NULL is returned.
+//
+//==========================================================================
+
+FRandom *FRandom::StaticFindRNGByCRC(uint32_t namecrc, bool create)
+{
+	if (namecrc == 0) return &pr_exrandom;
+
+	FRandom *probe = RNGList;
+	while (probe != NULL && probe->NameCRC < namecrc)
+	{
+		probe = probe->Next;
+	}
+	if (probe != NULL && probe->NameCRC == namecrc)
+		return probe;
+	if (!create)
+		return NULL;
+
+	probe = new FRandom(namecrc, NULL);
+	NewRNGs.Push(probe);
+	return probe;
+}
+
+//==========================================================================
+//
+// FRandom :: StaticIsRNG
+//
+//==========================================================================
+
+bool FRandom::StaticIsRNG(const FRandom *rng)
+{
+	for (FRandom *probe = RNGList; probe != NULL; probe = probe->Next)
+	{
+		if (probe == rng) return true;
+	}
+	return false;
+}
+
 //==========================================================================
 //
 // FRandom :: StaticPrintSeeds
@@ -418,7 +476,11 @@ void FRandom::StaticPrintSeeds ()
 	while (rng != NULL)
 	{
 		int idx = rng->idx < SFMT::N32 ? rng->idx : 0;
-		Printf ("%s: %08x .. %d\n", rng->Name, rng->sfmt.u[idx], idx);
+		// RNGs recreated from the code cache only know their CRC.
+		if (rng->Name != NULL)
+			Printf ("%s: %08x .. %d\n", rng->Name, rng->sfmt.u[idx], idx);
+		else
+			Printf ("[%08x]: %08x .. %d\n", rng->NameCRC, rng->sfmt.u[idx], idx);
 		rng = rng->Next;
 	}
 }
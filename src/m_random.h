@@ -177,12 +177,18 @@ public:
 	static void StaticReadRNGState (FSerializer &arc);
 	static void StaticWriteRNGState (FSerializer &file);
 	static FRandom *StaticFindRNG(const char *name);
+	static FRandom *StaticFindRNGByCRC(uint32_t namecrc, bool create = false);
+	static bool StaticIsRNG(const FRandom *rng);
+
+	uint32_t GetNameCRC() const { return NameCRC; }
 
 #ifndef NDEBUG
 	static void StaticPrintSeeds ();
 #endif
 
 private:
+	FRandom (uint32_t namecrc, const char *name);
+
 #ifndef NDEBUG
 	const char *Name;
 #endif
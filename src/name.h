@@ -70,6 +70,9 @@ public:
 
 	bool IsValidName() const { return (unsigned)Index < (unsigned)NameData.NumNames; }
 
+	// Number of names created so far. New names always get the next index.
+	static int GetNumNames() { return NameData.NumNames; }
+
 	// Note that the comparison operators compare the names' indices, not
 	// their text, so they cannot be used to do a lexicographical sort.
 	bool operator == (const FName &other) const { return Index == other.Index; }
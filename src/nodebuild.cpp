@@ -50,11 +50,22 @@
 #include "tarray.h"
 #include "m_bbox.h"
 #include "c_console.h"
+#include "c_cvars.h"
 #include "r_state.h"
+#include "workerpool.h"
+#include "c_dispatch.h"
+#include "doomstat.h"
+#include "g_levellocals.h"
+
+// Score candidate splitters on the worker pool. The result is identical to
+// scoring them one after another.
+CVAR(Bool, parallelnodes, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 const int MaxSegs = 64;
 const int SplitCost = 8;
 const int AAPreference = 16;
+const unsigned int MinParallelWork = 32768;	// candidates * segs in set
+const int ClassifyBatch = 32;				// segs classified together by Heuristic
 
 #if 0
 #define D(x) x
@@ -114,6 +125,8 @@ void FNodeBuilder::Clear()
 	Planes.Clear();
 	Touched.Clear();
 	Colinear.Clear();
+	Candidates.Clear();
+	Scores.Clear();
 	SplitSharers.Clear();
 	if (VertexMap == NULL)
 	{
@@ -452,6 +465,7 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 	int bestvalue;
 	uint32_t bestseg;
 	uint32_t seg;
+	unsigned int segsInSet;
 	bool nosplitters = false;
 
 	bestvalue = 0;
@@ -459,8 +473,10 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 
 	seg = set;
 	stepleft = 0;
+	segsInSet = 0;
 
 	memset (&PlaneChecked[0], 0, PlaneChecked.Size());
+	Candidates.Clear ();
 
 	D(Printf (PRINT_LOG, "Processing set %d\n", set));
 
@@ -481,26 +497,52 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 				}
 
 				stepleft = step;
-				SetNodeFromSeg (node, pseg);
+				Candidates.Push (seg);
+			}
+		}
 
-				int value = Heuristic (node, set, nosplit);
+		seg = pseg->next;
+		segsInSet++;
+	}
 
-				D(Printf (PRINT_LOG, "Seg %5d, ld %d (%5d,%5d)-(%5d,%5d) scores %d\n", seg, Segs[seg].linedef, node.x>>16, node.y>>16,
-					(node.x+node.dx)>>16, (node.y+node.dy)>>16, value));
+	// Scoring a splitter only reads the segs, so all candidates can be scored
+	// at the same time. The best one is still picked in list order below.
+	Scores.Resize (Candidates.Size());
+	if (parallelnodes && Candidates.Size() > 1 && Candidates.Size() * segsInSet >= MinParallelWork)
+	{
+		FWorkerPool::Instance()->ParallelFor ((int)Candidates.Size(), [&](int i)
+		{
+			node_t test;
+			TArray<int> touched, colinear;
 
-				if (value > bestvalue)
-				{
-					bestvalue = value;
-					bestseg = seg;
-				}
-				else if (value < 0)
-				{
-					nosplitters = true;
-				}
-			}
+			SetNodeFromSeg (test, &Segs[Candidates[i]]);
+			Scores[i] = Heuristic (test, set, nosplit, touched, colinear);
+		});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < Candidates.Size(); ++i)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates[i]]);
+			Scores[i] = Heuristic (node, set, nosplit);
 		}
+	}
 
-		seg = pseg->next;
+	for (unsigned int i = 0; i < Candidates.Size(); ++i)
+	{
+		int value = Scores[i];
+
+		D(Printf (PRINT_LOG, "Seg %5d, ld %d scores %d\n", Candidates[i], Segs[Candidates[i]].linedef, value));
+
+		if (value > bestvalue)
+		{
+			bestvalue = value;
+			bestseg = Candidates[i];
+		}
+		else if (value < 0)
+		{
+			nosplitters = true;
+		}
 	}
 
 	if (bestseg == DWORD_MAX)
@@ -523,6 +565,11 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 // in the set.
 
 int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
+{
+	return Heuristic (node, set, honorNoSplit, Touched, Colinear);
+}
+
+int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit, TArray<int> &touched, TArray<int> &colinear)
 {
 	// Set the initial score above 0 so that near vertex anti-weighting is less likely to produce a negative score.
 	int score = 1000000;
@@ -537,141 +584,158 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	unsigned int max, m2, p, q;
 	double frac;
 
-	Touched.Clear ();
-	Colinear.Clear ();
+	touched.Clear ();
+	colinear.Clear ();
 
 	while (i != DWORD_MAX)
 	{
-		const FPrivSeg *test = &Segs[i];
+		// Classify the vertices of the next batch of segs in one go.
+		const FSimpleVert *points[ClassifyBatch*2];
+		int pointSides[ClassifyBatch*2];
+		int batch = 0;
 
-		if (HackSeg == i)
+		for (uint32_t j = i; j != DWORD_MAX && batch < ClassifyBatch; j = Segs[j].next, ++batch)
 		{
-			side = 1;
+			points[batch*2] = &Vertices[Segs[j].v1];
+			points[batch*2+1] = &Vertices[Segs[j].v2];
 		}
-		else
-		{
-			side = ClassifyLine (node, &Vertices[test->v1], &Vertices[test->v2], sidev);
-		}
-		switch (side)
+		ClassifyPoints (node, points, batch*2, pointSides);
+
+		for (int k = 0; k < batch; ++k)
 		{
-		case 0:	// Seg is on only one side of the partition
-		case 1:
-			// If we don't split this line, but it abuts the splitter, also reject it.
-			// The "right" thing to do in this case is to only reject it if there is
-			// another nosplit seg from the same sector at this vertex. Note that a line
-			// that lies exactly on top of the splitter is okay.
-			if (test->loopnum && honorNoSplit && (sidev[0] == 0 || sidev[1] == 0))
+			const FPrivSeg *test = &Segs[i];
+
+			if (HackSeg == i)
 			{
-				if ((sidev[0] | sidev[1]) != 0)
+				side = 1;
+			}
+			else
+			{
+				sidev[0] = pointSides[k*2];
+				sidev[1] = pointSides[k*2+1];
+				side = ClassifySide (node, &Vertices[test->v1], &Vertices[test->v2], sidev);
+			}
+			switch (side)
+			{
+			case 0:	// Seg is on only one side of the partition
+			case 1:
+				// If we don't split this line, but it abuts the splitter, also reject it.
+				// The "right" thing to do in this case is to only reject it if there is
+				// another nosplit seg from the same sector at this vertex. Note that a line
+				// that lies exactly on top of the splitter is okay.
+				if (test->loopnum && honorNoSplit && (sidev[0] == 0 || sidev[1] == 0))
 				{
-					max = Touched.Size();
-					for (p = 0; p < max; ++p)
+					if ((sidev[0] | sidev[1]) != 0)
 					{
-						if (Touched[p] == test->loopnum)
+						max = touched.Size();
+						for (p = 0; p < max; ++p)
 						{
-							break;
+							if (touched[p] == test->loopnum)
+							{
+								break;
+							}
 						}
-					}
-					if (p == max)
-					{
-						Touched.Push (test->loopnum);
-					}
-				}
-				else
-				{
-					max = Colinear.Size();
-					for (p = 0; p < max; ++p)
-					{
-						if (Colinear[p] == test->loopnum)
+						if (p == max)
 						{
-							break;
+							touched.Push (test->loopnum);
 						}
 					}
-					if (p == max)
+					else
 					{
-						Colinear.Push (test->loopnum);
+						max = colinear.Size();
+						for (p = 0; p < max; ++p)
+						{
+							if (colinear[p] == test->loopnum)
+							{
+								break;
+							}
+						}
+						if (p == max)
+						{
+							colinear.Push (test->loopnum);
+						}
 					}
 				}
-			}
 
-			counts[side]++;
-			if (test->linedef != -1)
-			{
-				realSegs[side]++;
-				if (test->frontsector == test->backsector)
+				counts[side]++;
+				if (test->linedef != -1)
 				{
-					specialSegs[side]++;
-				}
-				// Add some weight to the score for unsplit lines
-				score += SplitCost;	
-			}
-			else
-			{
-				// Minisegs don't count quite as much for nosplitting
-				score += SplitCost / 4;
-			}
-			break;
-
-		default:	// Seg is cut by the partition
-			// If we are not allowed to split this seg, reject this splitter
-			if (test->loopnum)
-			{
-				if (honorNoSplit)
-				{
-					D(Printf (PRINT_LOG, "Splits seg %d\n", i));
-					return -1;
+					realSegs[side]++;
+					if (test->frontsector == test->backsector)
+					{
+						specialSegs[side]++;
+					}
+					// Add some weight to the score for unsplit lines
+					score += SplitCost;	
 				}
 				else
 				{
-					splitter = true;
+					// Minisegs don't count quite as much for nosplitting
+					score += SplitCost / 4;
 				}
-			}
+				break;
 
-			// Splitters that are too close to a vertex are bad.
-			frac = InterceptVector (node, *test);
-			if (frac < 0.001 || frac > 0.999)
-			{
-				FPrivVert *v1 = &Vertices[test->v1];
-				FPrivVert *v2 = &Vertices[test->v2];
-				double x = v1->x, y = v1->y;
-				x += frac * (v2->x - x);
-				y += frac * (v2->y - y);
-				if (fabs(x - v1->x) < VERTEX_EPSILON+1 && fabs(y - v1->y) < VERTEX_EPSILON+1)
-				{
-					D(Printf("Splitter will produce same start vertex as seg %d\n", i));
-					return -1;
-				}
-				if (fabs(x - v2->x) < VERTEX_EPSILON+1 && fabs(y - v2->y) < VERTEX_EPSILON+1)
+			default:	// Seg is cut by the partition
+				// If we are not allowed to split this seg, reject this splitter
+				if (test->loopnum)
 				{
-					D(Printf("Splitter will produce same end vertex as seg %d\n", i));
-					return -1;
+					if (honorNoSplit)
+					{
+						D(Printf (PRINT_LOG, "Splits seg %d\n", i));
+						return -1;
+					}
+					else
+					{
+						splitter = true;
+					}
 				}
-				if (frac > 0.999)
+
+				// Splitters that are too close to a vertex are bad.
+				frac = InterceptVector (node, *test);
+				if (frac < 0.001 || frac > 0.999)
 				{
-					frac = 1 - frac;
+					FPrivVert *v1 = &Vertices[test->v1];
+					FPrivVert *v2 = &Vertices[test->v2];
+					double x = v1->x, y = v1->y;
+					x += frac * (v2->x - x);
+					y += frac * (v2->y - y);
+					if (fabs(x - v1->x) < VERTEX_EPSILON+1 && fabs(y - v1->y) < VERTEX_EPSILON+1)
+					{
+						D(Printf("Splitter will produce same start vertex as seg %d\n", i));
+						return -1;
+					}
+					if (fabs(x - v2->x) < VERTEX_EPSILON+1 && fabs(y - v2->y) < VERTEX_EPSILON+1)
+					{
+						D(Printf("Splitter will produce same end vertex as seg %d\n", i));
+						return -1;
+					}
+					if (frac > 0.999)
+					{
+						frac = 1 - frac;
+					}
+					int penalty = int(1 / frac);
+					score = MAX(score - penalty, 1);
+					D(Printf ("Penalized splitter by %d for being near endpt of seg %d (%f).\n", penalty, i, frac));
 				}
-				int penalty = int(1 / frac);
-				score = MAX(score - penalty, 1);
-				D(Printf ("Penalized splitter by %d for being near endpt of seg %d (%f).\n", penalty, i, frac));
-			}
 
-			counts[0]++;
-			counts[1]++;
-			if (test->linedef != -1)
-			{
-				realSegs[0]++;
-				realSegs[1]++;
-				if (test->frontsector == test->backsector)
+				counts[0]++;
+				counts[1]++;
+				if (test->linedef != -1)
 				{
-					specialSegs[0]++;
-					specialSegs[1]++;
+					realSegs[0]++;
+					realSegs[1]++;
+					if (test->frontsector == test->backsector)
+					{
+						specialSegs[0]++;
+						specialSegs[1]++;
+					}
 				}
+				break;
 			}
-			break;
-		}
 
-		segsInSet++;
-		i = test->next;
+			segsInSet++;
+			i = test->next;
+		}
 	}
 
 	// If this line is outside all the others, return a special score
@@ -706,8 +770,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	// seg of that sector must be crossing the container's corner and does not
 	// actually split the container.
 
-	max = Touched.Size ();
-	m2 = Colinear.Size ();
+	max = touched.Size ();
+	m2 = colinear.Size ();
 
 	// If honorNoSplit is false, then both these lists will be empty.
 
@@ -720,10 +784,10 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 
 	for (p = 0; p < max; ++p)
 	{
-		int look = Touched[p];
+		int look = touched[p];
 		for (q = 0; q < m2; ++q)
 		{
-			if (look == Colinear[q])
+			if (look == colinear[q])
 			{
 				break;
 			}
@@ -760,6 +824,72 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	return score;
 }
 
+// Classifies points against a splitter with the best kernel for this CPU.
+// All kernels return the same result.
+
+void FNodeBuilder::ClassifyPoints (const node_t &node, const FSimpleVert *const *points, int count, int *sides)
+{
+#ifndef NO_SSE
+	if (CPU.bAVX)
+	{
+		ClassifyPointsAVX (node, points, count, sides);
+		return;
+	}
+	if (CPU.bSSE2)
+	{
+		ClassifyPointsSSE2 (node, points, count, sides);
+		return;
+	}
+#endif
+	ClassifyPointsC (node, points, count, sides);
+}
+
+int FNodeBuilder::TestClassifyKernels (node_t &node, const FSimpleVert *verts, int numsegs)
+{
+	typedef void (*ClassifyFunc)(const node_t &, const FSimpleVert *const *, int, int *);
+
+	ClassifyFunc kernels[3];
+	int numkernels = 0;
+	int errors = 0;
+
+	kernels[numkernels++] = ClassifyPointsC;
+#ifndef NO_SSE
+	if (CPU.bSSE2) kernels[numkernels++] = ClassifyPointsSSE2;
+	if (CPU.bAVX) kernels[numkernels++] = ClassifyPointsAVX;
+#endif
+
+	TArray<const FSimpleVert *> points(numsegs * 2, true);
+	TArray<int> sides(numsegs * 2, true);
+	for (int i = 0; i < numsegs * 2; ++i)
+	{
+		points[i] = &verts[i];
+	}
+
+	for (int k = 0; k < numkernels; ++k)
+	{
+		kernels[k] (node, &points[0], numsegs * 2, &sides[0]);
+
+		for (int i = 0; i < numsegs; ++i)
+		{
+			FPrivVert v1, v2;
+			int sidev[2];
+
+			v1.x = verts[i*2].x;
+			v1.y = verts[i*2].y;
+			v2.x = verts[i*2+1].x;
+			v2.y = verts[i*2+1].y;
+			int side = ClassifyLine (node, &v1, &v2, sidev);
+
+			if (sidev[0] != sides[i*2] || sidev[1] != sides[i*2+1] ||
+				side != ClassifySide (node, &verts[i*2], &verts[i*2+1], &sides[i*2]))
+			{
+				errors++;
+			}
+		}
+	}
+	return errors;
+}
+
 void FNodeBuilder::SplitSegs (uint32_t set, node_t &node, uint32_t splitseg, uint32_t &outset0, uint32_t &outset1, unsigned int &count0, unsigned int &count1)
 {
 	unsigned int _count0 = 0;
@@ -1078,3 +1208,93 @@ void FNodeBuilder::PrintSet (int l, uint32_t set)
 	}
 	Printf (PRINT_LOG, "*\n");
 }
+
+//==========================================================================
+//
+// testnodeclassify [count]
+//
+// Checks that all seg classification kernels agree with ClassifyLine on
+// random splitters, on segs placed close to them, and on the lines of the
+// current map.
+//
+//==========================================================================
+
+CCMD (testnodeclassify)
+{
+	int count = argv.argc() > 1 ? MAX(atoi(argv[1]), 1) : 1000;
+	uint32_t seed = 0x9e3779b9;
+	auto random = [&]() -> int
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return int(seed & 0x7fffffff);
+	};
+
+	const int NumSegs = 257;	// odd, so that the kernels' tail handling gets tested
+	TArray<FSimpleVert> verts(NumSegs * 2, true);
+	int errors = 0;
+	int tests = 0;
+
+	for (int i = 0; i < count; ++i)
+	{
+		node_t node;
+		node.x = (random() % 16384 - 8192) << FRACBITS;
+		node.y = (random() % 16384 - 8192) << FRACBITS;
+		node.dx = (random() % 4 == 0) ? 0 : (random() % 4096 - 2048) << FRACBITS;
+		node.dy = (node.dx != 0 && random() % 4 == 0) ? 0 : (random() % 4096 - 2048) << FRACBITS;
+		if (node.dx == 0 && node.dy == 0) node.dy = FRACUNIT;
+
+		for (unsigned j = 0; j < verts.Size(); ++j)
+		{
+			if (j & 2)
+			{
+				// Anywhere in the map
+				verts[j].x = (random() % 16384 - 8192) << FRACBITS;
+				verts[j].y = (random() % 16384 - 8192) << FRACBITS;
+			}
+			else
+			{
+				// On or very close to the splitter
+				double t = (random() % 4096 - 2048) / 1024.;
+				verts[j].x = fixed_t(node.x + t * node.dx) + random() % 64 - 32;
+				verts[j].y = fixed_t(node.y + t * node.dy) + random() % 64 - 32;
+			}
+		}
+		errors += FNodeBuilder::TestClassifyKernels (node, &verts[0], NumSegs);
+		tests += NumSegs;
+	}
+
+	if (gamestate == GS_LEVEL && level.lines.Size() > 0)
+	{
+		unsigned numlines = level.lines.Size();
+		verts.Resize(numlines * 2);
+		for (unsigned j = 0; j < numlines; ++j)
+		{
+			verts[j*2].x = FLOAT2FIXED(level.lines[j].v1->fX());
+			verts[j*2].y = FLOAT2FIXED(level.lines[j].v1->fY());
+			verts[j*2+1].x = FLOAT2FIXED(level.lines[j].v2->fX());
+			verts[j*2+1].y = FLOAT2FIXED(level.lines[j].v2->fY());
+		}
+		for (unsigned j = 0; j < numlines; j += MAX(numlines / count, 1u))
+		{
+			node_t node;
+			node.x = verts[j*2].x;
+			node.y = verts[j*2].y;
+			node.dx = verts[j*2+1].x - node.x;
+			node.dy = verts[j*2+1].y - node.y;
+			if (node.dx == 0 && node.dy == 0) continue;
+
+			errors += FNodeBuilder::TestClassifyKernels (node, &verts[0], numlines);
+			tests += numlines;
+		}
+	}
+
+	Printf ("Kernels:%s%s  %d segs tested, %d mismatches\n",
+#ifndef NO_SSE
+		CPU.bSSE2 ? " SSE2" : "", CPU.bAVX ? " AVX" : "",
+#else
+		"", "",
+#endif
+		tests, errors);
+}
@@ -249,6 +249,24 @@ public:
 
 	static inline int PointOnSide (int x, int y, int x1, int y1, int dx, int dy);
 
+	// Classifies a batch of points against a splitter, using the same rules
+	// as ClassifyLine does for a seg's vertices:
+	//   -1 : in front of line
+	//    0 : on line
+	//    1 : behind line
+	// ClassifyPoints picks the fastest kernel the CPU supports.
+
+	static void ClassifyPoints (const node_t &node, const FSimpleVert *const *points, int count, int *sides);
+	static void ClassifyPointsC (const node_t &node, const FSimpleVert *const *points, int count, int *sides);
+#ifndef NO_SSE
+	static void ClassifyPointsSSE2 (const node_t &node, const FSimpleVert *const *points, int count, int *sides);
+	static void ClassifyPointsAVX (const node_t &node, const FSimpleVert *const *points, int count, int *sides);
+#endif
+
+	// Checks all classification kernels against ClassifyLine for the segs
+	// (verts[0],verts[1]), (verts[2],verts[3]), ... Returns the number of mismatches.
+	static int TestClassifyKernels (node_t &node, const FSimpleVert *verts, int numsegs);
+
 private:
 	IVertexMap *VertexMap;
 	int *OldVertexTable;
@@ -264,6 +282,8 @@ private:
 
 	TArray<int> Touched;	// Loops a splitter touches on a vertex
 	TArray<int> Colinear;	// Loops with edges colinear to a splitter
+	TArray<uint32_t> Candidates;	// Splitters considered for the current set
+	TArray<int> Scores;		// Heuristic scores of the candidates
 	FEventTree Events;		// Vertices intersected by the current splitter
 
 	TArray<FSplitSharer> SplitSharers;	// Segs colinear with the current splitter
@@ -295,13 +315,17 @@ private:
 	void SplitSegs (uint32_t set, node_t &node, uint32_t splitseg, uint32_t &outset0, uint32_t &outset1, unsigned int &count0, unsigned int &count1);
 	uint32_t SplitSeg (uint32_t segnum, int splitvert, int v1InFront);
 	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit);
+	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit, TArray<int> &touched, TArray<int> &colinear);
 
 	// Returns:
 	//	0 = seg is in front
 	//  1 = seg is in back
 	// -1 = seg cuts the node
 
-	int ClassifyLine (node_t &node, const FPrivVert *v1, const FPrivVert *v2, int sidev[2]);
+	static int ClassifyLine (node_t &node, const FPrivVert *v1, const FPrivVert *v2, int sidev[2]);
+
+	// Does the same as the end of ClassifyLine with vertex sides from ClassifyPoints.
+	static inline int ClassifySide (const node_t &node, const FSimpleVert *v1, const FSimpleVert *v2, const int sidev[2]);
 
 	void FixSplitSharers (const node_t &node);
 	double AddIntersection (const node_t &node, int vertex);
@@ -360,3 +384,30 @@ inline int FNodeBuilder::PointOnSide (int x, int y, int x1, int y1, int dx, int
 	}
 	return s_num > 0.0 ? -1 : 1;
 }
+
+inline int FNodeBuilder::ClassifySide (const node_t &node, const FSimpleVert *v1, const FSimpleVert *v2, const int sidev[2])
+{
+	if ((sidev[0] | sidev[1]) == 0)
+	{ // seg is coplanar with the splitter, so use its orientation to determine
+	  // which child it ends up in. If it faces the same direction as the splitter,
+	  // it goes in front. Otherwise, it goes in back.
+
+		if (node.dx != 0)
+		{
+			return ((node.dx > 0 && v2->x > v1->x) || (node.dx < 0 && v2->x < v1->x)) ? 0 : 1;
+		}
+		else
+		{
+			return ((node.dy > 0 && v2->y > v1->y) || (node.dy < 0 && v2->y < v1->y)) ? 0 : 1;
+		}
+	}
+	else if (sidev[0] <= 0 && sidev[1] <= 0)
+	{
+		return 0;
+	}
+	else if (sidev[0] >= 0 && sidev[1] >= 0)
+	{
+		return 1;
+	}
+	return -1;
+}
@@ -134,3 +134,26 @@ int FNodeBuilder::ClassifyLine(node_t &node, const FPrivVert *v1, const FPrivVer
 	}
 	return -1;
 }
+
+void FNodeBuilder::ClassifyPointsC(const node_t &node, const FSimpleVert *const *points, int count, int *sides)
+{
+	double d_x1 = double(node.x);
+	double d_y1 = double(node.y);
+	double d_dx = double(node.dx);
+	double d_dy = double(node.dy);
+	double l = 1.f / (d_dx*d_dx + d_dy*d_dy);
+
+	for (int i = 0; i < count; ++i)
+	{
+		double s_num = (d_y1 - double(points[i]->y)) * d_dx - (d_x1 - double(points[i]->x)) * d_dy;
+
+		if (s_num > -FAR_ENOUGH && s_num < FAR_ENOUGH && s_num * s_num * l < SIDE_EPSILON*SIDE_EPSILON)
+		{
+			sides[i] = 0;
+		}
+		else
+		{
+			sides[i] = s_num > 0.0 ? -1 : 1;
+		}
+	}
+}
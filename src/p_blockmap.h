@@ -2,6 +2,8 @@
 #define __P_BLOCKMAP_H
 
 #include "doomtype.h"
+#include "tarray.h"
+#include "memarena.h"
 
 class AActor;
 
@@ -20,6 +22,17 @@ struct FBlockNode
 	void Release ();
 
 	static FBlockNode *FreeBlocks;
+	static FMemArena Arena;			// nodes are never freed individually
+	static int NumNodes;
+};
+
+// The actors of one block, in the same order as its chain of block nodes.
+// Iterating these is a lot cheaper than walking the chain, since the
+// entries are next to each other in memory.
+struct FBlockEntry
+{
+	AActor *Actor;
+	bool SingleBlock;				// the actor is in no other block, so it can only be found once
 };
 
 // BLOCKMAP
@@ -40,6 +53,7 @@ struct FBlockmap
 	double				bmaporgx;
 	double				bmaporgy;		// origin of block map
 	FBlockNode**		blocklinks; 	// for thing chains
+	TArray<FBlockEntry>*	blockcells;		// for thing iterators; the chain's head is the last entry
 
 	// mapblocks are used to check movement
 	// against lines and things
@@ -75,6 +89,10 @@ struct FBlockmap
 
 	bool VerifyBlockMap(int count);
 
+	void LinkCells(AActor *actor);
+	void UnlinkCells(AActor *actor);
+	void RebuildCell(int index);
+
 	void Clear()
 	{
 		if (blockmaplump != NULL)
@@ -87,6 +105,11 @@ struct FBlockmap
 			delete[] blocklinks;
 			blocklinks = NULL;
 		}
+		if (blockcells != NULL)
+		{
+			delete[] blockcells;
+			blockcells = NULL;
+		}
 	}
 
 };
@@ -55,6 +55,9 @@
 #include "r_utility.h"
 #include "g_levellocals.h"
 #include "vm.h"
+#include "stats.h"
+#include "c_dispatch.h"
+#include "portal.h"
 
 CVAR (Int, cl_rockettrails, 1, CVAR_ARCHIVE);
 CVAR (Bool, r_rail_smartspiral, 0, CVAR_ARCHIVE);
@@ -62,16 +65,20 @@ CVAR (Int, r_rail_spiralsparsity, 1, CVAR_ARCHIVE);
 CVAR (Int, r_rail_trailsparsity, 1, CVAR_ARCHIVE);
 CVAR (Bool, r_particles, true, 0);
 
+cycle_t EffectCycles;
+
 FRandom pr_railtrail("RailTrail");
 
 #define FADEFROMTTL(a)	(1.f/(a))
 
+// Upper limit for r_maxparticles.
+enum { MAX_PARTICLES = 1 << 18 };
+
 // [RH] particle globals
-uint16_t			NumParticles;
-uint16_t			ActiveParticles;
-uint16_t			InactiveParticles;
+uint32_t			NumParticles;
+uint32_t			ActiveParticles;
 particle_t		*Particles;
-TArray<uint16_t>	ParticlesInSubsec;
+TArray<uint32_t>	ParticlesInSubsec;
 
 static int grey1, grey2, grey3, grey4, red, green, blue, yellow, black,
 		   red1, green1, blue1, yellow1, purple, purple1, white,
@@ -114,12 +121,10 @@ static const struct ColorList {
 inline particle_t *NewParticle (void)
 {
 	particle_t *result = NULL;
-	if (InactiveParticles != NO_PARTICLE)
+	if (ActiveParticles < NumParticles)
 	{
-		result = Particles + InactiveParticles;
-		InactiveParticles = result->tnext;
-		result->tnext = ActiveParticles;
-		ActiveParticles = uint16_t(result - Particles);
+		result = Particles + ActiveParticles++;
+		memset (result, 0, sizeof(particle_t));
 	}
 	return result;
 }
@@ -136,8 +141,8 @@ CUSTOM_CVAR( Int, r_maxparticles, 4000, CVAR_ARCHIVE )
 {
 	if ( self == 0 )
 		self = 4000;
-	else if (self > 65535)
-		self = 65535;
+	else if (self > MAX_PARTICLES)
+		self = MAX_PARTICLES;
 	else if (self < 100)
 		self = 100;
 
@@ -160,7 +165,7 @@ void P_InitParticles ()
 		num = r_maxparticles;
 
 	// This should be good, but eh...
-	NumParticles = (uint16_t)clamp<int>(num, 100, 65535);
+	NumParticles = (uint32_t)clamp<int>(num, 100, MAX_PARTICLES);
 
 	P_DeinitParticles();
 	Particles = new particle_t[NumParticles];
@@ -179,19 +184,15 @@ void P_DeinitParticles()
 
 void P_ClearParticles ()
 {
-	int i;
-
-	memset (Particles, 0, NumParticles * sizeof(particle_t));
-	ActiveParticles = NO_PARTICLE;
-	InactiveParticles = 0;
-	for (i = 0; i < NumParticles-1; i++)
-		Particles[i].tnext = i + 1;
-	Particles[i].tnext = NO_PARTICLE;
+	ActiveParticles = 0;
 }
 
 // Group particles by subsectors. Because particles are always
 // in motion, there is little benefit to caching this information
 // from one frame to the next.
+//
+// The array is walked backwards so that the particles of each
+// subsector end up linked in the order they are stored in.
 
 void P_FindParticleSubsectors ()
 {
@@ -200,18 +201,19 @@ void P_FindParticleSubsectors ()
 		ParticlesInSubsec.Reserve (level.subsectors.Size() - ParticlesInSubsec.Size());
 	}
 
-	fillshort (&ParticlesInSubsec[0], level.subsectors.Size(), NO_PARTICLE);
+	memset (&ParticlesInSubsec[0], 0xff, level.subsectors.Size() * sizeof(uint32_t));
 
 	if (!r_particles)
 	{
 		return;
 	}
-	for (uint16_t i = ActiveParticles; i != NO_PARTICLE; i = Particles[i].tnext)
+	for (uint32_t i = ActiveParticles; i-- > 0; )
 	{
+		particle_t *particle = &Particles[i];
 		 // Try to reuse the subsector from the last portal check, if still valid.
-		if (Particles[i].subsector == NULL) Particles[i].subsector = R_PointInSubsector(Particles[i].Pos);
-		int ssnum = Particles[i].subsector->Index();
-		Particles[i].snext = ParticlesInSubsec[ssnum];
+		if (particle->subsector == NULL) particle->subsector = R_PointInSubsector(particle->Pos);
+		int ssnum = particle->subsector->Index();
+		particle->snext = ParticlesInSubsec[ssnum];
 		ParticlesInSubsec[ssnum] = i;
 	}
 }
@@ -256,18 +258,20 @@ void P_InitEffects ()
 
 void P_ThinkParticles ()
 {
-	int i;
-	particle_t *particle, *prev;
+	FCycleScope clock(EffectCycles);
+	particle_t *particle;
+	bool frozen = bglobal.freeze || (level.flags2 & LEVEL2_FROZEN);
+	bool lineportals = PortalBlockmap.containsLines;
 
-	i = ActiveParticles;
-	prev = NULL;
-	while (i != NO_PARTICLE)
+	// Expired particles are replaced by the last active one, which is
+	// then processed in the same slot, so the active ones stay packed.
+	uint32_t i = 0;
+	while (i < ActiveParticles)
 	{
 		particle = Particles + i;
-		i = particle->tnext;
-		if (!particle->notimefreeze && ((bglobal.freeze) || (level.flags2 & LEVEL2_FROZEN)))
+		if (frozen && !particle->notimefreeze)
 		{
-			prev = particle;
+			i++;
 			continue;
 		}
 		
@@ -276,21 +280,25 @@ void P_ThinkParticles ()
 		particle->size += particle->sizestep;
 		if (particle->alpha <= 0 || oldtrans < particle->alpha || --particle->ttl <= 0 || (particle->size <= 0))
 		{ // The particle has expired, so free it
-			memset (particle, 0, sizeof(particle_t));
-			if (prev)
-				prev->tnext = i;
-			else
-				ActiveParticles = i;
-			particle->tnext = InactiveParticles;
-			InactiveParticles = (int)(particle - Particles);
+			if (i != --ActiveParticles)
+			{
+				*particle = Particles[ActiveParticles];
+			}
 			continue;
 		}
 
 		// Handle crossing a line portal
-		DVector2 newxy = P_GetOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
-		particle->Pos.X = newxy.X;
-		particle->Pos.Y = newxy.Y;
-		particle->Pos.Z += particle->Vel.Z;
+		if (lineportals)
+		{
+			DVector2 newxy = P_GetOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
+			particle->Pos.X = newxy.X;
+			particle->Pos.Y = newxy.Y;
+			particle->Pos.Z += particle->Vel.Z;
+		}
+		else
+		{
+			particle->Pos += particle->Vel;
+		}
 		particle->Vel += particle->Acc;
 		particle->subsector = R_PointInSubsector(particle->Pos);
 		sector_t *s = particle->subsector->sector;
@@ -311,7 +319,7 @@ void P_ThinkParticles ()
 				particle->subsector = NULL;
 			}
 		}
-		prev = particle;
+		i++;
 	}
 }
 
@@ -350,6 +358,7 @@ void P_SpawnParticle(const DVector3 &pos, const DVector3 &vel, const DVector3 &a
 //
 void P_RunEffects ()
 {
+	FCycleScope clock(EffectCycles);
 	if (players[consoleplayer].camera == NULL) return;
 
 	int	pnum = players[consoleplayer].camera->Sector->Index() * level.sectors.Size();
@@ -963,3 +972,55 @@ void P_DisconnectEffect (AActor *actor)
 		p->size = 4;
 	}
 }
+
+//==========================================================================
+//
+// CCMD particlebench
+//
+// Keeps the given number of particles alive around the camera and times
+// how long thinking and sorting them into subsectors takes per tic.
+// The particles that were active before are lost.
+//
+//==========================================================================
+
+CCMD (particlebench)
+{
+	AActor *camera = players[consoleplayer].camera;
+	if (gamestate != GS_LEVEL || camera == NULL)
+	{
+		Printf ("Not in a level\n");
+		return;
+	}
+	int count = argv.argc() > 1 ? atoi(argv[1]) : (int)NumParticles;
+	int tics = argv.argc() > 2 ? atoi(argv[2]) : TICRATE * 10;
+	if (count > (int)NumParticles)
+	{
+		Printf ("Only %u particles are available, change r_maxparticles to get more\n", NumParticles);
+		count = NumParticles;
+	}
+	count = MAX(count, 1);
+	tics = MAX(tics, 1);
+
+	cycle_t think, find;
+	think.Reset();
+	find.Reset();
+	P_ClearParticles ();
+	for (int tic = 0; tic < tics; tic++)
+	{
+		while ((int)ActiveParticles < count)
+		{
+			DVector3 pos = camera->Vec3Offset((M_Random() - 128) * 4., (M_Random() - 128) * 4., M_Random() / 4.);
+			DVector3 vel((M_Random() - 128) / 64., (M_Random() - 128) / 64., M_Random() / 128.);
+			P_SpawnParticle(pos, vel, DVector3(0, 0, -1. / 32), PalEntry(255, 255, 255), 1., 35 + (M_Random() & 63), 2., -1, 0);
+		}
+		think.Clock();
+		P_ThinkParticles ();
+		think.Unclock();
+		find.Clock();
+		P_FindParticleSubsectors ();
+		find.Unclock();
+	}
+	P_ClearParticles ();
+	Printf ("%d particles, %d tics: think %.3f ms/tic, subsectors %.3f ms/tic\n", count, tics,
+		think.TimeMS() / tics, find.TimeMS() / tics);
+}
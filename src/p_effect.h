@@ -58,14 +58,15 @@ struct particle_t
 	float	fadestep;
 	float	alpha;
 	int		color;
-	uint16_t	tnext;
-	uint16_t	snext;
+	uint32_t	snext;
 };
 
+// Active particles are kept at the start of the array, in no particular order.
 extern particle_t *Particles;
-extern TArray<uint16_t>		ParticlesInSubsec;
+extern uint32_t ActiveParticles;
+extern TArray<uint32_t>		ParticlesInSubsec;
 
-const uint16_t NO_PARTICLE = 0xffff;
+const uint32_t NO_PARTICLE = 0xffffffff;
 
 void P_ClearParticles ();
 void P_FindParticleSubsectors ();
@@ -1436,13 +1436,13 @@ DEFINE_ACTION_FUNCTION(AActor, LookForMonsters)
 AActor *LookForTIDInBlock (AActor *lookee, int index, void *extparams)
 {
 	FLookExParams *params = (FLookExParams *)extparams;
-	FBlockNode *block;
 	AActor *link;
 	AActor *other;
+	TArray<FBlockEntry> &cell = level.blockmap.blockcells[index];
 	
-	for (block = level.blockmap.blocklinks[index]; block != NULL; block = block->NextActor)
+	for (int i = cell.Size() - 1; i >= 0; i--)
 	{
-		link = block->Me;
+		link = cell[i].Actor;
 
         if (!(link->flags & MF_SHOOTABLE))
 			continue;			// not shootable (observer or dead)
@@ -1614,14 +1614,14 @@ DEFINE_ACTION_FUNCTION(AActor, LookForTID)
 
 AActor *LookForEnemiesInBlock (AActor *lookee, int index, void *extparam)
 {
-	FBlockNode *block;
 	AActor *link;
 	AActor *other;
 	FLookExParams *params = (FLookExParams *)extparam;
+	TArray<FBlockEntry> &cell = level.blockmap.blockcells[index];
 	
-	for (block = level.blockmap.blocklinks[index]; block != NULL; block = block->NextActor)
+	for (int i = cell.Size() - 1; i >= 0; i--)
 	{
-		link = block->Me;
+		link = cell[i].Actor;
 
         if (!(link->flags & MF_SHOOTABLE))
 			continue;			// not shootable (observer or dead)
@@ -2927,20 +2927,28 @@ static bool P_CheckForResurrection(AActor *self, bool usevilestates)
 //
 //==========================================================================
 
-DEFINE_ACTION_FUNCTION(AActor, A_Chase)
+static void A_ChaseNative(AActor *self, int meleelabel, int missilelabel, int flags)
+{
+	FState *melee = (FState *)StateLabels.GetState(meleelabel, self->GetClass());
+	FState *missile = (FState *)StateLabels.GetState(missilelabel, self->GetClass());
+
+	if ((flags & CHF_RESURRECT) && P_CheckForResurrection(self, false))
+		return;
+	
+	A_DoChase(self, !!(flags&CHF_FASTCHASE), melee, missile, !(flags&CHF_NOPLAYACTIVE), 
+				!!(flags&CHF_NIGHTMAREFAST), !!(flags&CHF_DONTMOVE), flags);
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, A_Chase, A_ChaseNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
-	PARAM_STATE_DEF	(melee)		
-	PARAM_STATE_DEF	(missile)	
+	PARAM_INT_DEF	(melee)		
+	PARAM_INT_DEF	(missile)	
 	PARAM_INT_DEF	(flags)		
 
 	if (numparam > 1)
 	{
-		if ((flags & CHF_RESURRECT) && P_CheckForResurrection(self, false))
-			return 0;
-		
-		A_DoChase(self, !!(flags&CHF_FASTCHASE), melee, missile, !(flags&CHF_NOPLAYACTIVE), 
-					!!(flags&CHF_NIGHTMAREFAST), !!(flags&CHF_DONTMOVE), flags);
+		A_ChaseNative(self, melee, missile, flags);
 	}
 	else // this is the old default A_Chase
 	{
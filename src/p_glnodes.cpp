@@ -68,12 +68,19 @@
 #include "r_utility.h"
 #include "cmdlib.h"
 #include "g_levellocals.h"
+#include "g_level.h"
 #include "i_time.h"
 
 void P_GetPolySpots (MapData * lump, TArray<FNodeBuilder::FPolyStart> &spots, TArray<FNodeBuilder::FPolyStart> &anchors);
 
 CVAR(Bool, gl_cachenodes, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR(Float, gl_cachetime, 0.6f, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+// Directory with node caches named after the map checksum. It is only written by -precachenodes
+// so that several instances can share it.
+CVAR(String, gl_sharednodecache, "", CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+
+bool precachingnodes;		// Set while -precachenodes is loading maps
+static bool nodescached;
 
 void P_LoadZNodes (FileReader &dalump, uint32_t id);
 static bool CheckCachedNodes(MapData *map);
@@ -709,13 +716,17 @@ fail:
 //
 //===========================================================================
 
-static bool MatchHeader(const char * label, const char * hdata)
+static bool MatchHeader(const char * label, const char * hdata, size_t hsize)
 {
-	if (memcmp(hdata, "LEVEL=", 6) == 0)
+	if (hsize >= 6 && memcmp(hdata, "LEVEL=", 6) == 0)
 	{
 		size_t labellen = strlen(label);
 		labellen = MIN(size_t(8), labellen);
 
+		// The label must be followed by a line break within the lump
+		if (hsize < 7 + labellen)
+			return false;
+
 		if (strnicmp(hdata+6, label, labellen)==0 && 
 			(hdata[6+labellen]==0xa || hdata[6+labellen]==0xd))
 		{
@@ -759,7 +770,7 @@ static int FindGLNodesInWAD(int labellump)
 				if (Wads.GetLumpFile(lump)==wadfile)
 				{
 					FMemLump mem = Wads.ReadLump(lump);
-					if (MatchHeader(Wads.GetLumpFullName(labellump), (const char *)mem.GetMem())) return lump;
+					if (MatchHeader(Wads.GetLumpFullName(labellump), (const char *)mem.GetMem(), mem.GetSize())) return lump;
 				}
 			}
 		}
@@ -804,8 +815,8 @@ static int FindGLNodesInFile(FResourceFile * f, const char * label)
 				{
 					char check[16]={0};
 					FileReader *fr = f->GetLump(i)->GetReader();
-					fr->Read(check, 16);
-					if (MatchHeader(label, check)) return i;
+					long checksize = fr->Read(check, 16);
+					if (checksize > 0 && MatchHeader(label, check, checksize)) return i;
 				}
 				else return i;
 			}
@@ -983,7 +994,7 @@ bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime)
 		// Building nodes in debug is much slower so let's cache them only if cachetime is 0
 		buildtime = 0;
 #endif
-		if (level.maptype != MAPTYPE_BUILD && gl_cachenodes && buildtime/1000.f >= gl_cachetime)
+		if (level.maptype != MAPTYPE_BUILD && (precachingnodes || (gl_cachenodes && buildtime/1000.f >= gl_cachetime)))
 		{
 			DPrintf(DMSG_NOTIFY, "Caching nodes\n");
 			CreateCachedNodes(map);
@@ -1019,6 +1030,30 @@ static FString CreateCacheName(MapData *map, bool create)
 	return path;
 }
 
+//==========================================================================
+//
+// The shared cache is content addressed: A map's nodes are stored under
+// its checksum, no matter which file or lump name the map came from.
+//
+//==========================================================================
+
+static FString CreateSharedCacheName(MapData *map)
+{
+	FString path = *gl_sharednodecache;
+	if (path.IsEmpty()) return path;
+
+	uint8_t md5[16];
+	map->GetChecksum(md5);
+	FixPathSeperator(path);
+	if (path.Back() != '/') path << '/';
+	for (auto b : md5)
+	{
+		path.AppendFormat("%02x", b);
+	}
+	path << ".gzc";
+	return path;
+}
+
 static void WriteByte(MemFile &f, uint8_t b)
 {
 	f.Push(b);
@@ -1132,28 +1167,48 @@ static void CreateCachedNodes(MapData *map)
 	}
 	memcpy(compressed + offset - 4, "ZGL3", 4);
 
-	FString path = CreateCacheName(map, true);
-	FILE *f = fopen(path, "wb");
+	FString path, writepath;
+	if (precachingnodes)
+	{
+		// Other instances may be reading the shared cache right now, so the file
+		// is written under a temporary name and only renamed once it is complete.
+		path = CreateSharedCacheName(map);
+		CreatePath(ExtractFilePath(path));
+		writepath = path + ".tmp";
+	}
+	else
+	{
+		path = writepath = CreateCacheName(map, true);
+	}
+	FILE *f = fopen(writepath, "wb");
 
 	if (f != NULL)
 	{
-		if (fwrite(compressed, outlen+offset, 1, f) != 1)
+		bool ok = fwrite(compressed, outlen+offset, 1, f) == 1;
+		fclose(f);
+
+		if (ok && writepath.Compare(path) != 0)
+		{
+			remove(path);
+			ok = rename(writepath, path) == 0;
+		}
+		if (!ok)
 		{
 			Printf("Error saving nodes to file %s\n", path.GetChars());
+			if (writepath.Compare(path) != 0) remove(writepath);
 		}
-
-		fclose(f);
+		else nodescached = true;
 	}
 	else
 	{
-		Printf("Cannot open nodes file %s for writing\n", path.GetChars());
+		Printf("Cannot open nodes file %s for writing\n", writepath.GetChars());
 	}
 
 	delete [] compressed;
 }
 
 
-static bool CheckCachedNodes(MapData *map)
+static bool LoadCachedNodes(MapData *map, const char *path)
 {
 	char magic[4] = {0,0,0,0};
 	uint8_t md5[16];
@@ -1161,7 +1216,6 @@ static bool CheckCachedNodes(MapData *map)
 	uint32_t numlin;
 	uint32_t *verts = NULL;
 
-	FString path = CreateCacheName(map, false);
 	FILE *f = fopen(path, "rb");
 	if (f == NULL) return false;
 
@@ -1220,6 +1274,79 @@ errorout:
 	return false;
 }
 
+static bool CheckCachedNodes(MapData *map)
+{
+	FString path = CreateSharedCacheName(map);
+	if (path.IsNotEmpty() && LoadCachedNodes(map, path))
+	{
+		return true;
+	}
+	return LoadCachedNodes(map, CreateCacheName(map, false));
+}
+
+//==========================================================================
+//
+// -precachenodes
+//
+// Loads every map that is defined in MAPINFO and stores all nodes that
+// had to be built in the shared node cache, so that instances using
+// the same cache never need to build them during a level transition.
+//
+//==========================================================================
+
+void P_PrecacheNodes()
+{
+	if (*gl_sharednodecache == 0)
+	{
+		Printf("-precachenodes needs gl_sharednodecache to be set\n");
+		return;
+	}
+
+	int numcached = 0, numfound = 0;
+	precachingnodes = true;
+	for (unsigned i = 0; i < wadlevelinfos.Size(); i++)
+	{
+		FString mapname = wadlevelinfos[i].MapName;
+		MapData *map = P_OpenMapData(mapname, true);
+		if (map == NULL)
+		{
+			continue;
+		}
+		bool found = FileExists(CreateSharedCacheName(map));
+		delete map;
+		if (found)
+		{
+			numfound++;
+			continue;
+		}
+
+		uint64_t startTime = I_msTime();
+		nodescached = false;
+		try
+		{
+			G_InitNew(mapname, false);
+		}
+		catch (CRecoverableError &error)
+		{
+			Printf("%s: %s\n", mapname.GetChars(), error.GetMessage());
+			continue;
+		}
+		uint64_t endTime = I_msTime();
+
+		if (nodescached)
+		{
+			Printf("%s: nodes cached, %.3f sec\n", mapname.GetChars(), (endTime - startTime) * 0.001);
+			numcached++;
+		}
+		else
+		{
+			Printf("%s: nothing to cache\n", mapname.GetChars());
+		}
+	}
+	precachingnodes = false;
+	Printf("%d maps cached, %d already in the cache\n", numcached, numfound);
+}
+
 CCMD(clearnodecache)
 {
 	TArray<FFileList> list;
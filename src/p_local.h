@@ -279,6 +279,10 @@ void	P_SlideMove (AActor* mo, const DVector2 &pos, int numsteps);
 bool	P_BounceWall (AActor *mo);
 bool	P_BounceActor (AActor *mo, AActor *BlockingMobj, bool ontop);
 bool	P_CheckSight (AActor *t1, AActor *t2, int flags=0);
+void	P_StartSightCache ();
+void	P_EndSightCache ();
+bool	P_CanBatchSightChecks ();
+void	P_BatchSightChecks (AActor *const *lookers, int count, AActor *target, int flags);
 
 enum ESightFlags
 {
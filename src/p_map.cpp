@@ -100,11 +100,14 @@
 #include "r_sky.h"
 #include "g_levellocals.h"
 #include "actorinlines.h"
+#include "stats.h"
 
 CVAR(Bool, cl_bloodsplats, true, CVAR_ARCHIVE)
 CVAR(Int, sv_smartaim, 0, CVAR_ARCHIVE | CVAR_SERVERINFO)
 CVAR(Bool, cl_doautoaim, false, CVAR_ARCHIVE)
 
+cycle_t TryMoveCycles;
+
 static void CheckForPushSpecial(line_t *line, int side, AActor *mobj, DVector2 * posforwindowcheck = NULL);
 static void SpawnShootDecal(AActor *t1, const FTraceResults &trace);
 static void SpawnDeepSplash(AActor *t1, const FTraceResults &trace, AActor *puff);
@@ -2229,6 +2232,7 @@ bool P_TryMove(AActor *thing, const DVector2 &pos,
 	FCheckPosition &tm,
 	bool missileCheck)	// [GZ] Fired missiles ignore the drop-off test
 {
+	FCycleScope clock(TryMoveCycles);
 	sector_t	*oldsector;
 	double		oldz;
 	int 		side;
@@ -5653,6 +5657,127 @@ CUSTOM_CVAR(Float, splashfactor, 1.f, CVAR_SERVERINFO)
 		selfthrustscale = 1.f / self;
 }
 
+//==========================================================================
+//
+// P_CanRadiusDamage
+// Checks the flags that keep an actor out of a radius attack.
+//
+//==========================================================================
+
+static bool P_CanRadiusDamage(AActor *thing, AActor *bombspot, AActor *bombsource, int flags)
+{
+	// Vulnerable actors can be damaged by radius attacks even if not shootable
+	// Used to emulate MBF's vulnerability of non-missile bouncers to explosions.
+	if (!((thing->flags & MF_SHOOTABLE) || (thing->flags6 & MF6_VULNERABLE)))
+		return false;
+
+	// Boss spider and cyborg and Heretic's ep >= 2 bosses
+	// take no damage from concussion.
+	if (thing->flags3 & MF3_NORADIUSDMG && !(bombspot->flags4 & MF4_FORCERADIUSDMG))
+		return false;
+
+	if (!(flags & RADF_HURTSOURCE) && (thing == bombsource || thing == bombspot))
+	{ // don't damage the source of the explosion
+		return false;
+	}
+
+	// a much needed option: monsters that fire explosive projectiles cannot 
+	// be hurt by projectiles fired by a monster of the same type.
+	// Controlled by the DONTHARMCLASS and DONTHARMSPECIES flags.
+	if ((bombsource && !thing->player) // code common to both checks
+		&& ( // Class check first
+		((bombsource->flags4 & MF4_DONTHARMCLASS) && (thing->GetClass() == bombsource->GetClass()))
+		|| // Nigh-identical species check second
+		((bombsource->flags6 & MF6_DONTHARMSPECIES) && (thing->GetSpecies() == bombsource->GetSpecies()))
+		)
+		)	return false;
+
+	return true;
+}
+
+//==========================================================================
+//
+// P_RadiusDamagePoints
+// Damage of a radius attack before it is rounded.
+//
+//==========================================================================
+
+static double P_RadiusDamagePoints(AActor *thing, AActor *bombspot, AActor *bombsource, double bombdamagefloat, double bombdistancefloat, int fulldamagedistance)
+{
+	double points;
+	double len;
+	double dx, dy;
+	double boxradius;
+
+	DVector2 vec = bombspot->Vec2To(thing);
+	dx = fabs(vec.X);
+	dy = fabs(vec.Y);
+	boxradius = thing->radius;
+
+	// The damage pattern is square, not circular.
+	len = double(dx > dy ? dx : dy);
+
+	if (bombspot->Z() < thing->Z() || bombspot->Z() >= thing->Top())
+	{
+		double dz;
+
+		if (bombspot->Z() > thing->Z())
+		{
+			dz = double(bombspot->Z() - thing->Top());
+		}
+		else
+		{
+			dz = double(thing->Z() - bombspot->Z());
+		}
+		if (len <= boxradius)
+		{
+			len = dz;
+		}
+		else
+		{
+			len -= boxradius;
+			len = g_sqrt(len*len + dz*dz);
+		}
+	}
+	else
+	{
+		len -= boxradius;
+		if (len < 0.f)
+			len = 0.f;
+	}
+	len = clamp<double>(len - (double)fulldamagedistance, 0, len);
+	points = bombdamagefloat * (1. - len * bombdistancefloat);
+	if (thing == bombsource)
+	{
+		points = points * splashfactor;
+	}
+	points *= thing->RadiusDamageFactor;
+	return points;
+}
+
+//==========================================================================
+//
+// P_OldRadiusDamageDistance
+// Distance used by the original radius attack code.
+//
+//==========================================================================
+
+static double P_OldRadiusDamageDistance(AActor *thing, AActor *bombspot)
+{
+	double dx, dy, dist;
+
+	DVector2 vec = bombspot->Vec2To(thing);
+	dx = fabs(vec.X);
+	dy = fabs(vec.Y);
+
+	dist = dx>dy ? dx : dy;
+	dist -= thing->radius;
+
+	if (dist < 0)
+		dist = 0;
+	return dist;
+}
+
 //==========================================================================
 //
 // P_RadiusAttack
@@ -5679,35 +5804,48 @@ int P_RadiusAttack(AActor *bombspot, AActor *bombsource, int bombdamage, int bom
 		bombsource = bombspot;
 	}
 
-	int count = 0;
-	while ((it.Next(&cres)))
+	// Trace the sight checks of everything that is going to be hit in one
+	// batch first. The loop below then finds the results in the sight cache.
+	if (P_CanBatchSightChecks())
 	{
-		AActor *thing = cres.thing;
-		// Vulnerable actors can be damaged by radius attacks even if not shootable
-		// Used to emulate MBF's vulnerability of non-missile bouncers to explosions.
-		if (!((thing->flags & MF_SHOOTABLE) || (thing->flags6 & MF6_VULNERABLE)))
-			continue;
+		static TArray<AActor *> lookers;
 
-		// Boss spider and cyborg and Heretic's ep >= 2 bosses
-		// take no damage from concussion.
-		if (thing->flags3 & MF3_NORADIUSDMG && !(bombspot->flags4 & MF4_FORCERADIUSDMG))
-			continue;
+		lookers.Clear();
+		while ((it.Next(&cres)))
+		{
+			AActor *thing = cres.thing;
+			if (!P_CanRadiusDamage(thing, bombspot, bombsource, flags))
+				continue;
 
-		if (!(flags & RADF_HURTSOURCE) && (thing == bombsource || thing == bombspot))
-		{ // don't damage the source of the explosion
-			continue;
+			bool hit;
+			if ((flags & RADF_NODAMAGE) || !((bombspot->flags5 | thing->flags5) & MF5_OLDRADIUSDMG))
+			{
+				double points = P_RadiusDamagePoints(thing, bombspot, bombsource, bombdamagefloat, bombdistancefloat, fulldamagedistance);
+				double check = int(points) * bombdamage;
+				hit = check > 0 || (check == 0 && bombspot->flags7 & MF7_FORCEZERORADIUSDMG);
+			}
+			else
+			{
+				hit = P_OldRadiusDamageDistance(thing, bombspot) < bombdistance;
+			}
+			if (hit)
+			{
+				lookers.Push(thing);
+			}
 		}
+		if (lookers.Size() > 0)
+		{
+			P_BatchSightChecks(&lookers[0], lookers.Size(), bombspot, SF_IGNOREVISIBILITY | SF_IGNOREWATERBOUNDARY);
+		}
+		it.Reset();
+	}
 
-		// a much needed option: monsters that fire explosive projectiles cannot 
-		// be hurt by projectiles fired by a monster of the same type.
-		// Controlled by the DONTHARMCLASS and DONTHARMSPECIES flags.
-		if ((bombsource && !thing->player) // code common to both checks
-			&& ( // Class check first
-			((bombsource->flags4 & MF4_DONTHARMCLASS) && (thing->GetClass() == bombsource->GetClass()))
-			|| // Nigh-identical species check second
-			((bombsource->flags6 & MF6_DONTHARMSPECIES) && (thing->GetSpecies() == bombsource->GetSpecies()))
-			)
-			)	continue;
+	int count = 0;
+	while ((it.Next(&cres)))
+	{
+		AActor *thing = cres.thing;
+		if (!P_CanRadiusDamage(thing, bombspot, bombsource, flags))
+			continue;
 
 		// Barrels always use the original code, since this makes
 		// them far too "active." BossBrains also use the old code
@@ -5717,54 +5855,7 @@ int P_RadiusAttack(AActor *bombspot, AActor *bombsource, int bombdamage, int bom
 		{
 			// [RH] New code. The bounding box only covers the
 			// height of the thing and not the height of the map.
-			double points;
-			double len;
-			double dx, dy;
-			double boxradius;
-
-			DVector2 vec = bombspot->Vec2To(thing);
-			dx = fabs(vec.X);
-			dy = fabs(vec.Y);
-			boxradius = thing->radius;
-
-			// The damage pattern is square, not circular.
-			len = double(dx > dy ? dx : dy);
-
-			if (bombspot->Z() < thing->Z() || bombspot->Z() >= thing->Top())
-			{
-				double dz;
-
-				if (bombspot->Z() > thing->Z())
-				{
-					dz = double(bombspot->Z() - thing->Top());
-				}
-				else
-				{
-					dz = double(thing->Z() - bombspot->Z());
-				}
-				if (len <= boxradius)
-				{
-					len = dz;
-				}
-				else
-				{
-					len -= boxradius;
-					len = g_sqrt(len*len + dz*dz);
-				}
-			}
-			else
-			{
-				len -= boxradius;
-				if (len < 0.f)
-					len = 0.f;
-			}
-			len = clamp<double>(len - (double)fulldamagedistance, 0, len);
-			points = bombdamagefloat * (1. - len * bombdistancefloat);
-			if (thing == bombsource)
-			{
-				points = points * splashfactor;
-			}
-			points *= thing->RadiusDamageFactor;
+			double points = P_RadiusDamagePoints(thing, bombspot, bombsource, bombdamagefloat, bombdistancefloat, fulldamagedistance);
 
 			double check = int(points) * bombdamage;
 			// points and bombdamage should be the same sign (the double cast of 'points' is needed to prevent overflows and incorrect values slipping through.)
@@ -5823,17 +5914,7 @@ int P_RadiusAttack(AActor *bombspot, AActor *bombsource, int bombdamage, int bom
 		else
 		{
 			// [RH] Old code just for barrels
-			double dx, dy, dist;
-
-			DVector2 vec = bombspot->Vec2To(thing);
-			dx = fabs(vec.X);
-			dy = fabs(vec.Y);
-
-			dist = dx>dy ? dx : dy;
-			dist -= thing->radius;
-
-			if (dist < 0)
-				dist = 0;
+			double dist = P_OldRadiusDamageDistance(thing, bombspot);
 
 			if (dist >= bombdistance)
 				continue;  // out of range
@@ -80,6 +80,7 @@
 #include "r_state.h"
 #include "templates.h"
 #include "po_man.h"
+#include "stats.h"
 #include "g_levellocals.h"
 #include "vm.h"
 
@@ -328,6 +329,7 @@ void AActor::UnlinkFromWorld (FLinkContext *ctx)
 	if (!(flags & MF_NOBLOCKMAP))
 	{
 		// [RH] Unlink from all blocks this actor uses
+		level.blockmap.UnlinkCells(this);
 		FBlockNode *block = this->BlockNode;
 
 		while (block != NULL)
@@ -446,6 +448,8 @@ DEFINE_ACTION_FUNCTION(AActor, UnlinkFromWorld)
 //
 //==========================================================================
 
+static int LinkCount, LinkUnchanged;
+
 void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sector)
 {
 	bool spawning = spawningmapthing;
@@ -498,13 +502,39 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 		// When a node is deleted, its sector links (the links starting
 		// at sector_t->touching_thinglist) are broken. When a node is
 		// added, new sector links are created.
-		touching_sectorlist = P_CreateSecNodeList(this, radius, ctx != nullptr? ctx->sector_list : nullptr, &sector_t::touching_thinglist);	// Attach to thing
-		if (renderradius >= 0) touching_rendersectors = P_CreateSecNodeList(this, MAX(radius, renderradius), ctx != nullptr ? ctx->render_list : nullptr, &sector_t::touching_renderthings);
+		// The lists only depend on the position, the radius, the sector and
+		// the lines around, so if none of that changed since they were built
+		// they are already correct. Only polyobjects can move lines.
+		bool samepos = ctx != nullptr && Pos().XY() == LinkPos && sector == LinkSector && po_UnlinkCount == LinkPolyUnlinks;
+		double renderbox = renderradius >= 0 ? MAX(radius, renderradius) : -1;
+
+		LinkCount++;
+		if (samepos && ctx->sector_list != nullptr && radius == LinkRadius)
+		{
+			touching_sectorlist = ctx->sector_list;
+			LinkUnchanged++;
+		}
+		else
+		{
+			touching_sectorlist = P_CreateSecNodeList(this, radius, ctx != nullptr? ctx->sector_list : nullptr, &sector_t::touching_thinglist);	// Attach to thing
+		}
+		if (renderradius >= 0)
+		{
+			if (samepos && ctx->render_list != nullptr && renderbox == LinkRenderRadius)
+				touching_rendersectors = ctx->render_list;
+			else
+				touching_rendersectors = P_CreateSecNodeList(this, renderbox, ctx != nullptr ? ctx->render_list : nullptr, &sector_t::touching_renderthings);
+		}
 		else
 		{
 			touching_rendersectors = nullptr;
 			if (ctx != nullptr) P_DelSeclist(ctx->render_list, &sector_t::touching_renderthings);
 		}
+		LinkPos = Pos().XY();
+		LinkRadius = radius;
+		LinkRenderRadius = renderbox;
+		LinkSector = sector;
+		LinkPolyUnlinks = po_UnlinkCount;
 	}
 
 
@@ -559,6 +589,7 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 				}
 			}
 		}
+		level.blockmap.LinkCells(this);
 	}
 	// Portal links cannot be done unless the level is fully initialized.
 	if (!spawningmapthing) UpdateRenderSectorList();
@@ -600,6 +631,8 @@ DEFINE_ACTION_FUNCTION(AActor, SetOrigin)
 //===========================================================================
 
 FBlockNode *FBlockNode::FreeBlocks = NULL;
+FMemArena FBlockNode::Arena(sizeof(FBlockNode) * 1024);
+int FBlockNode::NumNodes;
 
 FBlockNode *FBlockNode::Create (AActor *who, int x, int y, int group)
 {
@@ -612,7 +645,8 @@ FBlockNode *FBlockNode::Create (AActor *who, int x, int y, int group)
 	}
 	else
 	{
-		block = new FBlockNode;
+		block = (FBlockNode *)Arena.Alloc(sizeof(FBlockNode));
+		NumNodes++;
 	}
 	block->BlockIndex = x + y*level.blockmap.bmapwidth;
 	block->Me = who;
@@ -629,6 +663,82 @@ void FBlockNode::Release ()
 	FreeBlocks = this;
 }
 
+ADD_STAT(links)
+{
+	FString out;
+	out.Format("%d links, %d with unchanged sector lists (%.1f%%), %d block nodes", LinkCount, LinkUnchanged,
+		LinkCount > 0 ? LinkUnchanged * 100. / LinkCount : 0., FBlockNode::NumNodes);
+	return out;
+}
+
+//===========================================================================
+//
+// FBlockmap :: LinkCells
+//
+// Adds an actor that was just linked into the blockmap to the entries of
+// its blocks. Its nodes are at the head of their chains, so it goes last.
+//
+//===========================================================================
+
+void FBlockmap::LinkCells(AActor *actor)
+{
+	FBlockEntry entry = { actor, actor->BlockNode != NULL && actor->BlockNode->NextBlock == NULL };
+	for (FBlockNode *node = actor->BlockNode; node != NULL; node = node->NextBlock)
+	{
+		blockcells[node->BlockIndex].Push(entry);
+	}
+}
+
+//===========================================================================
+//
+// FBlockmap :: UnlinkCells
+//
+// Must be called while the actor's block nodes are still there.
+//
+//===========================================================================
+
+void FBlockmap::UnlinkCells(AActor *actor)
+{
+	if (blockcells == NULL)
+		return;
+
+	for (FBlockNode *node = actor->BlockNode; node != NULL; node = node->NextBlock)
+	{
+		TArray<FBlockEntry> &cell = blockcells[node->BlockIndex];
+		for (int i = cell.Size() - 1; i >= 0; i--)
+		{
+			if (cell[i].Actor == actor)
+			{
+				cell.Delete(i);
+				break;
+			}
+		}
+	}
+}
+
+//===========================================================================
+//
+// FBlockmap :: RebuildCell
+//
+// For code that changes the chains directly.
+//
+//===========================================================================
+
+void FBlockmap::RebuildCell(int index)
+{
+	TArray<FBlockEntry> &cell = blockcells[index];
+	unsigned count = 0;
+	for (FBlockNode *node = blocklinks[index]; node != NULL; node = node->NextActor)
+	{
+		count++;
+	}
+	cell.Resize(count);
+	for (FBlockNode *node = blocklinks[index]; node != NULL; node = node->NextActor)
+	{
+		cell[--count] = { node->Me, node->NextBlock == NULL && node->PrevBlock == &node->Me->BlockNode };
+	}
+}
+
 //
 // BLOCK MAP ITERATORS
 // For each line/thing in the given mapblock,
@@ -1003,17 +1113,22 @@ DEFINE_FIELD_NAMED(DBlockLinesIterator, cres.portalflags, portalflags);
 //
 //===========================================================================
 
+static unsigned BlockStampSlots;	// Bit set for every slot in use
+static uint64_t BlockStampCounter;
+
 FBlockThingsIterator::FBlockThingsIterator()
-: DynHash(0)
+: StampSlot(-1), UseStamps(true), DynHash(0)
 {
 	minx = maxx = 0;
 	miny = maxy = 0;
 	ClearHash();
-	block = NULL;
+	cell = NULL;
+	index = -1;
+	last = NULL;
 }
 
 FBlockThingsIterator::FBlockThingsIterator(int _minx, int _miny, int _maxx, int _maxy)
-: DynHash(0)
+: StampSlot(-1), UseStamps(true), DynHash(0)
 {
 	minx = _minx;
 	maxx = _maxx;
@@ -1023,6 +1138,14 @@ FBlockThingsIterator::FBlockThingsIterator(int _minx, int _miny, int _maxx, int
 	Reset();
 }
 
+FBlockThingsIterator::~FBlockThingsIterator()
+{
+	if (StampSlot >= 0)
+	{
+		BlockStampSlots &= ~(1u << StampSlot);
+	}
+}
+
 void FBlockThingsIterator::init(const FBoundingBox &box)
 {
 	maxy = level.blockmap.GetBlockY(box.Top());
@@ -1041,9 +1164,103 @@ void FBlockThingsIterator::init(const FBoundingBox &box)
 
 void FBlockThingsIterator::ClearHash()
 {
-	memset(Buckets, -1, sizeof(Buckets));
-	NumFixedHash = 0;
-	DynHash.Clear();
+	if (StampSlot < 0 && UseStamps)
+	{
+		for (int i = 0; i < AActor::NUM_BLOCKSTAMPS; i++)
+		{
+			if (!(BlockStampSlots & (1u << i)))
+			{
+				BlockStampSlots |= 1u << i;
+				StampSlot = i;
+				break;
+			}
+		}
+	}
+	if (StampSlot >= 0)
+	{
+		// 0 is what new actors start with. The counter is wide enough that it
+		// never wraps around to a value still stored in an actor.
+		Stamp = ++BlockStampCounter;
+	}
+	else
+	{
+		memset(Buckets, -1, sizeof(Buckets));
+		NumFixedHash = 0;
+		DynHash.Clear();
+	}
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: DisableStamps
+//
+// Switches to the hash for good. Must be called before the first actor
+// has been returned.
+//
+//===========================================================================
+
+void FBlockThingsIterator::DisableStamps()
+{
+	if (StampSlot >= 0)
+	{
+		BlockStampSlots &= ~(1u << StampSlot);
+		StampSlot = -1;
+	}
+	UseStamps = false;
+	ClearHash();
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: CheckHash
+//
+// Returns false if the actor was already returned.
+//
+//===========================================================================
+
+bool FBlockThingsIterator::CheckHash(AActor *me)
+{
+	if (StampSlot >= 0)
+	{
+		if (me->BlockStamps[StampSlot] == Stamp)
+		{
+			return false;
+		}
+		me->BlockStamps[StampSlot] = Stamp;
+		return true;
+	}
+
+	HashEntry *entry;
+	size_t hash = ((size_t)me >> 3) % countof(Buckets);
+	for (int i = Buckets[hash]; i >= 0; )
+	{
+		entry = GetHashEntry(i);
+		if (entry->Actor == me)
+		{ // I've already been checked. Skip to the next actor.
+			return false;
+		}
+		i = entry->Next;
+	}
+	// Add me to the hash table and return me.
+	if (NumFixedHash < (int)countof(FixedHash))
+	{
+		entry = &FixedHash[NumFixedHash];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = NumFixedHash++;
+	}
+	else
+	{
+		if (DynHash.Size() == 0)
+		{
+			DynHash.Grow(50);
+		}
+		int i = DynHash.Reserve(1);
+		entry = &DynHash[i];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = i + countof(FixedHash);
+	}
+	entry->Actor = me;
+	return true;
 }
 
 //===========================================================================
@@ -1056,14 +1273,17 @@ void FBlockThingsIterator::StartBlock(int x, int y)
 {
 	curx = x;
 	cury = y;
+	last = NULL;
 	if (level.blockmap.isValidBlock(x, y))
 	{
-		block = level.blockmap.blocklinks[y*level.blockmap.bmapwidth + x];
+		cell = &level.blockmap.blockcells[y*level.blockmap.bmapwidth + x];
+		index = cell->Size();
 	}
 	else
 	{
 		// invalid block
-		block = NULL;
+		cell = NULL;
+		index = -1;
 	}
 }
 
@@ -1084,23 +1304,40 @@ void FBlockThingsIterator::SwitchBlock(int x, int y)
 //
 // FBlockThingsIterator :: Next
 //
+// The entries of a block are walked from the last to the first, which is
+// the order of the block's chain.
+//
 //===========================================================================
 
 AActor *FBlockThingsIterator::Next(bool centeronly)
 {
 	for (;;)
 	{
-		while (block != NULL)
+		if (cell != NULL && last != NULL)
 		{
-			AActor *me = block->Me;
-			FBlockNode *mynode = block;
-			HashEntry *entry;
-			int i;
+			// The caller may have moved actors in or out of this block since
+			// the last call. Entries are only ever appended at the end or
+			// removed, so continue below wherever the last actor is now.
+			// If it is gone, the entry below it has taken its place.
+			if ((unsigned)index >= cell->Size() || (*cell)[index].Actor != last)
+			{
+				int i = MIN<int>(index, cell->Size() - 1);
+				while (i >= 0 && (*cell)[i].Actor != last) i--;
+				if (i >= 0) index = i;
+				else index = MIN<int>(index, cell->Size());
+			}
+			last = NULL;
+		}
+
+		while (cell != NULL && --index >= 0)
+		{
+			const FBlockEntry &entry = (*cell)[index];
+			AActor *me = entry.Actor;
 
-			block = block->NextActor;
 			// Don't recheck things that were already checked
-			if (mynode->NextBlock == NULL && mynode->PrevBlock == &me->BlockNode)
+			if (entry.SingleBlock)
 			{ // This actor doesn't span blocks, so we know it can only ever be checked once.
+				last = me;
 				return me;
 			}
 			if (centeronly)
@@ -1115,43 +1352,14 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 				if (me->X() >= blockleft && me->X() < blockright &&
 					me->Y() >= blockbottom && me->Y() < blocktop)
 				{
+					last = me;
 					return me;
 				}
 			}
-			else
+			else if (CheckHash(me))
 			{
-				size_t hash = ((size_t)me >> 3) % countof(Buckets);
-				for (i = Buckets[hash]; i >= 0; )
-				{
-					entry = GetHashEntry(i);
-					if (entry->Actor == me)
-					{ // I've already been checked. Skip to the next actor.
-						break;
-					}
-					i = entry->Next;
-				}
-				if (i < 0)
-				{ // Add me to the hash table and return me.
-					if (NumFixedHash < (int)countof(FixedHash))
-					{
-						entry = &FixedHash[NumFixedHash];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = NumFixedHash++;
-					}
-					else
-					{
-						if (DynHash.Size() == 0)
-						{
-							DynHash.Grow(50);
-						}
-						i = DynHash.Reserve(1);
-						entry = &DynHash[i];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = i + countof(FixedHash);
-					}
-					entry->Actor = me;
-					return me;
-				}
+				last = me;
+				return me;
 			}
 		}
 
@@ -1274,6 +1482,8 @@ void FMultiBlockThingsIterator::Reset()
 //
 //===========================================================================
 
+// Script iterators live until the collector gets to them, so they use the
+// hash rather than keeping a stamp slot away from the native iterators.
 class DBlockThingsIterator : public DObject, public FMultiBlockThingsIterator
 {
 	DECLARE_ABSTRACT_CLASS(DBlockThingsIterator, DObject);
@@ -1289,6 +1499,7 @@ public:
 	DBlockThingsIterator(AActor *origin, double checkradius = -1, bool ignorerestricted = false)
 		: FMultiBlockThingsIterator(check, origin, checkradius, ignorerestricted)
 	{
+		DisableStamps();
 		cres.thing = nullptr;
 		cres.Position.Zero();
 		cres.portalflags = 0;
@@ -1297,6 +1508,7 @@ public:
 	DBlockThingsIterator(double checkx, double checky, double checkz, double checkh, double checkradius, bool ignorerestricted, sector_t *newsec)
 		: FMultiBlockThingsIterator(check, checkx, checky, checkz, checkh, checkradius, ignorerestricted, newsec)
 	{
+		DisableStamps();
 		cres.thing = nullptr;
 		cres.Position.Zero();
 		cres.portalflags = 0;
@@ -1976,23 +2188,24 @@ static AActor *RoughBlockCheck (AActor *mo, int index, void *param)
 {
 	BlockCheckInfo *info = (BlockCheckInfo *)param;
 
-	FBlockNode *link;
+	TArray<FBlockEntry> &cell = level.blockmap.blockcells[index];
 
-	for (link = level.blockmap.blocklinks[index]; link != NULL; link = link->NextActor)
+	for (int i = cell.Size() - 1; i >= 0; i--)
 	{
-		if (link->Me != mo)
+		AActor *link = cell[i].Actor;
+		if (link != mo)
 		{
-			if (info->onlyseekable && !mo->CanSeek(link->Me))
+			if (info->onlyseekable && !mo->CanSeek(link))
 			{
 				continue;
 			}
-			if (info->frontonly && P_PointOnDivlineSide(link->Me->X(), link->Me->Y(), &info->frontline) != 0)
+			if (info->frontonly && P_PointOnDivlineSide(link->X(), link->Y(), &info->frontline) != 0)
 			{
 				continue;
 			}
-			if (mo->IsOkayToAttack (link->Me))
+			if (mo->IsOkayToAttack (link))
 			{
-				return link->Me;
+				return link;
 			}
 		}
 	}
@@ -5,6 +5,7 @@
 #include "r_defs.h"
 #include "doomstat.h"
 #include "m_bbox.h"
+#include "p_blockmap.h"
 
 extern int validcount;
 struct FBlockNode;
@@ -279,7 +280,16 @@ class FBlockThingsIterator
 
 	int curx, cury;
 
-	FBlockNode *block;
+	TArray<FBlockEntry> *cell;
+	int index;					// entry that was returned last
+	AActor *last;
+
+	// Actors that span several blocks are marked with a stamp so that they
+	// are only returned once. Each live iterator has its own stamp slot in
+	// the actors. If all slots are taken the hash below is used instead.
+	int StampSlot;
+	uint64_t Stamp;
+	bool UseStamps;
 
 	int Buckets[32];
 
@@ -297,6 +307,8 @@ class FBlockThingsIterator
 	void StartBlock(int x, int y);
 	void SwitchBlock(int x, int y);
 	void ClearHash();
+	bool CheckHash(AActor *me);
+	void DisableStamps();
 
 	// The following is only for use in the path traverser 
 	// and therefore declared private.
@@ -308,9 +320,12 @@ class FBlockThingsIterator
 public:
 	FBlockThingsIterator(int minx, int miny, int maxx, int maxy);
 	FBlockThingsIterator(const FBoundingBox &box)
+		: StampSlot(-1), UseStamps(true)
 	{
 		init(box);
 	}
+	FBlockThingsIterator(const FBlockThingsIterator &other) = delete;
+	~FBlockThingsIterator();
 	void init(const FBoundingBox &box);
 	AActor *Next(bool centeronly = false);
 	void Reset() { StartBlock(minx, miny); }
@@ -330,6 +345,10 @@ class FMultiBlockThingsIterator
 
 protected:
 	FMultiBlockThingsIterator(FPortalGroupArray &check) : checklist(check) {}
+
+	// For iterators whose lifetime is not bound to a scope, so that they do
+	// not hold on to a stamp slot.
+	void DisableStamps() { blockIterator.DisableStamps(); }
 public:
 
 	struct CheckResult
@@ -7793,10 +7793,15 @@ double AActor::GetGravity() const
 	return level.gravity * Sector->gravity * Gravity * 0.00125;
 }
 
-DEFINE_ACTION_FUNCTION(AActor, GetGravity)
+static double GetGravityNative(AActor *self)
+{
+	return self->GetGravity();
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, GetGravity, GetGravityNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
-	ACTION_RETURN_FLOAT(self->GetGravity());
+	ACTION_RETURN_FLOAT(GetGravityNative(self));
 }
 
 
@@ -8019,11 +8024,16 @@ double AActor::GetBobOffset(double ticfrac) const
 	return BobSin(FloatBobPhase + level.maptime + ticfrac) * FloatBobStrength;
 }
 
-DEFINE_ACTION_FUNCTION(AActor, GetBobOffset)
+static double GetBobOffsetNative(AActor *self, double frac)
+{
+	return self->GetBobOffset(frac);
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, GetBobOffset, GetBobOffsetNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
 	PARAM_FLOAT_DEF(frac);
-	ACTION_RETURN_FLOAT(self->GetBobOffset(frac));
+	ACTION_RETURN_FLOAT(GetBobOffsetNative(self, frac));
 }
 
 
@@ -8064,34 +8074,54 @@ DEFINE_ACTION_FUNCTION(DActorIterator, Reinit)
 
 
 
-DEFINE_ACTION_FUNCTION(AActor, deltaangle)	// should this be global?
+static double DeltaAngleNative(double a1, double a2)
+{
+	return deltaangle(DAngle(a1), DAngle(a2)).Degrees;
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, deltaangle, DeltaAngleNative)	// should this be global?
 {
 	PARAM_PROLOGUE;
 	PARAM_FLOAT(a1);
 	PARAM_FLOAT(a2);
-	ACTION_RETURN_FLOAT(deltaangle(DAngle(a1), DAngle(a2)).Degrees);
+	ACTION_RETURN_FLOAT(DeltaAngleNative(a1, a2));
+}
+
+static double AbsAngleNative(double a1, double a2)
+{
+	return absangle(DAngle(a1), DAngle(a2)).Degrees;
 }
 
-DEFINE_ACTION_FUNCTION(AActor, absangle)	// should this be global?
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, absangle, AbsAngleNative)	// should this be global?
 {
 	PARAM_PROLOGUE;
 	PARAM_FLOAT(a1);
 	PARAM_FLOAT(a2);
-	ACTION_RETURN_FLOAT(absangle(DAngle(a1), DAngle(a2)).Degrees);
+	ACTION_RETURN_FLOAT(AbsAngleNative(a1, a2));
 }
 
-DEFINE_ACTION_FUNCTION(AActor, Distance2D)
+static double Distance2DNative(AActor *self, AActor *other)
+{
+	return self->Distance2D(other);
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, Distance2D, Distance2DNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
 	PARAM_OBJECT_NOT_NULL(other, AActor);
-	ACTION_RETURN_FLOAT(self->Distance2D(other));
+	ACTION_RETURN_FLOAT(Distance2DNative(self, other));
+}
+
+static double Distance3DNative(AActor *self, AActor *other)
+{
+	return self->Distance3D(other);
 }
 
-DEFINE_ACTION_FUNCTION(AActor, Distance3D)
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, Distance3D, Distance3DNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
 	PARAM_OBJECT_NOT_NULL(other, AActor);
-	ACTION_RETURN_FLOAT(self->Distance3D(other));
+	ACTION_RETURN_FLOAT(Distance3DNative(self, other));
 }
 
 DEFINE_ACTION_FUNCTION(AActor, AddZ)
@@ -8185,12 +8215,17 @@ DEFINE_ACTION_FUNCTION(AActor, Thrust)
 	return 0;
 }
 
-DEFINE_ACTION_FUNCTION(AActor, AngleTo)
+static double AngleToNative(AActor *self, AActor *targ, bool absolute)
+{
+	return self->AngleTo(targ, absolute).Degrees;
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, AngleTo, AngleToNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
 	PARAM_OBJECT_NOT_NULL(targ, AActor);
 	PARAM_BOOL_DEF(absolute);
-	ACTION_RETURN_FLOAT(self->AngleTo(targ, absolute).Degrees);
+	ACTION_RETURN_FLOAT(AngleToNative(self, targ, absolute));
 }
 
 DEFINE_ACTION_FUNCTION(AActor, AngleToVector)
@@ -8217,12 +8252,17 @@ DEFINE_ACTION_FUNCTION(AActor, Normalize180)
 	ACTION_RETURN_FLOAT(angle.Normalized180().Degrees);
 }
 
-DEFINE_ACTION_FUNCTION(AActor, DistanceBySpeed)
+static double DistanceBySpeedNative(AActor *self, AActor *targ, double speed)
+{
+	return self->DistanceBySpeed(targ, speed);
+}
+
+DEFINE_ACTION_FUNCTION_NATIVE(AActor, DistanceBySpeed, DistanceBySpeedNative)
 {
 	PARAM_SELF_PROLOGUE(AActor);
 	PARAM_OBJECT_NOT_NULL(targ, AActor);
 	PARAM_FLOAT(speed);
-	ACTION_RETURN_FLOAT(self->DistanceBySpeed(targ, speed));
+	ACTION_RETURN_FLOAT(DistanceBySpeedNative(self, targ, speed));
 }
 
 DEFINE_ACTION_FUNCTION(AActor, SetXYZ)
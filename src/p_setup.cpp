@@ -78,6 +78,8 @@
 #include "p_effect.h"
 #include "p_terrain.h"
 #include "nodebuild.h"
+#include "c_dispatch.h"
+#include "workerpool.h"
 #include "s_sound.h"
 #include "doomstat.h"
 #include "p_lnspec.h"
@@ -137,6 +139,7 @@ extern int numinterpolations;
 extern unsigned int R_OldBlend;
 
 EXTERN_CVAR(Bool, am_textured)
+EXTERN_CVAR(Bool, parallelnodes)
 
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
@@ -3118,6 +3121,7 @@ void P_LoadBlockMap (MapData * map)
 	count = level.blockmap.bmapwidth*level.blockmap.bmapheight;
 	level.blockmap.blocklinks = new FBlockNode *[count];
 	memset (level.blockmap.blocklinks, 0, count*sizeof(*level.blockmap.blocklinks));
+	level.blockmap.blockcells = new TArray<FBlockEntry>[count];
 	level.blockmap.blockmap = level.blockmap.blockmaplump+4;
 }
 
@@ -3485,6 +3489,7 @@ static void P_PrecacheLevel()
 		if (tex.Exists()) hitlist[tex.GetIndex()] |= FTextureManager::HIT_Wall;
 	}
 
+	TexMan.PrefetchTextures(hitlist);
 	Renderer->Precache(hitlist, actorhitlist);
 
 	delete[] hitlist;
@@ -3595,16 +3600,9 @@ void P_FreeExtraLevelData()
 	// Free all blocknodes and msecnodes.
 	// *NEVER* call this function without calling
 	// P_FreeLevelData() first, or they might not all be freed.
-	{
-		FBlockNode *node = FBlockNode::FreeBlocks;
-		while (node != NULL)
-		{
-			FBlockNode *next = node->NextBlock;
-			delete node;
-			node = next;
-		}
-		FBlockNode::FreeBlocks = NULL;
-	}
+	FBlockNode::Arena.FreeAllBlocks();
+	FBlockNode::FreeBlocks = NULL;
+	FBlockNode::NumNodes = 0;
 	secnodearena.FreeAllBlocks();
 	headsecnode = nullptr;
 }
@@ -3631,7 +3629,7 @@ void P_SetupLevel (const char *lumpname, int position)
 
 	// This is motivated as follows:
 
-	bool RequireGLNodes = Renderer->RequireGLNodes() || am_textured;
+	bool RequireGLNodes = Renderer->RequireGLNodes() || am_textured || precachingnodes;
 
 	for (i = 0; i < (int)countof(times); ++i)
 	{
@@ -4168,7 +4166,7 @@ void P_SetupLevel (const char *lumpname, int position)
 
 	times[17].Clock();
 	// preload graphics and sounds
-	if (precache)
+	if (precache && !precachingnodes)
 	{
 		P_PrecacheLevel ();
 		S_PrecacheLevel ();
@@ -4225,6 +4223,15 @@ void P_SetupLevel (const char *lumpname, int position)
 	memcpy(&level.loadlines[0], &level.lines[0], level.lines.Size() * sizeof(level.lines[0]));
 	level.loadsides.Resize(level.sides.Size());
 	memcpy(&level.loadsides[0], &level.sides[0], level.sides.Size() * sizeof(level.sides[0]));
+
+	// If the next map is stored compressed in a zip, get it decompressed
+	// in the background while this one is being played.
+	if (level.NextMap.IsNotEmpty())
+	{
+		FString fmt;
+		fmt.Format("maps/%s.wad", level.NextMap.GetChars());
+		Wads.PrefetchLump(Wads.CheckNumForFullName(fmt));
+	}
 }
 
 
@@ -4258,8 +4265,56 @@ static void P_Shutdown ()
 	}
 }
 
+//==========================================================================
+//
+// benchnodes [count]
+//
+// Rebuilds the current map's nodes with and without parallel splitter
+// selection and prints how long each build took. Polyobject containers
+// are not taken into account.
+//
+//==========================================================================
+
+CCMD (benchnodes)
+{
+	if (gamestate != GS_LEVEL || level.lines.Size() == 0)
+	{
+		Printf ("No level loaded\n");
+		return;
+	}
+
+	int count = argv.argc() > 1 ? MAX(atoi(argv[1]), 1) : 1;
+	bool oldparallel = parallelnodes;
+	uint64_t times[2] = { 0, 0 };
+
+	for (int i = 0; i < count; ++i)
+	{
+		for (int parallel = 0; parallel < 2; ++parallel)
+		{
+			parallelnodes = !!parallel;
+
+			TArray<FNodeBuilder::FPolyStart> polyspots, anchors;
+			FNodeBuilder::FLevel leveldata =
+			{
+				&level.vertexes[0], (int)level.vertexes.Size(),
+				&level.sides[0], (int)level.sides.Size(),
+				&level.lines[0], (int)level.lines.Size(),
+				0, 0, 0, 0
+			};
+			leveldata.FindMapBounds ();
+
+			uint64_t startTime = I_nsTime ();
+			FNodeBuilder builder (leveldata, polyspots, anchors, true);
+			times[parallel] += I_nsTime () - startTime;
+		}
+	}
+	parallelnodes = oldparallel;
+
+	Printf ("%s: %d lines, serial %.3f ms, parallel %.3f ms (%d threads, %d runs)\n", level.MapName.GetChars(), level.lines.Size(),
+		times[0] * 1e-6 / count, times[1] * 1e-6 / count, FWorkerPool::Instance()->NumWorkers() + 1, count);
+}
+
 #if 0
-#include "c_dispatch.h"
 CCMD (lineloc)
 {
 	if (argv.argc() != 2)
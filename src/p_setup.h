@@ -130,6 +130,7 @@ bool P_LoadGLNodes(MapData * map);
 bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime);
 bool P_CheckForGLNodes();
 void P_SetRenderSector();
+void P_PrecacheNodes();
 
 
 struct sidei_t	// [RH] Only keep BOOM sidedef init stuff around for init
@@ -155,6 +156,7 @@ struct sidei_t	// [RH] Only keep BOOM sidedef init stuff around for init
 };
 extern sidei_t *sidetemp;
 extern bool hasglnodes;
+extern bool precachingnodes;
 
 struct FMissingCount
 {
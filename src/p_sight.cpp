@@ -21,6 +21,8 @@
 //-----------------------------------------------------------------------------
 //
 #include <assert.h>
+#include <vector>
+#include <unordered_map>
 
 #include "doomdef.h"
 #include "i_system.h"
@@ -36,6 +38,9 @@
 #include "b_bot.h"
 #include "p_spec.h"
 #include "vm.h"
+#include "c_cvars.h"
+#include "d_player.h"
+#include "workerpool.h"
 
 // State.
 #include "r_state.h"
@@ -58,8 +63,8 @@ This uses specialized forms of the maputils routines for optimized performance
 */
 
 // Performance meters
-static int sightcounts[6];
-static cycle_t SightCycles;
+static thread_local int sightcounts[6];
+cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
 enum
@@ -94,8 +99,21 @@ struct SightTask
 };
 
 
-static TArray<intercept_t> intercepts (128);
-static TArray<SightTask> portals(32);
+// Sight checks also run on worker threads during the sight pre-pass, so
+// they keep their own scratch data and mark the lines they have visited
+// themselves instead of using validcount.
+static thread_local std::vector<intercept_t> intercepts;
+static thread_local std::vector<SightTask> portals;
+static thread_local std::vector<int> sightlinemarks;
+static thread_local std::vector<int> sightpolymarks;
+static thread_local int sightmark;
+
+static void P_NextSightMark()
+{
+	if (sightlinemarks.size() != level.lines.Size()) sightlinemarks.assign(level.lines.Size(), 0);
+	if (sightpolymarks.size() != (size_t)po_NumPolyobjs) sightpolymarks.assign(po_NumPolyobjs, 0);
+	sightmark++;
+}
 
 class SightCheck
 {
@@ -114,6 +132,7 @@ class SightCheck
 	int portalgroup;
 	bool portalfound;
 	unsigned int myseethrough;
+	std::vector<line_t *> *crossed;
 
 	void P_SightOpening(SightOpening &open, const line_t *linedef, double x, double y);
 	bool PTR_SightTraverse (intercept_t *in);
@@ -125,7 +144,8 @@ class SightCheck
 public:
 	bool P_SightPathTraverse ();
 
-	void init(AActor * t1, AActor * t2, sector_t *startsector, SightTask *task, int flags)
+	// If set, every line that crosses the trace is added to the list.
+	void init(AActor * t1, AActor * t2, sector_t *startsector, SightTask *task, int flags, std::vector<line_t *> *crossedlines = nullptr)
 	{
 		sightstart = t1->PosRelative(task->portalgroup);
 		sightend = t2->PosRelative(task->portalgroup);
@@ -144,6 +164,7 @@ public:
 		portalfound = false;
 
 		myseethrough = FF_SEETHROUGH;
+		crossed = crossedlines;
 	}
 };
 
@@ -277,16 +298,16 @@ bool SightCheck::PTR_SightTraverse (intercept_t *in)
 
 		if (portaldir != sector_t::floor && (open.portalflags & SO_TOPBACK) && !(open.portalflags & SO_TOPFRONT))
 		{
-			portals.Push({ in->frac, topslope, bottomslope, sector_t::ceiling, backsec->GetOppositePortalGroup(sector_t::ceiling) });
+			portals.push_back({ in->frac, topslope, bottomslope, sector_t::ceiling, backsec->GetOppositePortalGroup(sector_t::ceiling) });
 		}
 		if (portaldir != sector_t::ceiling && (open.portalflags & SO_BOTTOMBACK) && !(open.portalflags & SO_BOTTOMFRONT))
 		{
-			portals.Push({ in->frac, topslope, bottomslope, sector_t::floor, backsec->GetOppositePortalGroup(sector_t::floor) });
+			portals.push_back({ in->frac, topslope, bottomslope, sector_t::floor, backsec->GetOppositePortalGroup(sector_t::floor) });
 		}
 	}
 	if (lport != nullptr && lport->mDestination != nullptr)
 	{
-		portals.Push({ in->frac, topslope, bottomslope, portaldir, lport->mDestination->frontsector->PortalGroup });
+		portals.push_back({ in->frac, topslope, bottomslope, portaldir, lport->mDestination->frontsector->PortalGroup });
 		return false;
 	}
 
@@ -432,11 +453,12 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	int &mark = sightlinemarks[ld->Index()];
+	if (mark == sightmark)
 	{
 		return true;
 	}
-	ld->validcount = validcount;
+	mark = sightmark;
 	if (P_PointOnDivlineSide (ld->v1->fPos(), &Trace) ==
 		P_PointOnDivlineSide (ld->v2->fPos(), &Trace))
 	{
@@ -448,6 +470,10 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 	{
 		return true;		// line isn't crossed
 	}
+	if (crossed != nullptr)
+	{
+		crossed->push_back(ld);
+	}
 
 	if (!portalfound)	// when portals come into play, the quick-outs here may not be performed
 	{
@@ -459,7 +485,7 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 	intercept_t newintercept;
 	newintercept.isaline = true;
 	newintercept.d.line = ld;
-	intercepts.Push (newintercept);
+	intercepts.push_back (newintercept);
 
 	return true;
 }
@@ -494,9 +520,10 @@ int SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			int &mark = sightpolymarks[polyLink->polyobj - polyobjs];
+			if (mark != sightmark)
 			{
-				polyLink->polyobj->validcount = validcount;
+				mark = sightmark;
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine(polyLink->polyobj->Linedefs[i]))
@@ -539,11 +566,11 @@ bool SightCheck::P_SightTraverseIntercepts ()
 	unsigned scanpos;
 	divline_t dl;
 
-	count = intercepts.Size ();
+	count = intercepts.size ();
 //
 // calculate intercept distance
 //
-	for (scanpos = 0; scanpos < intercepts.Size (); scanpos++)
+	for (scanpos = 0; scanpos < intercepts.size (); scanpos++)
 	{
 		scan = &intercepts[scanpos];
 		P_MakeDivline (scan->d.line, &dl);
@@ -564,7 +591,7 @@ bool SightCheck::P_SightTraverseIntercepts ()
 	while (count--)
 	{
 		dist = INT_MAX;
-		for (scanpos = 0; scanpos < intercepts.Size (); scanpos++)
+		for (scanpos = 0; scanpos < intercepts.size (); scanpos++)
 		{
 			scan = &intercepts[scanpos];
 			if (scan->frac < dist)
@@ -626,8 +653,8 @@ bool SightCheck::P_SightPathTraverse ()
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
-	intercepts.Clear ();
+	P_NextSightMark();
+	intercepts.clear ();
 	x1 = sightstart.X + Startfrac * Trace.dx;
 	y1 = sightstart.Y + Startfrac * Trace.dy;
 	x2 = sightend.X;
@@ -658,11 +685,11 @@ bool SightCheck::P_SightPathTraverse ()
 	// We also must check if the starting sector contains  portals, and start sight checks in those as well.
 	if (portaldir != sector_t::floor && checkceiling && !lastsector->PortalBlocksSight(sector_t::ceiling))
 	{
-		portals.Push({ 0, topslope, bottomslope, sector_t::ceiling, lastsector->GetOppositePortalGroup(sector_t::ceiling) });
+		portals.push_back({ 0, topslope, bottomslope, sector_t::ceiling, lastsector->GetOppositePortalGroup(sector_t::ceiling) });
 	}
 	if (portaldir != sector_t::ceiling && checkfloor && !lastsector->PortalBlocksSight(sector_t::floor))
 	{
-		portals.Push({ 0, topslope, bottomslope, sector_t::floor, lastsector->GetOppositePortalGroup(sector_t::floor) });
+		portals.push_back({ 0, topslope, bottomslope, sector_t::floor, lastsector->GetOppositePortalGroup(sector_t::floor) });
 	}
 
 	x1 -= level.blockmap.bmaporgx;
@@ -824,6 +851,392 @@ sightcounts[2]++;
 	return traverseres;
 }
 
+//==========================================================================
+//
+// P_SightPath
+//
+// The part of P_CheckSight that traces through the map. It neither changes
+// the game state nor calls the RNG, so it may run on a worker thread.
+//
+//==========================================================================
+
+static bool P_SightPath(AActor *t1, AActor *t2, int flags, std::vector<line_t *> *crossed = nullptr)
+{
+	bool res;
+
+	portals.clear();
+
+	sector_t *sec;
+	double lookheight = t1->Z() + t1->Height*0.75;
+	t1->GetPortalTransition(lookheight, &sec);
+
+	double bottomslope = t2->Z() - lookheight;
+	double topslope = bottomslope + t2->Height;
+	SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
+
+	SightCheck s;
+	s.init(t1, t2, sec, &task, flags, crossed);
+	res = s.P_SightPathTraverse ();
+	if (!res)
+	{
+		double dist = t1->Distance2D(t2);
+		for (unsigned i = 0; i < portals.size(); i++)
+		{
+			portals[i].Frac += 1 / dist;
+			s.init(t1, t2, NULL, &portals[i], flags, crossed);
+			if (s.P_SightPathTraverse())
+			{
+				res = true;
+				break;
+			}
+		}
+	}
+	return res;
+}
+
+//==========================================================================
+//
+// Sight cache
+//
+// Monsters tend to check sight against the same target several times a
+// tic, so while the thinkers run, trace results are kept for each looker,
+// target and trace flags. Before the thinkers start, the traces monsters
+// are about to make are also done ahead of time on the worker pool. A
+// monster whose state advances this tic is expected to look at its target,
+// or at the players if it has none.
+//
+// P_CheckSight still does the reject, visibility and water checks itself,
+// since they may call the RNG, and only takes a stored result if nothing the
+// trace depended on has changed since: both actors' positions, heights and
+// sectors, and the flags, special and sector planes of every line that
+// crossed the trace. Traces through 3D floors are not cached, polyobject
+// movement invalidates everything, and maps with portals skip the cache.
+// The results are therefore exactly what tracing again would return.
+//
+//==========================================================================
+
+CVAR(Bool, sight_cache, true, 0)
+CVAR(Bool, sight_prepass, true, 0)
+
+// Only worth the overhead if there is enough to split among the workers.
+enum { SIGHT_MINPREPASS = 32, SIGHT_MINBATCH = 8 };
+
+// Flags that change how the trace sees lines.
+enum { SF_TRACEFLAGS = SF_SEEPASTSHOOTABLELINES | SF_SEEPASTBLOCKEVERYTHING | SF_IGNOREWATERBOUNDARY };
+
+struct FSightLine
+{
+	line_t *Line;
+	sector_t *Front, *Back;
+	uint32_t Flags, Activation;
+	int Special, Arg1;
+	secplane_t Planes[4];
+
+	void Set(line_t *ld)
+	{
+		Line = ld;
+		Front = ld->frontsector;
+		Back = ld->backsector;
+		Flags = ld->flags;
+		Activation = ld->activation;
+		Special = ld->special;
+		Arg1 = ld->args[1];
+		Planes[0] = Front->floorplane;
+		Planes[1] = Front->ceilingplane;
+		if (Back != nullptr)
+		{
+			Planes[2] = Back->floorplane;
+			Planes[3] = Back->ceilingplane;
+		}
+	}
+
+	bool Unchanged() const
+	{
+		if (Line->frontsector != Front || Line->backsector != Back || Line->flags != Flags || Line->activation != Activation ||
+			Line->special != Special || Line->args[1] != Arg1 || Front->floorplane != Planes[0] || Front->ceilingplane != Planes[1])
+		{
+			return false;
+		}
+		return Back == nullptr || (Back->floorplane == Planes[2] && Back->ceilingplane == Planes[3]);
+	}
+};
+
+struct FSightKey
+{
+	AActor *Looker, *Target;
+	int Flags;
+
+	bool operator==(const FSightKey &other) const
+	{
+		return Looker == other.Looker && Target == other.Target && Flags == other.Flags;
+	}
+};
+
+struct FSightKeyHash
+{
+	size_t operator()(const FSightKey &key) const
+	{
+		return (size_t)key.Looker * 31 + (size_t)key.Target * 7 + key.Flags;
+	}
+};
+
+struct FSightQuery
+{
+	AActor *Looker, *Target;
+	int Flags;
+	DVector3 LookerPos, TargetPos;
+	double LookerHeight, TargetHeight;
+	sector_t *LookerSector, *TargetSector;
+	unsigned PolyUnlinks;
+	int CompatFlags;
+	bool Cacheable;
+	bool Result;
+	std::vector<FSightLine> Lines;
+
+	void Set(AActor *t1, AActor *t2, int flags)
+	{
+		Looker = t1;
+		Target = t2;
+		Flags = flags;
+		LookerPos = t1->Pos();
+		TargetPos = t2->Pos();
+		LookerHeight = t1->Height;
+		TargetHeight = t2->Height;
+		LookerSector = t1->Sector;
+		TargetSector = t2->Sector;
+		PolyUnlinks = po_UnlinkCount;
+		CompatFlags = i_compatflags;
+		Lines.clear();
+	}
+
+	bool Unchanged() const
+	{
+		if (Looker->Pos() != LookerPos || Target->Pos() != TargetPos || Looker->Height != LookerHeight || Target->Height != TargetHeight ||
+			Looker->Sector != LookerSector || Target->Sector != TargetSector || po_UnlinkCount != PolyUnlinks || i_compatflags != CompatFlags)
+		{
+			return false;
+		}
+		for (auto &line : Lines)
+		{
+			if (!line.Unchanged()) return false;
+		}
+		return true;
+	}
+};
+
+static struct FSightCache
+{
+	// Entries are reused from tic to tic so that their line lists keep their memory.
+	std::vector<FSightQuery> Queries;
+	unsigned NumQueries;
+	std::unordered_map<FSightKey, unsigned, FSightKeyHash> Index;
+	bool Active;
+	int Prepassed, Hits, Stale, Misses;
+
+	void Clear()
+	{
+		NumQueries = 0;
+		Index.clear();
+		Active = false;
+	}
+
+	// Drops the entries from count on.
+	void Truncate(unsigned count)
+	{
+		for (unsigned i = count; i < NumQueries; i++)
+		{
+			const FSightQuery &q = Queries[i];
+			Index.erase(FSightKey{ q.Looker, q.Target, q.Flags });
+		}
+		NumQueries = count;
+	}
+
+	// Returns nullptr if the key is already there.
+	FSightQuery *Add(AActor *t1, AActor *t2, int flags)
+	{
+		if (!Index.emplace(FSightKey{ t1, t2, flags }, NumQueries).second)
+		{
+			return nullptr;
+		}
+		if (NumQueries == Queries.size())
+		{
+			Queries.emplace_back();
+		}
+		FSightQuery *q = &Queries[NumQueries++];
+		q->Set(t1, t2, flags);
+		return q;
+	}
+} SightCache;
+
+static void P_RunSightQuery(FSightQuery &q)
+{
+	static thread_local std::vector<line_t *> crossed;
+
+	crossed.clear();
+	q.Result = P_SightPath(q.Looker, q.Target, q.Flags, &crossed);
+	q.Cacheable = q.LookerSector->e->XFloor.ffloors.Size() == 0 && q.TargetSector->e->XFloor.ffloors.Size() == 0;
+	for (unsigned i = 0; i < crossed.size() && q.Cacheable; i++)
+	{
+		line_t *ld = crossed[i];
+		if (ld->frontsector->e->XFloor.ffloors.Size() || (ld->backsector != nullptr && ld->backsector->e->XFloor.ffloors.Size()))
+		{
+			q.Cacheable = false;
+		}
+		else
+		{
+			q.Lines.emplace_back();
+			q.Lines.back().Set(ld);
+		}
+	}
+}
+
+static void P_AddSightQuery(AActor *t1, AActor *t2, int flags)
+{
+	int pnum = t1->Sector->Index() * level.sectors.Size() + t2->Sector->Index();
+	if (t1 == t2 || (level.rejectmatrix.Size() > 0 && (level.rejectmatrix[pnum >> 3] & (1 << (pnum & 7)))))
+	{
+		return;
+	}
+	SightCache.Add(t1, t2, flags);
+}
+
+static void P_RunSightPrepass()
+{
+	TThinkerIterator<AActor> it(STAT_DEFAULT);
+	AActor *ac;
+	while ((ac = it.Next()) != nullptr)
+	{
+		if (ac->tics != 1 || !(ac->flags3 & MF3_ISMONSTER) || ac->health <= 0)
+		{
+			continue;
+		}
+		AActor *target = ac->target;
+		if (target != nullptr)
+		{
+			P_AddSightQuery(ac, target, 0);
+			P_AddSightQuery(ac, target, SF_SEEPASTBLOCKEVERYTHING);
+		}
+		else
+		{
+			for (int i = 0; i < MAXPLAYERS; i++)
+			{
+				if (playeringame[i] && players[i].mo != nullptr)
+				{
+					P_AddSightQuery(ac, players[i].mo, 0);
+				}
+			}
+		}
+	}
+
+	if (SightCache.NumQueries >= SIGHT_MINPREPASS)
+	{
+		auto &queries = SightCache.Queries;
+		FWorkerPool::Instance()->ParallelFor((int)SightCache.NumQueries, [&](int i) { P_RunSightQuery(queries[i]); });
+		SightCache.Prepassed = SightCache.NumQueries;
+	}
+	else
+	{
+		SightCache.Truncate(0);
+	}
+}
+
+void P_StartSightCache()
+{
+	SightCache.Clear();
+	SightCache.Prepassed = SightCache.Hits = SightCache.Stale = SightCache.Misses = 0;
+
+	if (!sight_cache || linePortals.Size() > 0 ||
+		PortalBlockmap.containsLines || PortalBlockmap.hasLinkedSectorPortals || PortalBlockmap.hasLinkedPolyPortals)
+	{
+		return;
+	}
+
+	SightCycles.Clock();
+	if (sight_prepass && FWorkerPool::Instance()->NumWorkers() > 0)
+	{
+		P_RunSightPrepass();
+	}
+	SightCache.Active = true;
+	SightCycles.Unclock();
+}
+
+void P_EndSightCache()
+{
+	SightCache.Active = false;
+}
+
+//==========================================================================
+//
+// For code that is about to check sight from many actors to the same
+// target, like a radius attack. The traces are run on the worker pool and
+// the results stored in the sight cache, where P_CheckSight finds them.
+//
+//==========================================================================
+
+bool P_CanBatchSightChecks()
+{
+	return SightCache.Active && sight_prepass && FWorkerPool::Instance()->NumWorkers() > 0;
+}
+
+void P_BatchSightChecks(AActor *const *lookers, int count, AActor *target, int flags)
+{
+	if (count < SIGHT_MINBATCH || !P_CanBatchSightChecks())
+		return;
+
+	SightCycles.Clock();
+	unsigned first = SightCache.NumQueries;
+	for (int i = 0; i < count; i++)
+	{
+		P_AddSightQuery(lookers[i], target, flags & SF_TRACEFLAGS);
+	}
+	int added = SightCache.NumQueries - first;
+	if (added >= SIGHT_MINBATCH)
+	{
+		auto &queries = SightCache.Queries;
+		FWorkerPool::Instance()->ParallelFor(added, [&](int i) { P_RunSightQuery(queries[first + i]); });
+		SightCache.Prepassed += added;
+	}
+	else
+	{
+		SightCache.Truncate(first);
+	}
+	SightCycles.Unclock();
+}
+
+static bool P_CachedSightPath(AActor *t1, AActor *t2, int flags)
+{
+	if (!SightCache.Active)
+	{
+		return P_SightPath(t1, t2, flags);
+	}
+
+	flags &= SF_TRACEFLAGS;
+	FSightQuery *q;
+	auto found = SightCache.Index.find(FSightKey{ t1, t2, flags });
+	if (found != SightCache.Index.end())
+	{
+		q = &SightCache.Queries[found->second];
+		if (!q->Cacheable)
+		{
+			return P_SightPath(t1, t2, flags);
+		}
+		if (q->Unchanged())
+		{
+			SightCache.Hits++;
+			return q->Result;
+		}
+		SightCache.Stale++;
+		q->Set(t1, t2, flags);
+	}
+	else
+	{
+		SightCache.Misses++;
+		q = SightCache.Add(t1, t2, flags);
+	}
+	P_RunSightQuery(*q);
+	return q->Result;
+}
+
 /*
 =====================
 =
@@ -902,37 +1315,7 @@ sightcounts[0]++;
 
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
-
-	validcount++;
-	portals.Clear();
-	{
-		sector_t *sec;
-		double lookheight = t1->Z() + t1->Height*0.75;
-		t1->GetPortalTransition(lookheight, &sec);
-
-		double bottomslope = t2->Z() - lookheight;
-		double topslope = bottomslope + t2->Height;
-		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
-
-
-		SightCheck s;
-		s.init(t1, t2, sec, &task, flags);
-		res = s.P_SightPathTraverse ();
-		if (!res)
-		{
-			double dist = t1->Distance2D(t2);
-			for (unsigned i = 0; i < portals.Size(); i++)
-			{
-				portals[i].Frac += 1 / dist;
-				s.init(t1, t2, NULL, &portals[i], flags);
-				if (s.P_SightPathTraverse())
-				{
-					res = true;
-					break;
-				}
-			}
-		}
-	}
+	res = P_CachedSightPath(t1, t2, flags);
 
 done:
 	SightCycles.Unclock();
@@ -950,9 +1333,10 @@ DEFINE_ACTION_FUNCTION(AActor, CheckSight)
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d, cache %d/%d/%d/%d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		SightCache.Prepassed, SightCache.Hits, SightCache.Stale, SightCache.Misses);
 	return out;
 }
 
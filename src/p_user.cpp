@@ -2490,6 +2490,7 @@ void P_PredictPlayer (player_t *player)
 
 	// Blockmap ordering also needs to stay the same, so unlink the block nodes
 	// without releasing them. (They will be used again in P_UnpredictPlayer).
+	level.blockmap.UnlinkCells(act);
 	FBlockNode *block = act->BlockNode;
 
 	while (block != NULL)
@@ -2633,6 +2634,7 @@ void P_UnPredictPlayer ()
 			{
 				block->NextActor->PrevActor = &block->NextActor;
 			}
+			level.blockmap.RebuildCell(block->BlockIndex);
 			block = block->NextBlock;
 		}
 
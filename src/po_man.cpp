@@ -155,6 +155,7 @@ static void ReleaseAllPolyNodes();
 polyblock_t **PolyBlockMap;
 FPolyObj *polyobjs; // list of all poly-objects on the level
 int po_NumPolyobjs;
+unsigned po_UnlinkCount;
 polyspawns_t *polyspawns; // [RH] Let P_SpawnMapThings() find our thingies for us
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
@@ -1077,6 +1078,8 @@ void FPolyObj::UnLinkPolyobj ()
 	int i, j;
 	int index;
 
+	po_UnlinkCount++;
+
 	// remove the polyobj from each blockmap section
 	for(j = bbox[BOXBOTTOM]; j <= bbox[BOXTOP]; j++)
 	{
@@ -117,6 +117,7 @@ private:
 
 };
 extern FPolyObj *polyobjs;		// list of all poly-objects on the level
+extern unsigned po_UnlinkCount;	// changes whenever a polyobject moves
 
 struct polyblock_t
 {
@@ -825,10 +825,10 @@ private:
 	{
 		using namespace TriScreenDrawerModes;
 
-		int x0 = clamp((int)(args->X0() + 0.5f), 0, destWidth);
-		int x1 = clamp((int)(args->X1() + 0.5f), 0, destWidth);
-		int y0 = clamp((int)(args->Y0() + 0.5f), 0, destHeight);
-		int y1 = clamp((int)(args->Y1() + 0.5f), 0, destHeight);
+		int x0 = clamp((int)(args->X0() + 0.5f), thread->clip_left, MIN(destWidth, thread->clip_right));
+		int x1 = clamp((int)(args->X1() + 0.5f), thread->clip_left, MIN(destWidth, thread->clip_right));
+		int y0 = clamp((int)(args->Y0() + 0.5f), thread->clip_top, MIN(destHeight, thread->clip_bottom));
+		int y1 = clamp((int)(args->Y1() + 0.5f), thread->clip_top, MIN(destHeight, thread->clip_bottom));
 
 		if (x1 <= x0 || y1 <= y0)
 			return;
@@ -39,6 +39,9 @@
 #include "screen_triangle.h"
 #include "x86.h"
 
+// Sort the triangles into screen tiles and give each drawer thread its own tiles
+CVAR(Bool, r_polytiles, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+
 int PolyTriangleDrawer::viewport_x;
 int PolyTriangleDrawer::viewport_y;
 int PolyTriangleDrawer::viewport_width;
@@ -46,6 +49,8 @@ int PolyTriangleDrawer::viewport_height;
 int PolyTriangleDrawer::dest_pitch;
 int PolyTriangleDrawer::dest_width;
 int PolyTriangleDrawer::dest_height;
+int PolyTriangleDrawer::dest_offset_x;
+int PolyTriangleDrawer::dest_offset_y;
 uint8_t *PolyTriangleDrawer::dest;
 bool PolyTriangleDrawer::dest_bgra;
 bool PolyTriangleDrawer::mirror;
@@ -62,6 +67,9 @@ void PolyTriangleDrawer::set_viewport(int x, int y, int width, int height, DCanv
 	int offsety = clamp(y, 0, dest_height);
 	int pixelsize = dest_bgra ? 4 : 1;
 
+	dest_offset_x = offsetx;
+	dest_offset_y = offsety;
+
 	viewport_x = x - offsetx;
 	viewport_y = y - offsety;
 	viewport_width = width;
@@ -84,7 +92,7 @@ bool PolyTriangleDrawer::is_mirror()
 	return mirror;
 }
 
-void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThreadData *thread)
+void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThreadData *thread, PolyTriangleBins *bins)
 {
 	if (drawargs.VertexCount() < 3)
 		return;
@@ -113,7 +121,7 @@ void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThrea
 		{
 			for (int j = 0; j < 3; j++)
 				vert[j] = shade_vertex(drawargs, vinput[*(elements++)]);
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 		}
 	}
 	else if (drawargs.DrawMode() == PolyDrawMode::TriangleFan)
@@ -123,7 +131,7 @@ void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThrea
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = shade_vertex(drawargs, vinput[*(elements++)]);
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 			vert[1] = vert[2];
 		}
 	}
@@ -134,7 +142,7 @@ void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThrea
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = shade_vertex(drawargs, vinput[*(elements++)]);
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 			vert[0] = vert[1];
 			vert[1] = vert[2];
 			ccw = !ccw;
@@ -142,7 +150,7 @@ void PolyTriangleDrawer::draw_elements(const PolyDrawArgs &drawargs, WorkerThrea
 	}
 }
 
-void PolyTriangleDrawer::draw_arrays(const PolyDrawArgs &drawargs, WorkerThreadData *thread)
+void PolyTriangleDrawer::draw_arrays(const PolyDrawArgs &drawargs, WorkerThreadData *thread, PolyTriangleBins *bins)
 {
 	if (drawargs.VertexCount() < 3)
 		return;
@@ -170,7 +178,7 @@ void PolyTriangleDrawer::draw_arrays(const PolyDrawArgs &drawargs, WorkerThreadD
 		{
 			for (int j = 0; j < 3; j++)
 				vert[j] = shade_vertex(drawargs, *(vinput++));
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 		}
 	}
 	else if (drawargs.DrawMode() == PolyDrawMode::TriangleFan)
@@ -180,7 +188,7 @@ void PolyTriangleDrawer::draw_arrays(const PolyDrawArgs &drawargs, WorkerThreadD
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = shade_vertex(drawargs, *(vinput++));
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 			vert[1] = vert[2];
 		}
 	}
@@ -191,7 +199,7 @@ void PolyTriangleDrawer::draw_arrays(const PolyDrawArgs &drawargs, WorkerThreadD
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = shade_vertex(drawargs, *(vinput++));
-			draw_shaded_triangle(vert, ccw, &args, thread);
+			draw_shaded_triangle(vert, ccw, &args, thread, bins);
 			vert[0] = vert[1];
 			vert[1] = vert[2];
 			ccw = !ccw;
@@ -243,7 +251,7 @@ bool PolyTriangleDrawer::is_degenerate(const ShadedTriVertex *vert)
 	return crosslengthsqr <= 1.e-6f;
 }
 
-void PolyTriangleDrawer::draw_shaded_triangle(const ShadedTriVertex *vert, bool ccw, TriDrawTriangleArgs *args, WorkerThreadData *thread)
+void PolyTriangleDrawer::draw_shaded_triangle(const ShadedTriVertex *vert, bool ccw, TriDrawTriangleArgs *args, WorkerThreadData *thread, PolyTriangleBins *bins)
 {
 	// Reject triangle if degenerate
 	if (is_degenerate(vert))
@@ -325,7 +333,12 @@ void PolyTriangleDrawer::draw_shaded_triangle(const ShadedTriVertex *vert, bool
 			args->v2 = &clippedvert[i - 1];
 			args->v3 = &clippedvert[i - 2];
 			if (args->CalculateGradients())
-				ScreenTriangle::Draw(args, thread);
+			{
+				if (bins)
+					bins->AddTriangle(args);
+				else
+					ScreenTriangle::Draw(args, thread);
+			}
 		}
 	}
 	else
@@ -336,7 +349,12 @@ void PolyTriangleDrawer::draw_shaded_triangle(const ShadedTriVertex *vert, bool
 			args->v2 = &clippedvert[i - 1];
 			args->v3 = &clippedvert[i];
 			if (args->CalculateGradients())
-				ScreenTriangle::Draw(args, thread);
+			{
+				if (bins)
+					bins->AddTriangle(args);
+				else
+					ScreenTriangle::Draw(args, thread);
+			}
 		}
 	}
 }
@@ -517,8 +535,125 @@ int PolyTriangleDrawer::clipedge(const ShadedTriVertex *verts, ShadedTriVertex *
 
 /////////////////////////////////////////////////////////////////////////////
 
+void PolyTriangleBins::AddTriangle(const TriDrawTriangleArgs *args)
+{
+	const ShadedTriVertex &v1 = *args->v1;
+	const ShadedTriVertex &v2 = *args->v2;
+	const ShadedTriVertex &v3 = *args->v3;
+
+	// Conservative pixel bounds. TriangleBlock finds the exact ones for each tile
+	int x0 = MAX((int)floorf(MIN(MIN(v1.x, v2.x), v3.x)), 0);
+	int x1 = MIN((int)ceilf(MAX(MAX(v1.x, v2.x), v3.x)), args->clipright - 1);
+	int y0 = MAX((int)floorf(MIN(MIN(v1.y, v2.y), v3.y)), 0);
+	int y1 = MIN((int)ceilf(MAX(MAX(v1.y, v2.y), v3.y)), args->clipbottom - 1);
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	if (triangles.empty())
+		setupArgs = *args;
+
+	Triangle triangle;
+	triangle.vertices[0] = v1;
+	triangle.vertices[1] = v2;
+	triangle.vertices[2] = v3;
+	triangle.gradientX = args->gradientX;
+	triangle.gradientY = args->gradientY;
+	triangle.tileX0 = x0 >> TileShift;
+	triangle.tileY0 = y0 >> TileShift;
+	triangle.tileX1 = x1 >> TileShift;
+	triangle.tileY1 = y1 >> TileShift;
+	triangles.push_back(triangle);
+}
+
+void PolyTriangleBins::Sort()
+{
+	if (triangles.empty())
+		return;
+
+	tileX0 = triangles[0].tileX0;
+	tileY0 = triangles[0].tileY0;
+	tileX1 = triangles[0].tileX1;
+	tileY1 = triangles[0].tileY1;
+	for (const Triangle &triangle : triangles)
+	{
+		tileX0 = MIN(tileX0, triangle.tileX0);
+		tileY0 = MIN(tileY0, triangle.tileY0);
+		tileX1 = MAX(tileX1, triangle.tileX1);
+		tileY1 = MAX(tileY1, triangle.tileY1);
+	}
+
+	int tilesPerRow = tileX1 - tileX0 + 1;
+	int numTiles = tilesPerRow * (tileY1 - tileY0 + 1);
+
+	// Count the triangles of each tile
+	tileStart.assign(numTiles + 1, 0);
+	for (const Triangle &triangle : triangles)
+	{
+		for (int y = triangle.tileY0; y <= triangle.tileY1; y++)
+		{
+			for (int x = triangle.tileX0; x <= triangle.tileX1; x++)
+				tileStart[(x - tileX0) + (y - tileY0) * tilesPerRow + 1]++;
+		}
+	}
+	for (int i = 0; i < numTiles; i++)
+		tileStart[i + 1] += tileStart[i];
+
+	// Place them in draw order. This moves each start to the end of its tile, so shift them back afterwards
+	tileTriangles.resize(tileStart[numTiles]);
+	for (int i = 0; i < (int)triangles.size(); i++)
+	{
+		const Triangle &triangle = triangles[i];
+		for (int y = triangle.tileY0; y <= triangle.tileY1; y++)
+		{
+			for (int x = triangle.tileX0; x <= triangle.tileX1; x++)
+				tileTriangles[tileStart[(x - tileX0) + (y - tileY0) * tilesPerRow]++] = i;
+		}
+	}
+	for (int i = numTiles; i > 0; i--)
+		tileStart[i] = tileStart[i - 1];
+	tileStart[0] = 0;
+}
+
+void PolyTriangleBins::Draw(DrawerThread *thread)
+{
+	TriDrawTriangleArgs args = setupArgs;
+
+	WorkerThreadData tile;
+	tile.core = 0;
+	tile.num_cores = 1;
+
+	int tilesPerRow = tileX1 - tileX0 + 1;
+	for (int y = tileY0; y <= tileY1; y++)
+	{
+		for (int x = tileX0; x <= tileX1; x++)
+		{
+			if (!IsTileOwnedByThread(x, y, thread))
+				continue;
+
+			tile.clip_left = x * TileSize;
+			tile.clip_top = y * TileSize;
+			tile.clip_right = tile.clip_left + TileSize;
+			tile.clip_bottom = tile.clip_top + TileSize;
+
+			int index = (x - tileX0) + (y - tileY0) * tilesPerRow;
+			for (int i = tileStart[index]; i < tileStart[index + 1]; i++)
+			{
+				Triangle &triangle = triangles[tileTriangles[i]];
+				args.v1 = &triangle.vertices[0];
+				args.v2 = &triangle.vertices[1];
+				args.v3 = &triangle.vertices[2];
+				args.gradientX = triangle.gradientX;
+				args.gradientY = triangle.gradientY;
+				ScreenTriangle::Draw(&args, &tile);
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 DrawPolyTrianglesCommand::DrawPolyTrianglesCommand(const PolyDrawArgs &args, bool mirror)
-	: args(args)
+	: args(args), tiled(r_polytiles)
 {
 	if (mirror)
 		this->args.SetFaceCullCCW(!this->args.FaceCullCCW());
@@ -530,14 +665,33 @@ void DrawPolyTrianglesCommand::Execute(DrawerThread *thread)
 	thread_data.core = thread->core;
 	thread_data.num_cores = thread->num_cores;
 
-	if (!args.Elements())
-		PolyTriangleDrawer::draw_arrays(args, &thread_data);
-	else
-		PolyTriangleDrawer::draw_elements(args, &thread_data);
+	if (!tiled)
+	{
+		if (!args.Elements())
+			PolyTriangleDrawer::draw_arrays(args, &thread_data, nullptr);
+		else
+			PolyTriangleDrawer::draw_elements(args, &thread_data, nullptr);
+		return;
+	}
+
+	std::call_once(binsReady, [&]()
+	{
+		if (!args.Elements())
+			PolyTriangleDrawer::draw_arrays(args, &thread_data, &bins);
+		else
+			PolyTriangleDrawer::draw_elements(args, &thread_data, &bins);
+		bins.Sort();
+	});
+
+	bins.Draw(thread);
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
+DrawRectCommand::DrawRectCommand(const RectDrawArgs &args) : args(args), tiled(r_polytiles)
+{
+}
+
 void DrawRectCommand::Execute(DrawerThread *thread)
 {
 	WorkerThreadData thread_data;
@@ -550,8 +704,39 @@ void DrawRectCommand::Execute(DrawerThread *thread)
 	int destHeight = renderTarget->GetHeight();
 	int destPitch = renderTarget->GetPitch();
 	int blendmode = (int)args.BlendMode();
-	if (renderTarget->IsBgra())
-		ScreenTriangle::RectDrawers32[blendmode](destOrg, destWidth, destHeight, destPitch, &args, &thread_data);
-	else
-		ScreenTriangle::RectDrawers8[blendmode](destOrg, destWidth, destHeight, destPitch, &args, &thread_data);
+	auto drawFunc = renderTarget->IsBgra() ? ScreenTriangle::RectDrawers32[blendmode] : ScreenTriangle::RectDrawers8[blendmode];
+
+	if (!tiled)
+	{
+		drawFunc(destOrg, destWidth, destHeight, destPitch, &args, &thread_data);
+		return;
+	}
+
+	// Draw the parts of the rect inside the tiles this thread owns. The tiles
+	// are relative to the viewport, like those of the triangles.
+	int offsetx = PolyTriangleDrawer::dest_offset_x;
+	int offsety = PolyTriangleDrawer::dest_offset_y;
+	int x0 = clamp((int)(args.X0() + 0.5f), 0, destWidth) - offsetx;
+	int x1 = clamp((int)(args.X1() + 0.5f), 0, destWidth) - offsetx;
+	int y0 = clamp((int)(args.Y0() + 0.5f), 0, destHeight) - offsety;
+	int y1 = clamp((int)(args.Y1() + 0.5f), 0, destHeight) - offsety;
+	if (x1 <= x0 || y1 <= y0)
+		return;
+
+	thread_data.core = 0;
+	thread_data.num_cores = 1;
+	for (int y = y0 >> PolyTriangleBins::TileShift; y <= (y1 - 1) >> PolyTriangleBins::TileShift; y++)
+	{
+		for (int x = x0 >> PolyTriangleBins::TileShift; x <= (x1 - 1) >> PolyTriangleBins::TileShift; x++)
+		{
+			if (!PolyTriangleBins::IsTileOwnedByThread(x, y, thread))
+				continue;
+
+			thread_data.clip_left = MAX(x * PolyTriangleBins::TileSize + offsetx, 0);
+			thread_data.clip_top = MAX(y * PolyTriangleBins::TileSize + offsety, 0);
+			thread_data.clip_right = (x + 1) * PolyTriangleBins::TileSize + offsetx;
+			thread_data.clip_bottom = (y + 1) * PolyTriangleBins::TileSize + offsety;
+			drawFunc(destOrg, destWidth, destHeight, destPitch, &args, &thread_data);
+		}
+	}
 }
@@ -31,6 +31,8 @@
 
 typedef void(*PolyDrawFuncPtr)(const TriDrawTriangleArgs *, WorkerThreadData *);
 
+class PolyTriangleBins;
+
 class PolyTriangleDrawer
 {
 public:
@@ -40,14 +42,14 @@ public:
 
 private:
 	static ShadedTriVertex shade_vertex(const PolyDrawArgs &drawargs, const TriVertex &v);
-	static void draw_elements(const PolyDrawArgs &args, WorkerThreadData *thread);
-	static void draw_arrays(const PolyDrawArgs &args, WorkerThreadData *thread);
-	static void draw_shaded_triangle(const ShadedTriVertex *vertices, bool ccw, TriDrawTriangleArgs *args, WorkerThreadData *thread);
+	static void draw_elements(const PolyDrawArgs &args, WorkerThreadData *thread, PolyTriangleBins *bins);
+	static void draw_arrays(const PolyDrawArgs &args, WorkerThreadData *thread, PolyTriangleBins *bins);
+	static void draw_shaded_triangle(const ShadedTriVertex *vertices, bool ccw, TriDrawTriangleArgs *args, WorkerThreadData *thread, PolyTriangleBins *bins);
 	static bool is_degenerate(const ShadedTriVertex *vertices);
 
 	static int clipedge(const ShadedTriVertex *verts, ShadedTriVertex *clippedvert);
 
-	static int viewport_x, viewport_y, viewport_width, viewport_height, dest_pitch, dest_width, dest_height;
+	static int viewport_x, viewport_y, viewport_width, viewport_height, dest_pitch, dest_width, dest_height, dest_offset_x, dest_offset_y;
 	static bool dest_bgra;
 	static uint8_t *dest;
 	static bool mirror;
@@ -55,6 +57,44 @@ private:
 	enum { max_additional_vertices = 16 };
 
 	friend class DrawPolyTrianglesCommand;
+	friend class DrawRectCommand;
+};
+
+// Screen triangles of a draw call. They are set up once and then sorted into
+// tiles, so that each drawer thread only rasterizes the tiles it owns.
+class PolyTriangleBins
+{
+public:
+	// Tile size in pixels. Must be a multiple of the 8x8 rasterizer blocks
+	enum { TileShift = 6, TileSize = 1 << TileShift };
+
+	void AddTriangle(const TriDrawTriangleArgs *args);
+	void Sort();
+	void Draw(DrawerThread *thread);
+
+	// Checks if a tile is rendered by this thread
+	static bool IsTileOwnedByThread(int tileX, int tileY, DrawerThread *thread)
+	{
+		int core = (tileX + tileY) % thread->num_cores;
+		return (core < 0 ? core + thread->num_cores : core) == thread->core;
+	}
+
+private:
+	struct Triangle
+	{
+		ShadedTriVertex vertices[3];
+		ScreenTriangleStepVariables gradientX;
+		ScreenTriangleStepVariables gradientY;
+		int tileX0, tileY0, tileX1, tileY1;
+	};
+
+	TriDrawTriangleArgs setupArgs;
+	std::vector<Triangle> triangles;
+
+	// Triangle indices of each tile inside the bounding tiles, in draw order
+	int tileX0 = 0, tileY0 = 0, tileX1 = -1, tileY1 = -1;
+	std::vector<int> tileStart;
+	std::vector<int> tileTriangles;
 };
 
 class DrawPolyTrianglesCommand : public DrawerCommand
@@ -67,16 +107,22 @@ public:
 
 private:
 	PolyDrawArgs args;
+	bool tiled;
+
+	// The first thread to execute the command sets up the triangles for all of them
+	std::once_flag binsReady;
+	PolyTriangleBins bins;
 };
 
 class DrawRectCommand : public DrawerCommand
 {
 public:
-	DrawRectCommand(const RectDrawArgs &args) : args(args) { }
+	DrawRectCommand(const RectDrawArgs &args);
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "DrawRect"; }
 
 private:
 	RectDrawArgs args;
+	bool tiled;
 };
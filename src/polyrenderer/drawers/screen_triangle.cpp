@@ -144,8 +144,8 @@ TriangleBlock::TriangleBlock(const TriDrawTriangleArgs *args, WorkerThreadData *
 	const ShadedTriVertex &v2 = *args->v2;
 	const ShadedTriVertex &v3 = *args->v3;
 
-	clipright = args->clipright;
-	clipbottom = args->clipbottom;
+	clipright = MIN(args->clipright, thread->clip_right);
+	clipbottom = MIN(args->clipbottom, thread->clip_bottom);
 
 	stencilPitch = args->stencilPitch;
 	stencilValues = args->stencilValues;
@@ -201,14 +201,24 @@ TriangleBlock::TriangleBlock(const TriDrawTriangleArgs *args, WorkerThreadData *
 
 	// Bounding rectangle
 	minx = MAX((MIN(MIN(X1, X2), X3) + 0xF) >> 4, 0);
-	maxx = MIN((MAX(MAX(X1, X2), X3) + 0xF) >> 4, clipright - 1);
+	maxx = MIN((MAX(MAX(X1, X2), X3) + 0xF) >> 4, args->clipright - 1);
 	miny = MAX((MIN(MIN(Y1, Y2), Y3) + 0xF) >> 4, 0);
-	maxy = MIN((MAX(MAX(Y1, Y2), Y3) + 0xF) >> 4, clipbottom - 1);
+	maxy = MIN((MAX(MAX(Y1, Y2), Y3) + 0xF) >> 4, args->clipbottom - 1);
 	if (minx >= maxx || miny >= maxy)
 	{
 		return;
 	}
 
+	// Part of the triangle inside the tile being rendered
+	minx = MAX(minx, thread->clip_left);
+	maxx = MIN(maxx, clipright - 1);
+	miny = MAX(miny, thread->clip_top);
+	maxy = MIN(maxy, clipbottom - 1);
+	if (minx > maxx || miny > maxy)
+	{
+		return;
+	}
+
 	// Start and end in corner of 8x8 block
 	minx &= ~(q - 1);
 	miny &= ~(q - 1);
@@ -249,6 +259,9 @@ TriangleBlock::TriangleBlock(const TriDrawTriangleArgs *args, WorkerThreadData *
 
 void TriangleBlock::Render()
 {
+	if (minx >= maxx || miny >= maxy)
+		return;
+
 	RenderSubdivide(minx / q, miny / q, (maxx + 1) / q, (maxy + 1) / q);
 }
 
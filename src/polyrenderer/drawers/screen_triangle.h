@@ -33,6 +33,12 @@ struct WorkerThreadData
 	int32_t core;
 	int32_t num_cores;
 
+	// Screen area the drawers may write to. Set to a single tile when the triangles are binned
+	int32_t clip_left = 0;
+	int32_t clip_top = 0;
+	int32_t clip_right = 0x7fffffff;
+	int32_t clip_bottom = 0x7fffffff;
+
 	// The number of lines to skip to reach the first line to be rendered by this thread
 	int skipped_by_thread(int first_line)
 	{
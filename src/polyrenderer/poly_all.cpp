@@ -7,6 +7,7 @@
 #include "math/tri_matrix.cpp"
 #include "scene/poly_cull.cpp"
 #include "scene/poly_decal.cpp"
+#include "scene/poly_hiz.cpp"
 #include "scene/poly_particle.cpp"
 #include "scene/poly_plane.cpp"
 #include "scene/poly_playersprite.cpp"
@@ -33,6 +33,8 @@
 #include "st_stuff.h"
 #include "g_levellocals.h"
 #include "p_effect.h"
+#include "stats.h"
+#include "i_time.h"
 #include "polyrenderer/scene/poly_light.h"
 #include "swrenderer/scene/r_scene.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
@@ -42,8 +44,11 @@
 EXTERN_CVAR(Bool, r_shadercolormaps)
 EXTERN_CVAR(Int, screenblocks)
 EXTERN_CVAR(Float, r_visibility)
+EXTERN_CVAR(Bool, r_polytiles)
 void InitGLRMapinfoData();
 
+static cycle_t DrawerCycles;
+
 /////////////////////////////////////////////////////////////////////////////
 
 PolyRenderer *PolyRenderer::Instance()
@@ -77,8 +82,11 @@ void PolyRenderer::RenderView(player_t *player)
 		Threads.MainThread()->DrawQueue->Push<ApplySpecialColormapRGBACommand>(cameraLight->ShaderColormap(), screen);
 	}
 	
+	DrawerCycles.Reset();
+	DrawerCycles.Clock();
 	Threads.MainThread()->FlushDrawQueue();
 	DrawerThreads::WaitForWorkers();
+	DrawerCycles.Unclock();
 }
 
 void PolyRenderer::RenderViewToCanvas(AActor *actor, DCanvas *canvas, int x, int y, int width, int height, bool dontmaplines)
@@ -218,3 +226,23 @@ void PolyRenderer::SetupPerspectiveMatrix()
 
 	WorldToClip = TriMatrix::perspective(fovy, ratio, 5.0f, 65535.0f) * WorldToView;
 }
+
+//==========================================================================
+//
+// Time spent waiting for the drawer threads, to compare the tiled and the
+// line interleaved triangle drawing. Updated once a second.
+//
+//==========================================================================
+
+ADD_STAT(polydrawers)
+{
+	static FString buff;
+	static int64_t lasttime = 0;
+	int64_t t = I_msTime();
+	if (t - lasttime > 1000)
+	{
+		buff.Format("%s drawers at %dx%d: %2.3f ms", r_polytiles ? "Tiled" : "Line interleaved", SCREENWIDTH, SCREENHEIGHT, DrawerCycles.TimeMS());
+		lasttime = t;
+	}
+	return buff;
+}
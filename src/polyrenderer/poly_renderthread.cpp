@@ -38,12 +38,9 @@
 #include "r_data/colormaps.h"
 #include "poly_renderthread.h"
 #include "poly_renderer.h"
+#include "workerpool.h"
 #include <mutex>
 
-#ifdef WIN32
-void PeekThreadedErrorPane();
-#endif
-
 EXTERN_CVAR(Bool, r_scene_multithreaded);
 
 PolyRenderThread::PolyRenderThread(int threadIndex) : MainThread(threadIndex == 0), ThreadIndex(threadIndex)
@@ -147,9 +144,7 @@ void PolyRenderThreads::RenderThreadSlices(int totalcount, std::function<void(Po
 {
 	WorkerCallback = workerCallback;
 
-	int numThreads = std::thread::hardware_concurrency();
-	if (numThreads == 0)
-		numThreads = 4;
+	int numThreads = FWorkerPool::Instance()->NumWorkers();
 
 	if (!r_scene_multithreaded || !r_multithreaded)
 		numThreads = 1;
@@ -161,41 +156,23 @@ void PolyRenderThreads::RenderThreadSlices(int totalcount, std::function<void(Po
 	}
 
 	// Setup threads:
-	std::unique_lock<std::mutex> start_lock(start_mutex);
 	for (int i = 0; i < numThreads; i++)
 	{
 		Threads[i]->Start = totalcount * i / numThreads;
 		Threads[i]->End = totalcount * (i + 1) / numThreads;
 	}
-	run_id++;
-	start_lock.unlock();
 
-	// Notify threads to run
-	if (Threads.size() > 1)
+	// Run the other threads in the worker pool:
+	FJobGroup group;
+	for (int i = 1; i < numThreads; i++)
 	{
-		start_condition.notify_all();
+		PolyRenderThread *thread = Threads[i].get();
+		group.Run([=]() { RenderThreadSlice(thread); }, i);
 	}
 
-	// Do the main thread ourselves:
+	// Do the main thread ourselves and wait for everyone to finish:
 	RenderThreadSlice(MainThread());
-
-	// Wait for everyone to finish:
-	if (Threads.size() > 1)
-	{
-		using namespace std::chrono_literals;
-		std::unique_lock<std::mutex> end_lock(end_mutex);
-		finished_threads++;
-		if (!end_condition.wait_for(end_lock, 5s, [&]() { return finished_threads == Threads.size(); }))
-		{
-#ifdef WIN32
-			PeekThreadedErrorPane();
-#endif
-			// Invoke the crash reporter so that we can capture the call stack of whatever the hung worker thread is doing
-			int *threadCrashed = nullptr;
-			*threadCrashed = 0xdeadbeef;
-		}
-		finished_threads = 0;
-	}
+	group.Wait();
 
 	for (int i = 0; i < numThreads; i++)
 	{
@@ -220,45 +197,14 @@ void PolyRenderThreads::StartThreads(size_t numThreads)
 	while (Threads.size() < (size_t)numThreads)
 	{
 		std::unique_ptr<PolyRenderThread> thread(new PolyRenderThread((int)Threads.size()));
-		auto renderthread = thread.get();
-		int start_run_id = run_id;
-		thread->thread = std::thread([=]()
-		{
-			int last_run_id = start_run_id;
-			while (true)
-			{
-				// Wait until we are signalled to run:
-				std::unique_lock<std::mutex> start_lock(start_mutex);
-				start_condition.wait(start_lock, [&]() { return run_id != last_run_id || shutdown_flag; });
-				if (shutdown_flag)
-					break;
-				last_run_id = run_id;
-				start_lock.unlock();
-
-				RenderThreadSlice(renderthread);
-
-				// Notify main thread that we finished:
-				std::unique_lock<std::mutex> end_lock(end_mutex);
-				finished_threads++;
-				end_lock.unlock();
-				end_condition.notify_all();
-			}
-		});
 		Threads.push_back(std::move(thread));
 	}
 }
 
 void PolyRenderThreads::StopThreads()
 {
-	std::unique_lock<std::mutex> lock(start_mutex);
-	shutdown_flag = true;
-	lock.unlock();
-	start_condition.notify_all();
 	while (Threads.size() > 1)
 	{
-		Threads.back()->thread.join();
 		Threads.pop_back();
 	}
-	lock.lock();
-	shutdown_flag = false;
 }
@@ -23,7 +23,7 @@
 #pragma once
 
 #include <memory>
-#include <thread>
+#include <functional>
 #include "swrenderer/r_memory.h"
 
 class DrawerCommandQueue;
@@ -53,7 +53,6 @@ public:
 	void PreparePolyObject(subsector_t *sub);
 
 private:
-	std::thread thread;
 	std::vector<DrawerCommandQueuePtr> UsedDrawQueues;
 	std::vector<DrawerCommandQueuePtr> FreeDrawQueues;
 
@@ -81,11 +80,4 @@ private:
 	std::function<void(PolyRenderThread *)> WorkerCallback;
 
 	std::vector<std::unique_ptr<PolyRenderThread>> Threads;
-	std::mutex start_mutex;
-	std::condition_variable start_condition;
-	bool shutdown_flag = false;
-	int run_id = 0;
-	std::mutex end_mutex;
-	std::condition_variable end_condition;
-	size_t finished_threads = 0;
 };
@@ -27,8 +27,11 @@
 #include "r_data/r_translate.h"
 #include "poly_cull.h"
 #include "polyrenderer/poly_renderer.h"
+#include "r_state.h"
 
-void PolyCull::CullScene(const PolyClipPlane &portalClipPlane)
+CVAR(Bool, r_polyhiz, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+
+void PolyCull::CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane)
 {
 	ClearSolidSegments();
 	MarkViewFrustum();
@@ -45,6 +48,8 @@ void PolyCull::CullScene(const PolyClipPlane &portalClipPlane)
 	{
 		for (const auto &sub : PvsSectors)
 			SubsectorDepths[sub->Index()] = 0xffffffff;
+		for (const auto &sub : OccludedSubsectors)
+			SubsectorDepths[sub->Index()] = 0xffffffff;
 		SubsectorDepths.resize(level.subsectors.Size(), 0xffffffff);
 
 		for (const auto &sector : SeenSectors)
@@ -53,6 +58,7 @@ void PolyCull::CullScene(const PolyClipPlane &portalClipPlane)
 	}
 
 	PvsSectors.clear();
+	OccludedSubsectors.clear();
 	SeenSectors.clear();
 
 	NextPvsLineStart = 0;
@@ -61,6 +67,19 @@ void PolyCull::CullScene(const PolyClipPlane &portalClipPlane)
 
 	PortalClipPlane = portalClipPlane;
 
+	// The occlusion buffer does not know about the portal clip plane. Geometry
+	// in front of it is clipped away and must not hide anything.
+	bool isPortal = portalClipPlane.A != 0.0f || portalClipPlane.B != 0.0f || portalClipPlane.C != 0.0f;
+	if (r_polyhiz && !isPortal)
+	{
+		HiZ.Clear(worldToClip, viewwidth, viewheight);
+		FindMaxSkyHeights();
+	}
+	else
+	{
+		HiZ.Disable();
+	}
+
 	// Cull front to back
 	FirstSkyHeight = true;
 	MaxCeilingHeight = 0.0;
@@ -127,9 +146,24 @@ void PolyCull::CullSubsector(subsector_t *sub)
 
 	uint32_t subsectorDepth = (uint32_t)PvsSectors.size();
 
+	if (!SectorSeen[sub->sector->Index()])
+	{
+		SectorSeen[sub->sector->Index()] = true;
+		SeenSectors.push_back(sub->sector);
+	}
+
+	// Skip the geometry if it is hidden, but keep a depth for the things in it
+	if (IsSubsectorOccluded(sub))
+	{
+		OccludedSubsectors.push_back(sub);
+		SubsectorDepths[sub->Index()] = subsectorDepth;
+		return;
+	}
+
 	// Mark that we need to render this
 	PvsSectors.push_back(sub);
 	PvsLineStart.push_back(NextPvsLineStart);
+	uint32_t lineStart = NextPvsLineStart;
 
 	DVector3 viewpos = PolyRenderer::Instance()->Viewpoint.Pos;
 
@@ -166,13 +200,165 @@ void PolyCull::CullSubsector(subsector_t *sub)
 		PvsLineVisible[NextPvsLineStart++] = lineVisible;
 	}
 
-	if (!SectorSeen[sub->sector->Index()])
+	AddOccluders(sub, lineStart);
+
+	SubsectorDepths[sub->Index()] = subsectorDepth;
+}
+
+void PolyCull::FindMaxSkyHeights()
+{
+	LevelMaxCeilingHeight = -FLT_MAX;
+	LevelMinFloorHeight = FLT_MAX;
+	for (auto &sector : level.sectors)
 	{
-		SectorSeen[sub->sector->Index()] = true;
-		SeenSectors.push_back(sub->sector);
+		LevelMaxCeilingHeight = MAX(LevelMaxCeilingHeight, sector.ceilingplane.Zat0());
+		LevelMinFloorHeight = MIN(LevelMinFloorHeight, sector.floorplane.Zat0());
 	}
+}
 
-	SubsectorDepths[sub->Index()] = subsectorDepth;
+bool PolyCull::IsSubsectorOccluded(subsector_t *sub)
+{
+	if (!HiZ.IsEnabled() || sub->numlines == 0)
+		return false;
+
+	// Fake flats may be drawn outside the sector
+	sector_t *sector = sub->sector;
+	if (sector->GetHeightSec() != nullptr)
+		return false;
+
+	DVector3 mins(FLT_MAX, FLT_MAX, FLT_MAX);
+	DVector3 maxs(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		vertex_t *v = sub->firstline[i].v1;
+		mins.X = MIN(mins.X, v->fX());
+		mins.Y = MIN(mins.Y, v->fY());
+		maxs.X = MAX(maxs.X, v->fX());
+		maxs.Y = MAX(maxs.Y, v->fY());
+		mins.Z = MIN(mins.Z, sector->floorplane.ZatPoint(v));
+		maxs.Z = MAX(maxs.Z, sector->ceilingplane.ZatPoint(v));
+
+		for (F3DFloor *ffloor : sector->e->XFloor.ffloors)
+		{
+			mins.Z = MIN(mins.Z, ffloor->bottom.plane->ZatPoint(v));
+			maxs.Z = MAX(maxs.Z, ffloor->top.plane->ZatPoint(v));
+		}
+	}
+
+	// Sky planes and sector portals are drawn at the sky height of the scene
+	if (sector->GetTexture(sector_t::ceiling) == skyflatnum || sector->ValidatePortal(sector_t::ceiling))
+		maxs.Z = MAX(maxs.Z, LevelMaxCeilingHeight);
+	if (sector->GetTexture(sector_t::floor) == skyflatnum || sector->ValidatePortal(sector_t::floor))
+		mins.Z = MIN(mins.Z, LevelMinFloorHeight);
+
+	return HiZ.IsBoxOccluded(PolyHierarchicalZ::Subsector, mins, maxs);
+}
+
+void PolyCull::AddOccluders(subsector_t *sub, uint32_t lineStart)
+{
+	if (!HiZ.IsEnabled())
+		return;
+
+	sector_t *frontsector = sub->sector;
+	if (frontsector->GetHeightSec() != nullptr)
+		return;
+
+	const DVector3 &viewpos = PolyRenderer::Instance()->Viewpoint.Pos;
+
+	// Only geometry drawn with an opaque texture hides what is behind it. Must match what RenderPolyWall and RenderPolyPlane draws.
+	auto isOpaque = [](FTextureID picnum) -> bool
+	{
+		FTexture *tex = TexMan(picnum, true);
+		return tex && tex->UseType != FTexture::TEX_Null;
+	};
+	auto isOpaqueFlat = [&](int pos) -> bool
+	{
+		FTextureID picnum = frontsector->GetTexture(pos);
+		return picnum != skyflatnum && isOpaque(picnum) && !frontsector->ValidatePortal(pos);
+	};
+
+	if (frontsector->CenterFloor() != frontsector->CenterCeiling())
+	{
+		if (frontsector->floorplane.PointOnSide(viewpos) > 0 && isOpaqueFlat(sector_t::floor))
+			AddFlatOccluder(sub, frontsector->floorplane);
+		if (frontsector->ceilingplane.PointOnSide(viewpos) > 0 && isOpaqueFlat(sector_t::ceiling))
+			AddFlatOccluder(sub, frontsector->ceilingplane);
+	}
+
+	// Walls of subsectors with polyobjects are drawn through the polyobject BSP
+	if (sub->polys)
+		return;
+
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		seg_t *line = &sub->firstline[i];
+		if (!PvsLineVisible[lineStart + i] || !line->sidedef || !line->linedef)
+			continue;
+
+		if (line->linedef->special == Line_Mirror || line->linedef->isVisualPortal())
+			continue;
+
+		double frontceilz1 = frontsector->ceilingplane.ZatPoint(line->v1);
+		double frontfloorz1 = frontsector->floorplane.ZatPoint(line->v1);
+		double frontceilz2 = frontsector->ceilingplane.ZatPoint(line->v2);
+		double frontfloorz2 = frontsector->floorplane.ZatPoint(line->v2);
+
+		if (line->backsector == nullptr)
+		{
+			if (isOpaque(line->sidedef->GetTexture(side_t::mid)))
+				AddWallOccluder(line, frontceilz1, frontfloorz1, frontceilz2, frontfloorz2);
+		}
+		else if (line->PartnerSeg)
+		{
+			sector_t *backsector = line->PartnerSeg->Subsector->sector;
+			if (backsector->GetHeightSec() != nullptr)
+				continue;
+
+			double backceilz1 = backsector->ceilingplane.ZatPoint(line->v1);
+			double backfloorz1 = backsector->floorplane.ZatPoint(line->v1);
+			double backceilz2 = backsector->ceilingplane.ZatPoint(line->v2);
+			double backfloorz2 = backsector->floorplane.ZatPoint(line->v2);
+
+			double topfloorz1 = MAX(MIN(backceilz1, frontceilz1), frontfloorz1);
+			double topfloorz2 = MAX(MIN(backceilz2, frontceilz2), frontfloorz2);
+			double bottomceilz1 = MIN(MAX(frontfloorz1, backfloorz1), frontceilz1);
+			double bottomceilz2 = MIN(MAX(frontfloorz2, backfloorz2), frontceilz2);
+
+			bool bothSkyCeiling = frontsector->GetTexture(sector_t::ceiling) == skyflatnum && backsector->GetTexture(sector_t::ceiling) == skyflatnum;
+			bool bothSkyFloor = frontsector->GetTexture(sector_t::floor) == skyflatnum && backsector->GetTexture(sector_t::floor) == skyflatnum;
+
+			if (!bothSkyCeiling && isOpaque(line->sidedef->GetTexture(side_t::top)))
+				AddWallOccluder(line, frontceilz1, topfloorz1, frontceilz2, topfloorz2);
+			if (!bothSkyFloor && isOpaque(line->sidedef->GetTexture(side_t::bottom)))
+				AddWallOccluder(line, bottomceilz1, frontfloorz1, bottomceilz2, frontfloorz2);
+		}
+	}
+}
+
+void PolyCull::AddWallOccluder(seg_t *line, double ceilz1, double floorz1, double ceilz2, double floorz2)
+{
+	if (ceilz1 < floorz1 || ceilz2 < floorz2 || (ceilz1 == floorz1 && ceilz2 == floorz2))
+		return;
+
+	DVector3 vertices[4] =
+	{
+		{ line->v1->fX(), line->v1->fY(), ceilz1 },
+		{ line->v2->fX(), line->v2->fY(), ceilz2 },
+		{ line->v2->fX(), line->v2->fY(), floorz2 },
+		{ line->v1->fX(), line->v1->fY(), floorz1 }
+	};
+	HiZ.AddOccluder(vertices, 4);
+}
+
+void PolyCull::AddFlatOccluder(subsector_t *sub, const secplane_t &plane)
+{
+	OccluderVertices.resize(sub->numlines);
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		vertex_t *v = sub->firstline[i].v1;
+		OccluderVertices[i] = { v->fX(), v->fY(), plane.ZatPoint(v) };
+	}
+	HiZ.AddOccluder(OccluderVertices.data(), (int)OccluderVertices.size());
 }
 
 void PolyCull::ClearSolidSegments()
@@ -23,13 +23,14 @@
 #pragma once
 
 #include "polyrenderer/drawers/poly_triangle.h"
+#include "polyrenderer/scene/poly_hiz.h"
 #include <set>
 #include <unordered_map>
 
 class PolyCull
 {
 public:
-	void CullScene(const PolyClipPlane &portalClipPlane);
+	void CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane);
 
 	bool IsLineSegVisible(uint32_t subsectorDepth, uint32_t lineIndex)
 	{
@@ -44,6 +45,9 @@ public:
 	std::vector<bool> SectorSeen;
 	std::vector<uint32_t> SubsectorDepths;
 
+	// Opaque geometry of the subsectors in PvsSectors, for occlusion tests
+	PolyHierarchicalZ HiZ;
+
 	static angle_t PointToPseudoAngle(double x, double y);
 
 private:
@@ -70,6 +74,12 @@ private:
 
 	void MarkSegmentCulled(angle_t angle1, angle_t angle2);
 
+	void FindMaxSkyHeights();
+	bool IsSubsectorOccluded(subsector_t *sub);
+	void AddOccluders(subsector_t *sub, uint32_t lineStart);
+	void AddWallOccluder(seg_t *line, double ceilz1, double floorz1, double ceilz2, double floorz2);
+	void AddFlatOccluder(subsector_t *sub, const secplane_t &plane);
+
 	FString lastLevelName;
 
 	std::vector<SolidSegment> SolidSegments;
@@ -83,5 +93,15 @@ private:
 	std::vector<bool> PvsLineVisible;
 	uint32_t NextPvsLineStart = 0;
 
+	// Subsectors rejected by the occlusion test. Their things are still
+	// sorted by the depth they would have had.
+	std::vector<subsector_t *> OccludedSubsectors;
+
+	// Highest and lowest planes in the level, as sky planes and sector
+	// portals are drawn at MaxCeilingHeight and MinFloorHeight
+	double LevelMaxCeilingHeight = 0.0;
+	double LevelMinFloorHeight = 0.0;
+	std::vector<DVector3> OccluderVertices;
+
 	static angle_t AngleToPseudo(angle_t ang);
 };
@@ -0,0 +1,355 @@
+/*
+**  Polygon Doom software renderer
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#include <stdlib.h>
+#include <float.h>
+#include "templates.h"
+#include "doomdef.h"
+#include "c_cvars.h"
+#include "stats.h"
+#include "poly_hiz.h"
+
+EXTERN_CVAR(Bool, r_polyhiz)
+
+const float PolyHierarchicalZ::NearW = 5.0f;
+int PolyHierarchicalZ::Tested[NumObjectTypes];
+int PolyHierarchicalZ::Rejected[NumObjectTypes];
+
+void PolyHierarchicalZ::Clear(const TriMatrix &worldToClip, int viewwidth, int viewheight)
+{
+	Enabled = true;
+	WorldToClip = worldToClip;
+
+	int width = BaseWidth;
+	int height = clamp(BaseWidth * viewheight / MAX(viewwidth, 1), 1, (int)BaseWidth);
+	if (width != Width || height != Height)
+	{
+		Width = width;
+		Height = height;
+
+		LevelOffsets.clear();
+		LevelWidths.clear();
+		LevelHeights.clear();
+		int offset = 0;
+		while (true)
+		{
+			LevelOffsets.push_back(offset);
+			LevelWidths.push_back(width);
+			LevelHeights.push_back(height);
+			offset += width * height;
+			if (width == 1 && height == 1)
+				break;
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+		Values.resize(offset);
+	}
+
+	std::fill(Values.begin(), Values.end(), 0.0f);
+
+	for (int i = 0; i < NumObjectTypes; i++)
+	{
+		Tested[i] = 0;
+		Rejected[i] = 0;
+	}
+}
+
+void PolyHierarchicalZ::AddOccluder(const DVector3 *vertices, int count)
+{
+	if (!Enabled || count < 3)
+		return;
+
+	ClipVertices.resize(count);
+	for (int i = 0; i < count; i++)
+		ClipVertices[i] = WorldToClip * FVector4((float)vertices[i].X, (float)vertices[i].Y, (float)vertices[i].Z, 1.0f);
+
+	// Only the part in front of the near plane is drawn
+	ClippedVertices.clear();
+	for (int i = 0; i < count; i++)
+	{
+		const FVector4 &a = ClipVertices[i];
+		const FVector4 &b = ClipVertices[(i + 1) % count];
+		bool insideA = a.W >= NearW;
+		bool insideB = b.W >= NearW;
+		if (insideA)
+			ClippedVertices.push_back(a);
+		if (insideA != insideB)
+			ClippedVertices.push_back(a + (b - a) * ((NearW - a.W) / (b.W - a.W)));
+	}
+
+	int numvertices = (int)ClippedVertices.size();
+	if (numvertices < 3)
+		return;
+
+	ScreenVertices.resize(numvertices);
+	float miny = FLT_MAX, maxy = -FLT_MAX;
+	float mininvw = FLT_MAX, maxinvw = 0.0f;
+	for (int i = 0; i < numvertices; i++)
+	{
+		const FVector4 &v = ClippedVertices[i];
+		ScreenVertex &sv = ScreenVertices[i];
+		sv.iw = 1.0f / v.W;
+		sv.x = (v.X * sv.iw * 0.5f + 0.5f) * Width;
+		sv.y = (0.5f - v.Y * sv.iw * 0.5f) * Height;
+		miny = MIN(miny, sv.y);
+		maxy = MAX(maxy, sv.y);
+		mininvw = MIN(mininvw, sv.iw);
+		maxinvw = MAX(maxinvw, sv.iw);
+	}
+
+	// 1/w is linear in screen space. Find its gradient using the largest triangle of the fan.
+	const ScreenVertex *v = ScreenVertices.data();
+	float det = 0.0f;
+	int best = 1;
+	for (int i = 1; i + 1 < numvertices; i++)
+	{
+		float area = (v[i].x - v[0].x) * (v[i + 1].y - v[0].y) - (v[i + 1].x - v[0].x) * (v[i].y - v[0].y);
+		if (fabs(area) > fabs(det))
+		{
+			det = area;
+			best = i;
+		}
+	}
+	if (fabs(det) < 0.01f)
+		return;
+
+	float dx1 = v[best].x - v[0].x, dy1 = v[best].y - v[0].y, dw1 = v[best].iw - v[0].iw;
+	float dx2 = v[best + 1].x - v[0].x, dy2 = v[best + 1].y - v[0].y, dw2 = v[best + 1].iw - v[0].iw;
+	float gradx = (dw1 * dy2 - dw2 * dy1) / det;
+	float grady = (dx1 * dw2 - dx2 * dw1) / det;
+	float base = v[0].iw - gradx * v[0].x - grady * v[0].y;
+
+	// Mark the cells fully inside the polygon with the farthest depth of the polygon within the cell
+	int y0 = MAX((int)ceil(MAX(miny, -1.0f)), 0);
+	int y1 = MIN((int)floor(MIN(maxy, (float)Height)), Height);
+	int dirtyx0 = Width, dirtyx1 = 0, dirtyy0 = Height, dirtyy1 = 0;
+	float *cells = Level(0);
+	for (int y = y0; y < y1; y++)
+	{
+		float left0, right0, left1, right1;
+		if (!GetSpan(v, numvertices, (float)y, left0, right0) || !GetSpan(v, numvertices, (float)(y + 1), left1, right1))
+			continue;
+
+		int x0 = MAX((int)ceil(clamp(MAX(left0, left1), -1.0f, (float)Width)), 0);
+		int x1 = MIN((int)floor(clamp(MIN(right0, right1), -1.0f, (float)Width)), Width);
+		if (x0 >= x1)
+			continue;
+
+		float *line = cells + y * Width;
+		float rowinvw = base + grady * y + MIN(grady, 0.0f) + MIN(gradx, 0.0f);
+		for (int x = x0; x < x1; x++)
+		{
+			// Small safety margin so that geometry lying on the occluder itself is never rejected
+			float invw = clamp(rowinvw + gradx * x, mininvw, maxinvw) * (1.0f - 1.0f / 1024.0f);
+			line[x] = MAX(line[x], invw);
+		}
+
+		dirtyx0 = MIN(dirtyx0, x0);
+		dirtyx1 = MAX(dirtyx1, x1);
+		dirtyy0 = MIN(dirtyy0, y);
+		dirtyy1 = y + 1;
+	}
+
+	if (dirtyx0 < dirtyx1)
+		UpdateLevels(dirtyx0, dirtyy0, dirtyx1, dirtyy1);
+}
+
+bool PolyHierarchicalZ::GetSpan(const ScreenVertex *vertices, int count, float y, float &left, float &right) const
+{
+	left = FLT_MAX;
+	right = -FLT_MAX;
+	for (int i = 0; i < count; i++)
+	{
+		const ScreenVertex &a = vertices[i];
+		const ScreenVertex &b = vertices[(i + 1) % count];
+		if ((a.y <= y && b.y >= y) || (b.y <= y && a.y >= y))
+		{
+			if (a.y == b.y)
+			{
+				left = MIN(left, MIN(a.x, b.x));
+				right = MAX(right, MAX(a.x, b.x));
+			}
+			else
+			{
+				float x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+				left = MIN(left, x);
+				right = MAX(right, x);
+			}
+		}
+	}
+
+	// Keep away from the edges to stay conservative in the face of rounding
+	left += 0.01f;
+	right -= 0.01f;
+	return left < right;
+}
+
+void PolyHierarchicalZ::UpdateLevels(int x0, int y0, int x1, int y1)
+{
+	for (size_t level = 1; level < LevelOffsets.size(); level++)
+	{
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 = (x1 + 1) >> 1;
+		y1 = (y1 + 1) >> 1;
+
+		const float *src = Level((int)level - 1);
+		int srcwidth = LevelWidths[level - 1];
+		int srcheight = LevelHeights[level - 1];
+		float *dest = Level((int)level);
+		int destwidth = LevelWidths[level];
+
+		for (int y = y0; y < y1; y++)
+		{
+			int sy = y * 2;
+			for (int x = x0; x < x1; x++)
+			{
+				int sx = x * 2;
+				float value = src[sx + sy * srcwidth];
+				if (sx + 1 < srcwidth)
+					value = MIN(value, src[sx + 1 + sy * srcwidth]);
+				if (sy + 1 < srcheight)
+				{
+					value = MIN(value, src[sx + (sy + 1) * srcwidth]);
+					if (sx + 1 < srcwidth)
+						value = MIN(value, src[sx + 1 + (sy + 1) * srcwidth]);
+				}
+				dest[x + y * destwidth] = value;
+			}
+		}
+	}
+}
+
+bool PolyHierarchicalZ::IsBoxOccluded(ObjectType type, const DVector3 &mins, const DVector3 &maxs)
+{
+	DVector3 points[8];
+	for (int i = 0; i < 8; i++)
+	{
+		points[i].X = (i & 1) ? maxs.X : mins.X;
+		points[i].Y = (i & 2) ? maxs.Y : mins.Y;
+		points[i].Z = (i & 4) ? maxs.Z : mins.Z;
+	}
+	return IsOccluded(type, points, 8);
+}
+
+bool PolyHierarchicalZ::IsOccluded(ObjectType type, const DVector3 *points, int count)
+{
+	if (!Enabled)
+		return false;
+
+	ClipVertices.resize(count);
+	for (int i = 0; i < count; i++)
+		ClipVertices[i] = WorldToClip * FVector4((float)points[i].X, (float)points[i].Y, (float)points[i].Z, 1.0f);
+	return IsClipSpaceOccluded(type, ClipVertices.data(), count);
+}
+
+bool PolyHierarchicalZ::IsClipSpaceOccluded(ObjectType type, const FVector4 *points, int count)
+{
+	if (!Enabled)
+		return false;
+
+	Tested[type]++;
+
+	float minx = FLT_MAX, miny = FLT_MAX, maxx = -FLT_MAX, maxy = -FLT_MAX;
+	float nearestinvw = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		const FVector4 &p = points[i];
+		if (p.W < NearW)
+			return false;
+
+		float invw = 1.0f / p.W;
+		float x = (p.X * invw * 0.5f + 0.5f) * Width;
+		float y = (0.5f - p.Y * invw * 0.5f) * Height;
+		minx = MIN(minx, x);
+		maxx = MAX(maxx, x);
+		miny = MIN(miny, y);
+		maxy = MAX(maxy, y);
+		nearestinvw = MAX(nearestinvw, invw);
+	}
+
+	if (!IsRectOccluded(minx, miny, maxx, maxy, nearestinvw))
+		return false;
+
+	Rejected[type]++;
+	return true;
+}
+
+bool PolyHierarchicalZ::IsRectOccluded(float minx, float miny, float maxx, float maxy, float nearestinvw) const
+{
+	int x0 = MAX((int)floor(clamp(minx, -1.0f, (float)Width)), 0);
+	int x1 = MIN((int)floor(clamp(maxx, -1.0f, (float)Width)), Width - 1);
+	int y0 = MAX((int)floor(clamp(miny, -1.0f, (float)Height)), 0);
+	int y1 = MIN((int)floor(clamp(maxy, -1.0f, (float)Height)), Height - 1);
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	// Go up the levels until the rectangle only touches a few cells
+	int level = 0;
+	while (x1 - x0 >= MaxTestSize || y1 - y0 >= MaxTestSize)
+	{
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 >>= 1;
+		y1 >>= 1;
+		level++;
+	}
+
+	const float *cells = Level(level);
+	int width = LevelWidths[level];
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (!(nearestinvw < cells[x + y * width]))
+				return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// How many of the objects tested against the occlusion buffer were
+// rejected in the last frame
+//
+//==========================================================================
+
+ADD_STAT(polyhiz)
+{
+	static const char *names[PolyHierarchicalZ::NumObjectTypes] = { "Subsectors", "Sprites", "Models" };
+
+	FString out;
+	if (!r_polyhiz)
+	{
+		out = "Occlusion culling is off";
+		return out;
+	}
+
+	for (int i = 0; i < PolyHierarchicalZ::NumObjectTypes; i++)
+	{
+		int tested = PolyHierarchicalZ::Tested[i];
+		int rejected = PolyHierarchicalZ::Rejected[i];
+		out.AppendFormat("%s%s: %d/%d culled (%d%%)", i > 0 ? ", " : "", names[i], rejected, tested, tested > 0 ? rejected * 100 / tested : 0);
+	}
+	return out;
+}
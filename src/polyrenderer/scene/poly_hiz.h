@@ -0,0 +1,97 @@
+/*
+**  Polygon Doom software renderer
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include <vector>
+#include "vectors.h"
+#include "polyrenderer/math/tri_matrix.h"
+
+// Coarse screen space depth buffer of the opaque geometry found so far.
+//
+// Each cell stores the 1/w of the farthest point of the occluders fully
+// covering it. Anything entirely farther away than that is hidden. Every
+// level halves the resolution of the one below, keeping the minimum of the
+// four cells, so a large screen rectangle can be tested with a few reads.
+class PolyHierarchicalZ
+{
+public:
+	enum ObjectType
+	{
+		Subsector,
+		Sprite,
+		Model,
+		NumObjectTypes
+	};
+
+	void Clear(const TriMatrix &worldToClip, int viewwidth, int viewheight);
+	void Disable() { Enabled = false; }
+	bool IsEnabled() const { return Enabled; }
+
+	// Adds a planar convex polygon that will be drawn fully opaque
+	void AddOccluder(const DVector3 *vertices, int count);
+
+	// True if the world space box is hidden by the occluders
+	bool IsBoxOccluded(ObjectType type, const DVector3 &mins, const DVector3 &maxs);
+
+	// True if the convex hull of the world space points is hidden by the occluders
+	bool IsOccluded(ObjectType type, const DVector3 *points, int count);
+
+	// Same as IsOccluded, for points already transformed to clip space
+	bool IsClipSpaceOccluded(ObjectType type, const FVector4 *points, int count);
+
+	static int Tested[NumObjectTypes];
+	static int Rejected[NumObjectTypes];
+
+private:
+	struct ScreenVertex
+	{
+		float x, y, iw;
+	};
+
+	bool IsRectOccluded(float x0, float y0, float x1, float y1, float nearestInvW) const;
+	bool GetSpan(const ScreenVertex *vertices, int count, float y, float &left, float &right) const;
+	void UpdateLevels(int x0, int y0, int x1, int y1);
+
+	float *Level(int index) { return Values.data() + LevelOffsets[index]; }
+	const float *Level(int index) const { return Values.data() + LevelOffsets[index]; }
+
+	bool Enabled = false;
+	TriMatrix WorldToClip;
+
+	std::vector<float> Values;
+	std::vector<int> LevelOffsets;
+	std::vector<int> LevelWidths;
+	std::vector<int> LevelHeights;
+	int Width = 0;
+	int Height = 0;
+
+	std::vector<FVector4> ClipVertices;
+	std::vector<FVector4> ClippedVertices;
+	std::vector<ScreenVertex> ScreenVertices;
+
+	// Same as the near plane of the projection. Occluders are clipped to it and
+	// objects crossing it are always visible.
+	static const float NearW;
+	static const int BaseWidth = 128;
+	static const int MaxTestSize = 8;
+};
@@ -26,6 +26,7 @@
 #include "sbar.h"
 #include "r_data/r_translate.h"
 #include "poly_model.h"
+#include "polyrenderer/scene/poly_hiz.h"
 #include "polyrenderer/poly_renderer.h"
 #include "polyrenderer/scene/poly_light.h"
 #include "polyrenderer/poly_renderthread.h"
@@ -33,9 +34,10 @@
 #include "actorinlines.h"
 #include "i_time.h"
 
-void PolyRenderModel(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, uint32_t stencilValue, float x, float y, float z, FSpriteModelFrame *smf, AActor *actor)
+void PolyRenderModel(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, uint32_t stencilValue, float x, float y, float z, FSpriteModelFrame *smf, AActor *actor, PolyHierarchicalZ *hiz)
 {
 	PolyModelRenderer renderer(thread, worldToClip, clipPlane, stencilValue);
+	renderer.HiZ = hiz;
 	renderer.RenderModel(x, y, z, smf, actor);
 }
 
@@ -110,6 +112,9 @@ void PolyModelRenderer::SetMaterial(FTexture *skin, bool clampNoFilter, int tran
 
 void PolyModelRenderer::DrawArrays(int start, int count)
 {
+	if (Occluded)
+		return;
+
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
 
 	bool foggy = false;
@@ -119,14 +124,8 @@ void PolyModelRenderer::DrawArrays(int start, int count)
 	bool fullbrightSprite = ((ModelActor->renderflags & RF_FULLBRIGHT) || (ModelActor->flags5 & MF5_BRIGHT));
 	int lightlevel = fullbrightSprite ? 255 : ModelActor->Sector->lightlevel + actualextralight;
 
-	TriMatrix swapYZ = TriMatrix::null();
-	swapYZ.matrix[0 + 0 * 4] = 1.0f;
-	swapYZ.matrix[1 + 2 * 4] = 1.0f;
-	swapYZ.matrix[2 + 1 * 4] = 1.0f;
-	swapYZ.matrix[3 + 3 * 4] = 1.0f;
-
 	TriMatrix *transform = Thread->FrameMemory->NewObject<TriMatrix>();
-	*transform = WorldToClip * swapYZ * ObjectToWorld;
+	*transform = GetObjectToClip();
 
 	PolyDrawArgs args;
 	args.SetLight(GetColorTable(sector->Colormap, sector->SpecialColors[sector_t::sprites], true), lightlevel, PolyRenderer::Instance()->Light.SpriteGlobVis(foggy), fullbrightSprite);
@@ -144,6 +143,9 @@ void PolyModelRenderer::DrawArrays(int start, int count)
 
 void PolyModelRenderer::DrawElements(int numIndices, size_t offset)
 {
+	if (Occluded)
+		return;
+
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
 
 	bool foggy = false;
@@ -153,14 +155,8 @@ void PolyModelRenderer::DrawElements(int numIndices, size_t offset)
 	bool fullbrightSprite = ((ModelActor->renderflags & RF_FULLBRIGHT) || (ModelActor->flags5 & MF5_BRIGHT));
 	int lightlevel = fullbrightSprite ? 255 : ModelActor->Sector->lightlevel + actualextralight;
 
-	TriMatrix swapYZ = TriMatrix::null();
-	swapYZ.matrix[0 + 0 * 4] = 1.0f;
-	swapYZ.matrix[1 + 2 * 4] = 1.0f;
-	swapYZ.matrix[2 + 1 * 4] = 1.0f;
-	swapYZ.matrix[3 + 3 * 4] = 1.0f;
-
 	TriMatrix *transform = Thread->FrameMemory->NewObject<TriMatrix>();
-	*transform = WorldToClip * swapYZ * ObjectToWorld;
+	*transform = GetObjectToClip();
 
 	PolyDrawArgs args;
 	args.SetLight(GetColorTable(sector->Colormap, sector->SpecialColors[sector_t::sprites], true), lightlevel, PolyRenderer::Instance()->Light.SpriteGlobVis(foggy), fullbrightSprite);
@@ -176,6 +172,45 @@ void PolyModelRenderer::DrawElements(int numIndices, size_t offset)
 	args.DrawElements(Thread, VertexBuffer, IndexBuffer + offset / sizeof(unsigned int), numIndices);
 }
 
+TriMatrix PolyModelRenderer::GetObjectToClip() const
+{
+	TriMatrix swapYZ = TriMatrix::null();
+	swapYZ.matrix[0 + 0 * 4] = 1.0f;
+	swapYZ.matrix[1 + 2 * 4] = 1.0f;
+	swapYZ.matrix[2 + 1 * 4] = 1.0f;
+	swapYZ.matrix[3 + 3 * 4] = 1.0f;
+
+	return WorldToClip * swapYZ * ObjectToWorld;
+}
+
+void PolyModelRenderer::CheckOcclusion(const TriVertex *vertices, unsigned int count)
+{
+	Occluded = false;
+	if (!HiZ || !HiZ->IsEnabled() || count == 0)
+		return;
+
+	FVector3 mins(vertices[0].x, vertices[0].y, vertices[0].z);
+	FVector3 maxs = mins;
+	for (unsigned int i = 1; i < count; i++)
+	{
+		mins.X = MIN(mins.X, vertices[i].x);
+		mins.Y = MIN(mins.Y, vertices[i].y);
+		mins.Z = MIN(mins.Z, vertices[i].z);
+		maxs.X = MAX(maxs.X, vertices[i].x);
+		maxs.Y = MAX(maxs.Y, vertices[i].y);
+		maxs.Z = MAX(maxs.Z, vertices[i].z);
+	}
+
+	TriMatrix objectToClip = GetObjectToClip();
+	FVector4 points[8];
+	for (int i = 0; i < 8; i++)
+	{
+		FVector4 corner((i & 1) ? maxs.X : mins.X, (i & 2) ? maxs.Y : mins.Y, (i & 4) ? maxs.Z : mins.Z, 1.0f);
+		points[i] = objectToClip * corner;
+	}
+	Occluded = HiZ->IsClipSpaceOccluded(PolyHierarchicalZ::Model, points, 8);
+}
+
 double PolyModelRenderer::GetTimeFloat()
 {
 	return (float)I_msTime() * (float)TICRATE / 1000.0f;
@@ -253,4 +288,6 @@ void PolyModelVertexBuffer::SetupFrame(FModelRenderer *renderer, unsigned int fr
 		polyrenderer->VertexBuffer = vertices;
 		polyrenderer->IndexBuffer = &mIndexBuffer[0];
 	}
+
+	polyrenderer->CheckOcclusion(polyrenderer->VertexBuffer, size);
 }
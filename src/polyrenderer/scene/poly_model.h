@@ -26,7 +26,9 @@
 #include "r_data/matrix.h"
 #include "gl/models/gl_models.h"
 
-void PolyRenderModel(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, uint32_t stencilValue, float x, float y, float z, FSpriteModelFrame *smf, AActor *actor);
+class PolyHierarchicalZ;
+
+void PolyRenderModel(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, uint32_t stencilValue, float x, float y, float z, FSpriteModelFrame *smf, AActor *actor, PolyHierarchicalZ *hiz);
 void PolyRenderHUDModel(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, uint32_t stencilValue, DPSprite *psp, float ofsx, float ofsy);
 
 class PolyModelRenderer : public FModelRenderer
@@ -48,6 +50,9 @@ public:
 	void DrawElements(int numIndices, size_t offset) override;
 	double GetTimeFloat() override;
 
+	TriMatrix GetObjectToClip() const;
+	void CheckOcclusion(const TriVertex *vertices, unsigned int count);
+
 	PolyRenderThread *Thread = nullptr;
 	const TriMatrix &WorldToClip;
 	const PolyClipPlane &ClipPlane;
@@ -59,6 +64,10 @@ public:
 	unsigned int *IndexBuffer = nullptr;
 	TriVertex *VertexBuffer = nullptr;
 	float InterpolationFactor = 0.0;
+
+	// Skips the frame when its vertices are hidden behind the occluders of the scene
+	PolyHierarchicalZ *HiZ = nullptr;
+	bool Occluded = false;
 };
 
 class PolyModelVertexBuffer : public IModelVertexBuffer
@@ -60,7 +60,7 @@ void RenderPolyScene::Render(int portalDepth)
 
 	SectorPortals.clear();
 	LinePortals.clear();
-	Cull.CullScene(PortalPlane);
+	Cull.CullScene(WorldToClip, PortalPlane);
 	RenderSectors();
 	RenderPortals(portalDepth);
 }
@@ -144,7 +144,7 @@ void RenderPolyScene::RenderSubsector(PolyRenderThread *thread, subsector_t *sub
 	if (mainBSP)
 	{
 		int subsectorIndex = sub->Index();
-		for (int i = ParticlesInSubsec[subsectorIndex]; i != NO_PARTICLE; i = Particles[i].snext)
+		for (uint32_t i = ParticlesInSubsec[subsectorIndex]; i != NO_PARTICLE; i = Particles[i].snext)
 		{
 			particle_t *particle = Particles + i;
 			TranslucentObjects[thread->ThreadIndex].push_back(thread->FrameMemory->NewObject<PolyTranslucentParticle>(particle, sub, subsectorDepth, StencilValue));
@@ -216,7 +216,7 @@ void RenderPolyScene::RenderSprite(PolyRenderThread *thread, AActor *thing, doub
 	{
 		subsector_t *sub = &level.subsectors[0];
 		if (Cull.SubsectorDepths[sub->Index()] != 0xffffffff)
-			TranslucentObjects[thread->ThreadIndex].push_back(thread->FrameMemory->NewObject<PolyTranslucentThing>(thing, sub, Cull.SubsectorDepths[sub->Index()], sortDistance, 0.0f, 1.0f, StencilValue));
+			TranslucentObjects[thread->ThreadIndex].push_back(thread->FrameMemory->NewObject<PolyTranslucentThing>(thing, sub, Cull.SubsectorDepths[sub->Index()], sortDistance, 0.0f, 1.0f, StencilValue, &Cull.HiZ));
 	}
 	else
 	{
@@ -256,7 +256,7 @@ void RenderPolyScene::RenderSprite(PolyRenderThread *thread, AActor *thing, doub
 	subsector_t *sub = (subsector_t *)((uint8_t *)node - 1);
 	
 	if (Cull.SubsectorDepths[sub->Index()] != 0xffffffff)
-		TranslucentObjects[thread->ThreadIndex].push_back(thread->FrameMemory->NewObject<PolyTranslucentThing>(thing, sub, Cull.SubsectorDepths[sub->Index()], sortDistance, (float)t1, (float)t2, StencilValue));
+		TranslucentObjects[thread->ThreadIndex].push_back(thread->FrameMemory->NewObject<PolyTranslucentThing>(thing, sub, Cull.SubsectorDepths[sub->Index()], sortDistance, (float)t1, (float)t2, StencilValue, &Cull.HiZ));
 }
 
 void RenderPolyScene::RenderLine(PolyRenderThread *thread, subsector_t *sub, seg_t *line, sector_t *frontsector, uint32_t subsectorDepth)
@@ -379,6 +379,8 @@ void RenderPolyScene::RenderTranslucent(int portalDepth)
 			DVector2 left, right;
 			if (!RenderPolySprite::GetLine(thing, left, right))
 				continue;
+			if (RenderPolySprite::IsOccluded(Cull.HiZ, thing, left, right))
+				continue;
 			double distanceSquared = (thing->Pos() - viewpoint.Pos).LengthSquared();
 			RenderSprite(thread, thing, distanceSquared, left, right);
 		}
@@ -30,6 +30,7 @@
 #include "polyrenderer/scene/poly_light.h"
 #include "polyrenderer/poly_renderthread.h"
 #include "polyrenderer/scene/poly_model.h"
+#include "polyrenderer/scene/poly_hiz.h"
 #include "r_data/r_vanillatrans.h"
 #include "actorinlines.h"
 
@@ -72,16 +73,41 @@ bool RenderPolySprite::GetLine(AActor *thing, DVector2 &left, DVector2 &right)
 	return true;
 }
 
-void RenderPolySprite::Render(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, AActor *thing, subsector_t *sub, uint32_t stencilValue, float t1, float t2)
+bool RenderPolySprite::IsOccluded(PolyHierarchicalZ &hiz, AActor *thing, const DVector2 &left, const DVector2 &right)
 {
-	int spritenum = thing->sprite;
-	bool isPicnumOverride = thing->picnum.isValid();
-	FSpriteModelFrame *modelframe = isPicnumOverride ? nullptr : gl_FindModelFrame(thing->GetClass(), spritenum, thing->frame, !!(thing->flags & MF_DROPPED));
+	if (!hiz.IsEnabled())
+		return false;
+
+	// Wall sprites are not drawn along the line and models are tested against their vertices
+	if ((thing->renderflags & RF_SPRITETYPEMASK) == RF_WALLSPRITE || FindModelFrame(thing))
+		return false;
+
+	bool flipTextureX = false;
+	FTexture *tex = GetSpriteTexture(thing, flipTextureX);
+	if (tex == nullptr || tex->UseType == FTexture::TEX_Null)
+		return false;
+
+	double spriteHeight;
+	double posZ = GetSpriteZ(thing, tex, spriteHeight);
+
+	DVector3 points[4] =
+	{
+		{ left.X, left.Y, posZ },
+		{ right.X, right.Y, posZ },
+		{ right.X, right.Y, posZ + spriteHeight },
+		{ left.X, left.Y, posZ + spriteHeight }
+	};
+	return hiz.IsOccluded(PolyHierarchicalZ::Sprite, points, 4);
+}
+
+void RenderPolySprite::Render(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, AActor *thing, subsector_t *sub, uint32_t stencilValue, float t1, float t2, PolyHierarchicalZ *hiz)
+{
+	FSpriteModelFrame *modelframe = FindModelFrame(thing);
 	if (modelframe)
 	{
 		const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
 		DVector3 pos = thing->InterpolatedPosition(viewpoint.TicFrac);
-		PolyRenderModel(thread, worldToClip, clipPlane, stencilValue, (float)pos.X, (float)pos.Y, (float)pos.Z, modelframe, thing);
+		PolyRenderModel(thread, worldToClip, clipPlane, stencilValue, (float)pos.X, (float)pos.Y, (float)pos.Z, modelframe, thing, hiz);
 		return;
 	}
 
@@ -90,28 +116,14 @@ void RenderPolySprite::Render(PolyRenderThread *thread, const TriMatrix &worldTo
 		return;
 	
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
-	DVector3 thingpos = thing->InterpolatedPosition(viewpoint.TicFrac);
-
-	double posZ = thingpos.Z;
-
-	uint32_t spritetype = (thing->renderflags & RF_SPRITETYPEMASK);
-
-	if (spritetype == RF_FACESPRITE)
-		posZ -= thing->Floorclip;
-
-	if (thing->flags2 & MF2_FLOATBOB)
-		posZ += thing->GetBobOffset(viewpoint.TicFrac);
 
 	bool flipTextureX = false;
 	FTexture *tex = GetSpriteTexture(thing, flipTextureX);
 	if (tex == nullptr || tex->UseType == FTexture::TEX_Null)
 		return;
 
-	double thingyscalemul = thing->Scale.Y / tex->Scale.Y;
-	double spriteHeight = thingyscalemul * tex->GetHeight();
-
-	posZ -= (tex->GetHeight() - tex->TopOffset) * thingyscalemul;
-	posZ = PerformSpriteClipAdjustment(thing, thingpos, spriteHeight, posZ);
+	double spriteHeight;
+	double posZ = GetSpriteZ(thing, tex, spriteHeight);
 
 	//double depth = 1.0;
 	//visstyle_t visstyle = GetSpriteVisStyle(thing, depth);
@@ -172,6 +184,34 @@ void RenderPolySprite::Render(PolyRenderThread *thread, const TriMatrix &worldTo
 	args.DrawArray(thread, vertices, 4, PolyDrawMode::TriangleFan);
 }
 
+FSpriteModelFrame *RenderPolySprite::FindModelFrame(AActor *thing)
+{
+	bool isPicnumOverride = thing->picnum.isValid();
+	return isPicnumOverride ? nullptr : gl_FindModelFrame(thing->GetClass(), thing->sprite, thing->frame, !!(thing->flags & MF_DROPPED));
+}
+
+double RenderPolySprite::GetSpriteZ(AActor *thing, FTexture *tex, double &spriteHeight)
+{
+	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
+	DVector3 thingpos = thing->InterpolatedPosition(viewpoint.TicFrac);
+
+	double posZ = thingpos.Z;
+
+	uint32_t spritetype = (thing->renderflags & RF_SPRITETYPEMASK);
+
+	if (spritetype == RF_FACESPRITE)
+		posZ -= thing->Floorclip;
+
+	if (thing->flags2 & MF2_FLOATBOB)
+		posZ += thing->GetBobOffset(viewpoint.TicFrac);
+
+	double thingyscalemul = thing->Scale.Y / tex->Scale.Y;
+	spriteHeight = thingyscalemul * tex->GetHeight();
+
+	posZ -= (tex->GetHeight() - tex->TopOffset) * thingyscalemul;
+	return PerformSpriteClipAdjustment(thing, thingpos, spriteHeight, posZ);
+}
+
 double RenderPolySprite::GetSpriteFloorZ(AActor *thing, const DVector2 &thingpos)
 {
 	extsector_t::xfloor &x = thing->Sector->e->XFloor;
@@ -24,16 +24,22 @@
 
 #include "polyrenderer/drawers/poly_triangle.h"
 
+class PolyHierarchicalZ;
+struct FSpriteModelFrame;
+
 class RenderPolySprite
 {
 public:
-	void Render(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, AActor *thing, subsector_t *sub, uint32_t stencilValue, float t1, float t2);
+	void Render(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &clipPlane, AActor *thing, subsector_t *sub, uint32_t stencilValue, float t1, float t2, PolyHierarchicalZ *hiz);
 
 	static bool GetLine(AActor *thing, DVector2 &left, DVector2 &right);
 	static bool IsThingCulled(AActor *thing);
+	static bool IsOccluded(PolyHierarchicalZ &hiz, AActor *thing, const DVector2 &left, const DVector2 &right);
 	static FTexture *GetSpriteTexture(AActor *thing, /*out*/ bool &flipX);
 
 private:
+	static FSpriteModelFrame *FindModelFrame(AActor *thing);
+	static double GetSpriteZ(AActor *thing, FTexture *tex, double &spriteHeight);
 	static double PerformSpriteClipAdjustment(AActor *thing, const DVector2 &thingpos, double spriteheight, double z);
 	static double GetSpriteFloorZ(AActor *thing, const DVector2 &thingpos);
 	static double GetSpriteCeilingZ(AActor *thing, const DVector2 &thingpos);
@@ -43,7 +49,7 @@ private:
 class PolyTranslucentThing : public PolyTranslucentObject
 {
 public:
-	PolyTranslucentThing(AActor *thing, subsector_t *sub, uint32_t subsectorDepth, double dist, float t1, float t2, uint32_t stencilValue) : PolyTranslucentObject(subsectorDepth, dist), thing(thing), sub(sub), SpriteLeft(t1), SpriteRight(t2), StencilValue(stencilValue) { }
+	PolyTranslucentThing(AActor *thing, subsector_t *sub, uint32_t subsectorDepth, double dist, float t1, float t2, uint32_t stencilValue, PolyHierarchicalZ *hiz) : PolyTranslucentObject(subsectorDepth, dist), thing(thing), sub(sub), SpriteLeft(t1), SpriteRight(t2), StencilValue(stencilValue), HiZ(hiz) { }
 
 	void Render(PolyRenderThread *thread, const TriMatrix &worldToClip, const PolyClipPlane &portalPlane) override
 	{
@@ -55,7 +61,7 @@ public:
 		else
 		{
 			RenderPolySprite spr;
-			spr.Render(thread, worldToClip, portalPlane, thing, sub, StencilValue + 1, SpriteLeft, SpriteRight);
+			spr.Render(thread, worldToClip, portalPlane, thing, sub, StencilValue + 1, SpriteLeft, SpriteRight, HiZ);
 		}
 	}
 
@@ -64,4 +70,5 @@ public:
 	float SpriteLeft = 0.0f;
 	float SpriteRight = 1.0f;
 	uint32_t StencilValue = 0;
+	PolyHierarchicalZ *HiZ = nullptr;
 };
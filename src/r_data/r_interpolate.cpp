@@ -60,10 +60,11 @@ class DSectorPlaneInterpolation : public DInterpolation
 
 public:
 
-	DSectorPlaneInterpolation() {}
+	DSectorPlaneInterpolation() { Type = INTERP_SectorPlane; }
 	DSectorPlaneInterpolation(sector_t *sector, bool plane, bool attach);
 	void OnDestroy() override;
 	void UpdateInterpolation();
+	bool HasMoved();
 	void Restore();
 	void Interpolate(double smoothratio);
 	
@@ -89,10 +90,11 @@ class DSectorScrollInterpolation : public DInterpolation
 
 public:
 
-	DSectorScrollInterpolation() {}
+	DSectorScrollInterpolation() { Type = INTERP_SectorScroll; }
 	DSectorScrollInterpolation(sector_t *sector, bool plane);
 	void OnDestroy() override;
 	void UpdateInterpolation();
+	bool HasMoved();
 	void Restore();
 	void Interpolate(double smoothratio);
 	
@@ -117,10 +119,11 @@ class DWallScrollInterpolation : public DInterpolation
 
 public:
 
-	DWallScrollInterpolation() {}
+	DWallScrollInterpolation() { Type = INTERP_WallScroll; }
 	DWallScrollInterpolation(side_t *side, int part);
 	void OnDestroy() override;
 	void UpdateInterpolation();
+	bool HasMoved();
 	void Restore();
 	void Interpolate(double smoothratio);
 	
@@ -144,10 +147,11 @@ class DPolyobjInterpolation : public DInterpolation
 
 public:
 
-	DPolyobjInterpolation() {}
+	DPolyobjInterpolation() { Type = INTERP_Polyobj; }
 	DPolyobjInterpolation(FPolyObj *poly);
 	void OnDestroy() override;
 	void UpdateInterpolation();
+	bool HasMoved();
 	void Restore();
 	void Interpolate(double smoothratio);
 	
@@ -212,6 +216,43 @@ void FInterpolator::UpdateInterpolations()
 	{
 		probe->UpdateInterpolation ();
 	}
+	movingValid = false;
+}
+
+//==========================================================================
+//
+// Collects the interpolations whose source was changed by the last tic.
+// This only needs to be done once per tic, the other frames of the same
+// tic reuse the lists.
+//
+// An interpolation nobody refers to anymore is destroyed once its
+// source stops moving.
+//
+//==========================================================================
+
+void FInterpolator::FindMoving()
+{
+	for (auto &list : Moving)
+	{
+		for (auto interp : list) interp->Moving = false;
+		list.Clear();
+	}
+	DInterpolation *probe = Head;
+	while (probe != NULL)
+	{
+		DInterpolation *next = probe->Next;
+		if (probe->HasMoved())
+		{
+			probe->Moving = true;
+			Moving[probe->Type].Push(probe);
+		}
+		else if (probe->refcount == 0)
+		{
+			probe->Destroy();
+		}
+		probe = next;
+	}
+	movingValid = true;
 }
 
 //==========================================================================
@@ -227,6 +268,7 @@ void FInterpolator::AddInterpolation(DInterpolation *interp)
 	interp->Prev = NULL;
 	Head = interp;
 	count++;
+	movingValid = false;
 }
 
 //==========================================================================
@@ -250,6 +292,14 @@ void FInterpolator::RemoveInterpolation(DInterpolation *interp)
 		interp->Next = NULL;
 		interp->Prev = NULL;
 		count--;
+
+	if (interp->Moving)
+	{
+		auto &list = Moving[interp->Type];
+		unsigned index = list.Find(interp);
+		if (index < list.Size()) list.Delete(index);
+		interp->Moving = false;
+	}
 }
 
 //==========================================================================
@@ -258,6 +308,22 @@ void FInterpolator::RemoveInterpolation(DInterpolation *interp)
 //
 //==========================================================================
 
+template<class T> static void InterpolateList(TArray<DInterpolation *> &list, double smoothratio)
+{
+	for (auto interp : list)
+	{
+		static_cast<T *>(interp)->T::Interpolate(smoothratio);
+	}
+}
+
+template<class T> static void RestoreList(TArray<DInterpolation *> &list)
+{
+	for (auto interp : list)
+	{
+		static_cast<T *>(interp)->T::Restore();
+	}
+}
+
 void FInterpolator::DoInterpolations(double smoothratio)
 {
 	if (smoothratio >= 1.)
@@ -266,15 +332,17 @@ void FInterpolator::DoInterpolations(double smoothratio)
 		return;
 	}
 
-	didInterp = true;
-
-	DInterpolation *probe = Head;
-	while (probe != NULL)
+	if (!movingValid)
 	{
-		DInterpolation *next = probe->Next;
-		probe->Interpolate(smoothratio);
-		probe = next;
+		FindMoving();
 	}
+
+	didInterp = true;
+
+	InterpolateList<DSectorPlaneInterpolation>(Moving[INTERP_SectorPlane], smoothratio);
+	InterpolateList<DSectorScrollInterpolation>(Moving[INTERP_SectorScroll], smoothratio);
+	InterpolateList<DWallScrollInterpolation>(Moving[INTERP_WallScroll], smoothratio);
+	InterpolateList<DPolyobjInterpolation>(Moving[INTERP_Polyobj], smoothratio);
 }
 
 //==========================================================================
@@ -288,10 +356,10 @@ void FInterpolator::RestoreInterpolations()
 	if (didInterp)
 	{
 		didInterp = false;
-		for (DInterpolation *probe = Head; probe != NULL; probe = probe->Next)
-		{
-			probe->Restore();
-		}
+		RestoreList<DSectorPlaneInterpolation>(Moving[INTERP_SectorPlane]);
+		RestoreList<DSectorScrollInterpolation>(Moving[INTERP_SectorScroll]);
+		RestoreList<DWallScrollInterpolation>(Moving[INTERP_WallScroll]);
+		RestoreList<DPolyobjInterpolation>(Moving[INTERP_Polyobj]);
 	}
 }
 
@@ -303,6 +371,13 @@ void FInterpolator::RestoreInterpolations()
 
 void FInterpolator::ClearInterpolations()
 {
+	for (auto &list : Moving)
+	{
+		for (auto interp : list) interp->Moving = false;
+		list.Clear();
+	}
+	movingValid = false;
+
 	DInterpolation *probe = Head;
 	Head = NULL;
 	while (probe != NULL)
@@ -314,7 +389,6 @@ void FInterpolator::ClearInterpolations()
 	}
 }
 
-
 //==========================================================================
 //
 //
@@ -331,6 +405,7 @@ DInterpolation::DInterpolation()
 {
 	Next = NULL;
 	Prev = NULL;
+	Moving = false;
 	refcount = 0;
 }
 
@@ -401,6 +476,7 @@ void DInterpolation::Serialize(FSerializer &arc)
 
 DSectorPlaneInterpolation::DSectorPlaneInterpolation(sector_t *_sector, bool _plane, bool attach)
 {
+	Type = INTERP_SectorPlane;
 	sector = _sector;
 	ceiling = _plane;
 	UpdateInterpolation ();
@@ -466,6 +542,19 @@ void DSectorPlaneInterpolation::UpdateInterpolation()
 //
 //==========================================================================
 
+bool DSectorPlaneInterpolation::HasMoved()
+{
+	int pos = ceiling ? sector_t::ceiling : sector_t::floor;
+	const secplane_t &plane = ceiling ? sector->ceilingplane : sector->floorplane;
+	return oldheight != plane.fD() || oldtexz != sector->GetPlaneTexZ(pos);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void DSectorPlaneInterpolation::Restore()
 {
 	if (!ceiling)
@@ -507,17 +596,10 @@ void DSectorPlaneInterpolation::Interpolate(double smoothratio)
 	bakheight = pplane->fD();
 	baktexz = sector->GetPlaneTexZ(pos);
 
-	if (refcount == 0 && oldheight == bakheight)
-	{
-		Destroy();
-	}
-	else
-	{
-		pplane->setD(oldheight + (bakheight - oldheight) * smoothratio);
-		sector->SetPlaneTexZ(pos, oldtexz + (baktexz - oldtexz) * smoothratio, true);
+	pplane->setD(oldheight + (bakheight - oldheight) * smoothratio);
+	sector->SetPlaneTexZ(pos, oldtexz + (baktexz - oldtexz) * smoothratio, true);
 	P_RecalculateAttached3DFloors(sector);
-		sector->CheckPortalPlane(pos);
-	}
+	sector->CheckPortalPlane(pos);
 }
 
 //==========================================================================
@@ -585,6 +667,7 @@ size_t DSectorPlaneInterpolation::PropagateMark()
 
 DSectorScrollInterpolation::DSectorScrollInterpolation(sector_t *_sector, bool _plane)
 {
+	Type = INTERP_SectorScroll;
 	sector = _sector;
 	ceiling = _plane;
 	UpdateInterpolation ();
@@ -632,6 +715,17 @@ void DSectorScrollInterpolation::UpdateInterpolation()
 //
 //==========================================================================
 
+bool DSectorScrollInterpolation::HasMoved()
+{
+	return oldx != sector->GetXOffset(ceiling) || oldy != sector->GetYOffset(ceiling, false);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void DSectorScrollInterpolation::Restore()
 {
 	sector->SetXOffset(ceiling, bakx);
@@ -649,15 +743,8 @@ void DSectorScrollInterpolation::Interpolate(double smoothratio)
 	bakx = sector->GetXOffset(ceiling);
 	baky = sector->GetYOffset(ceiling, false);
 
-	if (refcount == 0 && oldx == bakx && oldy == baky)
-	{
-		Destroy();
-	}
-	else
-	{
-		sector->SetXOffset(ceiling, oldx + (bakx - oldx) * smoothratio);
-		sector->SetYOffset(ceiling, oldy + (baky - oldy) * smoothratio);
-	}
+	sector->SetXOffset(ceiling, oldx + (bakx - oldx) * smoothratio);
+	sector->SetYOffset(ceiling, oldy + (baky - oldy) * smoothratio);
 }
 
 //==========================================================================
@@ -690,6 +777,7 @@ void DSectorScrollInterpolation::Serialize(FSerializer &arc)
 
 DWallScrollInterpolation::DWallScrollInterpolation(side_t *_side, int _part)
 {
+	Type = INTERP_WallScroll;
 	side = _side;
 	part = _part;
 	UpdateInterpolation ();
@@ -730,6 +818,17 @@ void DWallScrollInterpolation::UpdateInterpolation()
 //
 //==========================================================================
 
+bool DWallScrollInterpolation::HasMoved()
+{
+	return oldx != side->GetTextureXOffset(part) || oldy != side->GetTextureYOffset(part);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void DWallScrollInterpolation::Restore()
 {
 	side->SetTextureXOffset(part, bakx);
@@ -747,15 +846,8 @@ void DWallScrollInterpolation::Interpolate(double smoothratio)
 	bakx = side->GetTextureXOffset(part);
 	baky = side->GetTextureYOffset(part);
 
-	if (refcount == 0 && oldx == bakx && oldy == baky)
-	{
-		Destroy();
-	}
-	else
-	{
-		side->SetTextureXOffset(part, oldx + (bakx - oldx) * smoothratio);
-		side->SetTextureYOffset(part, oldy + (baky - oldy) * smoothratio);
-	}
+	side->SetTextureXOffset(part, oldx + (bakx - oldx) * smoothratio);
+	side->SetTextureYOffset(part, oldy + (baky - oldy) * smoothratio);
 }
 
 //==========================================================================
@@ -787,6 +879,7 @@ void DWallScrollInterpolation::Serialize(FSerializer &arc)
 
 DPolyobjInterpolation::DPolyobjInterpolation(FPolyObj *po)
 {
+	Type = INTERP_Polyobj;
 	poly = po;
 	oldverts.Resize(po->Vertices.Size() << 1);
 	bakverts.Resize(po->Vertices.Size() << 1);
@@ -832,6 +925,24 @@ void DPolyobjInterpolation::UpdateInterpolation()
 //
 //==========================================================================
 
+bool DPolyobjInterpolation::HasMoved()
+{
+	for(unsigned int i = 0; i < poly->Vertices.Size(); i++)
+	{
+		if (oldverts[i*2] != poly->Vertices[i]->fX() || oldverts[i*2+1] != poly->Vertices[i]->fY())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void DPolyobjInterpolation::Restore()
 {
 	for(unsigned int i = 0; i < poly->Vertices.Size(); i++)
@@ -851,7 +962,6 @@ void DPolyobjInterpolation::Restore()
 
 void DPolyobjInterpolation::Interpolate(double smoothratio)
 {
-	bool changed = false;
 	for(unsigned int i = 0; i < poly->Vertices.Size(); i++)
 	{
 		bakverts[i*2  ] = poly->Vertices[i]->fX();
@@ -859,25 +969,17 @@ void DPolyobjInterpolation::Interpolate(double smoothratio)
 
 		if (bakverts[i * 2] != oldverts[i * 2] || bakverts[i * 2 + 1] != oldverts[i * 2 + 1])
 		{
-			changed = true;
 			poly->Vertices[i]->set(
 				oldverts[i * 2] + (bakverts[i * 2] - oldverts[i * 2]) * smoothratio,
 				oldverts[i * 2 + 1] + (bakverts[i * 2 + 1] - oldverts[i * 2 + 1]) * smoothratio);
 		}
 	}
-	if (refcount == 0 && !changed)
-	{
-		Destroy();
-	}
-	else
-	{
-		bakcx = poly->CenterSpot.pos.X;
-		bakcy = poly->CenterSpot.pos.Y;
-		poly->CenterSpot.pos.X = bakcx + (bakcx - oldcx) * smoothratio;
-		poly->CenterSpot.pos.Y = bakcy + (bakcy - oldcy) * smoothratio;
+	bakcx = poly->CenterSpot.pos.X;
+	bakcy = poly->CenterSpot.pos.Y;
+	poly->CenterSpot.pos.X = bakcx + (bakcx - oldcx) * smoothratio;
+	poly->CenterSpot.pos.Y = bakcy + (bakcy - oldcy) * smoothratio;
 
-		poly->ClearSubsectorLinks();
-	}
+	poly->ClearSubsectorLinks();
 }
 
 //==========================================================================
@@ -1006,7 +1108,9 @@ void FPolyObj::StopInterpolation()
 ADD_STAT (interpolations)
 {
 	FString out;
-	out.Format ("%d interpolations", interpolator.CountInterpolations ());
+	out.Format ("%d interpolations, moving: %u planes, %u flat scrolls, %u wall scrolls, %u polyobjects", interpolator.CountInterpolations (),
+		interpolator.Moving[INTERP_SectorPlane].Size(), interpolator.Moving[INTERP_SectorScroll].Size(),
+		interpolator.Moving[INTERP_WallScroll].Size(), interpolator.Moving[INTERP_Polyobj].Size());
 	return out;
 }
 
@@ -2,6 +2,17 @@
 #define R_INTERPOLATE_H
 
 #include "dobject.h"
+
+enum EInterpolationType
+{
+	INTERP_SectorPlane,
+	INTERP_SectorScroll,
+	INTERP_WallScroll,
+	INTERP_Polyobj,
+
+	NUM_INTERPOLATIONTYPES
+};
+
 //==========================================================================
 //
 //
@@ -18,8 +29,11 @@ class DInterpolation : public DObject
 	TObjPtr<DInterpolation*> Next;
 	TObjPtr<DInterpolation*> Prev;
 
+	bool Moving;			// in the interpolator's list of things that moved this tic
+
 protected:
 	int refcount;
+	uint8_t Type;			// EInterpolationType
 
 	DInterpolation();
 
@@ -29,6 +43,7 @@ public:
 
 	void OnDestroy() override;
 	virtual void UpdateInterpolation() = 0;
+	virtual bool HasMoved() = 0;
 	virtual void Restore() = 0;
 	virtual void Interpolate(double smoothratio) = 0;
 	
@@ -47,7 +62,13 @@ struct FInterpolator
 	bool didInterp;
 	int count;
 
+	// Interpolations whose source moved during the last tic, by type.
+	// Only these are touched when drawing a frame.
+	TArray<DInterpolation *> Moving[NUM_INTERPOLATIONTYPES];
+	bool movingValid;
+
 	int CountInterpolations ();
+	void FindMoving();
 
 public:
 	FInterpolator()
@@ -55,6 +76,7 @@ public:
 		Head = NULL;
 		didInterp = false;
 		count = 0;
+		movingValid = false;
 	}
 	void UpdateInterpolations();
 	void AddInterpolation(DInterpolation *);
@@ -188,9 +188,9 @@ FVoxel *R_LoadKVX(int lumpnum)
 	int mip, maxmipsize;
 	int i, j, n;
 
-	FMemLump lump = Wads.ReadLump(lumpnum);	// FMemLump adds an extra 0 byte to the end.
+	FMemLump lump = Wads.ReadLump(lumpnum);
 	uint8_t *rawvoxel = (uint8_t *)lump.GetMem();
-	int voxelsize = (int)(lump.GetSize()-1);
+	int voxelsize = (int)lump.GetSize();
 
 	// Oh, KVX, why couldn't you have a proper header? We'll just go through
 	// and collect each MIP level, doing lots of range checking, and if the
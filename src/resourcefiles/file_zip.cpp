@@ -42,6 +42,7 @@
 #include "w_zip.h"
 #include "i_system.h"
 #include "ancientzip.h"
+#include "zipcache.h"
 
 #define BUFREADCOMMENT (0x400)
 
@@ -381,6 +382,7 @@ bool FZipFile::Open(bool quiet)
 
 FZipFile::~FZipFile()
 {
+	FZipLumpCache::Instance()->Purge(this);
 	if (Lumps != NULL) delete [] Lumps;
 }
 
@@ -460,13 +462,50 @@ int FZipLump::FillCache()
 		return -1;
 	}
 
-	Owner->Reader->Seek(Position, SEEK_SET);
-	Cache = new char[LumpSize];
-	UncompressZipLump(Cache, Owner->Reader, Method, LumpSize, CompressedSize, GPFlags);
+	if (Method != METHOD_STORED)
+	{
+		Cache = FZipLumpCache::Instance()->Take(this);
+	}
+	if (Cache == NULL)
+	{
+		Owner->Reader->Seek(Position, SEEK_SET);
+		Cache = new char[LumpSize];
+		if (UncompressZipLump(Cache, Owner->Reader, Method, LumpSize, CompressedSize, GPFlags) && Method != METHOD_STORED)
+		{
+			FZipLumpCache::Instance()->SaveToDisk(this, Cache);
+		}
+	}
 	RefCount = 1;
 	return 1;
 }
 
+//==========================================================================
+//
+// Compressed lumps are kept in the zip cache after their last release
+// so that loading them again does not need another decompression.
+//
+//==========================================================================
+
+void FZipLump::FreeCache()
+{
+	if (Method == METHOD_STORED || !FZipLumpCache::Instance()->Store(this, Cache))
+	{
+		delete[] Cache;
+	}
+	Cache = NULL;
+}
+
+//==========================================================================
+//
+// Starts decompressing the lump in the background
+//
+//==========================================================================
+
+void FZipLump::Prefetch()
+{
+	FZipLumpCache::Instance()->Prefetch(this);
+}
+
 //==========================================================================
 //
 //
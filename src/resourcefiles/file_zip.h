@@ -24,8 +24,12 @@ struct FZipLump : public FResourceLump
 
 	virtual FileReader *GetReader();
 	virtual int FillCache();
+	virtual void FreeCache();
+	virtual void Prefetch();
 
 private:
+	friend class FZipLumpCache;
+
 	void SetLumpAddress();
 	virtual int GetFileOffset();
 	FCompressedBuffer GetRawData();
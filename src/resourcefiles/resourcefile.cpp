@@ -263,13 +263,24 @@ int FResourceLump::ReleaseCache()
 	{
 		if (--RefCount == 0)
 		{
-			delete [] Cache;
-			Cache = NULL;
+			FreeCache();
 		}
 	}
 	return RefCount;
 }
 
+//==========================================================================
+//
+// Frees the cached data after the last reference was released
+//
+//==========================================================================
+
+void FResourceLump::FreeCache()
+{
+	delete [] Cache;
+	Cache = NULL;
+}
+
 //==========================================================================
 //
 // Opens a resource file
@@ -72,9 +72,11 @@ struct FResourceLump
 
 	void *CacheLump();
 	int ReleaseCache();
+	virtual void Prefetch() {}
 
 protected:
 	virtual int FillCache() = 0;
+	virtual void FreeCache();
 
 };
 
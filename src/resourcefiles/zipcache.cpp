@@ -0,0 +1,353 @@
+/*
+** zipcache.cpp
+** Cache for decompressed zip lumps
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include "zipcache.h"
+#include "file_zip.h"
+#include "w_zip.h"
+#include "cmdlib.h"
+#include "templates.h"
+#include "m_misc.h"
+#include "m_crc32.h"
+#include "c_cvars.h"
+#include "stats.h"
+#include "workerpool.h"
+
+// Size of the memory cache in megabytes
+CVAR(Int, zip_cachesize, 64, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Bool, zip_prefetch, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Bool, zip_diskcache, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+// Small lumps inflate faster than they can be read back from disk.
+enum { DISKCACHE_MINSIZE = 65536 };
+
+//==========================================================================
+//
+// The cache is never destroyed because archives still purge their lumps
+// from it while Wads is torn down at exit. By then the worker pool has
+// finished every prefetch job, so Purge will not have to wait.
+//
+//==========================================================================
+
+FZipLumpCache *FZipLumpCache::Instance()
+{
+	static FZipLumpCache *cache = new FZipLumpCache;
+	return cache;
+}
+
+//==========================================================================
+//
+// Starts inflating a lump on the worker pool. The compressed data is read
+// here because the archive's reader may only be used by the main thread.
+//
+//==========================================================================
+
+void FZipLumpCache::Prefetch(FZipLump *lump)
+{
+	if (!zip_prefetch || lump->Method == METHOD_STORED || lump->Cache != NULL || lump->LumpSize <= 0)
+		return;
+
+	unsigned size = (unsigned)lump->LumpSize;
+	unsigned crc = lump->CRC32;
+	if (size > (unsigned)MAX(*zip_cachesize, 0) * 1024 * 1024)
+		return;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	if (Lookup.find(lump) != Lookup.end())
+		return;
+	lock.unlock();
+
+	std::string diskpath = DiskCachePath(lump).GetChars();
+	bool fromdisk = !diskpath.empty() && FileExists(diskpath.c_str());
+
+	FCompressedBuffer raw = {};
+	if (!fromdisk)
+		raw = lump->GetRawData();
+
+	lock.lock();
+	Entries.push_front({ lump, nullptr, size, false });
+	EntryList::iterator it = Entries.begin();
+	Lookup[lump] = it;
+	TotalSize += size;
+	Trim();
+	if (TotalSize > (size_t)*zip_cachesize * 1024 * 1024)
+	{
+		// Everything else is still pending, so there is no room for this one.
+		Remove(it);
+		lock.unlock();
+		raw.Clean();
+		return;
+	}
+	lock.unlock();
+
+	FWorkerPool::Instance()->Submit([=]()
+	{
+		FCompressedBuffer buffer = raw;
+		char *data = new char[size];
+		bool ok;
+		if (fromdisk)
+		{
+			ok = LoadFromDisk(diskpath, data, size, crc);
+		}
+		else
+		{
+			ok = buffer.Decompress(data);
+			buffer.Clean();
+			if (ok && !diskpath.empty())
+				WriteToDisk(diskpath, data, size);
+		}
+		if (!ok)
+		{
+			delete[] data;
+			data = nullptr;
+		}
+
+		std::unique_lock<std::mutex> lock(Mutex);
+		it->Data = data;
+		it->Ready = true;
+		ReadyCondition.notify_all();
+	});
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+char *FZipLumpCache::Take(FZipLump *lump)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	auto found = Lookup.find(lump);
+	if (found != Lookup.end())
+	{
+		EntryList::iterator it = found->second;
+		ReadyCondition.wait(lock, [&]() { return it->Ready; });
+		char *data = it->Data;
+		it->Data = nullptr;
+		Remove(it);
+		if (data != nullptr)
+		{
+			Hits++;
+			return data;
+		}
+	}
+	Misses++;
+	lock.unlock();
+
+	FString diskpath = DiskCachePath(lump);
+	if (diskpath.IsNotEmpty() && FileExists(diskpath))
+	{
+		char *data = new char[lump->LumpSize];
+		if (LoadFromDisk(diskpath.GetChars(), data, lump->LumpSize, lump->CRC32))
+			return data;
+		delete[] data;
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FZipLumpCache::Store(FZipLump *lump, char *data)
+{
+	unsigned size = (unsigned)lump->LumpSize;
+	if (size > (unsigned)MAX(*zip_cachesize, 0) * 1024 * 1024)
+		return false;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	if (Lookup.find(lump) != Lookup.end())
+		return false;
+
+	Entries.push_front({ lump, data, size, true });
+	Lookup[lump] = Entries.begin();
+	TotalSize += size;
+	Trim();
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FZipLumpCache::SaveToDisk(FZipLump *lump, const char *data)
+{
+	FString diskpath = DiskCachePath(lump);
+	if (diskpath.IsNotEmpty() && !FileExists(diskpath))
+		WriteToDisk(diskpath.GetChars(), data, lump->LumpSize);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FZipLumpCache::Purge(FResourceFile *file)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	ReadyCondition.wait(lock, [&]()
+	{
+		for (const Entry &entry : Entries)
+		{
+			if (entry.Lump->Owner == file && !entry.Ready)
+				return false;
+		}
+		return true;
+	});
+
+	for (auto it = Entries.begin(); it != Entries.end();)
+	{
+		auto next = std::next(it);
+		if (it->Lump->Owner == file)
+			Remove(it);
+		it = next;
+	}
+	lock.unlock();
+
+	DiskPaths.Remove(file);
+}
+
+//==========================================================================
+//
+// Drops the least recently used lumps until the cache fits its budget.
+// Lumps that are still being inflated are left alone.
+//
+//==========================================================================
+
+void FZipLumpCache::Trim()
+{
+	size_t budget = (size_t)MAX(*zip_cachesize, 0) * 1024 * 1024;
+	auto it = Entries.end();
+	while (TotalSize > budget && it != Entries.begin())
+	{
+		auto entry = std::prev(it);
+		if (entry->Ready)
+			Remove(entry);
+		else
+			it = entry;
+	}
+}
+
+void FZipLumpCache::Remove(EntryList::iterator it)
+{
+	delete[] it->Data;
+	TotalSize -= it->Size;
+	Lookup.erase(it->Lump);
+	Entries.erase(it);
+}
+
+//==========================================================================
+//
+// The disk cache is keyed by archive path and modification time so that
+// edited archives never pick up stale data. Archives inside other archives
+// have no file system path and are not cached on disk.
+//
+//==========================================================================
+
+FString FZipLumpCache::DiskCachePath(FZipLump *lump)
+{
+	if (!zip_diskcache || lump->LumpSize < DISKCACHE_MINSIZE)
+		return FString();
+
+	FString *prefix = DiskPaths.CheckKey(lump->Owner);
+	if (prefix == nullptr)
+	{
+		FString path;
+		struct stat info;
+		const char *filename = lump->Owner->Filename;
+		if (stat(filename, &info) == 0 && !(info.st_mode & S_IFDIR))
+		{
+			path = M_GetCachePath(true);
+			path.AppendFormat("/zipcache/%08x%08x", CalcCRC32((const uint8_t *)filename, (unsigned)strlen(filename)), (unsigned)info.st_mtime);
+		}
+		prefix = &(DiskPaths[lump->Owner] = path);
+	}
+	if (prefix->IsEmpty())
+		return FString();
+
+	FString path;
+	path.Format("%s/%08x%08x.lmp", prefix->GetChars(), lump->CRC32, lump->LumpSize);
+	return path;
+}
+
+bool FZipLumpCache::LoadFromDisk(const std::string &path, char *data, unsigned size, unsigned crc)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	bool ok = fread(data, 1, size, f) == size && fgetc(f) == EOF;
+	fclose(f);
+	return ok && CalcCRC32((const uint8_t *)data, size) == crc;
+}
+
+void FZipLumpCache::WriteToDisk(const std::string &path, const char *data, unsigned size)
+{
+	// Write to a temporary file first so that an interrupted write
+	// never leaves a truncated cache file behind.
+	std::string temppath = path + ".tmp";
+	CreatePath(path.substr(0, path.find_last_of('/')).c_str());
+	FILE *f = fopen(temppath.c_str(), "wb");
+	if (f == nullptr)
+		return;
+	bool ok = fwrite(data, 1, size, f) == size;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok || rename(temppath.c_str(), path.c_str()) != 0)
+		remove(temppath.c_str());
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FString FZipLumpCache::GetStats()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	FString out;
+	out.Format("lumps=%u  size=%.1f/%d MB  hits=%u  misses=%u", (unsigned)Entries.size(), TotalSize / (1024.0 * 1024.0), *zip_cachesize, Hits, Misses);
+	return out;
+}
+
+ADD_STAT(zipcache)
+{
+	return FZipLumpCache::Instance()->GetStats();
+}
@@ -0,0 +1,82 @@
+#ifndef __ZIPCACHE_H
+#define __ZIPCACHE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <condition_variable>
+#include "tarray.h"
+#include "zstring.h"
+
+struct FZipLump;
+class FResourceFile;
+
+//==========================================================================
+//
+// Keeps decompressed zip lumps around after their last user released
+// them, inflates prefetched lumps on the worker pool and optionally
+// stores inflated lumps on disk so that later sessions can skip the
+// decompression.
+//
+// Memory use is bounded by zip_cachesize. Least recently used lumps are
+// dropped first.
+//
+//==========================================================================
+
+class FZipLumpCache
+{
+public:
+	static FZipLumpCache *Instance();
+
+	// Starts inflating the lump in the background.
+	void Prefetch(FZipLump *lump);
+
+	// Returns the decompressed data for the lump if it is in the memory or disk
+	// cache, waiting for a pending prefetch if needed. The caller takes ownership.
+	char *Take(FZipLump *lump);
+
+	// Hands a decompressed buffer over to the cache. If this returns false the
+	// buffer was not taken and the caller must free it.
+	bool Store(FZipLump *lump, char *data);
+
+	// Writes freshly inflated data to the disk cache, if enabled.
+	void SaveToDisk(FZipLump *lump, const char *data);
+
+	// Drops everything belonging to an archive that is about to be closed.
+	void Purge(FResourceFile *file);
+
+	FString GetStats();
+
+private:
+	struct Entry
+	{
+		FZipLump *Lump;
+		char *Data;
+		unsigned Size;
+		bool Ready;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	FString DiskCachePath(FZipLump *lump);
+	void Trim();
+	void Remove(EntryList::iterator it);
+
+	static bool LoadFromDisk(const std::string &path, char *data, unsigned size, unsigned crc);
+	static void WriteToDisk(const std::string &path, const char *data, unsigned size);
+
+	EntryList Entries;	// Most recently used first
+	std::unordered_map<FZipLump *, EntryList::iterator> Lookup;
+	size_t TotalSize = 0;
+	unsigned Hits = 0;
+	unsigned Misses = 0;
+
+	std::mutex Mutex;
+	std::condition_variable ReadyCondition;
+
+	// Disk cache directory for each archive (only accessed by the main thread)
+	TMap<FResourceFile *, FString> DiskPaths;
+};
+
+#endif
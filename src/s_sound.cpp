@@ -88,6 +88,7 @@
 #include "r_state.h"
 #include "g_levellocals.h"
 #include "vm.h"
+#include "stats.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -167,6 +168,8 @@ CUSTOM_CVAR (Int, snd_channels, 128, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)	// number o
 CVAR (Bool, snd_flipstereo, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR(Bool, snd_waterreverb, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
+cycle_t SoundCycles;
+
 // CODE --------------------------------------------------------------------
 
 //==========================================================================
@@ -900,6 +903,7 @@ static FSoundChan *S_StartSound(AActor *actor, const sector_t *sec, const FPolyO
 	const FVector3 *pt, int channel, FSoundID sound_id, float volume, float attenuation,
 	FRolloffInfo *forcedrolloff=NULL)
 {
+	FCycleScope clock(SoundCycles);
 	sfxinfo_t *sfx;
 	int chanflags;
 	int basepriority;
@@ -2092,6 +2096,7 @@ void S_RestoreEvictedChannels()
 
 void S_UpdateSounds (AActor *listenactor)
 {
+	FCycleScope clock(SoundCycles);
 	FVector3 pos, vel;
 	SoundListener listener;
 
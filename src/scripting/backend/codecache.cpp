@@ -0,0 +1,903 @@
+/*
+** codecache.cpp
+** Disk cache for compiled script functions
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stdio.h>
+#include <memory>
+#include <algorithm>
+#include "codecache.h"
+#include "vmintern.h"
+#include "types.h"
+#include "info.h"
+#include "thingdef.h"
+#include "autosegs.h"
+#include "c_cvars.h"
+#include "m_random.h"
+#include "m_misc.h"
+#include "cmdlib.h"
+#include "w_wad.h"
+#include "s_sound.h"
+#include "version.h"
+#include "doomstat.h"
+#include "stats.h"
+#include "workerpool.h"
+#include "templates.h"
+
+extern FBaseCVar *CVars;
+
+CVAR(Bool, vm_compilecache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+FScriptCodeCache ScriptCodeCache;
+
+// Raise this whenever the format or the meaning of the bytecode changes.
+enum { CODECACHE_VERSION = 1 };
+static const char CODECACHE_MAGIC[4] = { 'Z', 'V', 'M', 'C' };
+
+// Anything below this cannot be a real address and is a member offset.
+enum { RAW_ADDRESS_LIMIT = 0x10000 };
+
+//==========================================================================
+//
+// Return types of anonymous functions, by index.
+//
+//==========================================================================
+
+static PType *BasicType(unsigned index)
+{
+	PType *const types[] = { TypeSInt32, TypeUInt32, TypeBool, TypeFloat64, TypeName, TypeSound, TypeColor,
+		TypeState, TypeString, TypeVector2, TypeVector3, TypeSpriteID, TypeTextureID };
+	return index < countof(types) ? types[index] : nullptr;
+}
+
+static int BasicTypeIndex(PType *type)
+{
+	for (unsigned i = 0; BasicType(i) != nullptr; i++)
+	{
+		if (BasicType(i) == type) return i;
+	}
+	return -1;
+}
+
+//==========================================================================
+//
+// Address of a CVar's value as FxCVar emits it.
+//
+//==========================================================================
+
+void *FScriptCodeCache::CVarAddress(FBaseCVar *cvar, int type)
+{
+	switch (type)
+	{
+	case CVAR_Int:
+	case CVAR_Color:	return &static_cast<FIntCVar *>(cvar)->Value;
+	case CVAR_Float:	return &static_cast<FFloatCVar *>(cvar)->Value;
+	case CVAR_Bool:		return &static_cast<FBoolCVar *>(cvar)->Value;
+	case CVAR_String:	return &static_cast<FStringCVar *>(cvar)->Value;
+	default:			return nullptr;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FScriptCodeCache::Writer::Put(const void *p, size_t size)
+{
+	unsigned pos = Data.Reserve((unsigned)size);
+	if (size > 0) memcpy(&Data[pos], p, size);
+}
+
+void FScriptCodeCache::Writer::PutString(const char *s)
+{
+	size_t len = strlen(s);
+	PutInt((uint32_t)len);
+	Put(s, len);
+}
+
+const uint8_t *FScriptCodeCache::Reader::Get(size_t size)
+{
+	if (Failed || size_t(End - Pos) < size)
+	{
+		Failed = true;
+		return nullptr;
+	}
+	const uint8_t *p = Pos;
+	Pos += size;
+	return p;
+}
+
+uint32_t FScriptCodeCache::Reader::GetInt()
+{
+	uint32_t v = 0;
+	const uint8_t *p = Get(4);
+	if (p != nullptr) memcpy(&v, p, 4);
+	return v;
+}
+
+FString FScriptCodeCache::Reader::GetString()
+{
+	uint32_t len = GetInt();
+	const uint8_t *p = Get(len);
+	return p != nullptr ? FString((const char *)p, len) : FString();
+}
+
+//==========================================================================
+//
+// The key covers the engine build and the text of every script lump in
+// the order the parsers read them. The git hash alone does not identify
+// a local build, so the layout of the native data the code addresses is
+// included as well.
+//
+//==========================================================================
+
+void FScriptCodeCache::Reset()
+{
+	Sources.Init();
+	const char *version = GetGitHash();
+	Sources.Update((const uint8_t *)version, (unsigned)strlen(version) + 1);
+	version = GetVersionString();
+	Sources.Update((const uint8_t *)version, (unsigned)strlen(version) + 1);
+	uint32_t build[] = { CODECACHE_VERSION, (uint32_t)sizeof(void *), (uint32_t)sizeof(VMOP) };
+	Sources.Update((const uint8_t *)build, sizeof(build));
+	HashNativeLayout(Sources);
+}
+
+void FScriptCodeCache::AddSource(int lump)
+{
+	if (!vm_compilecache || lump < 0)
+		return;
+
+	FMemLump data = Wads.ReadLump(lump);
+	FString path = Wads.GetLumpFullPath(lump);
+	uint32_t info[] = { (uint32_t)Wads.GetLumpFile(lump), (uint32_t)data.GetSize() };
+	Sources.Update((const uint8_t *)info, sizeof(info));
+	Sources.Update((const uint8_t *)path.GetChars(), (unsigned)path.Len() + 1);
+	Sources.Update((const uint8_t *)data.GetMem(), (unsigned)data.GetSize());
+}
+
+//==========================================================================
+//
+// Names and sounds are compiled into the code as indices, so the tables
+// must look the same as when the cache was written.
+//
+//==========================================================================
+
+void FScriptCodeCache::HashTables(uint8_t namehash[16], uint8_t soundhash[16])
+{
+	MD5Context md5;
+	md5.Init();
+	int numnames = FName::GetNumNames();
+	for (int i = 0; i < numnames; i++)
+	{
+		const char *name = FName(ENamedName(i)).GetChars();
+		md5.Update((const uint8_t *)name, (unsigned)strlen(name) + 1);
+	}
+	md5.Final(namehash);
+
+	md5.Init();
+	for (auto &sfx : S_sfx)
+	{
+		md5.Update((const uint8_t *)sfx.name.GetChars(), (unsigned)sfx.name.Len() + 1);
+	}
+	md5.Final(soundhash);
+}
+
+//==========================================================================
+//
+// Collects everything a compiled function may point to.
+//
+//==========================================================================
+
+void FScriptCodeCache::BuildRelocations()
+{
+	FunctionNames.clear();
+	FunctionLookup.Clear();
+	for (auto func : VMFunction::AllFunctions)
+	{
+		VMFunction **prev = FunctionLookup.CheckKey(func->PrintableName);
+		if (prev != nullptr)
+		{
+			// Ambiguous names can not be used to find the function again.
+			if (*prev != nullptr) FunctionNames.erase(*prev);
+			*prev = nullptr;
+		}
+		else
+		{
+			FunctionLookup[func->PrintableName] = func;
+			FunctionNames[func] = func->PrintableName;
+		}
+	}
+
+	CVarTypes.clear();
+	for (FBaseCVar *cvar = CVars; cvar != nullptr; cvar = cvar->GetNext())
+	{
+		int type = cvar->GetRealType();
+		void *address = CVarAddress(cvar, type);
+		if (address != nullptr) CVarTypes[address] = type;
+	}
+
+	auto cmp = [](const FRange &a, const FRange &b) { return a.Start < b.Start; };
+
+	StateRanges.Clear();
+	for (auto cls : PClassActor::AllActorClasses)
+	{
+		FActorInfo *info = cls->ActorInfo();
+		if (info != nullptr && info->NumOwnedStates > 0)
+		{
+			StateRanges.Push({ (size_t)info->OwnedStates, info->NumOwnedStates * sizeof(FState), cls->TypeName.GetChars(), cls });
+		}
+	}
+	std::sort(StateRanges.begin(), StateRanges.end(), cmp);
+
+	GlobalRanges.Clear();
+	FAutoSegIterator probe(FRegHead, FRegTail);
+	while (*++probe != NULL)
+	{
+		const FieldDesc *field = (const FieldDesc *)*probe;
+		if (field->ClassName[0] == 0)
+		{
+			GlobalRanges.Push({ field->FieldOffset, field->FieldSize, field->FieldName, nullptr });
+		}
+	}
+	std::sort(GlobalRanges.begin(), GlobalRanges.end(), cmp);
+}
+
+const FScriptCodeCache::FRange *FScriptCodeCache::FindRange(const TArray<FRange> &ranges, size_t address)
+{
+	int min = 0, max = (int)ranges.Size() - 1;
+	const FRange *found = nullptr;
+	while (min <= max)
+	{
+		int mid = (min + max) / 2;
+		if (ranges[mid].Start <= address)
+		{
+			found = &ranges[mid];
+			min = mid + 1;
+		}
+		else
+		{
+			max = mid - 1;
+		}
+	}
+	return found != nullptr && address - found->Start < found->Size ? found : nullptr;
+}
+
+//==========================================================================
+//
+// Address constants
+//
+//==========================================================================
+
+bool FScriptCodeCache::WriteState(Writer &w, FState *state)
+{
+	if (state == nullptr)
+	{
+		w.PutString("");
+		return true;
+	}
+	const FRange *range = FindRange(StateRanges, (size_t)state);
+	if (range == nullptr || ((size_t)state - range->Start) % sizeof(FState) != 0)
+		return false;
+
+	w.PutString(range->Name);
+	w.PutInt(uint32_t(state - range->Owner->ActorInfo()->OwnedStates));
+	return true;
+}
+
+bool FScriptCodeCache::ReadState(Reader &r, FState *&state)
+{
+	FString name = r.GetString();
+	if (name.IsEmpty())
+	{
+		state = nullptr;
+		return !r.Failed;
+	}
+	unsigned index = r.GetInt();
+	PClassActor *cls = PClass::FindActor(name);
+	if (r.Failed || cls == nullptr || cls->ActorInfo() == nullptr || index >= (unsigned)cls->ActorInfo()->NumOwnedStates)
+		return false;
+
+	state = cls->ActorInfo()->OwnedStates + index;
+	return true;
+}
+
+bool FScriptCodeCache::WriteAddress(Writer &w, void *ptr)
+{
+	if (ptr == nullptr)
+	{
+		w.PutInt(RELOC_Null);
+		return true;
+	}
+	if ((size_t)ptr < RAW_ADDRESS_LIMIT)
+	{
+		w.PutInt(RELOC_Raw);
+		w.PutInt((uint32_t)(size_t)ptr);
+		return true;
+	}
+
+	auto func = FunctionNames.find(ptr);
+	if (func != FunctionNames.end())
+	{
+		w.PutInt(RELOC_Function);
+		w.PutString(func->second);
+		return true;
+	}
+
+	auto cvar = CVarTypes.find(ptr);
+	if (cvar != CVarTypes.end())
+	{
+		// The CVar is found again by name, so this needs to search the list.
+		for (FBaseCVar *var = CVars; var != nullptr; var = var->GetNext())
+		{
+			if (CVarAddress(var, cvar->second) == ptr)
+			{
+				w.PutInt(RELOC_CVar);
+				w.PutString(var->GetName());
+				w.PutInt(cvar->second);
+				return true;
+			}
+		}
+	}
+
+	for (auto cls : PClass::AllClasses)
+	{
+		if (cls == ptr)
+		{
+			w.PutInt(RELOC_Class);
+			w.PutString(cls->TypeName.GetChars());
+			return true;
+		}
+	}
+
+	if (FindRange(StateRanges, (size_t)ptr) != nullptr)
+	{
+		w.PutInt(RELOC_State);
+		return WriteState(w, (FState *)ptr);
+	}
+
+	auto global = FindRange(GlobalRanges, (size_t)ptr);
+	if (global != nullptr)
+	{
+		w.PutInt(RELOC_Global);
+		w.PutString(global->Name);
+		w.PutInt(uint32_t((size_t)ptr - global->Start));
+		return true;
+	}
+
+	// RNGs can be created by the compiler, so they cannot be collected in advance.
+	auto rng = (FRandom *)ptr;
+	if (FRandom::StaticIsRNG(rng) && FRandom::StaticFindRNGByCRC(rng->GetNameCRC()) == rng)
+	{
+		w.PutInt(RELOC_RNG);
+		w.PutInt(rng->GetNameCRC());
+		return true;
+	}
+	return false;
+}
+
+bool FScriptCodeCache::ReadAddress(Reader &r, void *&ptr)
+{
+	ptr = nullptr;
+	switch (r.GetInt())
+	{
+	case RELOC_Null:
+		break;
+
+	case RELOC_Raw:
+		ptr = (void *)(size_t)r.GetInt();
+		break;
+
+	case RELOC_Function:
+	{
+		VMFunction **func = FunctionLookup.CheckKey(r.GetString());
+		ptr = func != nullptr ? *func : nullptr;
+		if (ptr == nullptr) return false;
+		break;
+	}
+
+	case RELOC_Class:
+		ptr = PClass::FindClass(r.GetString());
+		if (ptr == nullptr) return false;
+		break;
+
+	case RELOC_State:
+	{
+		FState *state;
+		if (!ReadState(r, state)) return false;
+		ptr = state;
+		break;
+	}
+
+	case RELOC_RNG:
+	{
+		// Named RNGs are created on demand, just like the compiler would.
+		uint32_t crc = r.GetInt();
+		ptr = FRandom::StaticFindRNGByCRC(crc, true);
+		break;
+	}
+
+	case RELOC_CVar:
+	{
+		FString name = r.GetString();
+		int type = r.GetInt();
+		FBaseCVar *cvar = FindCVar(name, nullptr);
+		if (cvar == nullptr || cvar->GetRealType() != type) return false;
+		ptr = CVarAddress(cvar, type);
+		break;
+	}
+
+	case RELOC_Global:
+	{
+		FString name = r.GetString();
+		unsigned offset = r.GetInt();
+		const FieldDesc *field = FindField(nullptr, name);
+		if (field == nullptr || offset >= field->FieldSize) return false;
+		ptr = (void *)(field->FieldOffset + offset);
+		break;
+	}
+
+	default:
+		return false;
+	}
+	return !r.Failed;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FScriptCodeCache::Open()
+{
+	Active = vm_compilecache;
+	Functions.Clear();
+	NameCount.Clear();
+	Loaded = Compiled = Unrelocatable = 0;
+	if (!Active)
+		return;
+
+	Sources.Final(Key);
+	NameStart = FName::GetNumNames();
+	LabelStart = StateLabels.Storage.Size();
+	HashTables(NameHash, SoundHash);
+	BuildRelocations();
+	if (!ReadFile())
+		Functions.Clear();
+}
+
+void FScriptCodeCache::Close(bool success)
+{
+	if (!Active)
+		return;
+
+	if (success && Compiled > 0)
+		WriteFile();
+	DPrintf(DMSG_NOTIFY, "Script code cache: %s\n", GetStats().GetChars());
+
+	Active = false;
+	Functions.Clear();
+	NameCount.Clear();
+	FunctionNames.clear();
+	FunctionLookup.Clear();
+	CVarTypes.clear();
+	StateRanges.Clear();
+	GlobalRanges.Clear();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FScriptCodeCache::Load(VMScriptFunction *func, const TArray<PType *> &argtypes)
+{
+	if (!Active)
+		return false;
+
+	if (++NameCount[func->PrintableName] > 1)
+	{
+		Functions.Remove(func->PrintableName);
+		return false;
+	}
+	TArray<uint8_t> *data = Functions.CheckKey(func->PrintableName);
+	if (data == nullptr)
+		return false;
+
+	Reader r = { &(*data)[0], &(*data)[0] + data->Size() };
+	unsigned codesize = r.GetInt();
+	unsigned numkonstd = r.GetInt();
+	unsigned numkonstf = r.GetInt();
+	unsigned numkonsts = r.GetInt();
+	unsigned numkonsta = r.GetInt();
+	unsigned numlines = r.GetInt();
+	unsigned numregd = r.GetInt();
+	unsigned numregf = r.GetInt();
+	unsigned numregs = r.GetInt();
+	unsigned numrega = r.GetInt();
+	unsigned maxparam = r.GetInt();
+	int extraspace = r.GetInt();
+	bool unsafe = !!r.GetInt();
+	FString sourcefile = r.GetString();
+	if (codesize > 0xffffff || MAX(MAX(numkonstd, numkonstf), MAX(numkonsts, MAX(numkonsta, numlines))) > 0xffff)
+		r.Failed = true;
+
+	TArray<PType *> rettypes;
+	bool hasproto = !!r.GetInt();
+	if (hasproto)
+	{
+		unsigned count = r.GetInt();
+		for (unsigned i = 0; i < count && !r.Failed; i++)
+		{
+			PType *type = BasicType(r.GetInt());
+			if (type == nullptr) r.Failed = true;
+			rettypes.Push(type);
+		}
+	}
+
+	const uint8_t *code = r.Get(codesize * sizeof(VMOP));
+	const uint8_t *lines = r.Get(numlines * sizeof(FStatementInfo));
+	const uint8_t *konstd = r.Get(numkonstd * sizeof(int));
+	const uint8_t *konstf = r.Get(numkonstf * sizeof(double));
+
+	TArray<FString> konsts;
+	if (!r.Failed) konsts.Resize(numkonsts);
+	for (unsigned i = 0; i < numkonsts && !r.Failed; i++)
+	{
+		konsts[i] = r.GetString();
+	}
+	TArray<void *> konsta;
+	if (!r.Failed) konsta.Resize(numkonsta);
+	for (unsigned i = 0; i < numkonsta && !r.Failed; i++)
+	{
+		if (!ReadAddress(r, konsta[i])) r.Failed = true;
+	}
+
+	if (r.Failed || r.Pos != r.End || codesize == 0 || hasproto != (func->Proto == nullptr))
+	{
+		// Compile it normally and replace the entry.
+		Functions.Remove(func->PrintableName);
+		return false;
+	}
+
+	func->Alloc(codesize, numkonstd, numkonstf, numkonsts, numkonsta, numlines);
+	memcpy(func->Code, code, codesize * sizeof(VMOP));
+	if (numlines > 0) memcpy(func->LineInfo, lines, numlines * sizeof(FStatementInfo));
+	if (numkonstd > 0) memcpy(func->KonstD, konstd, numkonstd * sizeof(int));
+	if (numkonstf > 0) memcpy(func->KonstF, konstf, numkonstf * sizeof(double));
+	for (unsigned i = 0; i < numkonsts; i++) func->KonstS[i] = konsts[i];
+	for (unsigned i = 0; i < numkonsta; i++) func->KonstA[i].v = konsta[i];
+
+	func->NumRegD = numregd;
+	func->NumRegF = numregf;
+	func->NumRegS = numregs;
+	func->NumRegA = numrega;
+	func->MaxParam = maxparam;
+	func->ExtraSpace = extraspace;
+	func->StackSize = VMFrame::FrameSize(func->NumRegD, func->NumRegF, func->NumRegS, func->NumRegA, func->MaxParam, func->ExtraSpace);
+	func->Unsafe = unsafe;
+	func->SourceFileName = sourcefile;
+	if (hasproto)
+	{
+		func->Proto = NewPrototype(rettypes, argtypes);
+	}
+	Loaded++;
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FScriptCodeCache::Store(VMScriptFunction *func)
+{
+	if (!Active)
+		return;
+
+	// Load has already counted the name.
+	Compiled++;
+	int *count = NameCount.CheckKey(func->PrintableName);
+	if (count == nullptr || *count > 1)
+		return;
+
+	// Locals that need construction refer to their types.
+	if (func->SpecialInits.Size() > 0 || func->CodeSize == 0)
+	{
+		Unrelocatable++;
+		return;
+	}
+
+	Writer w;
+	w.PutInt(func->CodeSize);
+	w.PutInt(func->NumKonstD);
+	w.PutInt(func->NumKonstF);
+	w.PutInt(func->NumKonstS);
+	w.PutInt(func->NumKonstA);
+	w.PutInt(func->LineInfoCount);
+	w.PutInt(func->NumRegD);
+	w.PutInt(func->NumRegF);
+	w.PutInt(func->NumRegS);
+	w.PutInt(func->NumRegA);
+	w.PutInt(func->MaxParam);
+	w.PutInt(func->ExtraSpace);
+	w.PutInt(func->Unsafe);
+	w.PutString(func->SourceFileName);
+
+	// Anonymous functions get their prototype from the code.
+	bool hasproto = func->Name == NAME_None;
+	w.PutInt(hasproto);
+	if (hasproto)
+	{
+		auto &rettypes = func->Proto->ReturnTypes;
+		w.PutInt(rettypes.Size());
+		for (auto type : rettypes)
+		{
+			int index = BasicTypeIndex(type);
+			if (index < 0)
+			{
+				Unrelocatable++;
+				return;
+			}
+			w.PutInt(index);
+		}
+	}
+
+	w.Put(func->Code, func->CodeSize * sizeof(VMOP));
+	w.Put(func->LineInfo, func->LineInfoCount * sizeof(FStatementInfo));
+	w.Put(func->KonstD, func->NumKonstD * sizeof(int));
+	w.Put(func->KonstF, func->NumKonstF * sizeof(double));
+	for (unsigned i = 0; i < func->NumKonstS; i++)
+	{
+		w.PutInt(func->KonstS[i].Len());
+		w.Put(func->KonstS[i].GetChars(), func->KonstS[i].Len());
+	}
+	for (unsigned i = 0; i < func->NumKonstA; i++)
+	{
+		if (!WriteAddress(w, func->KonstA[i].v))
+		{
+			Unrelocatable++;
+			return;
+		}
+	}
+	Functions[func->PrintableName] = std::move(w.Data);
+}
+
+//==========================================================================
+//
+// Layout: header, names created by the compiler, state labels added by
+// the compiler, function bodies.
+//
+//==========================================================================
+
+FString FScriptCodeCache::CachePath()
+{
+	FString path = M_GetCachePath(true);
+	path += "/scriptcache/";
+	for (auto b : Key) path.AppendFormat("%02x", b);
+	path += ".zvm";
+	return path;
+}
+
+bool FScriptCodeCache::ReadFile()
+{
+	TArray<uint8_t> data;
+	FString path = CachePath();
+	FILE *f = fopen(path, "rb");
+	if (f == nullptr)
+		return false;
+	uint8_t buffer[65536];
+	size_t len;
+	while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0)
+	{
+		unsigned pos = data.Reserve((unsigned)len);
+		memcpy(&data[pos], buffer, len);
+	}
+	fclose(f);
+	if (data.Size() == 0)
+		return false;
+
+	Reader r = { &data[0], &data[0] + data.Size() };
+	const uint8_t *magic = r.Get(4);
+	unsigned version = r.GetInt();
+	const uint8_t *key = r.Get(16);
+	const uint8_t *namehash = r.Get(16);
+	const uint8_t *soundhash = r.Get(16);
+	int namestart = r.GetInt();
+	if (r.Failed || memcmp(magic, CODECACHE_MAGIC, 4) || version != CODECACHE_VERSION || memcmp(key, Key, 16) ||
+		memcmp(namehash, NameHash, 16) || memcmp(soundhash, SoundHash, 16) || namestart != NameStart)
+	{
+		return false;
+	}
+
+	// Creating the names in the same order gives them the same indices.
+	unsigned numnames = r.GetInt();
+	for (unsigned i = 0; i < numnames && !r.Failed; i++)
+	{
+		FName name = r.GetString();
+		if (name.GetIndex() != NameStart + (int)i)
+			return false;
+	}
+
+	// State labels are compiled in as offsets into the label storage.
+	unsigned labelstart = r.GetInt();
+	unsigned numlabels = r.GetInt();
+	if (r.Failed || labelstart != LabelStart)
+		return false;
+
+	TArray<FState *> states;
+	TArray<TArray<FName>> names;
+	for (unsigned i = 0; i < numlabels && !r.Failed; i++)
+	{
+		unsigned count = r.GetInt();
+		FState *state = nullptr;
+		TArray<FName> labelnames;
+		if (count == 0)
+		{
+			if (!ReadState(r, state) || state == nullptr)
+				return false;
+		}
+		else
+		{
+			for (unsigned j = 0; j < count; j++)
+				labelnames.Push(ENamedName(r.GetInt()));
+		}
+		states.Push(state);
+		names.Push(std::move(labelnames));
+	}
+	if (r.Failed)
+		return false;
+
+	unsigned numfuncs = r.GetInt();
+	for (unsigned i = 0; i < numfuncs && !r.Failed; i++)
+	{
+		FString name = r.GetString();
+		unsigned size = r.GetInt();
+		const uint8_t *body = r.Get(size);
+		if (body != nullptr)
+		{
+			TArray<uint8_t> &entry = Functions[name];
+			entry.Resize(size);
+			memcpy(&entry[0], body, size);
+		}
+	}
+	if (r.Failed || r.Pos != r.End)
+		return false;
+
+	for (unsigned i = 0; i < states.Size(); i++)
+	{
+		if (states[i] != nullptr) StateLabels.AddPointer(states[i]);
+		else StateLabels.AddNames(names[i]);
+	}
+	return true;
+}
+
+void FScriptCodeCache::WriteFile()
+{
+	auto w = std::make_shared<Writer>();
+	w->Put(CODECACHE_MAGIC, 4);
+	w->PutInt(CODECACHE_VERSION);
+	w->Put(Key, 16);
+	w->Put(NameHash, 16);
+	w->Put(SoundHash, 16);
+	w->PutInt(NameStart);
+
+	int numnames = FName::GetNumNames();
+	w->PutInt(numnames - NameStart);
+	for (int i = NameStart; i < numnames; i++)
+	{
+		w->PutString(FName(ENamedName(i)).GetChars());
+	}
+
+	// Walk the label storage the same way FStateLabelStorage fills it.
+	TArray<uint8_t> &storage = StateLabels.Storage;
+	unsigned countpos = w->Data.Size() + 4;
+	unsigned numlabels = 0;
+	w->PutInt(LabelStart);
+	w->PutInt(0);
+	for (unsigned pos = LabelStart; pos < storage.Size(); numlabels++)
+	{
+		int count;
+		memcpy(&count, &storage[pos], sizeof(int));
+		w->PutInt(count);
+		if (count == 0)
+		{
+			FState *state;
+			memcpy(&state, &storage[pos + sizeof(int)], sizeof(state));
+			if (!WriteState(*w, state))
+				return;
+			pos += sizeof(int) + sizeof(state);
+		}
+		else
+		{
+			w->Put(&storage[pos + sizeof(int)], count * sizeof(FName));
+			pos += sizeof(int) + count * sizeof(FName);
+		}
+	}
+	memcpy(&w->Data[countpos], &numlabels, 4);
+
+	unsigned numfuncs = 0;
+	unsigned funccountpos = w->Data.Size();
+	w->PutInt(0);
+	decltype(Functions)::Iterator it(Functions);
+	decltype(Functions)::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		int *count = NameCount.CheckKey(pair->Key);
+		if (count != nullptr && *count == 1)
+		{
+			w->PutString(pair->Key);
+			w->PutInt(pair->Value.Size());
+			w->Put(&pair->Value[0], pair->Value.Size());
+			numfuncs++;
+		}
+	}
+	memcpy(&w->Data[funccountpos], &numfuncs, 4);
+
+	// Nothing needs the file until the next startup.
+	std::string path = CachePath().GetChars();
+	FWorkerPool::Instance()->Submit([=]()
+	{
+		std::string temppath = path + ".tmp";
+		CreatePath(path.substr(0, path.find_last_of('/')).c_str());
+		FILE *f = fopen(temppath.c_str(), "wb");
+		if (f == nullptr)
+			return;
+		bool ok = fwrite(&w->Data[0], 1, w->Data.Size(), f) == w->Data.Size();
+		ok = (fclose(f) == 0) && ok;
+		if (!ok || rename(temppath.c_str(), path.c_str()) != 0)
+			remove(temppath.c_str());
+	});
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FString FScriptCodeCache::GetStats()
+{
+	FString out;
+	out.Format("%u functions loaded, %u compiled, %u not cacheable", Loaded, Compiled, Unrelocatable);
+	return out;
+}
+
+ADD_STAT(scriptcache)
+{
+	return ScriptCodeCache.GetStats();
+}
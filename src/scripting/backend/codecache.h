@@ -0,0 +1,126 @@
+#ifndef CODECACHE_H
+#define CODECACHE_H
+
+#include <unordered_map>
+#include "md5.h"
+#include "tarray.h"
+#include "zstring.h"
+
+class PType;
+class FBaseCVar;
+class PClassActor;
+class VMFunction;
+class VMScriptFunction;
+struct FState;
+
+//==========================================================================
+//
+// Stores the bytecode of compiled script functions on disk so that later
+// sessions with the same script lumps can skip resolving and emitting them.
+//
+// Compiled code refers to engine objects by address and to names, sounds
+// and state labels by index. Addresses are written as relocations (function,
+// class, state, RNG, CVar or global variable by name). Name indices are kept
+// valid by restoring the names the compiler created in the same order. A
+// function whose constants cannot be described this way is simply compiled
+// again every time.
+//
+//==========================================================================
+
+class FScriptCodeCache
+{
+public:
+	// Starts a new compilation. All script lumps must be passed to
+	// AddSource as they are parsed.
+	void Reset();
+	void AddSource(int lump);
+
+	// Called around FFunctionBuildList::Build.
+	void Open();
+	void Close(bool success);
+
+	// Fills in a function from the cache. Anonymous functions also get
+	// their prototype.
+	bool Load(VMScriptFunction *func, const TArray<PType *> &argtypes);
+
+	// Records a freshly compiled function.
+	void Store(VMScriptFunction *func);
+
+	FString GetStats();
+
+private:
+	enum ERelocType
+	{
+		RELOC_Null,
+		RELOC_Raw,
+		RELOC_Function,
+		RELOC_Class,
+		RELOC_State,
+		RELOC_RNG,
+		RELOC_CVar,
+		RELOC_Global,
+	};
+
+	struct FRange
+	{
+		size_t Start, Size;
+		const char *Name;
+		PClassActor *Owner;
+	};
+	static const FRange *FindRange(const TArray<FRange> &ranges, size_t address);
+	static void *CVarAddress(FBaseCVar *cvar, int type);
+
+	class Writer
+	{
+	public:
+		TArray<uint8_t> Data;
+		void Put(const void *p, size_t size);
+		void PutInt(uint32_t v) { Put(&v, 4); }
+		void PutString(const char *s);
+	};
+
+	class Reader
+	{
+	public:
+		const uint8_t *Pos, *End;
+		bool Failed = false;
+		const uint8_t *Get(size_t size);
+		uint32_t GetInt();
+		FString GetString();
+	};
+
+	FString CachePath();
+	void HashTables(uint8_t namehash[16], uint8_t soundhash[16]);
+	void BuildRelocations();
+	bool ReadFile();
+	void WriteFile();
+	bool WriteAddress(Writer &w, void *ptr);
+	bool ReadAddress(Reader &r, void *&ptr);
+	bool WriteState(Writer &w, FState *state);
+	bool ReadState(Reader &r, FState *&state);
+
+	MD5Context Sources;
+	uint8_t Key[16];
+	uint8_t NameHash[16];
+	uint8_t SoundHash[16];
+	int NameStart;
+	unsigned LabelStart;
+	bool Active = false;
+
+	// The function bodies by printable name. Names that occur more than once
+	// are not cached since they cannot be told apart.
+	TMap<FString, TArray<uint8_t>> Functions;
+	TMap<FString, int> NameCount;
+
+	TMap<FString, VMFunction *> FunctionLookup;
+	std::unordered_map<void *, FString> FunctionNames;
+	std::unordered_map<void *, int> CVarTypes;
+	TArray<FRange> StateRanges;
+	TArray<FRange> GlobalRanges;
+
+	unsigned Loaded = 0, Compiled = 0, Unrelocatable = 0;
+};
+
+extern FScriptCodeCache ScriptCodeCache;
+
+#endif
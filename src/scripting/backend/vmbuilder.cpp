@@ -39,6 +39,8 @@
 //#include "thingdef.h"
 #include "doomerrors.h"
 #include "vmintern.h"
+#include "codecache.h"
+#include "workerpool.h"
 
 struct VMRemap
 {
@@ -843,10 +845,42 @@ void FFunctionBuildList::Build()
 
 	if (Args->CheckParm("-dumpdisasm")) dump = fopen("disasm.txt", "w");
 
+	// Native code generation only reads the finished function, so it can run
+	// on the worker pool while the next functions are being compiled.
+	FJobGroup jitjobs;
+	auto finish = [&](Item &item)
+	{
+		VMScriptFunction *sfunc = item.Function;
+		sfunc->NumArgs = 0;
+		// NumArgs for the VMFunction must be the amount of stack elements, which can differ from the amount of logical function arguments if vectors are in the list.
+		// For the VM a vector is 2 or 3 args, depending on size.
+		for (auto s : item.Func->Variants[0].Proto->ArgumentTypes)
+		{
+			sfunc->NumArgs += s->GetRegCount();
+		}
+
+		if (dump != nullptr)
+		{
+			DumpFunction(dump, sfunc, item.PrintableName.GetChars(), (int)item.PrintableName.Len());
+			codesize += sfunc->CodeSize;
+			datasize += sfunc->LineInfoCount * sizeof(FStatementInfo) + sfunc->ExtraSpace + sfunc->NumKonstD * sizeof(int) +
+				sfunc->NumKonstA * sizeof(void*) + sfunc->NumKonstF * sizeof(double) + sfunc->NumKonstS * sizeof(FString);
+		}
+		if (VMJitEnabled) jitjobs.Run([=]() { VMJitCompile(sfunc); });
+	};
+
+	ScriptCodeCache.Open();
 	for (auto &item : mItems)
 	{
 		assert(item.Code != NULL);
 
+		if (ScriptCodeCache.Load(item.Function, item.Func->Variants[0].Proto->ArgumentTypes))
+		{
+			finish(item);
+			delete item.Code;
+			continue;
+		}
+
 		// We don't know the return type in advance for anonymous functions.
 		FCompileContext ctx(item.CurGlobals, item.Func, item.Func->SymbolName == NAME_None ? nullptr : item.Func->Variants[0].Proto, item.FromDecorate, item.StateIndex, item.StateCount, item.Lump, item.Version);
 
@@ -908,22 +942,9 @@ void FFunctionBuildList::Build()
 				item.Code->Emit(&buildit);
 				buildit.EndStatement();
 				buildit.MakeFunction(sfunc);
-				sfunc->NumArgs = 0;
-				// NumArgs for the VMFunction must be the amount of stack elements, which can differ from the amount of logical function arguments if vectors are in the list.
-				// For the VM a vector is 2 or 3 args, depending on size.
-				for (auto s : item.Func->Variants[0].Proto->ArgumentTypes)
-				{
-					sfunc->NumArgs += s->GetRegCount();
-				}
-
-				if (dump != nullptr)
-				{
-					DumpFunction(dump, sfunc, item.PrintableName.GetChars(), (int)item.PrintableName.Len());
-					codesize += sfunc->CodeSize;
-					datasize += sfunc->LineInfoCount * sizeof(FStatementInfo) + sfunc->ExtraSpace + sfunc->NumKonstD * sizeof(int) +
-						sfunc->NumKonstA * sizeof(void*) + sfunc->NumKonstF * sizeof(double) + sfunc->NumKonstS * sizeof(FString);
-				}
 				sfunc->Unsafe = ctx.Unsafe;
+				ScriptCodeCache.Store(sfunc);
+				finish(item);
 			}
 			catch (CRecoverableError &err)
 			{
@@ -937,6 +958,8 @@ void FFunctionBuildList::Build()
 			fflush(dump);
 		}
 	}
+	jitjobs.Wait();
+	ScriptCodeCache.Close(FScriptPosition::ErrorCounter == 0);
 	if (dump != nullptr)
 	{
 		fprintf(dump, "\n*************************************************************************\n%i code bytes\n%i data bytes", codesize * 4, datasize);
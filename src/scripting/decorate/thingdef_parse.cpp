@@ -50,6 +50,7 @@
 #include "doomerrors.h"
 #include "i_system.h"
 #include "backend/codegen.h"
+#include "backend/codecache.h"
 #include "w_wad.h"
 #include "v_video.h"
 #include "v_text.h"
@@ -1253,6 +1254,8 @@ static void ParseDamageDefinition(FScanner &sc)
 
 void ParseDecorate (FScanner &sc, PNamespace *ns)
 {
+	ScriptCodeCache.AddSource(sc.LumpNum);
+
 	// Get actor class name.
 	for(;;)
 	{
@@ -63,6 +63,7 @@
 #include "backend/codegen.h"
 #include "a_sharedglobal.h"
 #include "backend/vmbuilder.h"
+#include "backend/codecache.h"
 #include "stats.h"
 
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
@@ -383,6 +384,7 @@ void LoadActors()
 	FScriptPosition::ResetErrorCounter();
 
 	InitThingdef();
+	ScriptCodeCache.Reset();
 	FScriptPosition::StrictErrors = true;
 	ParseScripts();
 
@@ -51,6 +51,7 @@
 
 
 class FScanner;
+struct MD5Context;
 
 
 //==========================================================================
@@ -192,6 +193,7 @@ inline void ResetBaggage (Baggage *bag, PClassActor *stateclass)
 
 AFuncDesc *FindFunction(PContainerType *cls, const char * string);
 FieldDesc *FindField(PContainerType *cls, const char * string);
+void HashNativeLayout(MD5Context &md5);
 
 
 FxExpression *ParseExpression(FScanner &sc, PClassActor *cls, PNamespace *resolvenspc = nullptr);
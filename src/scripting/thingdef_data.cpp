@@ -63,6 +63,7 @@
 #include "a_dynlight.h"
 #include "vm.h"
 #include "types.h"
+#include "md5.h"
 
 static TArray<FPropertyInfo*> properties;
 static TArray<AFuncDesc> AFTable;
@@ -935,6 +936,7 @@ void InitThingdef()
 			AFuncDesc *afunc = (AFuncDesc *)*probe;
 			assert(afunc->VMPointer != NULL);
 			*(afunc->VMPointer) = new VMNativeFunction(afunc->Function, afunc->FuncName);
+			(*(afunc->VMPointer))->Direct = afunc->Direct;
 			(*(afunc->VMPointer))->PrintableName.Format("%s.%s [Native]", afunc->ClassName+1, afunc->FuncName);
 			AFTable.Push(*afunc);
 		}
@@ -965,6 +967,46 @@ void InitThingdef()
 	}
 }
 
+//==========================================================================
+//
+// Hashes the offsets and sizes of everything native that compiled script
+// code addresses directly: the exported fields, the actor flags and the
+// native classes. Any change to them between builds changes the hash.
+//
+//==========================================================================
+
+void HashNativeLayout(MD5Context &md5)
+{
+	for (auto &field : FieldTable)
+	{
+		md5.Update((const uint8_t *)field.ClassName, (unsigned)strlen(field.ClassName) + 1);
+		md5.Update((const uint8_t *)field.FieldName, (unsigned)strlen(field.FieldName) + 1);
+		uint32_t layout[] = { (uint32_t)field.FieldOffset, field.FieldSize, (uint32_t)field.BitValue };
+		md5.Update((const uint8_t *)layout, sizeof(layout));
+	}
+
+	for (size_t i = 0; i < NUM_FLAG_LISTS; ++i)
+	{
+		for (int j = 0; j < FlagLists[i].NumDefs; j++)
+		{
+			const FFlagDef &flag = FlagLists[i].Defs[j];
+			md5.Update((const uint8_t *)flag.name, (unsigned)strlen(flag.name) + 1);
+			uint32_t layout[] = { flag.flagbit, (uint32_t)flag.structoffset, (uint32_t)flag.fieldsize, (uint32_t)flag.varflags };
+			md5.Update((const uint8_t *)layout, sizeof(layout));
+		}
+	}
+
+	for (auto cls : PClass::AllClasses)
+	{
+		if (cls->bRuntimeClass)
+			continue;
+		const char *name = cls->TypeName.GetChars();
+		md5.Update((const uint8_t *)name, (unsigned)strlen(name) + 1);
+		uint32_t layout[] = { cls->Size };
+		md5.Update((const uint8_t *)layout, sizeof(layout));
+	}
+}
+
 void SynthesizeFlagFields()
 {
 	// These are needed for inserting the flag symbols
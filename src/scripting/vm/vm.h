@@ -36,6 +36,8 @@
 #ifndef VM_H
 #define VM_H
 
+#include <exception>
+#include <type_traits>
 #include "zstring.h"
 #include "autosegs.h"
 #include "vectors.h"
@@ -352,6 +354,97 @@ public:
 protected:
 };
 
+//==========================================================================
+//
+// Natives registered with DEFINE_ACTION_FUNCTION_NATIVE also export a plain
+// C++ function with typed arguments. The JIT calls that one directly with
+// the arguments in machine registers instead of packing them into VMValues
+// and unpacking them again with the PARAM macros. Exceptions are caught
+// right at that boundary because generated code cannot be unwound.
+//
+//==========================================================================
+
+enum EDirectNativeType
+{
+	DNT_Void,
+	DNT_Int,
+	DNT_Bool,
+	DNT_Float,
+	DNT_Pointer,
+	DNT_Invalid
+};
+
+enum
+{
+	MAX_DIRECT_ARGS = 4
+};
+
+struct FDirectNativeDesc
+{
+	void *Function;
+	uint8_t NumArgs;
+	uint8_t ReturnType;
+	uint8_t ArgTypes[MAX_DIRECT_ARGS];
+};
+
+template<class T> struct TDirectNativeType
+{
+	enum
+	{
+		Type = std::is_pointer<T>::value ? DNT_Pointer :
+			std::is_same<T, double>::value ? DNT_Float :
+			std::is_same<T, bool>::value ? DNT_Bool :
+			(std::is_integral<T>::value || std::is_enum<T>::value) && sizeof(T) == 4 ? DNT_Int : DNT_Invalid
+	};
+};
+
+template<> struct TDirectNativeType<void>
+{
+	enum { Type = DNT_Void };
+};
+
+constexpr bool DirectNativeTypesValid(const uint8_t *types, int count)
+{
+	return count == 0 || (types[0] != DNT_Invalid && DirectNativeTypesValid(types + 1, count - 1));
+}
+
+extern bool VMDirectCallFailed;
+extern std::exception_ptr VMDirectCallException;
+
+template<class F, F Func> struct TDirectNative;
+
+template<class Ret, class... Args, Ret(*Func)(Args...)>
+struct TDirectNative<Ret(*)(Args...), Func>
+{
+	static Ret Call(Args... args)
+	{
+		try
+		{
+			return Func(args...);
+		}
+		catch (...)
+		{
+			VMDirectCallException = std::current_exception();
+			VMDirectCallFailed = true;
+			return Ret();
+		}
+	}
+
+	static FDirectNativeDesc Desc()
+	{
+		static constexpr uint8_t types[] = { uint8_t(TDirectNativeType<Ret>::Type), uint8_t(TDirectNativeType<Args>::Type)... };
+		static_assert(sizeof...(Args) <= MAX_DIRECT_ARGS, "Too many arguments for a direct native call");
+		static_assert(DirectNativeTypesValid(types, 1 + sizeof...(Args)), "Direct native calls only take int, bool, double and pointer arguments");
+
+		FDirectNativeDesc desc = { (void *)&Call, uint8_t(sizeof...(Args)), types[0], {} };
+		for (unsigned i = 0; i < sizeof...(Args); i++)
+		{
+			desc.ArgTypes[i] = types[i + 1];
+		}
+		return desc;
+	}
+};
+
 class VMNativeFunction : public VMFunction
 {
 public:
@@ -364,6 +457,9 @@ public:
 
 	// Return value is the number of results.
 	NativeCallType NativeCall;
+
+	// Typed entry point, if the native has one.
+	FDirectNativeDesc Direct = {};
 };
 
 int VMCall(VMFunction *func, VMValue *params, int numparams, VMReturn *results, int numresults/*, VMException **trap = NULL*/);
@@ -480,6 +576,7 @@ struct AFuncDesc
 	const char *FuncName;
 	actionf_p Function;
 	VMNativeFunction **VMPointer;
+	FDirectNativeDesc Direct;
 };
 
 #if defined(_MSC_VER)
@@ -508,6 +605,16 @@ struct AFuncDesc
 	MSVC_ASEG AFuncDesc const *const cls##_##name##_HookPtr GCC_ASEG = &cls##_##name##_Hook; \
 	static int AF_##cls##_##name(VM_ARGS)
 
+// Same as above, but native is also registered as the function's direct entry point.
+// Its arguments must be the same as the script function's, including self.
+#define DEFINE_ACTION_FUNCTION_NATIVE(cls, name, native) \
+	static int AF_##cls##_##name(VM_ARGS); \
+	VMNativeFunction *cls##_##name##_VMPtr; \
+	static const AFuncDesc cls##_##name##_Hook = { #cls, #name, AF_##cls##_##name, &cls##_##name##_VMPtr, TDirectNative<decltype(&native), &native>::Desc() }; \
+	extern AFuncDesc const *const cls##_##name##_HookPtr; \
+	MSVC_ASEG AFuncDesc const *const cls##_##name##_HookPtr GCC_ASEG = &cls##_##name##_Hook; \
+	static int AF_##cls##_##name(VM_ARGS)
+
 // cls is the scripted class name, icls the internal one (e.g. player_t vs. Player)
 #define DEFINE_FIELD_X(cls, icls, name) \
 	static const FieldDesc VMField_##icls##_##name = { "A" #cls, #name, (unsigned)myoffsetof(icls, name), (unsigned)sizeof(icls::name), 0 }; \
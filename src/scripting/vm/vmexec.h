@@ -718,7 +718,7 @@ static int Exec(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret)
 				VMFillParams(reg.param + f->NumParam - b, newf, b);
 				try
 				{
-					numret = Exec(stack, script->Code, returns, C);
+					numret = VMUseJit(script) ? VMJitExec(stack, script, returns, C) : Exec(stack, script->Code, returns, C);
 				}
 				catch(...)
 				{
@@ -772,7 +772,7 @@ static int Exec(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret)
 				VMFillParams(reg.param + f->NumParam - B, newf, B);
 				try
 				{
-					numret = Exec(stack, script->Code, ret, numret);
+					numret = VMUseJit(script) ? VMJitExec(stack, script, ret, numret) : Exec(stack, script->Code, ret, numret);
 				}
 				catch(...)
 				{
@@ -73,10 +73,13 @@ VMScriptFunction::VMScriptFunction(FName name)
 	NumKonstA = 0;
 	MaxParam = 0;
 	NumArgs = 0;
+	JitCode = nullptr;
+	JitData = nullptr;
 }
 
 VMScriptFunction::~VMScriptFunction()
 {
+	if (JitData != nullptr) delete JitData;
 	if (Code != NULL)
 	{
 		if (KonstS != NULL)
@@ -194,6 +197,7 @@ int VMScriptFunction::AllocExtraStack(PType *type)
 
 int VMScriptFunction::PCToLine(const VMOP *pc)
 {
+	if (JitData != nullptr) pc = VMJitMapPC(this, pc);
 	int PCIndex = int(pc - Code);
 	if (LineInfoCount == 1) return LineInfo[0].LineNumber;
 	for (unsigned i = 1; i < LineInfoCount; i++)
@@ -460,7 +464,8 @@ int VMCall(VMFunction *func, VMValue *params, int numparams, VMReturn *results,
 				stack.AllocFrame(static_cast<VMScriptFunction *>(func));
 				allocated = true;
 				VMFillParams(params, stack.TopFrame(), numparams);
-				int numret = VMExec(&stack, code, results, numresults);
+				auto sfunc = static_cast<VMScriptFunction *>(func);
+				int numret = VMUseJit(sfunc) ? VMJitExec(&stack, sfunc, results, numresults) : VMExec(&stack, code, results, numresults);
 				stack.PopFrame();
 				VMCycles[0].Unclock();
 				return numret;
@@ -578,6 +583,9 @@ DEFINE_ACTION_FUNCTION(DObject, ThrowAbortException)
 	return 0;
 }
 
+bool VMDirectCallFailed;
+std::exception_ptr VMDirectCallException;
+
 void NullParam(const char *varname)
 {
 	ThrowAbortException(X_READ_NIL, "In function parameter %s", varname);
@@ -637,3 +645,56 @@ CCMD(vmengine)
 	Printf("Usage: vmengine <default|checked|unchecked>\n");
 }
 
+//-----------------------------------------------------------------------------
+//
+// Compares a native called through its VMValue interface with the same
+// native called through its typed entry point.
+//
+//-----------------------------------------------------------------------------
+extern VMNativeFunction *AActor_deltaangle_VMPtr;
+
+CCMD(vmbench_nativecalls)
+{
+	VMNativeFunction *func = AActor_deltaangle_VMPtr;
+	if (func == nullptr || func->Direct.Function == nullptr)
+	{
+		Printf("deltaangle has no direct entry point\n");
+		return;
+	}
+	int count = argv.argc() > 1 ? atoi(argv[1]) : 10000000;
+	if (count <= 0)
+	{
+		Printf("Usage: vmbench_nativecalls [count]\n");
+		return;
+	}
+	auto direct = (double(*)(double, double))func->Direct.Function;
+	cycle_t marshalled, typed;
+	double sum1 = 0, sum2 = 0;
+
+	marshalled.Reset();
+	marshalled.Clock();
+	for (int i = 0; i < count; i++)
+	{
+		VMValue params[2] = { double(i & 1023), 90. };
+		double result;
+		VMReturn ret(&result);
+		func->NativeCall(params, func->DefaultArgs, 2, &ret, 1);
+		sum1 += result;
+	}
+	marshalled.Unclock();
+
+	typed.Reset();
+	typed.Clock();
+	for (int i = 0; i < count; i++)
+	{
+		sum2 += direct(double(i & 1023), 90.);
+	}
+	typed.Unclock();
+
+	Printf("%d calls: VMValue %.3f ms, direct %.3f ms (%.2fx)\n", count, marshalled.TimeMS(), typed.TimeMS(),
+		marshalled.TimeMS() / MAX(typed.TimeMS(), 0.001));
+	if (sum1 != sum2)
+	{
+		Printf(TEXTCOLOR_RED "Results differ: %f vs. %f\n", sum1, sum2);
+	}
+}
@@ -430,6 +430,25 @@ void VMSelectEngine(EVMEngine engine);
 extern int (*VMExec)(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret);
 void VMFillParams(VMValue *params, VMFrame *callee, int numparam);
 
+// Template JIT for x86-64 (see vmjit.cpp). Instructions without a native
+// template are run by the interpreter, one at a time, from a copy of the
+// instruction that is followed by a RET.
+struct JitContext;
+typedef int(*JitFuncPtr)(JitContext *ctx);
+
+struct FJitFunction
+{
+	TArray<VMOP> Snippets;			// Interpreter fallback code for every instruction
+	TArray<unsigned> SnippetStart;	// Index into Snippets for each instruction of the function
+	int NativeOps = 0;				// Number of instructions that got a native template
+	bool Pure = false;				// Only changes its own registers, so vm_jitverify can run it twice
+};
+
+extern bool VMJitEnabled;
+bool VMJitCompile(VMScriptFunction *func);
+int VMJitExec(VMFrameStack *stack, VMScriptFunction *func, VMReturn *ret, int numret);
+const VMOP *VMJitMapPC(const VMScriptFunction *func, const VMOP *pc);
+
 void VMDumpConstants(FILE *out, const VMScriptFunction *func);
 void VMDisasm(FILE *out, const VMOP *code, int codesize, const VMScriptFunction *func);
 
@@ -466,9 +485,18 @@ public:
 	VM_UHALF MaxParam;		// Maximum number of parameters this function has on the stack at once
 	VM_UBYTE NumArgs;		// Number of arguments this function takes
 	TArray<FTypeAndOffset> SpecialInits;	// list of all contents on the extra stack which require construction and destruction
+	JitFuncPtr JitCode;		// Native code, if the JIT compiled this function
+	FJitFunction *JitData;	// NULL until the JIT has looked at this function
 
 	void InitExtra(void *addr);
 	void DestroyExtra(void *addr);
 	int AllocExtraStack(PType *type);
 	int PCToLine(const VMOP *pc);
 };
+
+inline bool VMUseJit(VMScriptFunction *func)
+{
+	if (!VMJitEnabled) return false;
+	if (func->JitData == nullptr) VMJitCompile(func);
+	return func->JitCode != nullptr;
+}
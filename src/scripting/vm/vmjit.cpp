@@ -0,0 +1,2118 @@
+/*
+** vmjit.cpp
+** Template JIT for the VM on x86-64
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Every instruction is translated on its own into a fixed sequence of
+** machine code that works directly on the registers in the VM frame, so
+** the frame is always up to date between two instructions. That makes it
+** possible to hand any instruction without a native template over to the
+** interpreter: It gets copied into a snippet followed by a RET and the
+** interpreter runs that snippet on the current frame. Calls, strings and
+** everything that may throw a VM exception are done this way.
+**
+** Exceptions must never unwind through generated code since it has no
+** unwind information. The snippet runner catches them and the generated
+** code returns to VMJitExec, which rethrows them.
+**
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include "dobject.h"
+#include "c_cvars.h"
+#include "v_text.h"
+#include "stats.h"
+#include "templates.h"
+#include "vmintern.h"
+#include "types.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define VM_JIT_X64 1
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+bool VMJitEnabled;
+
+CUSTOM_CVAR(Bool, vm_jit, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	VMJitEnabled = self;
+}
+
+// Runs every call to a pure function through the JIT and the interpreter and compares the results.
+CVAR(Bool, vm_jitverify, false, 0)
+
+struct JitContext
+{
+	int *D;
+	double *F;
+	FString *S;
+	void **A;
+	VMValue *Param;
+	VMFrame *Frame;
+	void *Extra;
+	VMFrameStack *Stack;
+	VMScriptFunction *Func;
+	VMReturn *Ret;
+	int NumRet;
+	std::exception_ptr Exception;
+};
+
+// Functions may be compiled on the worker pool while scripts are loaded.
+static std::atomic<int> JitFunctions, JitFailures, JitNativeOps, JitTotalOps, JitDirectCalls;
+static int JitVerifiedCalls, JitMismatches;
+
+//===========================================================================
+//
+// Runs the interpreter fallback of one instruction. Returns the number of
+// results if the instruction returned from the function or -1 if it threw.
+//
+//===========================================================================
+
+static int JitExecSnippet(JitContext *ctx, int index)
+{
+	try
+	{
+		FJitFunction *data = ctx->Func->JitData;
+		return VMExec(ctx->Stack, &data->Snippets[data->SnippetStart[index]], ctx->Ret, ctx->NumRet);
+	}
+	catch (...)
+	{
+		ctx->Exception = std::current_exception();
+		return -1;
+	}
+}
+
+static int JitCompareStrings(JitContext *ctx, int index)
+{
+	const VMOP *pc = &ctx->Func->Code[index];
+	int a = pc->a;
+	const FString *b = (a & CMP_BK) ? &ctx->Func->KonstS[pc->b] : &ctx->S[pc->b];
+	const FString *c = (a & CMP_CK) ? &ctx->Func->KonstS[pc->c] : &ctx->S[pc->c];
+	int test = (a & CMP_APPROX) ? b->CompareNoCase(*c) : b->Compare(*c);
+	int method = a & CMP_METHOD_MASK;
+	return method == CMP_EQ ? !test : method == CMP_LT ? test < 0 : test <= 0;
+}
+
+static void JitWriteBarrier(DObject *pointed)
+{
+	GC::WriteBarrier(pointed);
+}
+
+// A native that was called directly threw an exception. Add the same
+// information the interpreter adds and leave.
+static int JitDirectCallFailed(JitContext *ctx, int index)
+{
+	VMFunction *call = (VMFunction *)ctx->Func->KonstA[ctx->Func->Code[index].a].o;
+	std::exception_ptr exception = VMDirectCallException;
+	VMDirectCallException = nullptr;
+	VMDirectCallFailed = false;
+	try
+	{
+		std::rethrow_exception(exception);
+	}
+	catch (CVMAbortException &err)
+	{
+		err.MaybePrintMessage();
+		err.stacktrace.AppendFormat("Called from %s\n", call->PrintableName.GetChars());
+		ctx->Exception = std::current_exception();
+	}
+	catch (...)
+	{
+		ctx->Exception = std::current_exception();
+	}
+	return -1;
+}
+
+//===========================================================================
+//
+// Maps a pc inside the snippets back to the instruction it was copied from
+// so that error messages report the right line.
+//
+//===========================================================================
+
+const VMOP *VMJitMapPC(const VMScriptFunction *func, const VMOP *pc)
+{
+	FJitFunction *data = func->JitData;
+	if (data->Snippets.Size() == 0 || pc < &data->Snippets[0] || pc >= &data->Snippets[0] + data->Snippets.Size())
+	{
+		return pc;
+	}
+	unsigned offset = unsigned(pc - &data->Snippets[0]);
+	unsigned lo = 0, hi = data->SnippetStart.Size();
+	while (hi - lo > 1)
+	{
+		unsigned mid = (lo + hi) / 2;
+		if (data->SnippetStart[mid] <= offset) lo = mid;
+		else hi = mid;
+	}
+	unsigned index = lo;
+	return func->Code + index;
+}
+
+#ifdef VM_JIT_X64
+
+namespace
+{
+
+enum
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum
+{
+	XMM0, XMM1, XMM2, XMM3
+};
+
+enum
+{
+	CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+	CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+#ifdef _WIN32
+const int ARG1 = RCX, ARG2 = RDX;
+#else
+const int ARG1 = RDI, ARG2 = RSI;
+#endif
+
+// Registers that stay loaded for the whole function:
+const int REG_D = RBX;			// int registers
+const int REG_F = R12;			// float registers
+const int REG_A = R13;			// pointer registers
+const int REG_CTX = R14;		// JitContext
+const int REG_KD = R15;			// int constants
+const int REG_KF = RBP;			// float constants
+
+struct Mem
+{
+	int Base;
+	int Index;
+	int Scale;
+	int Disp;
+};
+
+inline Mem Ptr(int base, int disp = 0)
+{
+	Mem m = { base, -1, 1, disp };
+	return m;
+}
+
+inline Mem Ptr(int base, int index, int scale, int disp)
+{
+	Mem m = { base, index, scale, disp };
+	return m;
+}
+
+//===========================================================================
+//
+// Just enough of an x86-64 assembler for the templates.
+//
+//===========================================================================
+
+class FJitAssembler
+{
+public:
+	TArray<uint8_t> Code;
+
+	int NewLabel()
+	{
+		return Labels.Push(-1);
+	}
+
+	void Bind(int label)
+	{
+		Labels[label] = Code.Size();
+	}
+
+	void Jmp(int label)
+	{
+		Byte(0xE9);
+		Fixup(label);
+	}
+
+	void Jcc(int cc, int label)
+	{
+		Byte(0x0F);
+		Byte(0x80 | cc);
+		Fixup(label);
+	}
+
+	bool Link()
+	{
+		for (auto &fixup : Fixups)
+		{
+			int target = Labels[fixup.Label];
+			if (target < 0) return false;
+			int32_t rel = target - (fixup.Offset + 4);
+			memcpy(&Code[fixup.Offset], &rel, 4);
+		}
+		return true;
+	}
+
+	void Byte(int b)
+	{
+		Code.Push(uint8_t(b));
+	}
+
+	void Dword(uint32_t d)
+	{
+		for (int i = 0; i < 4; i++) Byte(d >> (i * 8));
+	}
+
+	void Qword(uint64_t q)
+	{
+		for (int i = 0; i < 8; i++) Byte(int(q >> (i * 8)));
+	}
+
+	// Instruction with a memory operand
+	void Op(int prefix, bool w, unsigned opcode, int reg, const Mem &m)
+	{
+		if (prefix) Byte(prefix);
+		int rex = (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((m.Index >= 0 && (m.Index & 8)) ? 2 : 0) | ((m.Base & 8) ? 1 : 0);
+		if (rex) Byte(0x40 | rex);
+		Opcode(opcode);
+
+		int mod = (m.Disp == 0 && (m.Base & 7) != RBP) ? 0 : (m.Disp >= -128 && m.Disp <= 127) ? 1 : 2;
+		if (m.Index < 0 && (m.Base & 7) != RSP)
+		{
+			Byte((mod << 6) | ((reg & 7) << 3) | (m.Base & 7));
+		}
+		else
+		{
+			int index = m.Index < 0 ? RSP : m.Index;
+			int scale = m.Scale == 8 ? 3 : m.Scale == 4 ? 2 : m.Scale == 2 ? 1 : 0;
+			Byte((mod << 6) | ((reg & 7) << 3) | 4);
+			Byte((scale << 6) | ((index & 7) << 3) | (m.Base & 7));
+		}
+		if (mod == 1) Byte(m.Disp);
+		else if (mod == 2) Dword(m.Disp);
+	}
+
+	// Instruction with a register operand
+	void OpR(int prefix, bool w, unsigned opcode, int reg, int rm)
+	{
+		if (prefix) Byte(prefix);
+		int rex = (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+		if (rex) Byte(0x40 | rex);
+		Opcode(opcode);
+		Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	void Load32(int reg, const Mem &m) { Op(0, false, 0x8B, reg, m); }
+	void Store32(const Mem &m, int reg) { Op(0, false, 0x89, reg, m); }
+	void Load64(int reg, const Mem &m) { Op(0, true, 0x8B, reg, m); }
+	void Store64(const Mem &m, int reg) { Op(0, true, 0x89, reg, m); }
+	void Lea(int reg, const Mem &m) { Op(0, true, 0x8D, reg, m); }
+	void Store32Imm(const Mem &m, int imm) { Op(0, false, 0xC7, 0, m); Dword(imm); }
+	void Store8Imm(const Mem &m, int imm) { Op(0, false, 0xC6, 0, m); Byte(imm); }
+	void Mov64(int dst, int src) { OpR(0, true, 0x8B, dst, src); }
+
+	void MovImm32(int reg, int imm)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0xB8 | (reg & 7));
+		Dword(imm);
+	}
+
+	void MovImm64(int reg, uint64_t imm)
+	{
+		Byte(0x48 | ((reg & 8) ? 1 : 0));
+		Byte(0xB8 | (reg & 7));
+		Qword(imm);
+	}
+
+	void MovImm64(int reg, const void *ptr)
+	{
+		MovImm64(reg, (uint64_t)(uintptr_t)ptr);
+	}
+
+	// Arithmetic: 0x03 add, 0x0B or, 0x23 and, 0x2B sub, 0x33 xor, 0x3B cmp
+	void Alu32(unsigned opcode, int reg, const Mem &m) { Op(0, false, opcode, reg, m); }
+	void Alu32(unsigned opcode, int reg, int rm) { OpR(0, false, opcode, reg, rm); }
+	void Alu64(unsigned opcode, int reg, const Mem &m) { Op(0, true, opcode, reg, m); }
+	void Alu64(unsigned opcode, int reg, int rm) { OpR(0, true, opcode, reg, rm); }
+
+	// Arithmetic with an immediate: /0 add, /1 or, /4 and, /5 sub, /6 xor, /7 cmp
+	void AluImm32(int digit, int reg, int imm) { OpR(0, false, 0x81, digit, reg); Dword(imm); }
+	void AluImm32(int digit, const Mem &m, int imm) { Op(0, false, 0x81, digit, m); Dword(imm); }
+	void AluImm64(int digit, int reg, int imm) { OpR(0, true, 0x81, digit, reg); Dword(imm); }
+
+	void Imul32(int reg, int rm) { OpR(0, false, 0x0FAF, reg, rm); }
+	void Imul32(int reg, const Mem &m) { Op(0, false, 0x0FAF, reg, m); }
+
+	// Shifts: /4 shl, /5 shr, /7 sar
+	void ShiftCl(int digit, int reg) { OpR(0, false, 0xD3, digit, reg); }
+	void ShiftImm(int digit, int reg, int imm) { OpR(0, false, 0xC1, digit, reg); Byte(imm); }
+
+	// Unary: /2 not, /3 neg, /6 div, /7 idiv
+	void Unary32(int digit, int reg) { OpR(0, false, 0xF7, digit, reg); }
+
+	void Cdq() { Byte(0x99); }
+	void Cmov(int cc, int dst, int src) { OpR(0, false, 0x0F40 | cc, dst, src); }
+	void Setcc(int cc, int reg) { OpR(0, false, 0x0F90 | cc, 0, reg); }
+	void Movzx8(int dst, int src) { OpR(0, false, 0x0FB6, dst, src); }
+	void Test32(int reg, int rm) { OpR(0, false, 0x85, reg, rm); }
+	void Test64(int reg, int rm) { OpR(0, true, 0x85, reg, rm); }
+	void Test8(int reg, int rm) { OpR(0, false, 0x84, reg, rm); }
+	void And8(int rm, int reg) { OpR(0, false, 0x20, reg, rm); }
+	void Or8(int rm, int reg) { OpR(0, false, 0x08, reg, rm); }
+	void Movsxd(int reg, const Mem &m) { Op(0, true, 0x63, reg, m); }
+
+	// SSE2
+	void LoadSD(int xmm, const Mem &m) { Op(0xF2, false, 0x0F10, xmm, m); }
+	void StoreSD(const Mem &m, int xmm) { Op(0xF2, false, 0x0F11, xmm, m); }
+	void ArithSD(unsigned opcode, int xmm, const Mem &m) { Op(0xF2, false, opcode, xmm, m); }
+	void ArithSD(unsigned opcode, int xmm, int src) { OpR(0xF2, false, opcode, xmm, src); }
+	void Ucomisd(int xmm, const Mem &m) { Op(0x66, false, 0x0F2E, xmm, m); }
+	void Ucomisd(int xmm, int src) { OpR(0x66, false, 0x0F2E, xmm, src); }
+	void Xorpd(int xmm, int src) { OpR(0x66, false, 0x0F57, xmm, src); }
+	void MovqToXmm(int xmm, int reg) { OpR(0x66, true, 0x0F6E, xmm, reg); }
+	void MovqFromXmm(int reg, int xmm) { OpR(0x66, true, 0x0F7E, xmm, reg); }
+
+	void Push(int reg)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0x50 | (reg & 7));
+	}
+
+	void Pop(int reg)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0x58 | (reg & 7));
+	}
+
+	void CallRax() { Byte(0xFF); Byte(0xD0); }
+	void Ret() { Byte(0xC3); }
+
+private:
+	struct FixupInfo
+	{
+		unsigned Offset;
+		int Label;
+	};
+
+	TArray<int> Labels;
+	TArray<FixupInfo> Fixups;
+
+	void Fixup(int label)
+	{
+		Fixups.Push({ Code.Size(), label });
+		Dword(0);
+	}
+
+	void Opcode(unsigned opcode)
+	{
+		if (opcode > 0xFF) Byte(opcode >> 8);
+		Byte(opcode & 0xFF);
+	}
+};
+
+enum
+{
+	SSE_ADD = 0x0F58,
+	SSE_MUL = 0x0F59,
+	SSE_SUB = 0x0F5C,
+	SSE_MIN = 0x0F5D,
+	SSE_DIV = 0x0F5E,
+	SSE_MAX = 0x0F5F,
+	SSE_SQRT = 0x0F51,
+	ALU_ADD = 0x03,
+	ALU_OR = 0x0B,
+	ALU_AND = 0x23,
+	ALU_SUB = 0x2B,
+	ALU_XOR = 0x33,
+	ALU_CMP = 0x3B,
+};
+
+//===========================================================================
+//
+// The compiler
+//
+//===========================================================================
+
+class FJitCompiler
+{
+public:
+	FJitCompiler(VMScriptFunction *func, FJitFunction *data) : Func(func), Data(data), Code(func->Code) {}
+	bool Compile();
+	TArray<uint8_t> &GetCode() { return as.Code; }
+
+private:
+	VMScriptFunction *Func;
+	FJitFunction *Data;
+	const VMOP *Code;
+	FJitAssembler as;
+	TArray<int> OpLabels;
+	int ExitLabel;
+	bool Failed = false;
+
+	struct FSlowPath
+	{
+		int Label;
+		int Index;
+	};
+	TArray<FSlowPath> SlowPaths;
+	TArray<FSlowPath> DirectCallFailures;
+
+	static Mem RegD(int r) { return Ptr(REG_D, r * 4); }
+	static Mem RegF(int r) { return Ptr(REG_F, r * 8); }
+	static Mem RegA(int r) { return Ptr(REG_A, r * 8); }
+	static Mem KonstF(int k) { return Ptr(REG_KF, k * 8); }
+	static Mem Context(size_t offset) { return Ptr(REG_CTX, int(offset)); }
+	int KonstD(int k) const { return Func->KonstD[k]; }
+
+	void BuildSnippets();
+	bool EmitOp(int i);
+	void CallSnippet(int i);
+	int SlowPath(int i);
+	int JumpTarget(int jmpindex);
+	void CmpJmp(int i, int cc);
+
+	void LoadAddress(const VMOP *pc, int base, bool regoffset, int &disp, int i);
+	void EmitLoad(const VMOP *pc, bool regoffset, int i);
+	void EmitStore(const VMOP *pc, bool regoffset, int i);
+	void EmitParam(const VMOP *pc);
+	bool EmitDirectCall(int i);
+	void EmitReturn(const VMOP *pc, int i);
+	void EmitFloatCompare(const VMOP *pc, const Mem &b, const Mem &c, int cc, bool swap);
+	void EmitVectorCompare(const VMOP *pc, int count, bool konst, int i);
+	void LoadEpsilon(int xmm, double eps);
+	void AbsXmm0();
+	void NegateDouble(const Mem &dst, const Mem &src);
+};
+
+//===========================================================================
+//
+// Every instruction gets a copy that the interpreter can run. Calls also
+// need their RESULT instructions.
+//
+//===========================================================================
+
+void FJitCompiler::BuildSnippets()
+{
+	VMOP ret;
+	ret.word = 0;
+	ret.op = OP_RET;
+	ret.a = RET_FINAL;
+	ret.b = REGT_NIL;
+
+	Data->Snippets.Clear();
+	Data->SnippetStart.Resize(Func->CodeSize);
+	for (int i = 0; i < Func->CodeSize; i++)
+	{
+		Data->SnippetStart[i] = Data->Snippets.Push(Code[i]);
+		if (Code[i].op == OP_CALL || Code[i].op == OP_CALL_K)
+		{
+			for (int j = 1; j <= Code[i].c && i + j < Func->CodeSize; j++)
+			{
+				Data->Snippets.Push(Code[i + j]);
+			}
+		}
+		Data->Snippets.Push(ret);
+	}
+}
+
+void FJitCompiler::CallSnippet(int i)
+{
+	as.Mov64(ARG1, REG_CTX);
+	as.MovImm32(ARG2, i);
+	as.MovImm64(RAX, (void *)JitExecSnippet);
+	as.CallRax();
+	as.Test32(RAX, RAX);
+	as.Jcc(CC_S, ExitLabel);
+}
+
+// The interpreter takes over the instruction if it has to throw an exception.
+int FJitCompiler::SlowPath(int i)
+{
+	int label = as.NewLabel();
+	SlowPaths.Push({ label, i });
+	return label;
+}
+
+int FJitCompiler::JumpTarget(int jmpindex)
+{
+	if (jmpindex >= Func->CodeSize || Code[jmpindex].op != OP_JMP)
+	{
+		Failed = true;
+		return ExitLabel;
+	}
+	int target = jmpindex + 1 + Code[jmpindex].i24;
+	if (target < 0 || target > Func->CodeSize)
+	{
+		Failed = true;
+		return ExitLabel;
+	}
+	return OpLabels[target];
+}
+
+// Conditional instructions are followed by a JMP that is taken if the condition
+// matches the check bit. Otherwise execution continues after the JMP.
+void FJitCompiler::CmpJmp(int i, int cc)
+{
+	if (!(Code[i].a & CMP_CHECK)) cc ^= 1;
+	as.Jcc(cc, JumpTarget(i + 1));
+	as.Jmp(OpLabels[MIN(i + 2, Func->CodeSize)]);
+}
+
+//===========================================================================
+//
+// Memory access
+//
+//===========================================================================
+
+// Loads the base pointer from aB (or aA for stores) into RAX and adds the offset.
+void FJitCompiler::LoadAddress(const VMOP *pc, int base, bool regoffset, int &disp, int i)
+{
+	as.Load64(RAX, RegA(base));
+	as.Test64(RAX, RAX);
+	as.Jcc(CC_E, SlowPath(i));
+	if (regoffset)
+	{
+		as.Movsxd(RCX, RegD(pc->c));
+		as.Alu64(ALU_ADD, RAX, RCX);
+		disp = 0;
+	}
+	else
+	{
+		disp = KonstD(pc->c);
+	}
+}
+
+void FJitCompiler::EmitLoad(const VMOP *pc, bool regoffset, int i)
+{
+	int disp;
+	LoadAddress(pc, pc->b, regoffset, disp, i);
+	Mem src = Ptr(RAX, disp);
+	int a = pc->a;
+
+	switch (regoffset ? pc->op - 1 : pc->op)
+	{
+	case OP_LB:
+		as.Op(0, false, 0x0FBE, RCX, src);
+		as.Store32(RegD(a), RCX);
+		break;
+	case OP_LBU:
+		as.Op(0, false, 0x0FB6, RCX, src);
+		as.Store32(RegD(a), RCX);
+		break;
+	case OP_LH:
+		as.Op(0, false, 0x0FBF, RCX, src);
+		as.Store32(RegD(a), RCX);
+		break;
+	case OP_LHU:
+		as.Op(0, false, 0x0FB7, RCX, src);
+		as.Store32(RegD(a), RCX);
+		break;
+	case OP_LW:
+		as.Load32(RCX, src);
+		as.Store32(RegD(a), RCX);
+		break;
+	case OP_LSP:
+		as.Op(0xF3, false, 0x0F5A, XMM0, src);		// cvtss2sd
+		as.StoreSD(RegF(a), XMM0);
+		break;
+	case OP_LDP:
+		as.LoadSD(XMM0, src);
+		as.StoreSD(RegF(a), XMM0);
+		break;
+	case OP_LP:
+		as.Load64(RCX, src);
+		as.Store64(RegA(a), RCX);
+		break;
+	case OP_LV2:
+	case OP_LV3:
+		for (int j = 0; j < (pc->op == OP_LV2 || pc->op == OP_LV2_R ? 2 : 3); j++)
+		{
+			as.LoadSD(XMM0, Ptr(RAX, disp + j * 8));
+			as.StoreSD(RegF(a + j), XMM0);
+		}
+		break;
+	case OP_LO:
+	{
+		// Same as GC::ReadBarrier: Pointers to dying objects read as (and get set to) NULL.
+		int done = as.NewLabel();
+		as.Load64(RCX, src);
+		as.Test64(RCX, RCX);
+		as.Jcc(CC_E, done);
+		as.Op(0, false, 0xF7, 0, Ptr(RCX, int(myoffsetof(DObject, ObjectFlags))));
+		as.Dword(OF_EuthanizeMe);
+		as.Jcc(CC_E, done);
+		as.Alu32(ALU_XOR, RCX, RCX);
+		as.Store64(src, RCX);
+		as.Bind(done);
+		as.Store64(RegA(a), RCX);
+		break;
+	}
+	}
+}
+
+void FJitCompiler::EmitStore(const VMOP *pc, bool regoffset, int i)
+{
+	int disp;
+	LoadAddress(pc, pc->a, regoffset, disp, i);
+	Mem dst = Ptr(RAX, disp);
+	int b = pc->b;
+
+	switch (regoffset ? pc->op - 1 : pc->op)
+	{
+	case OP_SB:
+		as.Load32(RCX, RegD(b));
+		as.Op(0, false, 0x88, RCX, dst);
+		break;
+	case OP_SH:
+		as.Load32(RCX, RegD(b));
+		as.Op(0x66, false, 0x89, RCX, dst);
+		break;
+	case OP_SW:
+		as.Load32(RCX, RegD(b));
+		as.Store32(dst, RCX);
+		break;
+	case OP_SSP:
+		as.Op(0xF2, false, 0x0F5A, XMM0, RegF(b));	// cvtsd2ss
+		as.Op(0xF3, false, 0x0F11, XMM0, dst);		// movss
+		break;
+	case OP_SDP:
+		as.LoadSD(XMM0, RegF(b));
+		as.StoreSD(dst, XMM0);
+		break;
+	case OP_SP:
+		as.Load64(RCX, RegA(b));
+		as.Store64(dst, RCX);
+		break;
+	case OP_SO:
+		as.Load64(ARG1, RegA(b));
+		as.Store64(dst, ARG1);
+		as.MovImm64(RAX, (void *)JitWriteBarrier);
+		as.CallRax();
+		break;
+	case OP_SV2:
+	case OP_SV3:
+		for (int j = 0; j < (pc->op == OP_SV2 || pc->op == OP_SV2_R ? 2 : 3); j++)
+		{
+			as.LoadSD(XMM0, RegF(b + j));
+			as.StoreSD(Ptr(RAX, disp + j * 8), XMM0);
+		}
+		break;
+	}
+}
+
+//===========================================================================
+//
+// PARAM
+//
+//===========================================================================
+
+void FJitCompiler::EmitParam(const VMOP *pc)
+{
+	static_assert(sizeof(VMValue) == 16, "PARAM addresses the parameter array with a shift");
+
+	int b = pc->op == OP_PARAMI ? REGT_INT | REGT_KONST : pc->b;
+	int c = pc->c;
+	int count = b == (REGT_FLOAT | REGT_MULTIREG3) ? 3 : b == (REGT_FLOAT | REGT_MULTIREG2) ? 2 : 1;
+
+	// RAX = &reg.param[f->NumParam], f->NumParam += count
+	as.Load64(RDX, Context(offsetof(JitContext, Frame)));
+	as.Op(0, false, 0x0FB7, RAX, Ptr(RDX, int(offsetof(VMFrame, NumParam))));
+	as.Op(0, false, 0x8D, RCX, Ptr(RAX, count));
+	as.Op(0x66, false, 0x89, RCX, Ptr(RDX, int(offsetof(VMFrame, NumParam))));
+	as.ShiftImm(4, RAX, 4);
+	as.Alu64(ALU_ADD, RAX, Context(offsetof(JitContext, Param)));
+
+	Mem value = Ptr(RAX, 0);
+	int type;
+	switch (b)
+	{
+	case REGT_NIL:
+		as.Op(0, true, 0xC7, 0, value);
+		as.Dword(0);
+		type = REGT_NIL;
+		break;
+	case REGT_INT:
+		as.Load32(RCX, RegD(c));
+		as.Store32(value, RCX);
+		type = REGT_INT;
+		break;
+	case REGT_INT | REGT_KONST:
+		as.Store32Imm(value, pc->op == OP_PARAMI ? pc->i24 : KonstD(c));
+		type = REGT_INT;
+		break;
+	case REGT_INT | REGT_ADDROF:
+		as.Lea(RCX, RegD(c));
+		as.Store64(value, RCX);
+		type = REGT_POINTER;
+		break;
+	case REGT_STRING:
+	case REGT_STRING | REGT_ADDROF:
+		as.Load64(RCX, Context(offsetof(JitContext, S)));
+		as.Lea(RCX, Ptr(RCX, int(c * sizeof(FString))));
+		as.Store64(value, RCX);
+		type = b == REGT_STRING ? REGT_STRING : REGT_POINTER;
+		break;
+	case REGT_STRING | REGT_KONST:
+		as.MovImm64(RCX, &Func->KonstS[c]);
+		as.Store64(value, RCX);
+		type = REGT_STRING;
+		break;
+	case REGT_POINTER:
+		as.Load64(RCX, RegA(c));
+		as.Store64(value, RCX);
+		type = REGT_POINTER;
+		break;
+	case REGT_POINTER | REGT_ADDROF:
+		as.Lea(RCX, RegA(c));
+		as.Store64(value, RCX);
+		type = REGT_POINTER;
+		break;
+	case REGT_POINTER | REGT_KONST:
+		as.MovImm64(RCX, &Func->KonstA[c].v);
+		as.Load64(RCX, Ptr(RCX));
+		as.Store64(value, RCX);
+		type = REGT_POINTER;
+		break;
+	case REGT_FLOAT | REGT_ADDROF:
+		as.Lea(RCX, RegF(c));
+		as.Store64(value, RCX);
+		type = REGT_POINTER;
+		break;
+	default:
+		// REGT_FLOAT, possibly with REGT_KONST or as a vector
+		for (int j = 0; j < count; j++)
+		{
+			as.LoadSD(XMM0, (b & REGT_KONST) ? KonstF(c + j) : RegF(c + j));
+			as.StoreSD(Ptr(RAX, j * int(sizeof(VMValue))), XMM0);
+			as.Store8Imm(Ptr(RAX, j * int(sizeof(VMValue)) + int(offsetof(VMValue, Type))), REGT_FLOAT);
+		}
+		return;
+	}
+	as.Store8Imm(Ptr(RAX, int(offsetof(VMValue, Type))), type);
+}
+
+//===========================================================================
+//
+// Calls a native through its typed entry point. The arguments are taken
+// straight from the parameter stack into the argument registers and the
+// result goes straight into the register named by the RESULT.
+//
+//===========================================================================
+
+bool FJitCompiler::EmitDirectCall(int i)
+{
+#ifdef _WIN32
+	static const int intargs[] = { RCX, RDX, R8, R9 };
+#else
+	static const int intargs[] = { RDI, RSI, RDX, RCX };
+#endif
+	const VMOP *pc = &Code[i];
+	VMFunction *call = (VMFunction *)Func->KonstA[pc->a].o;
+	if (call == nullptr || !(call->VarFlags & VARF_Native)) return false;
+
+	const FDirectNativeDesc &desc = static_cast<VMNativeFunction *>(call)->Direct;
+	int numargs = pc->b;
+	if (desc.Function == nullptr || desc.NumArgs != numargs || pc->c > 1) return false;
+
+	int result = -1;
+	if (pc->c == 1)
+	{
+		static const int regtypes[] = { -1, REGT_INT, REGT_INT, REGT_FLOAT, REGT_POINTER };
+		if (i + 1 >= Func->CodeSize || Code[i + 1].op != OP_RESULT || Code[i + 1].b != regtypes[desc.ReturnType]) return false;
+		result = Code[i + 1].c;
+	}
+
+	// R10 = &reg.param[f->NumParam - numargs]
+	as.Load64(R11, Context(offsetof(JitContext, Frame)));
+	as.Op(0, false, 0x0FB7, RAX, Ptr(R11, int(offsetof(VMFrame, NumParam))));
+	as.AluImm32(5, RAX, numargs);
+	as.OpR(0, false, 0x8B, R10, RAX);
+	as.ShiftImm(4, R10, 4);
+	as.Alu64(ALU_ADD, R10, Context(offsetof(JitContext, Param)));
+
+	// Null pointers go through the normal call so that the native can complain about them.
+	for (int j = 0; j < numargs; j++)
+	{
+		if (desc.ArgTypes[j] == DNT_Pointer)
+		{
+			as.Op(0, true, 0x83, 7, Ptr(R10, j * int(sizeof(VMValue))));
+			as.Byte(0);
+			as.Jcc(CC_E, SlowPath(i));
+		}
+	}
+	as.Op(0x66, false, 0x89, RAX, Ptr(R11, int(offsetof(VMFrame, NumParam))));
+
+	// Win64 assigns the argument registers by position, SysV counts ints and floats separately.
+	int intarg = 0, floatarg = 0;
+	for (int j = 0; j < numargs; j++)
+	{
+		Mem arg = Ptr(R10, j * int(sizeof(VMValue)));
+#ifdef _WIN32
+		intarg = floatarg = j;
+#endif
+		switch (desc.ArgTypes[j])
+		{
+		case DNT_Int:
+			as.Load32(intargs[intarg++], arg);
+			break;
+		case DNT_Bool:
+			as.AluImm32(7, arg, 0);
+			as.Setcc(CC_NE, RAX);
+			as.Movzx8(intargs[intarg++], RAX);
+			break;
+		case DNT_Float:
+			as.LoadSD(floatarg++, arg);
+			break;
+		case DNT_Pointer:
+			as.Load64(intargs[intarg++], arg);
+			break;
+		}
+	}
+	as.MovImm64(RAX, desc.Function);
+	as.CallRax();
+
+	int failed = as.NewLabel();
+	DirectCallFailures.Push({ failed, i });
+	as.MovImm64(RCX, &VMDirectCallFailed);
+	as.Op(0, false, 0x80, 7, Ptr(RCX));		// cmp byte [rcx], 0
+	as.Byte(0);
+	as.Jcc(CC_NE, failed);
+
+	if (result >= 0)
+	{
+		switch (desc.ReturnType)
+		{
+		case DNT_Bool:
+			as.Movzx8(RAX, RAX);
+			// fall through
+		case DNT_Int:
+			as.Store32(RegD(result), RAX);
+			break;
+		case DNT_Float:
+			as.StoreSD(RegF(result), XMM0);
+			break;
+		case DNT_Pointer:
+			as.Store64(RegA(result), RAX);
+			break;
+		}
+	}
+	return true;
+}
+
+//===========================================================================
+//
+// RET and RETI
+//
+//===========================================================================
+
+void FJitCompiler::EmitReturn(const VMOP *pc, int i)
+{
+	int retnum = pc->a & ~RET_FINAL;
+	int b = pc->op == OP_RETI ? REGT_INT | REGT_KONST : pc->b;
+	int c = pc->c;
+	int skip = as.NewLabel();
+
+	as.Load32(RCX, Context(offsetof(JitContext, NumRet)));
+	as.AluImm32(7, RCX, retnum);
+	as.Jcc(CC_LE, skip);
+	as.Load64(RDX, Context(offsetof(JitContext, Ret)));
+	as.Load64(RDX, Ptr(RDX, int(retnum * sizeof(VMReturn) + offsetof(VMReturn, Location))));
+
+	switch (b & REGT_TYPE)
+	{
+	case REGT_INT:
+		if (pc->op == OP_RETI) as.Store32Imm(Ptr(RDX), pc->i16);
+		else if (b & REGT_KONST) as.Store32Imm(Ptr(RDX), KonstD(c));
+		else
+		{
+			as.Load32(RAX, RegD(c));
+			as.Store32(Ptr(RDX), RAX);
+		}
+		break;
+
+	case REGT_FLOAT:
+	{
+		int count = (b & REGT_MULTIREG3) ? 3 : (b & REGT_MULTIREG2) ? 2 : 1;
+		for (int j = 0; j < count; j++)
+		{
+			as.LoadSD(XMM0, (b & REGT_KONST) ? KonstF(c + j) : RegF(c + j));
+			as.StoreSD(Ptr(RDX, j * 8), XMM0);
+		}
+		break;
+	}
+
+	case REGT_POINTER:
+		if (b & REGT_KONST)
+		{
+			as.MovImm64(RAX, &Func->KonstA[c].v);
+			as.Load64(RAX, Ptr(RAX));
+		}
+		else
+		{
+			as.Load64(RAX, RegA(c));
+		}
+		as.Store64(Ptr(RDX), RAX);
+		break;
+	}
+	as.Bind(skip);
+
+	if (pc->a & RET_FINAL)
+	{
+		// return retnum < numret ? retnum + 1 : numret;
+		as.Load32(RCX, Context(offsetof(JitContext, NumRet)));
+		as.MovImm32(RAX, retnum + 1);
+		as.Alu32(ALU_CMP, RAX, RCX);
+		as.Cmov(CC_G, RAX, RCX);
+		as.Jmp(ExitLabel);
+	}
+}
+
+//===========================================================================
+//
+// Floating point comparisons. The result of the test ends up in AL.
+//
+//===========================================================================
+
+void FJitCompiler::LoadEpsilon(int xmm, double eps)
+{
+	uint64_t bits;
+	memcpy(&bits, &eps, sizeof(bits));
+	as.MovImm64(RAX, bits);
+	as.MovqToXmm(xmm, RAX);
+}
+
+void FJitCompiler::AbsXmm0()
+{
+	as.MovqFromXmm(RAX, XMM0);
+	as.OpR(0, true, 0x0FBA, 6, RAX);		// btr rax, 63
+	as.Byte(63);
+	as.MovqToXmm(XMM0, RAX);
+}
+
+// EQF, LTF and LEF. b and c are the operands in the order the interpreter uses them.
+void FJitCompiler::EmitFloatCompare(const VMOP *pc, const Mem &b, const Mem &c, int cc, bool approx)
+{
+	if (cc == CC_E)
+	{
+		if (approx)
+		{
+			// fabs(c - b) < VM_EPSILON
+			as.LoadSD(XMM0, c);
+			as.ArithSD(SSE_SUB, XMM0, b);
+			AbsXmm0();
+			LoadEpsilon(XMM1, VM_EPSILON);
+			as.Ucomisd(XMM1, XMM0);
+			as.Setcc(CC_A, RAX);
+		}
+		else
+		{
+			as.LoadSD(XMM0, c);
+			as.Ucomisd(XMM0, b);
+			as.Setcc(CC_E, RAX);
+			as.Setcc(CC_NP, RCX);
+			as.And8(RAX, RCX);
+		}
+	}
+	else if (approx)
+	{
+		// (b - c) < -VM_EPSILON or (b - c) <= -VM_EPSILON
+		as.LoadSD(XMM0, b);
+		as.ArithSD(SSE_SUB, XMM0, c);
+		LoadEpsilon(XMM1, -VM_EPSILON);
+		as.Ucomisd(XMM1, XMM0);
+		as.Setcc(cc == CC_L ? CC_A : CC_AE, RAX);
+	}
+	else
+	{
+		// b < c or b <= c, written as c > b and c >= b so that NaNs compare false.
+		as.LoadSD(XMM0, c);
+		as.Ucomisd(XMM0, b);
+		as.Setcc(cc == CC_L ? CC_A : CC_AE, RAX);
+	}
+}
+
+void FJitCompiler::EmitVectorCompare(const VMOP *pc, int count, bool konst, int i)
+{
+	bool approx = !!(pc->a & CMP_APPROX);
+	as.MovImm32(RDX, 1);
+	for (int j = 0; j < count; j++)
+	{
+		Mem b = RegF(pc->b + j);
+		Mem c = konst ? KonstF(pc->c + j) : RegF(pc->c + j);
+		if (approx)
+		{
+			as.LoadSD(XMM0, b);
+			as.ArithSD(SSE_SUB, XMM0, c);
+			AbsXmm0();
+			LoadEpsilon(XMM1, VM_EPSILON);
+			as.Ucomisd(XMM1, XMM0);
+			as.Setcc(CC_A, RAX);
+		}
+		else
+		{
+			as.LoadSD(XMM0, b);
+			as.Ucomisd(XMM0, c);
+			as.Setcc(CC_E, RAX);
+			as.Setcc(CC_NP, RCX);
+			as.And8(RAX, RCX);
+		}
+		as.And8(RDX, RAX);
+	}
+	as.Test8(RDX, RDX);
+	CmpJmp(i, CC_NE);
+}
+
+void FJitCompiler::NegateDouble(const Mem &dst, const Mem &src)
+{
+	as.Load64(RAX, src);
+	as.OpR(0, true, 0x0FBA, 7, RAX);		// btc rax, 63
+	as.Byte(63);
+	as.Store64(dst, RAX);
+}
+
+//===========================================================================
+//
+// Emits one instruction. Returns false if the interpreter has to run it.
+//
+//===========================================================================
+
+bool FJitCompiler::EmitOp(int i)
+{
+	const VMOP *pc = &Code[i];
+	int a = pc->a, b = pc->b, c = pc->c;
+
+	switch (pc->op)
+	{
+	case OP_NOP:
+	case OP_RESULT:
+		return true;
+
+	case OP_LI:
+		as.Store32Imm(RegD(a), pc->i16);
+		return true;
+
+	case OP_LK:
+		as.Store32Imm(RegD(a), KonstD(pc->i16u));
+		return true;
+
+	case OP_LKF:
+		as.LoadSD(XMM0, KonstF(pc->i16u));
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+
+	case OP_LKP:
+		as.MovImm64(RAX, &Func->KonstA[pc->i16u].v);
+		as.Load64(RAX, Ptr(RAX));
+		as.Store64(RegA(a), RAX);
+		return true;
+
+	case OP_LK_R:
+		as.Movsxd(RCX, RegD(b));
+		as.Load32(RAX, Ptr(REG_KD, RCX, 4, c * 4));
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_LKF_R:
+		as.Movsxd(RCX, RegD(b));
+		as.LoadSD(XMM0, Ptr(REG_KF, RCX, 8, c * 8));
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+
+	case OP_LKP_R:
+		as.Movsxd(RCX, RegD(b));
+		as.MovImm64(RAX, Func->KonstA);
+		as.Load64(RAX, Ptr(RAX, RCX, 8, c * int(sizeof(FVoidObj))));
+		as.Store64(RegA(a), RAX);
+		return true;
+
+	case OP_LFP:
+		as.Load64(RAX, Context(offsetof(JitContext, Extra)));
+		as.Store64(RegA(a), RAX);
+		return true;
+
+	case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+	case OP_LSP: case OP_LDP: case OP_LP: case OP_LO: case OP_LV2: case OP_LV3:
+		EmitLoad(pc, false, i);
+		return true;
+
+	case OP_LB_R: case OP_LBU_R: case OP_LH_R: case OP_LHU_R: case OP_LW_R:
+	case OP_LSP_R: case OP_LDP_R: case OP_LP_R: case OP_LO_R: case OP_LV2_R: case OP_LV3_R:
+		EmitLoad(pc, true, i);
+		return true;
+
+	case OP_LBIT:
+		as.Load64(RAX, RegA(b));
+		as.Test64(RAX, RAX);
+		as.Jcc(CC_E, SlowPath(i));
+		as.Op(0, false, 0xF6, 0, Ptr(RAX));		// test byte [rax], c
+		as.Byte(c);
+		as.Setcc(CC_NE, RAX);
+		as.Movzx8(RAX, RAX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_SB: case OP_SH: case OP_SW: case OP_SSP: case OP_SDP: case OP_SP: case OP_SO: case OP_SV2: case OP_SV3:
+		EmitStore(pc, false, i);
+		return true;
+
+	case OP_SB_R: case OP_SH_R: case OP_SW_R: case OP_SSP_R: case OP_SDP_R: case OP_SP_R: case OP_SV2_R: case OP_SV3_R:
+		EmitStore(pc, true, i);
+		return true;
+
+	case OP_SBIT:
+	{
+		int clear = as.NewLabel(), done = as.NewLabel();
+		as.Load64(RAX, RegA(a));
+		as.Test64(RAX, RAX);
+		as.Jcc(CC_E, SlowPath(i));
+		as.Load32(RCX, RegD(b));
+		as.Test32(RCX, RCX);
+		as.Jcc(CC_E, clear);
+		as.Op(0, false, 0x80, 1, Ptr(RAX));		// or byte [rax], c
+		as.Byte(c);
+		as.Jmp(done);
+		as.Bind(clear);
+		as.Op(0, false, 0x80, 4, Ptr(RAX));		// and byte [rax], ~c
+		as.Byte(~c);
+		as.Bind(done);
+		return true;
+	}
+
+	case OP_MOVE:
+		as.Load32(RAX, RegD(b));
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_MOVEA:
+		as.Load64(RAX, RegA(b));
+		as.Store64(RegA(a), RAX);
+		return true;
+
+	case OP_MOVEF:
+	case OP_MOVEV2:
+	case OP_MOVEV3:
+		for (int j = 0; j < (pc->op == OP_MOVEF ? 1 : pc->op == OP_MOVEV2 ? 2 : 3); j++)
+		{
+			as.LoadSD(XMM0, RegF(b + j));
+			as.StoreSD(RegF(a + j), XMM0);
+		}
+		return true;
+
+	case OP_CAST:
+		switch (c)
+		{
+		case CAST_I2F:
+			as.Op(0xF2, false, 0x0F2A, XMM0, RegD(b));		// cvtsi2sd
+			as.StoreSD(RegF(a), XMM0);
+			return true;
+		case CAST_U2F:
+			as.Load32(RAX, RegD(b));
+			as.OpR(0xF2, true, 0x0F2A, XMM0, RAX);
+			as.StoreSD(RegF(a), XMM0);
+			return true;
+		case CAST_F2I:
+			as.Op(0xF2, false, 0x0F2C, RAX, RegF(b));		// cvttsd2si
+			as.Store32(RegD(a), RAX);
+			return true;
+		case CAST_F2U:
+			as.Op(0xF2, true, 0x0F2C, RAX, RegF(b));
+			as.Store32(RegD(a), RAX);
+			return true;
+		}
+		break;
+
+	case OP_CASTB:
+		switch (c)
+		{
+		case CASTB_I:
+			as.AluImm32(7, RegD(b), 0);
+			as.Setcc(CC_NE, RAX);
+			break;
+		case CASTB_F:
+			as.Xorpd(XMM1, XMM1);
+			as.Ucomisd(XMM1, RegF(b));
+			as.Setcc(CC_NE, RAX);
+			as.Setcc(CC_P, RCX);
+			as.Or8(RAX, RCX);
+			break;
+		case CASTB_A:
+			as.Op(0, true, 0x83, 7, RegA(b));			// cmp qword, 0
+			as.Byte(0);
+			as.Setcc(CC_NE, RAX);
+			break;
+		default:
+			return false;
+		}
+		as.Movzx8(RAX, RAX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_TEST:
+		as.AluImm32(7, RegD(a), pc->i16u);
+		as.Jcc(CC_NE, OpLabels[MIN(i + 2, Func->CodeSize)]);
+		return true;
+
+	case OP_TESTN:
+		as.Load32(RAX, RegD(a));
+		as.Unary32(3, RAX);
+		as.AluImm32(7, RAX, pc->i16u);
+		as.Jcc(CC_NE, OpLabels[MIN(i + 2, Func->CodeSize)]);
+		return true;
+
+	case OP_JMP:
+	{
+		int target = i + 1 + pc->i24;
+		if (target < 0 || target > Func->CodeSize)
+		{
+			Failed = true;
+			return false;
+		}
+		as.Jmp(OpLabels[target]);
+		return true;
+	}
+
+	case OP_IJMP:
+	{
+		// The jump table is a list of JMPs.
+		int table = i + 1 + pc->i16;
+		int count = 0;
+		while (table + count >= 0 && table + count < Func->CodeSize && Code[table + count].op == OP_JMP) count++;
+		if (table < 0 || count == 0)
+		{
+			Failed = true;
+			return false;
+		}
+		as.Load32(RAX, RegD(a));
+		for (int j = 0; j < count - 1; j++)
+		{
+			as.AluImm32(7, RAX, j);
+			as.Jcc(CC_E, OpLabels[table + j]);
+		}
+		as.Jmp(OpLabels[table + count - 1]);
+		return true;
+	}
+
+	case OP_PARAMI:
+		EmitParam(pc);
+		return true;
+
+	case OP_PARAM:
+		switch (b)
+		{
+		case REGT_NIL:
+		case REGT_INT: case REGT_INT | REGT_KONST: case REGT_INT | REGT_ADDROF:
+		case REGT_STRING: case REGT_STRING | REGT_KONST: case REGT_STRING | REGT_ADDROF:
+		case REGT_POINTER: case REGT_POINTER | REGT_KONST: case REGT_POINTER | REGT_ADDROF:
+		case REGT_FLOAT: case REGT_FLOAT | REGT_KONST: case REGT_FLOAT | REGT_ADDROF:
+		case REGT_FLOAT | REGT_MULTIREG2: case REGT_FLOAT | REGT_MULTIREG3:
+			EmitParam(pc);
+			return true;
+		}
+		break;
+
+	case OP_RET:
+		if (b == REGT_NIL)
+		{
+			as.Alu32(ALU_XOR, RAX, RAX);
+			as.Jmp(ExitLabel);
+			return true;
+		}
+		if ((b & REGT_TYPE) != REGT_STRING)
+		{
+			EmitReturn(pc, i);
+			return true;
+		}
+		CallSnippet(i);
+		if (a & RET_FINAL) as.Jmp(ExitLabel);
+		return false;
+
+	case OP_RETI:
+		EmitReturn(pc, i);
+		return true;
+
+	case OP_CALL_K:
+		if (EmitDirectCall(i))
+		{
+			JitDirectCalls++;
+			return true;
+		}
+		break;
+
+	case OP_TAIL:
+	case OP_TAIL_K:
+		CallSnippet(i);
+		as.Jmp(ExitLabel);
+		return false;
+
+	case OP_BOUND:
+	case OP_BOUND_K:
+	case OP_BOUND_R:
+	{
+		int slow = SlowPath(i);
+		as.Load32(RAX, RegD(a));
+		if (pc->op == OP_BOUND) as.AluImm32(7, RAX, pc->i16u);
+		else if (pc->op == OP_BOUND_K) as.AluImm32(7, RAX, KonstD(pc->i16u));
+		else as.Alu32(ALU_CMP, RAX, RegD(b));
+		as.Jcc(CC_GE, slow);
+		as.Test32(RAX, RAX);
+		as.Jcc(CC_S, slow);
+		return true;
+	}
+
+	case OP_CMPS:
+		as.Mov64(ARG1, REG_CTX);
+		as.MovImm32(ARG2, i);
+		as.MovImm64(RAX, (void *)JitCompareStrings);
+		as.CallRax();
+		as.Test32(RAX, RAX);
+		CmpJmp(i, CC_NE);
+		return true;
+
+	// Integer math
+
+	case OP_SLL_RR: case OP_SRL_RR: case OP_SRA_RR:
+	case OP_SLL_KR: case OP_SRA_KR:
+	{
+		int digit = (pc->op == OP_SLL_RR || pc->op == OP_SLL_KR) ? 4 : pc->op == OP_SRL_RR ? 5 : 7;
+		if (pc->op == OP_SLL_KR || pc->op == OP_SRA_KR) as.MovImm32(RAX, KonstD(b));
+		else as.Load32(RAX, RegD(b));
+		as.Load32(RCX, RegD(c));
+		as.ShiftCl(digit, RAX);
+		as.Store32(RegD(a), RAX);
+		return true;
+	}
+
+	case OP_SLL_RI: case OP_SRL_RI: case OP_SRA_RI:
+		as.Load32(RAX, RegD(b));
+		as.ShiftImm(pc->op == OP_SLL_RI ? 4 : pc->op == OP_SRL_RI ? 5 : 7, RAX, c);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_SRL_KR:
+		// The interpreter shifts by the register number here, not by its content.
+		as.MovImm32(RAX, KonstD(b));
+		as.ShiftImm(5, RAX, c);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_ADD_RR: case OP_SUB_RR: case OP_AND_RR: case OP_OR_RR: case OP_XOR_RR:
+	case OP_ADD_RK: case OP_SUB_RK: case OP_AND_RK: case OP_OR_RK: case OP_XOR_RK:
+	{
+		unsigned opcode;
+		int digit;
+		bool konst = false;
+		switch (pc->op)
+		{
+		default:
+		case OP_ADD_RK: konst = true;
+		case OP_ADD_RR: opcode = ALU_ADD; digit = 0; break;
+		case OP_SUB_RK: konst = true;
+		case OP_SUB_RR: opcode = ALU_SUB; digit = 5; break;
+		case OP_AND_RK: konst = true;
+		case OP_AND_RR: opcode = ALU_AND; digit = 4; break;
+		case OP_OR_RK: konst = true;
+		case OP_OR_RR: opcode = ALU_OR; digit = 1; break;
+		case OP_XOR_RK: konst = true;
+		case OP_XOR_RR: opcode = ALU_XOR; digit = 6; break;
+		}
+		as.Load32(RAX, RegD(b));
+		if (konst) as.AluImm32(digit, RAX, KonstD(c));
+		else as.Alu32(opcode, RAX, RegD(c));
+		as.Store32(RegD(a), RAX);
+		return true;
+	}
+
+	case OP_ADDI:
+		as.Load32(RAX, RegD(b));
+		as.AluImm32(0, RAX, pc->cs);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_SUB_KR:
+		as.MovImm32(RAX, KonstD(b));
+		as.Alu32(ALU_SUB, RAX, RegD(c));
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_MUL_RR:
+		as.Load32(RAX, RegD(b));
+		as.Imul32(RAX, RegD(c));
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_MUL_RK:
+		as.Load32(RAX, RegD(b));
+		as.MovImm32(RCX, KonstD(c));
+		as.Imul32(RAX, RCX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_DIV_RR: case OP_DIV_RK: case OP_DIV_KR:
+	case OP_DIVU_RR: case OP_DIVU_RK: case OP_DIVU_KR:
+	case OP_MOD_RR: case OP_MOD_RK: case OP_MOD_KR:
+	case OP_MODU_RR: case OP_MODU_RK: case OP_MODU_KR:
+	{
+		int op = pc->op;
+		bool isunsigned = op >= OP_DIVU_RR && op <= OP_DIVU_KR || op >= OP_MODU_RR && op <= OP_MODU_KR;
+		bool ismod = op >= OP_MOD_RR && op <= OP_MODU_KR;
+		bool konstb = op == OP_DIV_KR || op == OP_DIVU_KR || op == OP_MOD_KR || op == OP_MODU_KR;
+		bool konstc = op == OP_DIV_RK || op == OP_DIVU_RK || op == OP_MOD_RK || op == OP_MODU_RK;
+
+		if (konstc)
+		{
+			if (KonstD(c) == 0) break;	// Let the interpreter throw.
+			as.MovImm32(RCX, KonstD(c));
+		}
+		else
+		{
+			as.Load32(RCX, RegD(c));
+			as.Test32(RCX, RCX);
+			as.Jcc(CC_E, SlowPath(i));
+		}
+		if (konstb) as.MovImm32(RAX, KonstD(b));
+		else as.Load32(RAX, RegD(b));
+		if (isunsigned)
+		{
+			as.Alu32(ALU_XOR, RDX, RDX);
+			as.Unary32(6, RCX);
+		}
+		else
+		{
+			as.Cdq();
+			as.Unary32(7, RCX);
+		}
+		as.Store32(RegD(a), ismod ? RDX : RAX);
+		return true;
+	}
+
+	case OP_MIN_RR: case OP_MIN_RK:
+	case OP_MAX_RR: case OP_MAX_RK:
+		as.Load32(RAX, RegD(b));
+		if (pc->op == OP_MIN_RK || pc->op == OP_MAX_RK) as.MovImm32(RCX, KonstD(c));
+		else as.Load32(RCX, RegD(c));
+		as.Alu32(ALU_CMP, RAX, RCX);
+		as.Cmov(pc->op == OP_MIN_RR || pc->op == OP_MIN_RK ? CC_G : CC_L, RAX, RCX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_ABS:
+		as.Load32(RAX, RegD(b));
+		as.Cdq();
+		as.Alu32(ALU_XOR, RAX, RDX);
+		as.Alu32(ALU_SUB, RAX, RDX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_NEG:
+	case OP_NOT:
+		as.Load32(RAX, RegD(b));
+		as.Unary32(pc->op == OP_NEG ? 3 : 2, RAX);
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_EQ_R: case OP_EQ_K:
+	case OP_LT_RR: case OP_LT_RK: case OP_LT_KR:
+	case OP_LE_RR: case OP_LE_RK: case OP_LE_KR:
+	case OP_LTU_RR: case OP_LTU_RK: case OP_LTU_KR:
+	case OP_LEU_RR: case OP_LEU_RK: case OP_LEU_KR:
+	{
+		int op = pc->op;
+		int cc = op <= OP_EQ_K ? CC_E : op <= OP_LT_KR ? CC_L : op <= OP_LE_KR ? CC_LE : op <= OP_LTU_KR ? CC_B : CC_BE;
+		bool konstb = op == OP_LT_KR || op == OP_LE_KR || op == OP_LTU_KR || op == OP_LEU_KR;
+		bool konstc = op == OP_EQ_K || op == OP_LT_RK || op == OP_LE_RK || op == OP_LTU_RK || op == OP_LEU_RK;
+		if (konstb) as.MovImm32(RAX, KonstD(b));
+		else as.Load32(RAX, RegD(b));
+		if (konstc) as.AluImm32(7, RAX, KonstD(c));
+		else as.Alu32(ALU_CMP, RAX, RegD(c));
+		CmpJmp(i, cc);
+		return true;
+	}
+
+	// Floating point math
+
+	case OP_ADDF_RR: case OP_ADDF_RK:
+	case OP_SUBF_RR: case OP_SUBF_RK: case OP_SUBF_KR:
+	case OP_MULF_RR: case OP_MULF_RK:
+	case OP_MINF_RR: case OP_MINF_RK:
+	case OP_MAXF_RR: case OP_MAXF_RK:
+	{
+		int op = pc->op;
+		unsigned opcode = op <= OP_ADDF_RK ? SSE_ADD : op <= OP_SUBF_KR ? SSE_SUB : op <= OP_MULF_RK ? SSE_MUL : op <= OP_MINF_RK ? SSE_MIN : SSE_MAX;
+		bool konstb = op == OP_SUBF_KR;
+		bool konstc = op == OP_ADDF_RK || op == OP_SUBF_RK || op == OP_MULF_RK || op == OP_MINF_RK || op == OP_MAXF_RK;
+		as.LoadSD(XMM0, konstb ? KonstF(b) : RegF(b));
+		as.ArithSD(opcode, XMM0, konstc ? KonstF(c) : RegF(c));
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+	}
+
+	case OP_DIVF_RR: case OP_DIVF_RK: case OP_DIVF_KR:
+		if (pc->op == OP_DIVF_RK)
+		{
+			if (Func->KonstF[c] == 0.) break;	// Let the interpreter throw.
+		}
+		else
+		{
+			// NaNs also take the slow path, the interpreter will handle them just fine.
+			as.Xorpd(XMM1, XMM1);
+			as.Ucomisd(XMM1, RegF(c));
+			as.Jcc(CC_E, SlowPath(i));
+		}
+		as.LoadSD(XMM0, pc->op == OP_DIVF_KR ? KonstF(b) : RegF(b));
+		as.ArithSD(SSE_DIV, XMM0, pc->op == OP_DIVF_RK ? KonstF(c) : RegF(c));
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+
+	case OP_FLOP:
+		if (c == FLOP_ABS)
+		{
+			as.Load64(RAX, RegF(b));
+			as.OpR(0, true, 0x0FBA, 6, RAX);		// btr rax, 63
+			as.Byte(63);
+			as.Store64(RegF(a), RAX);
+			return true;
+		}
+		else if (c == FLOP_NEG)
+		{
+			NegateDouble(RegF(a), RegF(b));
+			return true;
+		}
+		else if (c == FLOP_SQRT)
+		{
+			as.ArithSD(SSE_SQRT, XMM0, RegF(b));
+			as.StoreSD(RegF(a), XMM0);
+			return true;
+		}
+		break;
+
+	case OP_EQF_R: case OP_EQF_K:
+	case OP_LTF_RR: case OP_LTF_RK: case OP_LTF_KR:
+	case OP_LEF_RR: case OP_LEF_RK: case OP_LEF_KR:
+	{
+		int op = pc->op;
+		int cc = op <= OP_EQF_K ? CC_E : op <= OP_LTF_KR ? CC_L : CC_LE;
+		bool konstb = op == OP_LTF_KR || op == OP_LEF_KR;
+		bool konstc = op == OP_EQF_K || op == OP_LTF_RK || op == OP_LEF_RK;
+		EmitFloatCompare(pc, konstb ? KonstF(b) : RegF(b), konstc ? KonstF(c) : RegF(c), cc, !!(a & CMP_APPROX));
+		as.Test8(RAX, RAX);
+		CmpJmp(i, CC_NE);
+		return true;
+	}
+
+	// Vector math
+
+	case OP_NEGV2:
+	case OP_NEGV3:
+		for (int j = 0; j < (pc->op == OP_NEGV2 ? 2 : 3); j++)
+		{
+			NegateDouble(RegF(a + j), RegF(b + j));
+		}
+		return true;
+
+	case OP_ADDV2_RR: case OP_SUBV2_RR:
+	case OP_ADDV3_RR: case OP_SUBV3_RR:
+	{
+		int count = pc->op == OP_ADDV2_RR || pc->op == OP_SUBV2_RR ? 2 : 3;
+		unsigned opcode = pc->op == OP_ADDV2_RR || pc->op == OP_ADDV3_RR ? SSE_ADD : SSE_SUB;
+		for (int j = 0; j < count; j++)
+		{
+			as.LoadSD(XMM0, RegF(b + j));
+			as.ArithSD(opcode, XMM0, RegF(c + j));
+			as.StoreSD(RegF(a + j), XMM0);
+		}
+		return true;
+	}
+
+	case OP_DOTV2_RR:
+	case OP_DOTV3_RR:
+		as.LoadSD(XMM0, RegF(b));
+		as.ArithSD(SSE_MUL, XMM0, RegF(c));
+		for (int j = 1; j < (pc->op == OP_DOTV2_RR ? 2 : 3); j++)
+		{
+			as.LoadSD(XMM1, RegF(b + j));
+			as.ArithSD(SSE_MUL, XMM1, RegF(c + j));
+			as.ArithSD(SSE_ADD, XMM0, XMM1);
+		}
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+
+	case OP_LENV2:
+	case OP_LENV3:
+		as.LoadSD(XMM0, RegF(b));
+		as.ArithSD(SSE_MUL, XMM0, RegF(b));
+		for (int j = 1; j < (pc->op == OP_LENV2 ? 2 : 3); j++)
+		{
+			as.LoadSD(XMM1, RegF(b + j));
+			as.ArithSD(SSE_MUL, XMM1, RegF(b + j));
+			as.ArithSD(SSE_ADD, XMM0, XMM1);
+		}
+		as.ArithSD(SSE_SQRT, XMM0, XMM0);
+		as.StoreSD(RegF(a), XMM0);
+		return true;
+
+	case OP_MULVF2_RR: case OP_MULVF2_RK: case OP_DIVVF2_RR: case OP_DIVVF2_RK:
+	case OP_MULVF3_RR: case OP_MULVF3_RK: case OP_DIVVF3_RR: case OP_DIVVF3_RK:
+	{
+		int op = pc->op;
+		int count = op <= OP_DIVVF2_RK ? 2 : 3;
+		bool konst = op == OP_MULVF2_RK || op == OP_DIVVF2_RK || op == OP_MULVF3_RK || op == OP_DIVVF3_RK;
+		unsigned opcode = op == OP_MULVF2_RR || op == OP_MULVF2_RK || op == OP_MULVF3_RR || op == OP_MULVF3_RK ? SSE_MUL : SSE_DIV;
+		as.LoadSD(XMM1, konst ? KonstF(c) : RegF(c));
+		for (int j = 0; j < count; j++)
+		{
+			as.LoadSD(XMM0, RegF(b + j));
+			as.ArithSD(opcode, XMM0, XMM1);
+			as.StoreSD(RegF(a + j), XMM0);
+		}
+		return true;
+	}
+
+	case OP_CROSSV_RR:
+		// t2 = b0*c1 - b1*c0, t1 = b2*c0 - b0*c2, t0 = b1*c2 - b2*c1
+		as.LoadSD(XMM0, RegF(b + 1));
+		as.ArithSD(SSE_MUL, XMM0, RegF(c + 2));
+		as.LoadSD(XMM1, RegF(b + 2));
+		as.ArithSD(SSE_MUL, XMM1, RegF(c + 1));
+		as.ArithSD(SSE_SUB, XMM0, XMM1);
+		as.LoadSD(XMM1, RegF(b + 2));
+		as.ArithSD(SSE_MUL, XMM1, RegF(c));
+		as.LoadSD(XMM2, RegF(b));
+		as.ArithSD(SSE_MUL, XMM2, RegF(c + 2));
+		as.ArithSD(SSE_SUB, XMM1, XMM2);
+		as.LoadSD(XMM2, RegF(b));
+		as.ArithSD(SSE_MUL, XMM2, RegF(c + 1));
+		as.LoadSD(XMM3, RegF(b + 1));
+		as.ArithSD(SSE_MUL, XMM3, RegF(c));
+		as.ArithSD(SSE_SUB, XMM2, XMM3);
+		as.StoreSD(RegF(a), XMM0);
+		as.StoreSD(RegF(a + 1), XMM1);
+		as.StoreSD(RegF(a + 2), XMM2);
+		return true;
+
+	case OP_EQV2_R: case OP_EQV2_K:
+	case OP_EQV3_R: case OP_EQV3_K:
+		EmitVectorCompare(pc, pc->op <= OP_EQV2_K ? 2 : 3, pc->op == OP_EQV2_K || pc->op == OP_EQV3_K, i);
+		return true;
+
+	// Pointer math
+
+	case OP_ADDA_RR:
+	case OP_ADDA_RK:
+	{
+		// NULL stays NULL.
+		int done = as.NewLabel();
+		as.Load64(RAX, RegA(b));
+		as.Test64(RAX, RAX);
+		as.Jcc(CC_E, done);
+		if (pc->op == OP_ADDA_RR)
+		{
+			as.Movsxd(RCX, RegD(c));
+			as.Alu64(ALU_ADD, RAX, RCX);
+		}
+		else
+		{
+			as.AluImm64(0, RAX, KonstD(c));
+		}
+		as.Bind(done);
+		as.Store64(RegA(a), RAX);
+		return true;
+	}
+
+	case OP_SUBA:
+		as.Load64(RAX, RegA(b));
+		as.Alu64(ALU_SUB, RAX, RegA(c));
+		as.Store32(RegD(a), RAX);
+		return true;
+
+	case OP_EQA_R:
+	case OP_EQA_K:
+		as.Load64(RAX, RegA(b));
+		if (pc->op == OP_EQA_R)
+		{
+			as.Alu64(ALU_CMP, RAX, RegA(c));
+		}
+		else
+		{
+			as.MovImm64(RCX, &Func->KonstA[c].v);
+			as.Alu64(ALU_CMP, RAX, Ptr(RCX));
+		}
+		CmpJmp(i, CC_E);
+		return true;
+	}
+
+	// Everything else is done by the interpreter.
+	CallSnippet(i);
+	return false;
+}
+
+//===========================================================================
+//
+//
+//
+//===========================================================================
+
+bool FJitCompiler::Compile()
+{
+	BuildSnippets();
+
+	for (int i = 0; i <= Func->CodeSize; i++)
+	{
+		OpLabels.Push(as.NewLabel());
+	}
+	ExitLabel = as.NewLabel();
+
+	// Prologue. After pushing six registers the stack needs another 40 bytes to be
+	// 16 byte aligned again. This also provides the shadow space for Win64 calls.
+	as.Push(RBX);
+	as.Push(RBP);
+	as.Push(R12);
+	as.Push(R13);
+	as.Push(R14);
+	as.Push(R15);
+	as.AluImm64(5, RSP, 40);
+	as.Mov64(REG_CTX, ARG1);
+	as.Load64(REG_D, Context(offsetof(JitContext, D)));
+	as.Load64(REG_F, Context(offsetof(JitContext, F)));
+	as.Load64(REG_A, Context(offsetof(JitContext, A)));
+	as.MovImm64(REG_KD, Func->KonstD);
+	as.MovImm64(REG_KF, Func->KonstF);
+
+	bool pure = Func->ExtraSpace == 0;
+	for (int i = 0; i < Func->CodeSize; i++)
+	{
+		as.Bind(OpLabels[i]);
+		if (EmitOp(i))
+		{
+			Data->NativeOps++;
+		}
+
+		switch (Code[i].op)
+		{
+		case OP_SB: case OP_SB_R: case OP_SH: case OP_SH_R: case OP_SW: case OP_SW_R:
+		case OP_SSP: case OP_SSP_R: case OP_SDP: case OP_SDP_R: case OP_SS: case OP_SS_R:
+		case OP_SP: case OP_SP_R: case OP_SO: case OP_SO_R: case OP_SV2: case OP_SV2_R:
+		case OP_SV3: case OP_SV3_R: case OP_SBIT: case OP_LO: case OP_LO_R:
+		case OP_CALL: case OP_CALL_K: case OP_TAIL: case OP_TAIL_K: case OP_NEW: case OP_NEW_K:
+			pure = false;
+			break;
+		}
+		// Skip the RESULTs of a call.
+		if (Code[i].op == OP_CALL || Code[i].op == OP_CALL_K)
+		{
+			for (int j = 1; j <= Code[i].c && i + 1 < Func->CodeSize; j++)
+			{
+				as.Bind(OpLabels[++i]);
+			}
+		}
+	}
+	Data->Pure = pure;
+
+	// Code must never fall off the end, but just in case...
+	as.Bind(OpLabels[Func->CodeSize]);
+	as.Alu32(ALU_XOR, RAX, RAX);
+	as.Jmp(ExitLabel);
+
+	for (unsigned j = 0; j < SlowPaths.Size(); j++)
+	{
+		as.Bind(SlowPaths[j].Label);
+		CallSnippet(SlowPaths[j].Index);
+		as.Jmp(OpLabels[SlowPaths[j].Index + 1]);
+	}
+
+	for (unsigned j = 0; j < DirectCallFailures.Size(); j++)
+	{
+		as.Bind(DirectCallFailures[j].Label);
+		as.Mov64(ARG1, REG_CTX);
+		as.MovImm32(ARG2, DirectCallFailures[j].Index);
+		as.MovImm64(RAX, (void *)JitDirectCallFailed);
+		as.CallRax();
+		as.Jmp(ExitLabel);
+	}
+
+	as.Bind(ExitLabel);
+	as.AluImm64(0, RSP, 40);
+	as.Pop(R15);
+	as.Pop(R14);
+	as.Pop(R13);
+	as.Pop(R12);
+	as.Pop(RBP);
+	as.Pop(RBX);
+	as.Ret();
+
+	return !Failed && as.Link();
+}
+
+//===========================================================================
+//
+// Executable memory. Generated code lives as long as the program.
+//
+//===========================================================================
+
+uint8_t *AllocJitMemory(size_t size)
+{
+	static std::mutex mutex;
+	static uint8_t *block;
+	static size_t blockleft;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size = (size + 15) & ~15;
+	if (size > blockleft)
+	{
+		size_t blocksize = MAX<size_t>(size, 1024 * 1024);
+#ifdef _WIN32
+		void *mem = VirtualAlloc(nullptr, blocksize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+		if (mem == nullptr) return nullptr;
+#else
+		void *mem = mmap(nullptr, blocksize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) return nullptr;
+#endif
+		block = (uint8_t *)mem;
+		blockleft = blocksize;
+	}
+	uint8_t *mem = block;
+	block += size;
+	blockleft -= size;
+	return mem;
+}
+
+}
+
+#endif
+
+//===========================================================================
+//
+// VMJitCompile
+//
+// Generates native code for a function. Even if that fails the function
+// gets its JitData so that it is not tried again.
+//
+//===========================================================================
+
+bool VMJitCompile(VMScriptFunction *func)
+{
+	if (func->JitData != nullptr) return func->JitCode != nullptr;
+	func->JitData = new FJitFunction;
+	if (func->Code == nullptr || func->CodeSize == 0) return false;
+
+#ifdef VM_JIT_X64
+	FJitCompiler compiler(func, func->JitData);
+	if (compiler.Compile())
+	{
+		TArray<uint8_t> &code = compiler.GetCode();
+		uint8_t *mem = AllocJitMemory(code.Size());
+		if (mem != nullptr)
+		{
+			memcpy(mem, &code[0], code.Size());
+			func->JitCode = (JitFuncPtr)mem;
+			JitFunctions++;
+			JitNativeOps += func->JitData->NativeOps;
+			JitTotalOps += func->CodeSize;
+			return true;
+		}
+	}
+#endif
+	JitFailures++;
+	return false;
+}
+
+//===========================================================================
+//
+// Differential testing: Pure functions are run by the JIT and then again by
+// the interpreter, starting from the same registers.
+//
+//===========================================================================
+
+struct FJitRegisterState
+{
+	TArray<int> D;
+	TArray<double> F;
+	TArray<FString> S;
+	TArray<void *> A;
+
+	void Save(const VMFrame *f)
+	{
+		VMRegisters reg(f);
+		D.Resize(f->NumRegD);
+		F.Resize(f->NumRegF);
+		S.Resize(f->NumRegS);
+		A.Resize(f->NumRegA);
+		if (f->NumRegD) memcpy(&D[0], reg.d, f->NumRegD * sizeof(int));
+		if (f->NumRegF) memcpy(&F[0], reg.f, f->NumRegF * sizeof(double));
+		if (f->NumRegA) memcpy(&A[0], reg.a, f->NumRegA * sizeof(void *));
+		for (int i = 0; i < f->NumRegS; i++) S[i] = reg.s[i];
+	}
+
+	void Restore(VMFrame *f) const
+	{
+		VMRegisters reg(f);
+		if (f->NumRegD) memcpy(reg.d, &D[0], f->NumRegD * sizeof(int));
+		if (f->NumRegF) memcpy(reg.f, &F[0], f->NumRegF * sizeof(double));
+		if (f->NumRegA) memcpy(reg.a, &A[0], f->NumRegA * sizeof(void *));
+		for (int i = 0; i < f->NumRegS; i++) reg.s[i] = S[i];
+	}
+};
+
+static int RunJit(JitContext &ctx)
+{
+	int numret = ctx.Func->JitCode(&ctx);
+	if (numret < 0)
+	{
+		std::rethrow_exception(ctx.Exception);
+	}
+	return numret;
+}
+
+static bool CompareReturn(const VMReturn &jit, const VMReturn &interp)
+{
+	switch (jit.RegType & REGT_TYPE)
+	{
+	case REGT_INT:
+		return *(int *)jit.Location == *(int *)interp.Location;
+	case REGT_FLOAT:
+		return !memcmp(jit.Location, interp.Location, sizeof(double) * ((jit.RegType & REGT_MULTIREG3) ? 3 : (jit.RegType & REGT_MULTIREG2) ? 2 : 1));
+	case REGT_STRING:
+		return *(FString *)jit.Location == *(FString *)interp.Location;
+	default:
+		return *(void **)jit.Location == *(void **)interp.Location;
+	}
+}
+
+static int VerifyJit(JitContext &ctx)
+{
+	VMFrame *f = ctx.Frame;
+	FJitRegisterState entry, jitstate, interpstate;
+	FString error;
+
+	entry.Save(f);
+	int jitret = RunJit(ctx);
+	jitstate.Save(f);
+	entry.Restore(f);
+
+	union FReturnValue
+	{
+		int i;
+		double f[3];
+		void *a;
+	} values[MAX_RETURNS];
+	FString strings[MAX_RETURNS];
+	VMReturn returns[MAX_RETURNS];
+	int numret = MIN(ctx.NumRet, MAX_RETURNS);
+	for (int i = 0; i < numret; i++)
+	{
+		returns[i].RegType = ctx.Ret[i].RegType;
+		returns[i].Location = (returns[i].RegType & REGT_TYPE) == REGT_STRING ? (void *)&strings[i] : (void *)&values[i];
+	}
+	int interpret = VMExec(ctx.Stack, ctx.Func->Code, returns, numret);
+	interpstate.Save(f);
+	JitVerifiedCalls++;
+
+	if (jitret != interpret)
+	{
+		error.Format("returned %d values instead of %d", jitret, interpret);
+	}
+	for (int i = 0; i < interpret && i < numret && error.IsEmpty(); i++)
+	{
+		if (!CompareReturn(ctx.Ret[i], returns[i])) error.Format("return value %d differs", i);
+	}
+	for (unsigned i = 0; i < jitstate.D.Size() && error.IsEmpty(); i++)
+	{
+		if (jitstate.D[i] != interpstate.D[i]) error.Format("d%u is %d instead of %d", i, jitstate.D[i], interpstate.D[i]);
+	}
+	for (unsigned i = 0; i < jitstate.F.Size() && error.IsEmpty(); i++)
+	{
+		if (memcmp(&jitstate.F[i], &interpstate.F[i], sizeof(double))) error.Format("f%u is %g instead of %g", i, jitstate.F[i], interpstate.F[i]);
+	}
+	for (unsigned i = 0; i < jitstate.A.Size() && error.IsEmpty(); i++)
+	{
+		if (jitstate.A[i] != interpstate.A[i]) error.Format("a%u is %p instead of %p", i, jitstate.A[i], interpstate.A[i]);
+	}
+	for (unsigned i = 0; i < jitstate.S.Size() && error.IsEmpty(); i++)
+	{
+		if (jitstate.S[i] != interpstate.S[i]) error.Format("s%u is \"%s\" instead of \"%s\"", i, jitstate.S[i].GetChars(), interpstate.S[i].GetChars());
+	}
+
+	if (error.IsNotEmpty())
+	{
+		// Keep using the interpreter for this function.
+		Printf(TEXTCOLOR_RED "JIT mismatch in %s: %s\n", ctx.Func->PrintableName.GetChars(), error.GetChars());
+		ctx.Func->JitCode = nullptr;
+		JitMismatches++;
+	}
+	return jitret;
+}
+
+//===========================================================================
+//
+// VMJitExec
+//
+// Runs a compiled function on the frame at the top of the stack.
+//
+//===========================================================================
+
+int VMJitExec(VMFrameStack *stack, VMScriptFunction *func, VMReturn *ret, int numret)
+{
+	JitContext ctx;
+	ctx.Frame = stack->TopFrame();
+	VMRegisters reg(ctx.Frame);
+	ctx.D = reg.d;
+	ctx.F = reg.f;
+	ctx.S = reg.s;
+	ctx.A = reg.a;
+	ctx.Param = reg.param;
+	ctx.Extra = func->ExtraSpace > 0 ? ctx.Frame->GetExtra() : nullptr;
+	ctx.Stack = stack;
+	ctx.Func = func;
+	ctx.Ret = ret;
+	ctx.NumRet = numret;
+
+	if (vm_jitverify && func->JitData->Pure)
+	{
+		return VerifyJit(ctx);
+	}
+	return RunJit(ctx);
+}
+
+ADD_STAT(vmjit)
+{
+	FString out;
+	out.Format("%d functions compiled, %d failed, %d of %d instructions native\n"
+		"%d direct native calls, %d verified calls, %d mismatches",
+		JitFunctions.load(), JitFailures.load(), JitNativeOps.load(), JitTotalOps.load(), JitDirectCalls.load(), JitVerifiedCalls, JitMismatches);
+	return out;
+}
@@ -44,6 +44,7 @@
 #include "version.h"
 #include "zcc_parser.h"
 #include "zcc_compile.h"
+#include "backend/codecache.h"
 
 TArray<FString> Includes;
 TArray<FScriptPosition> IncludeLocs;
@@ -263,6 +264,7 @@ static void ParseSingleFile(FScanner *pSC, const char *filename, int lump, void
 	}
 	FScanner &sc = *pSC;
 	sc.SetParseVersion(state.ParseVersion);
+	ScriptCodeCache.AddSource(sc.LumpNum);
 	state.sc = &sc;
 
 	while (sc.GetToken())
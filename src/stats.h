@@ -192,6 +192,18 @@ private:
 
 #endif
 
+// Clocks a counter for as long as it is in scope, for functions with
+// too many exits to unclock by hand.
+class FCycleScope
+{
+public:
+	FCycleScope(cycle_t &cycles) : Cycles(cycles) { Cycles.Clock(); }
+	~FCycleScope() { Cycles.Unclock(); }
+
+private:
+	cycle_t &Cycles;
+};
+
 class FStat
 {
 public:
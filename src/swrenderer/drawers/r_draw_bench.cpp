@@ -0,0 +1,488 @@
+/*
+** r_draw_bench.cpp
+** Compares and times the SSE2 and AVX2 truecolor drawers
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stddef.h>
+
+#include "templates.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "c_dispatch.h"
+#include "v_video.h"
+#include "v_text.h"
+#include "r_data/colormaps.h"
+#include "swrenderer/r_swcolormaps.h"
+#include "stats.h"
+#include "x86.h"
+#include "r_draw_rgba.h"
+#include "swrenderer/viewport/r_viewport.h"
+#include "swrenderer/scene/r_light.h"
+#ifndef NO_SSE
+#include "r_draw_wall32_avx2.h"
+#include "r_draw_sprite32_avx2.h"
+#include "r_draw_span32_avx2.h"
+#include "r_draw_sky32_avx2.h"
+#endif
+
+#ifndef NO_SSE
+
+namespace swrenderer
+{
+	// Runs every drawer the AVX2 tier replaces on the same synthetic jobs
+	// with both the SSE2 and the AVX2 version. The output of the two has to
+	// match pixel for pixel, both with one and several drawer threads.
+	class DrawerBenchmark
+	{
+	public:
+		DrawerBenchmark(int iterations);
+		~DrawerBenchmark();
+
+		int Run();
+
+	private:
+		enum
+		{
+			CanvasWidth = 640,
+			CanvasHeight = 480,
+			TextureSize = 256,
+			NumJobs = 512
+		};
+
+		uint32_t Random();
+		void FillCanvas();
+		uint8_t *Dest(int x, int y);
+
+		void MakeJobs(TArray<WallDrawerArgs> &jobs);
+		void MakeJobs(TArray<SpanDrawerArgs> &jobs);
+		void MakeJobs(TArray<SpriteDrawerArgs> &jobs, bool translated, bool shaded);
+		void MakeJobs(TArray<SkyDrawerArgs> &jobs, bool doublesky);
+
+		static int PixelCount(const WallDrawerArgs &args) { return args.Count(); }
+		static int PixelCount(const SpanDrawerArgs &args) { return args.DestX2() - args.DestX1() + 1; }
+		static int PixelCount(const SpriteDrawerArgs &args) { return args.Count(); }
+		static int PixelCount(const SkyDrawerArgs &args) { return args.Count(); }
+
+		template<typename CommandT, typename ArgsT>
+		void Execute(const TArray<ArgsT> &jobs, int num_cores);
+
+		template<typename CommandT, typename ArgsT>
+		int Test(const char *name, const TArray<ArgsT> &jobs);
+
+		int Iterations;
+		uint32_t Seed = 1;
+
+		DSimpleCanvas *Canvas;
+		RenderViewport Viewport;
+		DrawerThread Thread;
+		TArray<uint32_t> Reference;
+
+		TArray<uint32_t> Textures[2];
+		TArray<uint32_t> SpanTextures[2];
+		uint32_t Translation[256];
+		uint8_t ShadeMap[256];
+		FSWColormap SimpleColormap;
+		FSWColormap AdvancedColormap;
+		DrawerLight Lights[2];
+	};
+
+	DrawerBenchmark::DrawerBenchmark(int iterations) : Iterations(iterations)
+	{
+		Canvas = new DSimpleCanvas(CanvasWidth, CanvasHeight, true);
+		Canvas->Lock();
+		Viewport.RenderTarget = Canvas;
+		Reference.Resize(Canvas->GetPitch() * CanvasHeight);
+
+		// Textures with varied alpha and some fully transparent pixels so that
+		// the masked and translucent paths are all taken.
+		for (auto &texture : Textures)
+		{
+			texture.Resize(TextureSize * TextureSize);
+			for (auto &pixel : texture)
+			{
+				uint32_t color = Random();
+				pixel = (color & 15) == 0 ? 0 : color;
+			}
+		}
+
+		// 64x64 hits the dedicated span loop, 128x128 the generic one
+		SpanTextures[0].Resize(64 * 64);
+		SpanTextures[1].Resize(128 * 128);
+		for (auto &texture : SpanTextures)
+		{
+			for (auto &pixel : texture)
+			{
+				uint32_t color = Random();
+				pixel = (color & 15) == 0 ? 0 : color;
+			}
+		}
+
+		for (auto &color : Translation)
+			color = Random() | 0xff000000;
+		for (auto &shade : ShadeMap)
+			shade = Random() % 80;
+
+		SimpleColormap.Maps = ShadeMap;
+		SimpleColormap.Color = 0x00ffffff;
+		SimpleColormap.Fade = 0;
+		SimpleColormap.Desaturate = 0;
+
+		AdvancedColormap.Maps = ShadeMap;
+		AdvancedColormap.Color = PalEntry(255, 200, 170, 120);
+		AdvancedColormap.Fade = PalEntry(255, 20, 40, 60);
+		AdvancedColormap.Desaturate = 96;
+
+		Lights[0] = { 0xffff8040, 4096.0f, 0.0f, 24.0f, 256.0f / 160.0f };
+		Lights[1] = { 0xff4080ff, 9000.0f, 0.0f, -40.0f, 256.0f / 240.0f };
+	}
+
+	DrawerBenchmark::~DrawerBenchmark()
+	{
+		Canvas->Unlock();
+		delete Canvas;
+	}
+
+	uint32_t DrawerBenchmark::Random()
+	{
+		Seed = Seed * 1664525 + 1013904223;
+		return (Seed >> 16) | (Seed << 16);
+	}
+
+	void DrawerBenchmark::FillCanvas()
+	{
+		uint32_t *pixels = (uint32_t *)Canvas->GetBuffer();
+		int count = Canvas->GetPitch() * CanvasHeight;
+		for (int i = 0; i < count; i++)
+			pixels[i] = (i * 2654435761u) ^ 0x5a5a5a5a;
+	}
+
+	uint8_t *DrawerBenchmark::Dest(int x, int y)
+	{
+		return Canvas->GetBuffer() + (x + y * Canvas->GetPitch()) * 4;
+	}
+
+	void DrawerBenchmark::MakeJobs(TArray<WallDrawerArgs> &jobs)
+	{
+		for (int i = 0; i < NumJobs; i++)
+		{
+			WallDrawerArgs args;
+			args.SetLight(i & 1 ? &AdvancedColormap : &SimpleColormap, 0, (Random() % 32) << FRACBITS);
+			args.dc_viewport = &Viewport;
+
+			// Include counts 1-7 to cover all the tail cases
+			int y = Random() % 64;
+			args.dc_dest = Dest(Random() % CanvasWidth, y);
+			args.dc_dest_y = y;
+			args.dc_count = i < 64 ? 1 + (i & 7) : 1 + Random() % (CanvasHeight - y);
+			args.dc_textureheight = 64 << (Random() % 3);
+			args.dc_source = (const uint8_t *)&Textures[0][0];
+			args.dc_source2 = i & 2 ? (const uint8_t *)&Textures[1][0] : nullptr;
+			args.dc_texturefrac = Random();
+			args.dc_iscale = Random() >> 8;
+			args.dc_texturefracx = Random() & 15;
+			args.dc_srcalpha = Random() % (FRACUNIT + 1);
+			args.dc_destalpha = FRACUNIT - args.dc_srcalpha;
+			if (i & 4)
+			{
+				args.dc_lights = Lights;
+				args.dc_num_lights = 2;
+				args.dc_viewpos = { 0.0f, 0.0f, (float)(int)(Random() % 128) - 64.0f };
+				args.dc_viewpos_step = { 0.0f, 0.0f, 0.25f };
+			}
+			jobs.Push(args);
+		}
+	}
+
+	void DrawerBenchmark::MakeJobs(TArray<SpanDrawerArgs> &jobs)
+	{
+		for (int i = 0; i < NumJobs; i++)
+		{
+			SpanDrawerArgs args;
+			args.SetLight(i & 1 ? &AdvancedColormap : &SimpleColormap, 0, (Random() % 32) << FRACBITS);
+			args.ds_viewport = &Viewport;
+
+			const TArray<uint32_t> &texture = SpanTextures[(i >> 1) & 1];
+			int size = texture.Size() == 64 * 64 ? 64 : 128;
+			args.ds_source = (const uint8_t *)&texture[0];
+			args.ds_source_mipmapped = false;
+			args.ds_texwidth = size;
+			args.ds_texheight = size;
+			args.ds_xbits = size == 64 ? 6 : 7;
+			args.ds_ybits = args.ds_xbits;
+
+			// Negative LOD magnifies (nearest), positive minifies (linear)
+			args.ds_lod = i & 4 ? 1.0 : -1.0;
+
+			int x1 = Random() % CanvasWidth;
+			int count = i < 64 ? 1 + (i & 7) : 1 + Random() % (CanvasWidth - x1);
+			args.ds_y = Random() % CanvasHeight;
+			args.ds_x1 = x1;
+			args.ds_x2 = MIN(x1 + count, (int)CanvasWidth) - 1;
+			args.ds_xfrac = Random();
+			args.ds_yfrac = Random();
+			args.ds_xstep = Random() >> 6;
+			args.ds_ystep = Random() >> 6;
+			args.dc_srcblend = nullptr;
+			args.dc_destblend = nullptr;
+			args.dc_srcalpha = Random() % (FRACUNIT + 1);
+			args.dc_destalpha = FRACUNIT - args.dc_srcalpha;
+			if (i & 8)
+			{
+				args.dc_lights = Lights;
+				args.dc_num_lights = 2;
+				args.dc_normal = { 0.0f, 0.0f, 1.0f };
+				args.dc_viewpos = { (float)(int)(Random() % 128) - 64.0f, 32.0f, -16.0f };
+				args.dc_viewpos_step = { 0.5f, 0.0f, 0.0f };
+			}
+			else
+			{
+				args.dc_normal = { 0.0f, 0.0f, 0.0f };
+				args.dc_viewpos = { 0.0f, 0.0f, 0.0f };
+				args.dc_viewpos_step = { 0.0f, 0.0f, 0.0f };
+			}
+			jobs.Push(args);
+		}
+	}
+
+	void DrawerBenchmark::MakeJobs(TArray<SpriteDrawerArgs> &jobs, bool translated, bool shaded)
+	{
+		for (int i = 0; i < NumJobs; i++)
+		{
+			SpriteDrawerArgs args;
+			args.SetLight(i & 1 ? &AdvancedColormap : &SimpleColormap, 0, (Random() % 32) << FRACBITS);
+			if (translated)
+				args.SetTranslationMap((lighttable_t *)Translation);
+			args.dc_viewport = &Viewport;
+
+			int y = Random() % 64;
+			args.dc_dest = Dest(Random() % CanvasWidth, y);
+			args.dc_dest_y = y;
+			args.dc_count = i < 64 ? 1 + (i & 7) : 1 + Random() % (CanvasHeight - y);
+			args.dc_textureheight = 64 << (Random() % 3);
+			args.dc_source = (const uint8_t *)&Textures[0][0];
+			args.dc_source2 = (i & 2) && !translated && !shaded ? (const uint8_t *)&Textures[1][0] : nullptr;
+			args.dc_texturefrac = Random() >> 2;
+			args.dc_iscale = Random() >> 10;
+			args.dc_texturefracx = Random() & 15;
+			args.dc_srcalpha = Random() % (FRACUNIT + 1);
+			args.dc_destalpha = FRACUNIT - args.dc_srcalpha;
+			args.dc_color = Random() & 255;
+			args.dc_color_bgra = Random() | 0xff000000;
+			args.dc_srccolor = args.dc_color;
+			args.dc_srccolor_bgra = Random() | 0xff000000;
+			args.dynlightcolor = i & 4 ? Random() & 0x007f7f7f : 0;
+			jobs.Push(args);
+		}
+	}
+
+	void DrawerBenchmark::MakeJobs(TArray<SkyDrawerArgs> &jobs, bool doublesky)
+	{
+		for (int i = 0; i < NumJobs; i++)
+		{
+			SkyDrawerArgs args;
+			args.dc_viewport = &Viewport;
+
+			// Steps sized so that the columns cross all five bands
+			int y = Random() % 16;
+			args.dc_dest = Dest(Random() % CanvasWidth, y);
+			args.dc_dest_y = y;
+			args.dc_count = i < 64 ? 1 + (i & 7) : CanvasHeight - y;
+			args.dc_source = (const uint8_t *)&Textures[0][0];
+			args.dc_source2 = doublesky ? (const uint8_t *)&Textures[1][0] : nullptr;
+			args.dc_sourceheight = TextureSize;
+			args.dc_sourceheight2 = TextureSize;
+			args.dc_iscale = (2 << 24) / (200 + Random() % 400);
+			args.dc_texturefrac = (uint32_t)(-(int)(Random() % 64) * (int)args.dc_iscale);
+			args.solid_top = Random() | 0xff000000;
+			args.solid_bottom = Random() | 0xff000000;
+			args.fadeSky = (i & 1) == 0;
+			jobs.Push(args);
+		}
+	}
+
+	template<typename CommandT, typename ArgsT>
+	void DrawerBenchmark::Execute(const TArray<ArgsT> &jobs, int num_cores)
+	{
+		Thread.num_cores = num_cores;
+		for (int core = 0; core < num_cores; core++)
+		{
+			Thread.core = core;
+			for (const ArgsT &args : jobs)
+			{
+				CommandT command(args);
+				command.Execute(&Thread);
+			}
+		}
+	}
+
+	template<typename CommandT, typename ArgsT>
+	int DrawerBenchmark::Test(const char *name, const TArray<ArgsT> &jobs)
+	{
+		typedef typename AVX2Drawer<CommandT>::Type AVX2CommandT;
+
+		uint32_t *pixels = (uint32_t *)Canvas->GetBuffer();
+		int size = Canvas->GetPitch() * CanvasHeight;
+		int mismatches = 0;
+
+		static const int core_counts[] = { 1, 3 };
+		for (int num_cores : core_counts)
+		{
+			FillCanvas();
+			Execute<CommandT>(jobs, num_cores);
+			memcpy(&Reference[0], pixels, size * sizeof(uint32_t));
+
+			FillCanvas();
+			Execute<AVX2CommandT>(jobs, num_cores);
+			for (int i = 0; i < size; i++)
+			{
+				if (pixels[i] != Reference[i])
+					mismatches++;
+			}
+		}
+
+		double pixelcount = 0.0;
+		for (const ArgsT &args : jobs)
+			pixelcount += PixelCount(args);
+		pixelcount *= Iterations;
+
+		cycle_t sse2, avx2;
+		sse2.Reset();
+		avx2.Reset();
+		sse2.Clock();
+		for (int i = 0; i < Iterations; i++)
+			Execute<CommandT>(jobs, 1);
+		sse2.Unclock();
+		avx2.Clock();
+		for (int i = 0; i < Iterations; i++)
+			Execute<AVX2CommandT>(jobs, 1);
+		avx2.Unclock();
+
+		double sse2rate = pixelcount / MAX(sse2.TimeMS(), 0.001) / 1000.0;
+		double avx2rate = pixelcount / MAX(avx2.TimeMS(), 0.001) / 1000.0;
+		Printf("%-36s SSE2 %8.1f MPix/s  AVX2 %8.1f MPix/s  %5.2fx%s\n", name, sse2rate, avx2rate, avx2rate / sse2rate,
+			mismatches != 0 ? TEXTCOLOR_RED "  MISMATCH" : "");
+		if (mismatches != 0)
+			Printf("%d pixels differ\n", mismatches);
+		return mismatches != 0 ? 1 : 0;
+	}
+
+	int DrawerBenchmark::Run()
+	{
+		// GetDest adds the view window offset
+		int savedx = viewwindowx;
+		int savedy = viewwindowy;
+		viewwindowx = 0;
+		viewwindowy = 0;
+
+		int failed = 0;
+
+		TArray<WallDrawerArgs> walls;
+		MakeJobs(walls);
+		failed += Test<DrawWall32Command>("DrawWall32Command", walls);
+		failed += Test<DrawWallMasked32Command>("DrawWallMasked32Command", walls);
+		failed += Test<DrawWallAddClamp32Command>("DrawWallAddClamp32Command", walls);
+		failed += Test<DrawWallSubClamp32Command>("DrawWallSubClamp32Command", walls);
+		failed += Test<DrawWallRevSubClamp32Command>("DrawWallRevSubClamp32Command", walls);
+
+		TArray<SpanDrawerArgs> spans;
+		MakeJobs(spans);
+		failed += Test<DrawSpan32Command>("DrawSpan32Command", spans);
+		failed += Test<DrawSpanMasked32Command>("DrawSpanMasked32Command", spans);
+		failed += Test<DrawSpanTranslucent32Command>("DrawSpanTranslucent32Command", spans);
+		failed += Test<DrawSpanAddClamp32Command>("DrawSpanAddClamp32Command", spans);
+		failed += Test<DrawSpanSubClamp32Command>("DrawSpanSubClamp32Command", spans);
+		failed += Test<DrawSpanRevSubClamp32Command>("DrawSpanRevSubClamp32Command", spans);
+
+		TArray<SpriteDrawerArgs> sprites, translated, shaded;
+		MakeJobs(sprites, false, false);
+		MakeJobs(translated, true, false);
+		MakeJobs(shaded, false, true);
+		failed += Test<DrawSprite32Command>("DrawSprite32Command", sprites);
+		failed += Test<DrawSpriteAddClamp32Command>("DrawSpriteAddClamp32Command", sprites);
+		failed += Test<DrawSpriteSubClamp32Command>("DrawSpriteSubClamp32Command", sprites);
+		failed += Test<DrawSpriteRevSubClamp32Command>("DrawSpriteRevSubClamp32Command", sprites);
+		failed += Test<FillSprite32Command>("FillSprite32Command", sprites);
+		failed += Test<FillSpriteAddClamp32Command>("FillSpriteAddClamp32Command", sprites);
+		failed += Test<FillSpriteSubClamp32Command>("FillSpriteSubClamp32Command", sprites);
+		failed += Test<FillSpriteRevSubClamp32Command>("FillSpriteRevSubClamp32Command", sprites);
+		failed += Test<DrawSpriteShaded32Command>("DrawSpriteShaded32Command", shaded);
+		failed += Test<DrawSpriteAddClampShaded32Command>("DrawSpriteAddClampShaded32Command", shaded);
+		failed += Test<DrawSpriteTranslated32Command>("DrawSpriteTranslated32Command", translated);
+		failed += Test<DrawSpriteTranslatedAddClamp32Command>("DrawSpriteTranslatedAddClamp32Command", translated);
+		failed += Test<DrawSpriteTranslatedSubClamp32Command>("DrawSpriteTranslatedSubClamp32Command", translated);
+		failed += Test<DrawSpriteTranslatedRevSubClamp32Command>("DrawSpriteTranslatedRevSubClamp32Command", translated);
+
+		TArray<SkyDrawerArgs> singlesky, doublesky;
+		MakeJobs(singlesky, false);
+		MakeJobs(doublesky, true);
+		failed += Test<DrawSkySingle32Command>("DrawSkySingle32Command", singlesky);
+		failed += Test<DrawSkyDouble32Command>("DrawSkyDouble32Command", doublesky);
+
+		viewwindowx = savedx;
+		viewwindowy = savedy;
+		return failed;
+	}
+}
+
+#endif
+
+//==========================================================================
+//
+// CCMD drawerbench
+//
+// Checks that the AVX2 truecolor drawers produce exactly the same output
+// as the SSE2 ones and prints the fill rate of both.
+//
+//==========================================================================
+
+CCMD (drawerbench)
+{
+#ifndef NO_SSE
+	if (!CPU.bAVX2)
+	{
+		Printf ("This CPU does not support AVX2\n");
+		return;
+	}
+	int iterations = argv.argc() > 1 ? MAX(atoi(argv[1]), 1) : 20;
+
+	auto bench = new swrenderer::DrawerBenchmark(iterations);
+	int failed = bench->Run();
+	delete bench;
+
+	if (failed != 0)
+		Printf (TEXTCOLOR_RED "%d drawers do not match the SSE2 output\n", failed);
+	else
+		Printf ("All drawers match the SSE2 output\n");
+#else
+	Printf ("The AVX2 drawers are not available in this build\n");
+#endif
+}
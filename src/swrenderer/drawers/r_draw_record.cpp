@@ -0,0 +1,1148 @@
+/*
+** r_draw_record.cpp
+** Records the drawer calls of a frame and replays them as a benchmark
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stddef.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "templates.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "c_dispatch.h"
+#include "files.h"
+#include "r_state.h"
+#include "v_video.h"
+#include "v_text.h"
+#include "stats.h"
+#include "x86.h"
+#include "r_data/colormaps.h"
+#include "swrenderer/r_swcolormaps.h"
+#include "swrenderer/r_memory.h"
+#include "swrenderer/scene/r_light.h"
+#include "swrenderer/viewport/r_viewport.h"
+#include "r_draw_record.h"
+#include "r_draw_rgba.h"
+#include "r_draw_pal.h"
+#include "r_thread.h"
+
+EXTERN_CVAR(Bool, r_avx2drawers)
+
+namespace swrenderer
+{
+	typedef void(SWPixelFormatDrawers::*WallDrawerFunc)(const WallDrawerArgs &args);
+	typedef void(SWPixelFormatDrawers::*SkyDrawerFunc)(const SkyDrawerArgs &args);
+	typedef void(SWPixelFormatDrawers::*SpriteDrawerFunc)(const SpriteDrawerArgs &args);
+	typedef void(SWPixelFormatDrawers::*SpanDrawerFunc)(const SpanDrawerArgs &args);
+
+	// The recorded calls refer to the drawers by their index in these tables.
+	// The drawers reading a texture are listed before those that do not.
+
+	static const WallDrawerFunc WallDrawers[] =
+	{
+		&SWPixelFormatDrawers::DrawWallColumn,
+		&SWPixelFormatDrawers::DrawWallMaskedColumn,
+		&SWPixelFormatDrawers::DrawWallAddColumn,
+		&SWPixelFormatDrawers::DrawWallAddClampColumn,
+		&SWPixelFormatDrawers::DrawWallSubClampColumn,
+		&SWPixelFormatDrawers::DrawWallRevSubClampColumn
+	};
+
+	static const SkyDrawerFunc SkyDrawers[] =
+	{
+		&SWPixelFormatDrawers::DrawSingleSkyColumn,
+		&SWPixelFormatDrawers::DrawDoubleSkyColumn
+	};
+
+	static const SpriteDrawerFunc SpriteDrawers[] =
+	{
+		&SWPixelFormatDrawers::DrawColumn,
+		&SWPixelFormatDrawers::DrawAddColumn,
+		&SWPixelFormatDrawers::DrawTranslatedColumn,
+		&SWPixelFormatDrawers::DrawTranslatedAddColumn,
+		&SWPixelFormatDrawers::DrawShadedColumn,
+		&SWPixelFormatDrawers::DrawAddClampShadedColumn,
+		&SWPixelFormatDrawers::DrawAddClampColumn,
+		&SWPixelFormatDrawers::DrawAddClampTranslatedColumn,
+		&SWPixelFormatDrawers::DrawSubClampColumn,
+		&SWPixelFormatDrawers::DrawSubClampTranslatedColumn,
+		&SWPixelFormatDrawers::DrawRevSubClampColumn,
+		&SWPixelFormatDrawers::DrawRevSubClampTranslatedColumn,
+		&SWPixelFormatDrawers::FillColumn,
+		&SWPixelFormatDrawers::FillAddColumn,
+		&SWPixelFormatDrawers::FillAddClampColumn,
+		&SWPixelFormatDrawers::FillSubClampColumn,
+		&SWPixelFormatDrawers::FillRevSubClampColumn,
+		&SWPixelFormatDrawers::DrawFuzzColumn
+	};
+
+	static const SpanDrawerFunc SpanDrawers[] =
+	{
+		&SWPixelFormatDrawers::DrawSpan,
+		&SWPixelFormatDrawers::DrawSpanMasked,
+		&SWPixelFormatDrawers::DrawSpanTranslucent,
+		&SWPixelFormatDrawers::DrawSpanMaskedTranslucent,
+		&SWPixelFormatDrawers::DrawSpanAddClamp,
+		&SWPixelFormatDrawers::DrawSpanMaskedAddClamp,
+		&SWPixelFormatDrawers::FillSpan,
+		&SWPixelFormatDrawers::DrawColoredSpan,
+		&SWPixelFormatDrawers::DrawFogBoundaryLine
+	};
+
+	enum
+	{
+		NumTexturedSpriteDrawers = 12,
+		NumTexturedSpanDrawers = 6,
+		DoubleSkyDrawer = 1
+	};
+
+	enum RecordedCallType : uint8_t
+	{
+		RecordedWall,
+		RecordedSky,
+		RecordedSprite,
+		RecordedSpan,
+		RecordedTiltedSpan
+	};
+
+	struct RecordingHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		int32_t Bgra;
+		int32_t Width;
+		int32_t Height;
+		int32_t Pitch;
+		int32_t ViewWindowX;
+		int32_t ViewWindowY;
+		int32_t CenterX;
+		int32_t CenterY;
+		int32_t FuzzViewHeight;
+		int32_t NumCalls;
+		int32_t SkippedCalls;
+		uint32_t BlobsSize;
+		uint32_t NumColormaps;
+		uint32_t CallsSize;
+	};
+
+	static const uint32_t RecordingMagic = MAKE_ID('S', 'W', 'D', 'R');
+	static const uint32_t RecordingVersion = 1;
+	static const uint32_t NoData = 0xffffffff;
+
+	template<typename FuncT, size_t N>
+	static int FindDrawer(const FuncT (&drawers)[N], FuncT func)
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			if (drawers[i] == func)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	static int FindDrawer(const WallDrawerArgs &, WallDrawerFunc func) { return FindDrawer(WallDrawers, func); }
+	static int FindDrawer(const SkyDrawerArgs &, SkyDrawerFunc func) { return FindDrawer(SkyDrawers, func); }
+	static int FindDrawer(const SpriteDrawerArgs &, SpriteDrawerFunc func) { return FindDrawer(SpriteDrawers, func); }
+	static int FindDrawer(const SpanDrawerArgs &, SpanDrawerFunc func) { return FindDrawer(SpanDrawers, func); }
+
+	static RecordedCallType CallType(const WallDrawerArgs &) { return RecordedWall; }
+	static RecordedCallType CallType(const SkyDrawerArgs &) { return RecordedSky; }
+	static RecordedCallType CallType(const SpriteDrawerArgs &) { return RecordedSprite; }
+	static RecordedCallType CallType(const SpanDrawerArgs &) { return RecordedSpan; }
+
+	/////////////////////////////////////////////////////////////////////////////
+
+	// Writes the drawer args to the call stream of a recording or reads them
+	// back. The same code is used in both directions so the two stay in sync.
+	// Pointers are written as offsets into the blob of the recording, the
+	// destination as an offset into the render target.
+	class DrawerStream
+	{
+	public:
+		DrawerStream(DrawerRecording *recording, RenderViewport *viewport = nullptr) : Recording(recording), ReplayViewport(viewport), Loading(viewport != nullptr) { }
+
+		bool AtEnd() const { return Pos >= Recording->Calls.Size(); }
+		bool Failed() const { return Error; }
+
+		template<typename T>
+		void Value(T &value)
+		{
+			if (Loading)
+			{
+				if (Pos + sizeof(T) > Recording->Calls.Size())
+				{
+					Error = true;
+					memset(&value, 0, sizeof(T));
+					return;
+				}
+				memcpy(&value, &Recording->Calls[Pos], sizeof(T));
+				Pos += sizeof(T);
+			}
+			else
+			{
+				unsigned int pos = Recording->Calls.Reserve(sizeof(T));
+				memcpy(&Recording->Calls[pos], &value, sizeof(T));
+			}
+		}
+
+		template<typename T>
+		void Data(T *&data, size_t size)
+		{
+			uint32_t offset = NoData;
+			if (!Loading && data != nullptr && size != 0)
+				offset = Recording->AddBlob(data, size);
+			Value(offset);
+			if (Loading)
+			{
+				if (offset != NoData && offset >= Recording->Blobs.Size())
+					Error = true;
+				data = (offset != NoData && !Error) ? (T *)&Recording->Blobs[offset] : nullptr;
+			}
+		}
+
+		// The blend tables are global, so they are written as the row of the table they point to
+		void BlendTable(uint32_t *&table)
+		{
+			int32_t row = -1;
+			if (!Loading && table != nullptr)
+			{
+				for (int i = 0; i < 65 && row == -1; i++)
+				{
+					if (table == Col2RGB8[i])
+						row = i;
+					else if (table == Col2RGB8_LessPrecision[i])
+						row = 65 + i;
+					else if (table == Col2RGB8_Inverse[i])
+						row = 130 + i;
+				}
+			}
+			Value(row);
+			if (Loading)
+			{
+				if (row < 0 || row >= 195)
+					table = nullptr;
+				else if (row < 65)
+					table = Col2RGB8[row];
+				else if (row < 130)
+					table = Col2RGB8_LessPrecision[row - 65];
+				else
+					table = Col2RGB8_Inverse[row - 130];
+			}
+		}
+
+		void Colormap(FSWColormap *&colormap, uint32_t mapsSize)
+		{
+			int32_t index = -1;
+			if (!Loading && colormap != nullptr)
+				index = Recording->AddColormap(colormap, mapsSize);
+			Value(index);
+			if (Loading)
+			{
+				if (index >= (int)Recording->LoadedColormaps.Size())
+					Error = true;
+				colormap = (index >= 0 && !Error) ? &Recording->LoadedColormaps[index] : nullptr;
+			}
+		}
+
+		void Viewport(RenderViewport *&viewport)
+		{
+			if (Loading)
+				viewport = ReplayViewport;
+		}
+
+		void Dest(uint8_t *&dest, RenderViewport *viewport)
+		{
+			DCanvas *target = viewport->RenderTarget;
+			int size = target->GetPitch() * target->GetHeight() * (target->IsBgra() ? 4 : 1);
+			int32_t offset = -1;
+			if (!Loading && dest >= target->GetBuffer() && dest < target->GetBuffer() + size)
+				offset = (int32_t)(dest - target->GetBuffer());
+			Value(offset);
+			if (Loading)
+			{
+				if (offset >= size)
+					Error = true;
+				dest = (offset >= 0 && !Error) ? target->GetBuffer() + offset : nullptr;
+			}
+		}
+
+		void Serialize(DrawerArgs &args, uint32_t translationSize)
+		{
+			// The palette drawers use the light level picked by the args, the
+			// truecolor ones only the first table for the palette input
+			uint32_t mapsSize = 256;
+			if (!Loading && !Recording->Bgra && args.mBaseColormap != nullptr)
+				mapsSize = (GETPALOOKUP(args.mLight, args.mShade) + 1) << COLORMAPSHIFT;
+
+			Colormap(args.mBaseColormap, mapsSize);
+			Value(args.mLight);
+			Value(args.mShade);
+			Data(args.mTranslation, translationSize);
+		}
+
+		void Serialize(WallDrawerArgs &args, int drawer)
+		{
+			int pixelsize = Recording->Bgra ? 4 : 1;
+			Serialize(static_cast<DrawerArgs &>(args), 256 * pixelsize);
+			Viewport(args.dc_viewport);
+			Dest(args.dc_dest, args.dc_viewport);
+			Value(args.dc_dest_y);
+			Value(args.dc_count);
+			Value(args.dc_iscale);
+			Value(args.dc_texturefrac);
+			Value(args.dc_texturefracx);
+			Value(args.dc_textureheight);
+			Data(args.dc_source, args.dc_textureheight * pixelsize);
+			Data(args.dc_source2, args.dc_textureheight * pixelsize);
+			Value(args.dc_wall_fracbits);
+			BlendTable(args.dc_srcblend);
+			BlendTable(args.dc_destblend);
+			Value(args.dc_srcalpha);
+			Value(args.dc_destalpha);
+			Value(args.dc_normal);
+			Value(args.dc_viewpos);
+			Value(args.dc_viewpos_step);
+			Value(args.dc_num_lights);
+			Data(args.dc_lights, args.dc_num_lights * sizeof(DrawerLight));
+		}
+
+		void Serialize(SkyDrawerArgs &args, int drawer)
+		{
+			int pixelsize = Recording->Bgra ? 4 : 1;
+			if (!Loading && drawer != DoubleSkyDrawer)
+				args.dc_source2 = nullptr;
+
+			Serialize(static_cast<DrawerArgs &>(args), 256 * pixelsize);
+			Viewport(args.dc_viewport);
+			Dest(args.dc_dest, args.dc_viewport);
+			Value(args.dc_dest_y);
+			Value(args.dc_count);
+			Value(args.dc_sourceheight);
+			Value(args.dc_sourceheight2);
+			Data(args.dc_source, args.dc_sourceheight * pixelsize);
+			Data(args.dc_source2, args.dc_sourceheight2 * pixelsize);
+			Value(args.dc_texturefrac);
+			Value(args.dc_iscale);
+			Value(args.solid_top);
+			Value(args.solid_bottom);
+			Value(args.fadeSky);
+		}
+
+		void Serialize(SpriteDrawerArgs &args, int drawer)
+		{
+			Value(args.drawer_needs_pal_input);
+			int pixelsize = Recording->Bgra && !args.drawer_needs_pal_input ? 4 : 1;
+			if (!Loading && drawer >= NumTexturedSpriteDrawers)
+			{
+				args.dc_source = nullptr;
+				args.dc_source2 = nullptr;
+			}
+
+			Serialize(static_cast<DrawerArgs &>(args), 256 * pixelsize);
+			Viewport(args.dc_viewport);
+			Dest(args.dc_dest, args.dc_viewport);
+			Value(args.dc_dest_y);
+			Value(args.dc_count);
+			Value(args.dc_iscale);
+			Value(args.dc_texturefrac);
+			Value(args.dc_texturefracx);
+			Value(args.dc_textureheight);
+			Data(args.dc_source, args.dc_textureheight * pixelsize);
+			Data(args.dc_source2, args.dc_textureheight * pixelsize);
+			BlendTable(args.dc_srcblend);
+			BlendTable(args.dc_destblend);
+			Value(args.dc_srcalpha);
+			Value(args.dc_destalpha);
+			Value(args.dc_x);
+			Value(args.dc_yl);
+			Value(args.dc_yh);
+			Value(args.dc_color);
+			Value(args.dc_color_bgra);
+			Value(args.dc_srccolor);
+			Value(args.dc_srccolor_bgra);
+			Value(args.dynlightcolor);
+		}
+
+		void Serialize(SpanDrawerArgs &args, int drawer)
+		{
+			int pixelsize = Recording->Bgra ? 4 : 1;
+			if (!Loading && drawer >= NumTexturedSpanDrawers)
+				args.ds_source = nullptr;
+
+			Serialize(static_cast<DrawerArgs &>(args), 256 * pixelsize);
+			Viewport(args.ds_viewport);
+			Value(args.ds_y);
+			Value(args.ds_x1);
+			Value(args.ds_x2);
+			Value(args.ds_texwidth);
+			Value(args.ds_texheight);
+			Value(args.ds_xbits);
+			Value(args.ds_ybits);
+			Value(args.ds_source_mipmapped);
+			Data(args.ds_source, SpanTextureSize(args) * pixelsize);
+			Value(args.ds_xfrac);
+			Value(args.ds_yfrac);
+			Value(args.ds_xstep);
+			Value(args.ds_ystep);
+			BlendTable(args.dc_srcblend);
+			BlendTable(args.dc_destblend);
+			Value(args.dc_srcalpha);
+			Value(args.dc_destalpha);
+			Value(args.ds_color);
+			Value(args.ds_lod);
+			Value(args.dc_normal);
+			Value(args.dc_viewpos);
+			Value(args.dc_viewpos_step);
+			Value(args.dc_num_lights);
+			Data(args.dc_lights, args.dc_num_lights * sizeof(DrawerLight));
+		}
+
+	private:
+		// The truecolor span drawers can use the mipmap levels stored after the texture
+		size_t SpanTextureSize(const SpanDrawerArgs &args)
+		{
+			if (Loading || args.ds_source == nullptr)
+				return 0;
+
+			int width = args.ds_texwidth;
+			int height = args.ds_texheight;
+			if (!Recording->Bgra || !args.ds_source_mipmapped)
+				return width * height;
+
+			size_t size = 0;
+			for (int i = 0; (width >> i) != 0 || (height >> i) != 0; i++)
+				size += MAX(width >> i, 1) * MAX(height >> i, 1);
+			return size;
+		}
+
+		DrawerRecording *Recording;
+		RenderViewport *ReplayViewport;
+		bool Loading;
+		bool Error = false;
+		unsigned int Pos = 0;
+	};
+
+	/////////////////////////////////////////////////////////////////////////////
+
+	struct DrawerRecording::TiltedSpan
+	{
+		SpanDrawerArgs Args;
+		FVector3 plane_sz;
+		FVector3 plane_su;
+		FVector3 plane_sv;
+		bool plane_shade;
+		int planeshade;
+		float planelightfloat;
+		fixed_t pviewx;
+		fixed_t pviewy;
+		FDynamicColormap *basecolormap;
+	};
+
+	struct DrawerRecording::Replay
+	{
+		struct Call
+		{
+			RecordedCallType Type;
+			uint8_t Drawer;
+			unsigned int Index;
+		};
+
+		TArray<Call> Calls;
+		TArray<WallDrawerArgs> Walls;
+		TArray<SkyDrawerArgs> Skies;
+		TArray<SpriteDrawerArgs> Sprites;
+		TArray<SpanDrawerArgs> Spans;
+		TArray<TiltedSpan> TiltedSpans;
+	};
+
+	DrawerRecording *DrawerRecording::Current;
+	FString DrawerRecording::PendingFilename;
+
+	void DrawerRecording::Request(const char *filename)
+	{
+		PendingFilename = filename;
+	}
+
+	void DrawerRecording::BeginFrame(RenderViewport *viewport)
+	{
+		if (PendingFilename.IsEmpty())
+			return;
+
+		Current = new DrawerRecording();
+		Current->Filename = PendingFilename;
+		Current->Target = viewport->RenderTarget;
+		Current->Bgra = viewport->RenderTarget->IsBgra();
+		PendingFilename = "";
+	}
+
+	void DrawerRecording::EndFrame()
+	{
+		if (Current == nullptr)
+			return;
+
+		// The view window is only known once the frame has been set up
+		Current->Width = Current->Target->GetWidth();
+		Current->Height = Current->Target->GetHeight();
+		Current->Pitch = Current->Target->GetPitch();
+		Current->ViewWindowX = viewwindowx;
+		Current->ViewWindowY = viewwindowy;
+		Current->FuzzViewHeight = fuzzviewheight;
+
+		if (Current->Save(Current->Filename))
+		{
+			Printf("%d drawer calls written to %s\n", Current->NumCalls, Current->Filename.GetChars());
+			if (Current->SkippedCalls != 0)
+				Printf("%d calls could not be recorded\n", Current->SkippedCalls);
+		}
+		else
+		{
+			Printf(TEXTCOLOR_RED "Could not write %s\n", Current->Filename.GetChars());
+		}
+
+		delete Current;
+		Current = nullptr;
+	}
+
+	template<typename ArgsT, typename FuncT>
+	void DrawerRecording::Record(const ArgsT &args, FuncT func)
+	{
+		std::unique_lock<std::mutex> lock(Current->Mutex);
+
+		// Camera textures are rendered with the same drawers
+		int drawer = FindDrawer(args, func);
+		if (drawer == -1 || args.Viewport()->RenderTarget != Current->Target)
+		{
+			Current->SkippedCalls++;
+			return;
+		}
+
+		RecordedCallType type = CallType(args);
+		uint8_t index = (uint8_t)drawer;
+		ArgsT copy = args;
+		DrawerStream stream(Current);
+		stream.Value(type);
+		stream.Value(index);
+		stream.Serialize(copy, drawer);
+		Current->NumCalls++;
+	}
+
+	void DrawerRecording::Record(const SpanDrawerArgs &args, const FVector3 &plane_sz, const FVector3 &plane_su, const FVector3 &plane_sv, bool plane_shade, int planeshade, float planelightfloat, fixed_t pviewx, fixed_t pviewy, FDynamicColormap *basecolormap)
+	{
+		std::unique_lock<std::mutex> lock(Current->Mutex);
+
+		if (args.Viewport()->RenderTarget != Current->Target)
+		{
+			Current->SkippedCalls++;
+			return;
+		}
+
+		// The tilted span drawers also need the view window center
+		RenderViewport *viewport = args.Viewport();
+		Current->CenterX = viewport->viewwindow.centerx;
+		Current->CenterY = viewport->viewwindow.centery;
+
+		TiltedSpan span = { args, plane_sz, plane_su, plane_sv, plane_shade, planeshade, planelightfloat, pviewx, pviewy, basecolormap };
+		RecordedCallType type = RecordedTiltedSpan;
+		uint8_t index = 0;
+		FSWColormap *colormap = basecolormap;
+		DrawerStream stream(Current);
+		stream.Value(type);
+		stream.Value(index);
+		stream.Serialize(span.Args, 0);
+		stream.Value(span.plane_sz);
+		stream.Value(span.plane_su);
+		stream.Value(span.plane_sv);
+		stream.Value(span.plane_shade);
+		stream.Value(span.planeshade);
+		stream.Value(span.planelightfloat);
+		stream.Value(span.pviewx);
+		stream.Value(span.pviewy);
+		stream.Colormap(colormap, NUMCOLORMAPS * 256);
+		Current->NumCalls++;
+	}
+
+	void DrawerRecording::Skip()
+	{
+		std::unique_lock<std::mutex> lock(Current->Mutex);
+		Current->SkippedCalls++;
+	}
+
+	uint32_t DrawerRecording::AddBlob(const void *data, size_t size)
+	{
+		// A column can be drawn again later with a taller height
+		BlobLocation *location = BlobLocations.CheckKey(data);
+		if (location != nullptr && location->Size >= size)
+			return location->Offset;
+
+		uint32_t offset = (Blobs.Size() + 15) & ~15;
+		Blobs.Resize(offset + (uint32_t)size);
+		memcpy(&Blobs[offset], data, size);
+		BlobLocations[data] = { offset, (uint32_t)size };
+		return offset;
+	}
+
+	int DrawerRecording::AddColormap(const FSWColormap *colormap, uint32_t mapsSize)
+	{
+		int *index = ColormapIndices.CheckKey(colormap);
+		if (index == nullptr)
+		{
+			RecordedColormap recorded;
+			recorded.Maps = NoData;
+			recorded.MapsSize = 0;
+			recorded.Color = colormap->Color.d;
+			recorded.Fade = colormap->Fade.d;
+			recorded.Desaturate = colormap->Desaturate;
+			index = &(ColormapIndices[colormap] = Colormaps.Push(recorded));
+		}
+
+		RecordedColormap &recorded = Colormaps[*index];
+		if (colormap->Maps != nullptr && recorded.MapsSize < mapsSize)
+		{
+			recorded.Maps = AddBlob(colormap->Maps, mapsSize);
+			recorded.MapsSize = mapsSize;
+		}
+		return *index;
+	}
+
+	bool DrawerRecording::Save(const char *filename)
+	{
+		FileWriter *file = FileWriter::Open(filename);
+		if (file == nullptr)
+			return false;
+
+		RecordingHeader header;
+		header.Magic = RecordingMagic;
+		header.Version = RecordingVersion;
+		header.Bgra = Bgra;
+		header.Width = Width;
+		header.Height = Height;
+		header.Pitch = Pitch;
+		header.ViewWindowX = ViewWindowX;
+		header.ViewWindowY = ViewWindowY;
+		header.CenterX = CenterX;
+		header.CenterY = CenterY;
+		header.FuzzViewHeight = FuzzViewHeight;
+		header.NumCalls = NumCalls;
+		header.SkippedCalls = SkippedCalls;
+		header.BlobsSize = Blobs.Size();
+		header.NumColormaps = Colormaps.Size();
+		header.CallsSize = Calls.Size();
+
+		bool written = file->Write(&header, sizeof(header)) == sizeof(header);
+		if (written && Blobs.Size() != 0)
+			written = file->Write(&Blobs[0], Blobs.Size()) == Blobs.Size();
+		if (written && Colormaps.Size() != 0)
+			written = file->Write(&Colormaps[0], Colormaps.Size() * sizeof(RecordedColormap)) == Colormaps.Size() * sizeof(RecordedColormap);
+		if (written && Calls.Size() != 0)
+			written = file->Write(&Calls[0], Calls.Size()) == Calls.Size();
+		delete file;
+		return written;
+	}
+
+	bool DrawerRecording::Load(const char *filename)
+	{
+		FileReader file;
+		if (!file.Open(filename))
+			return false;
+
+		RecordingHeader header;
+		if (file.Read(&header, sizeof(header)) != (long)sizeof(header) || header.Magic != RecordingMagic || header.Version != RecordingVersion)
+			return false;
+
+		if (header.Width <= 0 || header.Height <= 0 || header.Pitch < header.Width)
+			return false;
+
+		long size = sizeof(header) + (long)header.BlobsSize + (long)header.NumColormaps * sizeof(RecordedColormap) + (long)header.CallsSize;
+		if (file.GetLength() < size)
+			return false;
+
+		Bgra = header.Bgra != 0;
+		Width = header.Width;
+		Height = header.Height;
+		Pitch = header.Pitch;
+		ViewWindowX = header.ViewWindowX;
+		ViewWindowY = header.ViewWindowY;
+		CenterX = header.CenterX;
+		CenterY = header.CenterY;
+		FuzzViewHeight = header.FuzzViewHeight;
+		NumCalls = header.NumCalls;
+		SkippedCalls = header.SkippedCalls;
+
+		Blobs.Resize(header.BlobsSize);
+		Colormaps.Resize(header.NumColormaps);
+		Calls.Resize(header.CallsSize);
+		if (header.BlobsSize != 0)
+			file.Read(&Blobs[0], header.BlobsSize);
+		if (header.NumColormaps != 0)
+			file.Read(&Colormaps[0], header.NumColormaps * sizeof(RecordedColormap));
+		if (header.CallsSize != 0)
+			file.Read(&Calls[0], header.CallsSize);
+
+		LoadedColormaps.Resize(Colormaps.Size());
+		for (unsigned int i = 0; i < Colormaps.Size(); i++)
+		{
+			const RecordedColormap &recorded = Colormaps[i];
+			if (recorded.Maps != NoData && (recorded.Maps >= Blobs.Size() || recorded.MapsSize > Blobs.Size() - recorded.Maps))
+				return false;
+
+			FDynamicColormap &colormap = LoadedColormaps[i];
+			colormap.Maps = recorded.Maps != NoData ? &Blobs[recorded.Maps] : nullptr;
+			colormap.Color = recorded.Color;
+			colormap.Fade = recorded.Fade;
+			colormap.Desaturate = recorded.Desaturate;
+			colormap.Next = nullptr;
+		}
+		return true;
+	}
+
+	bool DrawerRecording::Parse(Replay &replay, RenderViewport *viewport)
+	{
+		DrawerStream stream(this, viewport);
+		while (!stream.AtEnd() && !stream.Failed())
+		{
+			RecordedCallType type;
+			uint8_t drawer;
+			stream.Value(type);
+			stream.Value(drawer);
+
+			Replay::Call call = { type, drawer, 0 };
+			switch (type)
+			{
+			case RecordedWall:
+			{
+				if (drawer >= countof(WallDrawers))
+					return false;
+				WallDrawerArgs args;
+				stream.Serialize(args, drawer);
+				call.Index = replay.Walls.Push(args);
+				break;
+			}
+			case RecordedSky:
+			{
+				if (drawer >= countof(SkyDrawers))
+					return false;
+				SkyDrawerArgs args;
+				stream.Serialize(args, drawer);
+				call.Index = replay.Skies.Push(args);
+				break;
+			}
+			case RecordedSprite:
+			{
+				if (drawer >= countof(SpriteDrawers))
+					return false;
+				SpriteDrawerArgs args;
+				stream.Serialize(args, drawer);
+				call.Index = replay.Sprites.Push(args);
+				break;
+			}
+			case RecordedSpan:
+			{
+				if (drawer >= countof(SpanDrawers))
+					return false;
+				SpanDrawerArgs args;
+				stream.Serialize(args, drawer);
+				call.Index = replay.Spans.Push(args);
+				break;
+			}
+			case RecordedTiltedSpan:
+			{
+				TiltedSpan span;
+				FSWColormap *colormap = nullptr;
+				stream.Serialize(span.Args, 0);
+				stream.Value(span.plane_sz);
+				stream.Value(span.plane_su);
+				stream.Value(span.plane_sv);
+				stream.Value(span.plane_shade);
+				stream.Value(span.planeshade);
+				stream.Value(span.planelightfloat);
+				stream.Value(span.pviewx);
+				stream.Value(span.pviewy);
+				stream.Colormap(colormap, 0);
+				span.basecolormap = static_cast<FDynamicColormap *>(colormap);
+				if (span.basecolormap == nullptr)
+					return false;
+				call.Index = replay.TiltedSpans.Push(span);
+				break;
+			}
+			default:
+				return false;
+			}
+			replay.Calls.Push(call);
+		}
+		return !stream.Failed();
+	}
+
+	void DrawerRecording::Push(const Replay &replay, SWPixelFormatDrawers *drawers)
+	{
+		for (const Replay::Call &call : replay.Calls)
+		{
+			switch (call.Type)
+			{
+			case RecordedWall: (drawers->*WallDrawers[call.Drawer])(replay.Walls[call.Index]); break;
+			case RecordedSky: (drawers->*SkyDrawers[call.Drawer])(replay.Skies[call.Index]); break;
+			case RecordedSprite: (drawers->*SpriteDrawers[call.Drawer])(replay.Sprites[call.Index]); break;
+			case RecordedSpan: (drawers->*SpanDrawers[call.Drawer])(replay.Spans[call.Index]); break;
+			case RecordedTiltedSpan:
+			{
+				const TiltedSpan &span = replay.TiltedSpans[call.Index];
+				drawers->DrawTiltedSpan(span.Args, span.plane_sz, span.plane_su, span.plane_sv, span.plane_shade, span.planeshade, span.planelightfloat, span.pviewx, span.pviewy, span.basecolormap);
+				break;
+			}
+			}
+		}
+	}
+
+	// Threads kept alive for all the passes over the queue with one thread
+	// count, so that the timings do not include starting and joining them.
+	// The calling thread runs the first slice of lines.
+	class DrawerRecording::ReplayThreads
+	{
+	public:
+		ReplayThreads(DrawerCommandQueue *queue, int numThreads) : Queue(queue)
+		{
+			for (int core = 0; core < numThreads; core++)
+			{
+				Threads.push_back(std::unique_ptr<DrawerThread>(new DrawerThread()));
+				Threads.back()->core = core;
+				Threads.back()->num_cores = numThreads;
+			}
+			for (int i = 1; i < numThreads; i++)
+				Workers.push_back(std::thread([=]() { WorkerMain(Threads[i].get()); }));
+		}
+
+		~ReplayThreads()
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Shutdown = true;
+			lock.unlock();
+			StartCondition.notify_all();
+			for (auto &worker : Workers)
+				worker.join();
+		}
+
+		// Executes all commands in the queue once
+		void Run()
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Generation++;
+			Running = (int)Workers.size();
+			lock.unlock();
+			StartCondition.notify_all();
+
+			Execute(Threads[0].get());
+
+			lock.lock();
+			EndCondition.wait(lock, [&]() { return Running == 0; });
+		}
+
+	private:
+		void WorkerMain(DrawerThread *thread)
+		{
+			int generation = 0;
+			while (true)
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				StartCondition.wait(lock, [&]() { return Shutdown || Generation != generation; });
+				if (Shutdown)
+					break;
+				generation = Generation;
+				lock.unlock();
+
+				Execute(thread);
+
+				lock.lock();
+				bool done = --Running == 0;
+				lock.unlock();
+				if (done)
+					EndCondition.notify_one();
+			}
+		}
+
+		void Execute(DrawerThread *thread)
+		{
+			for (DrawerCommand *command : Queue->commands)
+				command->Execute(thread);
+		}
+
+		DrawerCommandQueue *Queue;
+		std::vector<std::unique_ptr<DrawerThread>> Threads;
+		std::vector<std::thread> Workers;
+
+		std::mutex Mutex;
+		std::condition_variable StartCondition;
+		std::condition_variable EndCondition;
+		int Generation = 0;
+		int Running = 0;
+		bool Shutdown = false;
+	};
+
+	void DrawerRecording::DestroyCommands(DrawerCommandQueue *queue)
+	{
+		for (DrawerCommand *command : queue->commands)
+			command->~DrawerCommand();
+		queue->Clear();
+	}
+
+	void DrawerRecording::Benchmark(int iterations)
+	{
+		auto canvas = new DSimpleCanvas(Width, Height, Bgra);
+		canvas->Lock();
+		if (canvas->GetPitch() != Pitch)
+		{
+			Printf(TEXTCOLOR_RED "The recording was made with a pitch of %d instead of %d\n", Pitch, canvas->GetPitch());
+			canvas->Unlock();
+			delete canvas;
+			return;
+		}
+
+		auto viewport = new RenderViewport();
+		viewport->RenderTarget = canvas;
+		viewport->viewwindow.centerx = CenterX;
+		viewport->viewwindow.centery = CenterY;
+
+		auto replay = new Replay();
+		if (!Parse(*replay, viewport))
+		{
+			Printf(TEXTCOLOR_RED "The recorded drawer calls are corrupt\n");
+			delete replay;
+			delete viewport;
+			canvas->Unlock();
+			delete canvas;
+			return;
+		}
+
+		Printf("%d drawer calls, %dx%d %s\n", replay->Calls.Size(), Width, Height, Bgra ? "truecolor" : "palette");
+
+		// GetDest adds the view window offset
+		int savedx = viewwindowx;
+		int savedy = viewwindowy;
+		int savedfuzzviewheight = fuzzviewheight;
+		bool savedmultithreaded = r_multithreaded;
+		bool savedavx2 = r_avx2drawers;
+		viewwindowx = ViewWindowX;
+		viewwindowy = ViewWindowY;
+		fuzzviewheight = FuzzViewHeight;
+
+		// Keep the commands in the queue instead of running them as they are pushed
+		r_multithreaded = true;
+
+		struct Backend
+		{
+			const char *Name;
+			bool AVX2;
+		};
+		TArray<Backend> backends;
+		if (!Bgra)
+		{
+			backends.Push({ "Palette", false });
+		}
+		else
+		{
+#ifdef NO_SSE
+			backends.Push({ "Truecolor", false });
+#else
+			backends.Push({ "Truecolor SSE2", false });
+			if (CPU.bAVX2)
+				backends.Push({ "Truecolor AVX2", true });
+#endif
+		}
+
+		int maxThreads = MAX((int)std::thread::hardware_concurrency(), 1);
+		TArray<int> threadCounts;
+		for (int count = 1; count < maxThreads; count *= 2)
+			threadCounts.Push(count);
+		threadCounts.Push(maxThreads);
+
+		int size = Pitch * Height * (Bgra ? 4 : 1);
+		TArray<uint8_t> reference;
+		reference.Resize(size);
+
+		RenderMemory memory;
+		auto queue = std::make_shared<DrawerCommandQueue>(&memory);
+
+		for (unsigned int i = 0; i < backends.Size(); i++)
+		{
+			const Backend &backend = backends[i];
+			r_avx2drawers = backend.AVX2;
+
+			std::unique_ptr<SWPixelFormatDrawers> drawers;
+			if (Bgra)
+				drawers.reset(new SWTruecolorDrawers(queue));
+			else
+				drawers.reset(new SWPalDrawers(queue));
+			Push(*replay, drawers.get());
+
+			for (int numThreads : threadCounts)
+			{
+				ReplayThreads threads(queue.get(), numThreads);
+
+				// The output must not depend on the backend or the number of threads
+				memset(canvas->GetBuffer(), 0, size);
+				threads.Run();
+				bool mismatch = false;
+				if (i == 0 && numThreads == 1)
+					memcpy(&reference[0], canvas->GetBuffer(), size);
+				else
+					mismatch = memcmp(&reference[0], canvas->GetBuffer(), size) != 0;
+
+				cycle_t timer;
+				timer.Reset();
+				timer.Clock();
+				for (int iteration = 0; iteration < iterations; iteration++)
+					threads.Run();
+				timer.Unclock();
+
+				Printf("%-16s %2d threads %8.3f ms%s\n", backend.Name, numThreads, timer.TimeMS() / iterations,
+					mismatch ? TEXTCOLOR_RED "  output differs" : "");
+			}
+
+			DestroyCommands(queue.get());
+			memory.Clear();
+		}
+
+		r_avx2drawers = savedavx2;
+		r_multithreaded = savedmultithreaded;
+		viewwindowx = savedx;
+		viewwindowy = savedy;
+		fuzzviewheight = savedfuzzviewheight;
+
+		delete replay;
+		delete viewport;
+		canvas->Unlock();
+		delete canvas;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////
+
+	template<typename ArgsT>
+	void SWRecordingDrawers::Forward(const ArgsT &args, void(SWPixelFormatDrawers::*func)(const ArgsT &))
+	{
+		DrawerRecording::Record(args, func);
+		(Drawers->*func)(args);
+	}
+
+	void SWRecordingDrawers::DrawWallColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallColumn); }
+	void SWRecordingDrawers::DrawWallMaskedColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallMaskedColumn); }
+	void SWRecordingDrawers::DrawWallAddColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallAddColumn); }
+	void SWRecordingDrawers::DrawWallAddClampColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallAddClampColumn); }
+	void SWRecordingDrawers::DrawWallSubClampColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallSubClampColumn); }
+	void SWRecordingDrawers::DrawWallRevSubClampColumn(const WallDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawWallRevSubClampColumn); }
+	void SWRecordingDrawers::DrawSingleSkyColumn(const SkyDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSingleSkyColumn); }
+	void SWRecordingDrawers::DrawDoubleSkyColumn(const SkyDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawDoubleSkyColumn); }
+	void SWRecordingDrawers::DrawColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawColumn); }
+	void SWRecordingDrawers::FillColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillColumn); }
+	void SWRecordingDrawers::FillAddColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillAddColumn); }
+	void SWRecordingDrawers::FillAddClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillAddClampColumn); }
+	void SWRecordingDrawers::FillSubClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillSubClampColumn); }
+	void SWRecordingDrawers::FillRevSubClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillRevSubClampColumn); }
+	void SWRecordingDrawers::DrawFuzzColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawFuzzColumn); }
+	void SWRecordingDrawers::DrawAddColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawAddColumn); }
+	void SWRecordingDrawers::DrawTranslatedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawTranslatedColumn); }
+	void SWRecordingDrawers::DrawTranslatedAddColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawTranslatedAddColumn); }
+	void SWRecordingDrawers::DrawShadedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawShadedColumn); }
+	void SWRecordingDrawers::DrawAddClampShadedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawAddClampShadedColumn); }
+	void SWRecordingDrawers::DrawAddClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawAddClampColumn); }
+	void SWRecordingDrawers::DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawAddClampTranslatedColumn); }
+	void SWRecordingDrawers::DrawSubClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSubClampColumn); }
+	void SWRecordingDrawers::DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSubClampTranslatedColumn); }
+	void SWRecordingDrawers::DrawRevSubClampColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawRevSubClampColumn); }
+	void SWRecordingDrawers::DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawRevSubClampTranslatedColumn); }
+	void SWRecordingDrawers::DrawSpan(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpan); }
+	void SWRecordingDrawers::DrawSpanMasked(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpanMasked); }
+	void SWRecordingDrawers::DrawSpanTranslucent(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpanTranslucent); }
+	void SWRecordingDrawers::DrawSpanMaskedTranslucent(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpanMaskedTranslucent); }
+	void SWRecordingDrawers::DrawSpanAddClamp(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpanAddClamp); }
+	void SWRecordingDrawers::DrawSpanMaskedAddClamp(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawSpanMaskedAddClamp); }
+	void SWRecordingDrawers::FillSpan(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::FillSpan); }
+	void SWRecordingDrawers::DrawColoredSpan(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawColoredSpan); }
+	void SWRecordingDrawers::DrawFogBoundaryLine(const SpanDrawerArgs &args) { Forward(args, &SWPixelFormatDrawers::DrawFogBoundaryLine); }
+
+	void SWRecordingDrawers::DrawTiltedSpan(const SpanDrawerArgs &args, const FVector3 &plane_sz, const FVector3 &plane_su, const FVector3 &plane_sv, bool plane_shade, int planeshade, float planelightfloat, fixed_t pviewx, fixed_t pviewy, FDynamicColormap *basecolormap)
+	{
+		DrawerRecording::Record(args, plane_sz, plane_su, plane_sv, plane_shade, planeshade, planelightfloat, pviewx, pviewy, basecolormap);
+		Drawers->DrawTiltedSpan(args, plane_sz, plane_su, plane_sv, plane_shade, planeshade, planelightfloat, pviewx, pviewy, basecolormap);
+	}
+
+	void SWRecordingDrawers::DrawVoxelBlocks(const SpriteDrawerArgs &args, const VoxelBlock *blocks, int blockcount)
+	{
+		// The voxel blocks live in the frame memory and are not worth the trouble
+		DrawerRecording::Skip();
+		Drawers->DrawVoxelBlocks(args, blocks, blockcount);
+	}
+}
+
+//==========================================================================
+//
+// CCMD recorddrawers
+//
+// Writes all drawer calls of the next rendered frame, together with the
+// texture, colormap and translation data they use, to a file.
+//
+//==========================================================================
+
+CCMD (recorddrawers)
+{
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: recorddrawers <filename>\n");
+		return;
+	}
+	swrenderer::DrawerRecording::Request(argv[1]);
+}
+
+//==========================================================================
+//
+// CCMD replaydrawers
+//
+// Replays a file written by recorddrawers with all drawers of its pixel
+// format and with different numbers of threads. Does not need a level.
+//
+//==========================================================================
+
+CCMD (replaydrawers)
+{
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: replaydrawers <filename> [iterations]\n");
+		return;
+	}
+	int iterations = argv.argc() > 2 ? MAX(atoi(argv[2]), 1) : 20;
+
+	auto recording = new swrenderer::DrawerRecording();
+	if (recording->Load(argv[1]))
+		recording->Benchmark(iterations);
+	else
+		Printf (TEXTCOLOR_RED "Could not read drawer recording %s\n", argv[1]);
+	delete recording;
+}
@@ -0,0 +1,153 @@
+
+#pragma once
+
+#include "r_draw.h"
+#include "swrenderer/r_swcolormaps.h"
+#include <mutex>
+
+class DCanvas;
+class DrawerCommandQueue;
+class DrawerThread;
+
+namespace swrenderer
+{
+	class RenderViewport;
+	class DrawerStream;
+
+	// Forwards all calls to the drawers of a pixel format and adds them to the
+	// drawer recording of the current frame on the way
+	class SWRecordingDrawers : public SWPixelFormatDrawers
+	{
+	public:
+		SWRecordingDrawers(SWPixelFormatDrawers *drawers) : SWPixelFormatDrawers(drawers->Queue), Drawers(drawers) { }
+
+		void DrawWallColumn(const WallDrawerArgs &args) override;
+		void DrawWallMaskedColumn(const WallDrawerArgs &args) override;
+		void DrawWallAddColumn(const WallDrawerArgs &args) override;
+		void DrawWallAddClampColumn(const WallDrawerArgs &args) override;
+		void DrawWallSubClampColumn(const WallDrawerArgs &args) override;
+		void DrawWallRevSubClampColumn(const WallDrawerArgs &args) override;
+		void DrawSingleSkyColumn(const SkyDrawerArgs &args) override;
+		void DrawDoubleSkyColumn(const SkyDrawerArgs &args) override;
+		void DrawColumn(const SpriteDrawerArgs &args) override;
+		void FillColumn(const SpriteDrawerArgs &args) override;
+		void FillAddColumn(const SpriteDrawerArgs &args) override;
+		void FillAddClampColumn(const SpriteDrawerArgs &args) override;
+		void FillSubClampColumn(const SpriteDrawerArgs &args) override;
+		void FillRevSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawFuzzColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddColumn(const SpriteDrawerArgs &args) override;
+		void DrawTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawTranslatedAddColumn(const SpriteDrawerArgs &args) override;
+		void DrawShadedColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampShadedColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawRevSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawVoxelBlocks(const SpriteDrawerArgs &args, const VoxelBlock *blocks, int blockcount) override;
+		void DrawSpan(const SpanDrawerArgs &args) override;
+		void DrawSpanMasked(const SpanDrawerArgs &args) override;
+		void DrawSpanTranslucent(const SpanDrawerArgs &args) override;
+		void DrawSpanMaskedTranslucent(const SpanDrawerArgs &args) override;
+		void DrawSpanAddClamp(const SpanDrawerArgs &args) override;
+		void DrawSpanMaskedAddClamp(const SpanDrawerArgs &args) override;
+		void FillSpan(const SpanDrawerArgs &args) override;
+		void DrawTiltedSpan(const SpanDrawerArgs &args, const FVector3 &plane_sz, const FVector3 &plane_su, const FVector3 &plane_sv, bool plane_shade, int planeshade, float planelightfloat, fixed_t pviewx, fixed_t pviewy, FDynamicColormap *basecolormap) override;
+		void DrawColoredSpan(const SpanDrawerArgs &args) override;
+		void DrawFogBoundaryLine(const SpanDrawerArgs &args) override;
+
+	private:
+		template<typename ArgsT>
+		void Forward(const ArgsT &args, void(SWPixelFormatDrawers::*func)(const ArgsT &));
+
+		SWPixelFormatDrawers *Drawers;
+	};
+
+	// Texture and colormap data referenced by the recorded drawer calls is
+	// copied into one blob, so the recording can be replayed with no level
+	// loaded. A colormap is stored as an offset to its light tables in there.
+	struct RecordedColormap
+	{
+		uint32_t Maps;
+		uint32_t MapsSize;
+		uint32_t Color;
+		uint32_t Fade;
+		int32_t Desaturate;
+	};
+
+	// The drawer calls of one software rendered frame, and the data needed
+	// to run them again against the drawers of the same pixel format.
+	class DrawerRecording
+	{
+	public:
+		// Captures the next frame rendered to the screen into the file
+		static void Request(const char *filename);
+
+		// True while the calls of a frame are being captured
+		static bool IsCapturing() { return Current != nullptr; }
+
+		static void BeginFrame(RenderViewport *viewport);
+		static void EndFrame();
+
+		template<typename ArgsT, typename FuncT>
+		static void Record(const ArgsT &args, FuncT func);
+		static void Record(const SpanDrawerArgs &args, const FVector3 &plane_sz, const FVector3 &plane_su, const FVector3 &plane_sv, bool plane_shade, int planeshade, float planelightfloat, fixed_t pviewx, fixed_t pviewy, FDynamicColormap *basecolormap);
+		static void Skip();
+
+		bool Save(const char *filename);
+		bool Load(const char *filename);
+
+		// Runs the recorded calls with every drawer backend of the recorded
+		// pixel format and a varying number of threads and prints the timings
+		void Benchmark(int iterations);
+
+		uint32_t AddBlob(const void *data, size_t size);
+		int AddColormap(const FSWColormap *colormap, uint32_t mapsSize);
+
+		bool Bgra = false;
+		int Width = 0;
+		int Height = 0;
+		int Pitch = 0;
+		int ViewWindowX = 0;
+		int ViewWindowY = 0;
+		int CenterX = 0;
+		int CenterY = 0;
+		int FuzzViewHeight = 0;
+		int NumCalls = 0;
+		int SkippedCalls = 0;
+
+		TArray<uint8_t> Blobs;
+		TArray<RecordedColormap> Colormaps;
+		TArray<uint8_t> Calls;
+
+		// Colormaps of a loaded recording, pointing into the blob
+		TArray<FDynamicColormap> LoadedColormaps;
+
+	private:
+		struct BlobLocation
+		{
+			uint32_t Offset;
+			uint32_t Size;
+		};
+
+		struct TiltedSpan;
+		struct Replay;
+		class ReplayThreads;
+
+		bool Parse(Replay &replay, RenderViewport *viewport);
+		void Push(const Replay &replay, SWPixelFormatDrawers *drawers);
+		void DestroyCommands(DrawerCommandQueue *queue);
+
+		static DrawerRecording *Current;
+		static FString PendingFilename;
+
+		FString Filename;
+		DCanvas *Target = nullptr;
+		TMap<const void *, BlobLocation> BlobLocations;
+		TMap<const FSWColormap *, int> ColormapIndices;
+		std::mutex Mutex;
+	};
+}
@@ -59,12 +59,17 @@
 #include "r_draw_sprite32_sse2.h"
 #include "r_draw_span32_sse2.h"
 #include "r_draw_sky32_sse2.h"
+#include "r_draw_wall32_avx2.h"
+#include "r_draw_sprite32_avx2.h"
+#include "r_draw_span32_avx2.h"
+#include "r_draw_sky32_avx2.h"
 #endif
 
 #include "gi.h"
 #include "stats.h"
 #include "x86.h"
 #include <vector>
+#include <type_traits>
 
 // Use linear filtering when scaling up
 CVAR(Bool, r_magfilter, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
@@ -78,66 +83,79 @@ CVAR(Bool, r_mipmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 // Level of detail texture bias
 CVAR(Float, r_lod_bias, -1.5, 0); // To do: add CVAR_ARCHIVE | CVAR_GLOBALCONFIG when a good default has been decided
 
+// Use the AVX2 drawers when the CPU supports them
+CVAR(Bool, r_avx2drawers, true, 0);
+
 namespace swrenderer
 {
+	template<typename CommandT, typename ArgsT>
+	void SWTruecolorDrawers::PushDrawer(const ArgsT &args)
+	{
+		typedef typename AVX2Drawer<CommandT>::Type AVX2CommandT;
+		if (!std::is_same<CommandT, AVX2CommandT>::value && r_avx2drawers && CPU.bAVX2)
+			Queue->Push<AVX2CommandT>(args);
+		else
+			Queue->Push<CommandT>(args);
+	}
+
 	void SWTruecolorDrawers::DrawWallColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWall32Command>(args);
+		PushDrawer<DrawWall32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallMaskedColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallMasked32Command>(args);
+		PushDrawer<DrawWallMasked32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallAddColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallAddClamp32Command>(args);
+		PushDrawer<DrawWallAddClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallAddClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallAddClamp32Command>(args);
+		PushDrawer<DrawWallAddClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallSubClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallSubClamp32Command>(args);
+		PushDrawer<DrawWallSubClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallRevSubClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallRevSubClamp32Command>(args);
+		PushDrawer<DrawWallRevSubClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSprite32Command>(args);
+		PushDrawer<DrawSprite32Command>(args);
 	}
 
 	void SWTruecolorDrawers::FillColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSprite32Command>(args);
+		PushDrawer<FillSprite32Command>(args);
 	}
 
 	void SWTruecolorDrawers::FillAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteAddClamp32Command>(args);
+		PushDrawer<FillSpriteAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::FillAddClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteAddClamp32Command>(args);
+		PushDrawer<FillSpriteAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::FillSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteSubClamp32Command>(args);
+		PushDrawer<FillSpriteSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::FillRevSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteRevSubClamp32Command>(args);
+		PushDrawer<FillSpriteRevSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawFuzzColumn(const SpriteDrawerArgs &args)
@@ -151,57 +169,57 @@ namespace swrenderer
 
 	void SWTruecolorDrawers::DrawAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClamp32Command>(args);
+		PushDrawer<DrawSpriteAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslated32Command>(args);
+		PushDrawer<DrawSpriteTranslated32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawTranslatedAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedAddClamp32Command>(args);
+		PushDrawer<DrawSpriteTranslatedAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawShadedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteShaded32Command>(args);
+		PushDrawer<DrawSpriteShaded32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampShadedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClampShaded32Command>(args);
+		PushDrawer<DrawSpriteAddClampShaded32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClamp32Command>(args);
+		PushDrawer<DrawSpriteAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedAddClamp32Command>(args);
+		PushDrawer<DrawSpriteTranslatedAddClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteSubClamp32Command>(args);
+		PushDrawer<DrawSpriteSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedSubClamp32Command>(args);
+		PushDrawer<DrawSpriteTranslatedSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawRevSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteRevSubClamp32Command>(args);
+		PushDrawer<DrawSpriteRevSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedRevSubClamp32Command>(args);
+		PushDrawer<DrawSpriteTranslatedRevSubClamp32Command>(args);
 	}
 
 	void SWTruecolorDrawers::DrawVoxelBlocks(const SpriteDrawerArgs &args, const VoxelBlock *blocks, int blockcount)
@@ -211,42 +229,42 @@ namespace swrenderer
 
 	void SWTruecolorDrawers::DrawSpan(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpan32Command>(args);
+		PushDrawer<DrawSpan32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMasked(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanMasked32Command>(args);
+		PushDrawer<DrawSpanMasked32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanTranslucent(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanTranslucent32Command>(args);
+		PushDrawer<DrawSpanTranslucent32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedTranslucent(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanAddClamp32Command>(args);
+		PushDrawer<DrawSpanAddClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanAddClamp(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanTranslucent32Command>(args);
+		PushDrawer<DrawSpanTranslucent32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedAddClamp(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanAddClamp32Command>(args);
+		PushDrawer<DrawSpanAddClamp32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawSingleSkyColumn(const SkyDrawerArgs &args)
 	{
-		Queue->Push<DrawSkySingle32Command>(args);
+		PushDrawer<DrawSkySingle32Command>(args);
 	}
 	
 	void SWTruecolorDrawers::DrawDoubleSkyColumn(const SkyDrawerArgs &args)
 	{
-		Queue->Push<DrawSkyDouble32Command>(args);
+		PushDrawer<DrawSkyDouble32Command>(args);
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
@@ -70,6 +70,14 @@ namespace swrenderer
 	#define VECTORCALL
 	#endif
 
+	// Compile a single function for AVX2 without raising the instruction set of the whole file.
+	// Only the AVX2 drawer tier uses this, and it is only run after checking CPU.bAVX2.
+	#if defined(__GNUC__)
+	#define AVX2_TARGET __attribute__((target("avx2")))
+	#else
+	#define AVX2_TARGET
+	#endif
+
 	class DrawFuzzColumnRGBACommand : public DrawerCommand
 	{
 		int _x;
@@ -246,6 +254,9 @@ namespace swrenderer
 
 	/////////////////////////////////////////////////////////////////////////////
 
+	// Maps a drawer command to its AVX2 version. Commands without one map to themselves.
+	template<typename CommandT> struct AVX2Drawer { typedef CommandT Type; };
+
 	class SWTruecolorDrawers : public SWPixelFormatDrawers
 	{
 	public:
@@ -293,6 +304,11 @@ namespace swrenderer
 
 		void DrawColoredSpan(const SpanDrawerArgs &args) override { Queue->Push<DrawColoredSpanRGBACommand>(args); }
 		void DrawFogBoundaryLine(const SpanDrawerArgs &args) override { Queue->Push<DrawFogBoundaryLineRGBACommand>(args); }
+
+	private:
+		// Queues the AVX2 version of a command if the CPU supports it
+		template<typename CommandT, typename ArgsT>
+		void PushDrawer(const ArgsT &args);
 	};
 
 	/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,194 @@
+/*
+**  AVX2 drawer commands for the sky
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_sky32_sse2.h"
+
+namespace swrenderer
+{
+	// Blends four rows of the fade bands at a time. The solid and textured
+	// bands are plain copies and stay scalar. The output is identical to the
+	// SSE2 version, including the bottom fade blending towards the top color.
+	template<typename BaseT, bool DoubleSky>
+	class DrawSky32AVX2T : public BaseT
+	{
+	public:
+		DrawSky32AVX2T(const SkyDrawerArgs &args) : BaseT(args) { }
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			const SkyDrawerArgs &args = this->args;
+			uint32_t *dest = (uint32_t *)args.Dest();
+			int count = args.Count();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			const uint32_t *source0 = (const uint32_t *)args.FrontTexturePixels();
+			const uint32_t *source1 = DoubleSky ? (const uint32_t *)args.BackTexturePixels() : nullptr;
+			int textureheight0 = args.FrontTextureHeight();
+			uint32_t maxtextureheight1 = DoubleSky ? args.BackTextureHeight() - 1 : 0;
+
+			int32_t frac = args.TextureVPos();
+			int32_t fracstep = args.TextureVStep();
+
+			uint32_t solid_top = args.SolidTopColor();
+			uint32_t solid_bottom = args.SolidBottomColor();
+			bool fadeSky = args.FadeSky();
+
+			// Find bands for top solid color, top fade, center textured, bottom fade, bottom solid color:
+			int start_fade = 2; // How fast it should fade out
+			int fade_length = (1 << (24 - start_fade));
+			int start_fadetop_y = (-frac) / fracstep;
+			int end_fadetop_y = (fade_length - frac) / fracstep;
+			int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
+			int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+			start_fadetop_y = clamp(start_fadetop_y, 0, count);
+			end_fadetop_y = clamp(end_fadetop_y, 0, count);
+			start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
+			end_fadebottom_y = clamp(end_fadebottom_y, 0, count);
+
+			int num_cores = thread->num_cores;
+			int skipped = thread->skipped_by_thread(args.DestY());
+			dest = thread->dest_for_thread(args.DestY(), pitch, dest);
+			frac += fracstep * skipped;
+			fracstep *= num_cores;
+			pitch *= num_cores;
+
+			if (!fadeSky)
+			{
+				count = thread->count_for_thread(args.DestY(), count);
+
+				for (int index = 0; index < count; index++)
+				{
+					*dest = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+					dest += pitch;
+					frac += fracstep;
+				}
+
+				return;
+			}
+
+			__m256i solid_top_fill = _mm256_cvtepu8_epi16(_mm_set1_epi32(solid_top));
+
+			int index = skipped;
+
+			// Top solid color:
+			while (index < start_fadetop_y)
+			{
+				*dest = solid_top;
+				dest += pitch;
+				frac += fracstep;
+				index += num_cores;
+			}
+
+			// Top fade:
+			Fade<false>(dest, frac, fracstep, index, end_fadetop_y, num_cores, pitch, start_fade, solid_top_fill, source0, source1, textureheight0, maxtextureheight1);
+
+			// Textured center:
+			while (index < start_fadebottom_y)
+			{
+				*dest = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+
+				frac += fracstep;
+				dest += pitch;
+				index += num_cores;
+			}
+
+			// Fade bottom:
+			Fade<true>(dest, frac, fracstep, index, end_fadebottom_y, num_cores, pitch, start_fade, solid_top_fill, source0, source1, textureheight0, maxtextureheight1);
+
+			// Bottom solid color:
+			while (index < count)
+			{
+				*dest = solid_bottom;
+				dest += pitch;
+				index += num_cores;
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE static uint32_t Sample(int32_t frac, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			uint32_t sample_index = (((((uint32_t)frac) << 8) >> FRACBITS) * textureheight0) >> FRACBITS;
+			uint32_t fg = source0[sample_index];
+			if (DoubleSky && fg == 0)
+			{
+				uint32_t sample_index2 = MIN(sample_index, maxtextureheight1);
+				fg = source1[sample_index2];
+			}
+			return fg;
+		}
+
+		template<bool Bottom>
+		AVX2_TARGET FORCEINLINE static void Fade(uint32_t *&dest, int32_t &frac, int32_t fracstep, int &index, int end, int num_cores, int pitch, int start_fade, __m256i fill, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			int total = MAX((end - index + num_cores - 1) / num_cores, 0);
+			for (int i = 0; i < total; i += 4)
+			{
+				// Fetch into registers. Building the vectors from four separate
+				// stores to the stack would stall on the failed store forwarding.
+				int n = MIN(total - i, 4);
+				int alpha0, alpha1 = 0, alpha2 = 0, alpha3 = 0;
+				uint32_t fg0 = FadeSample<Bottom>(frac, fracstep, start_fade, alpha0, source0, source1, textureheight0, maxtextureheight1);
+				uint32_t fg1 = n > 1 ? FadeSample<Bottom>(frac, fracstep, start_fade, alpha1, source0, source1, textureheight0, maxtextureheight1) : 0;
+				uint32_t fg2 = n > 2 ? FadeSample<Bottom>(frac, fracstep, start_fade, alpha2, source0, source1, textureheight0, maxtextureheight1) : 0;
+				uint32_t fg3 = n > 3 ? FadeSample<Bottom>(frac, fracstep, start_fade, alpha3, source0, source1, textureheight0, maxtextureheight1) : 0;
+
+				__m256i malpha = _mm256_set_epi16(
+					alpha3, alpha3, alpha3, alpha3, alpha2, alpha2, alpha2, alpha2,
+					alpha1, alpha1, alpha1, alpha1, alpha0, alpha0, alpha0, alpha0);
+				__m256i inv_alpha = _mm256_sub_epi16(_mm256_set1_epi16(256), malpha);
+
+				__m256i c = _mm256_cvtepu8_epi16(_mm_setr_epi32(fg0, fg1, fg2, fg3));
+				c = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c, malpha), _mm256_mullo_epi16(fill, inv_alpha)), 8);
+				c = _mm256_packus_epi16(c, _mm256_setzero_si256());
+				__m128i outcolor = _mm256_castsi256_si128(_mm256_permute4x64_epi64(c, _MM_SHUFFLE(3, 1, 2, 0)));
+
+				dest[0] = _mm_cvtsi128_si32(outcolor);
+				if (n > 1) dest[pitch] = _mm_extract_epi32(outcolor, 1);
+				if (n > 2) dest[pitch * 2] = _mm_extract_epi32(outcolor, 2);
+				if (n > 3) dest[pitch * 3] = _mm_extract_epi32(outcolor, 3);
+
+				dest += pitch * n;
+			}
+			index += total * num_cores;
+		}
+
+		template<bool Bottom>
+		AVX2_TARGET FORCEINLINE static uint32_t FadeSample(int32_t &frac, int32_t fracstep, int start_fade, int &alpha, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			uint32_t fg = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+			if (Bottom)
+				alpha = MAX(MIN(((2 << 24) - frac) >> (16 - start_fade), 256), 0);
+			else
+				alpha = MAX(MIN(frac >> (16 - start_fade), 256), 0);
+			frac += fracstep;
+			return fg;
+		}
+
+		FString DebugInfo() override { return DoubleSky ? "DrawSkyDouble32AVX2Command" : "DrawSkySingle32AVX2Command"; }
+	};
+
+	typedef DrawSky32AVX2T<DrawSkySingle32Command, false> DrawSkySingle32AVX2Command;
+	typedef DrawSky32AVX2T<DrawSkyDouble32Command, true> DrawSkyDouble32AVX2Command;
+
+	template<> struct AVX2Drawer<DrawSkySingle32Command> { typedef DrawSkySingle32AVX2Command Type; };
+	template<> struct AVX2Drawer<DrawSkyDouble32Command> { typedef DrawSkyDouble32AVX2Command Type; };
+}
@@ -0,0 +1,405 @@
+/*
+**  AVX2 drawer commands for sprites
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_sprite32_sse2.h"
+
+namespace swrenderer
+{
+	// Draws four pixels per step. Each 128-bit lane holds the same two pixels
+	// the SSE2 version works on, so the output is identical to it.
+	template<typename BlendT, typename SamplerT>
+	class DrawSprite32AVX2T : public DrawSprite32T<BlendT, SamplerT>
+	{
+	public:
+		DrawSprite32AVX2T(const SpriteDrawerArgs &drawerargs) : DrawSprite32T<BlendT, SamplerT>(drawerargs) { }
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			using namespace DrawSprite32TModes;
+
+			auto shade_constants = this->args.ColormapConstants();
+			if (SamplerT::Mode == (int)SpriteSamplers::Texture)
+			{
+				const uint32_t *source2 = (const uint32_t*)this->args.TexturePixels2();
+				bool is_nearest_filter = (source2 == nullptr);
+
+				if (shade_constants.simple_shade)
+				{
+					if (is_nearest_filter)
+						Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter>(thread, shade_constants);
+				}
+				else
+				{
+					if (is_nearest_filter)
+						Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter>(thread, shade_constants);
+				}
+			}
+			else // no linear filtering for translated, shaded or fill
+			{
+				if (shade_constants.simple_shade)
+				{
+					Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+				}
+				else
+				{
+					Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, ShadeConstants shade_constants)
+		{
+			using namespace DrawSprite32TModes;
+
+			SpriteDrawerArgs &args = this->args;
+			const uint32_t *source;
+			const uint32_t *source2;
+			const uint8_t *colormap;
+			const uint32_t *translation;
+
+			if (SamplerT::Mode == (int)SpriteSamplers::Shaded || SamplerT::Mode == (int)SpriteSamplers::Translated)
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = nullptr;
+				colormap = args.Colormap(args.Viewport());
+				translation = (const uint32_t*)args.TranslationMap();
+			}
+			else
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = (const uint32_t*)args.TexturePixels2();
+				colormap = nullptr;
+				translation = nullptr;
+			}
+
+			int textureheight = args.TextureHeight();
+			uint32_t one = ((0x20000000 + textureheight - 1) / textureheight) * 2 + 1;
+
+			// Shade constants
+			__m128i dynlight = _mm_cvtsi32_si128(args.DynamicLight());
+			dynlight = _mm_unpacklo_epi8(dynlight, _mm_setzero_si128());
+			dynlight = _mm_shuffle_epi32(dynlight, _MM_SHUFFLE(1, 0, 1, 0));
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			__m128i mlight128 = _mm_set_epi16(256, light, light, light, 256, light, light, light);
+
+			__m256i mlight, inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			__m256i lightcontrib;
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				__m256i inv_light = _mm256_broadcastsi128_si256(_mm_set_epi16(0, 256 - light, 256 - light, 256 - light, 0, 256 - light, 256 - light, 256 - light));
+				inv_desaturate = _mm256_broadcastsi128_si256(_mm_setr_epi16(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate));
+				shade_fade = _mm256_broadcastsi128_si256(_mm_set_epi16(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue, shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue));
+				shade_fade = _mm256_mullo_epi16(shade_fade, inv_light);
+				shade_light = _mm256_broadcastsi128_si256(_mm_set_epi16(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue, shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue));
+				desaturate = shade_constants.desaturate;
+
+				__m128i contrib = _mm_min_epi16(_mm_add_epi16(mlight128, dynlight), _mm_set1_epi16(256));
+				lightcontrib = _mm256_broadcastsi128_si256(_mm_sub_epi16(contrib, mlight128));
+				mlight = _mm256_broadcastsi128_si256(mlight128);
+			}
+			else
+			{
+				inv_desaturate = _mm256_setzero_si256();
+				shade_fade = _mm256_setzero_si256();
+				shade_light = _mm256_setzero_si256();
+				desaturate = 0;
+				lightcontrib = _mm256_setzero_si256();
+
+				mlight = _mm256_broadcastsi128_si256(_mm_min_epi16(_mm_add_epi16(mlight128, dynlight), _mm_set1_epi16(256)));
+			}
+
+			int count = args.Count();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			uint32_t fracstep = args.TextureVStep();
+			uint32_t frac = args.TextureVPos();
+			uint32_t texturefracx = args.TextureUPos();
+			uint32_t *dest = (uint32_t*)args.Dest();
+			int dest_y = args.DestY();
+
+			count = thread->count_for_thread(dest_y, count);
+			if (count <= 0) return;
+			frac += thread->skipped_by_thread(dest_y) * fracstep;
+			dest = thread->dest_for_thread(dest_y, pitch, dest);
+			fracstep *= thread->num_cores;
+			pitch *= thread->num_cores;
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				frac -= one / 2;
+			}
+
+			uint32_t srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			uint32_t destalpha = args.DestAlpha() >> (FRACBITS - 8);
+			uint32_t srccolor = args.SrcColorBgra();
+			uint32_t color = LightBgra::shade_bgra_simple(args.SolidColorBgra(),
+				LightBgra::calc_light_multiplier(light));
+
+			LoopData data;
+			data.source = source;
+			data.source2 = source2;
+			data.colormap = colormap;
+			data.translation = translation;
+			data.textureheight = textureheight;
+			data.one = one;
+			data.texturefracx = texturefracx;
+			data.color = color;
+			data.srccolor = srccolor;
+			data.srcalpha = srcalpha;
+			data.destalpha = destalpha;
+			data.desaturate = desaturate;
+			data.mlight = mlight;
+			data.inv_desaturate = inv_desaturate;
+			data.shade_fade = shade_fade;
+			data.shade_light = shade_light;
+			data.lightcontrib = lightcontrib;
+
+			// A constant pixel count in the main loop lets the compiler hoist the
+			// shading of the fill and shaded samplers, whose color never changes.
+			int index = 0;
+			for (; index + 4 <= count; index += 4)
+				Step<ShadeModeT, FilterModeT>(data, dest + index * pitch, pitch, frac, fracstep, 4);
+			if (index < count)
+				Step<ShadeModeT, FilterModeT>(data, dest + index * pitch, pitch, frac, fracstep, count - index);
+		}
+
+		struct LoopData
+		{
+			const uint32_t *source;
+			const uint32_t *source2;
+			const uint8_t *colormap;
+			const uint32_t *translation;
+			int textureheight;
+			uint32_t one;
+			uint32_t texturefracx;
+			uint32_t color;
+			uint32_t srccolor;
+			uint32_t srcalpha;
+			uint32_t destalpha;
+			int desaturate;
+			__m256i mlight;
+			__m256i inv_desaturate;
+			__m256i shade_fade;
+			__m256i shade_light;
+			__m256i lightcontrib;
+		};
+
+		// Draws up to four pixels
+		template<typename ShadeModeT, typename FilterModeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Step(const LoopData &data, uint32_t *d, int pitch, uint32_t &frac, uint32_t fracstep, int n)
+		{
+			// Fetch into registers. Building the vectors from four separate
+			// stores to the stack would stall on the failed store forwarding.
+			Texel t0 = Fetch<FilterModeT>(data, d, frac, fracstep);
+			Texel t1 = n > 1 ? Fetch<FilterModeT>(data, d + pitch, frac, fracstep) : Texel{ 0, 0, 0 };
+			Texel t2 = n > 2 ? Fetch<FilterModeT>(data, d + pitch * 2, frac, fracstep) : Texel{ 0, 0, 0 };
+			Texel t3 = n > 3 ? Fetch<FilterModeT>(data, d + pitch * 3, frac, fracstep) : Texel{ 0, 0, 0 };
+
+			unsigned int ifgcolor[4] = { t0.color, t1.color, t2.color, t3.color };
+			unsigned int ifgshade[4] = { t0.shade, t1.shade, t2.shade, t3.shade };
+			__m256i bgcolor = _mm256_cvtepu8_epi16(_mm_setr_epi32(t0.dest, t1.dest, t2.dest, t3.dest));
+			__m256i fgcolor = _mm256_cvtepu8_epi16(_mm_setr_epi32(t0.color, t1.color, t2.color, t3.color));
+
+			fgcolor = Shade<ShadeModeT>(fgcolor, data.mlight, ifgcolor, data.desaturate, data.inv_desaturate, data.shade_fade, data.shade_light, data.lightcontrib);
+			__m128i outcolor = Blend(fgcolor, bgcolor, ifgcolor, ifgshade, data.srcalpha, data.destalpha);
+
+			d[0] = _mm_cvtsi128_si32(outcolor);
+			if (n > 1) d[pitch] = _mm_extract_epi32(outcolor, 1);
+			if (n > 2) d[pitch * 2] = _mm_extract_epi32(outcolor, 2);
+			if (n > 3) d[pitch * 3] = _mm_extract_epi32(outcolor, 3);
+		}
+
+		struct Texel
+		{
+			uint32_t dest;
+			uint32_t color;
+			uint32_t shade;
+		};
+
+		template<typename FilterModeT>
+		AVX2_TARGET FORCEINLINE Texel VECTORCALL Fetch(const LoopData &data, const uint32_t *d, uint32_t &frac, uint32_t fracstep)
+		{
+			using namespace DrawSprite32TModes;
+
+			Texel texel;
+			texel.dest = BlendT::Mode != (int)SpriteBlendModes::Opaque && BlendT::Mode != (int)SpriteBlendModes::Copy ? *d : 0;
+			texel.color = this->template Sample<FilterModeT>(frac, data.source, data.source2, data.translation, data.textureheight, data.one, data.texturefracx, data.color, data.srccolor);
+			texel.shade = this->SampleShade(frac, data.source, data.colormap);
+			frac += fracstep;
+			return texel;
+		}
+
+		template<typename ShadeModeT>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Shade(__m256i fgcolor, __m256i mlight, const unsigned int *ifgcolor, int desaturate, __m256i inv_desaturate, __m256i shade_fade, __m256i shade_light, __m256i lightcontrib)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Copy)
+				return fgcolor;
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				return _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, mlight), 8);
+			}
+			else
+			{
+				__m256i lit_dynlight = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, lightcontrib), 8);
+
+				int intensity[4];
+				for (int i = 0; i < 4; i++)
+				{
+					int blue = BPART(ifgcolor[i]);
+					int green = GPART(ifgcolor[i]);
+					int red = RPART(ifgcolor[i]);
+					intensity[i] = ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate;
+				}
+
+				__m256i mintensity = _mm256_set_epi16(
+					0, intensity[3], intensity[3], intensity[3], 0, intensity[2], intensity[2], intensity[2],
+					0, intensity[1], intensity[1], intensity[1], 0, intensity[0], intensity[0], intensity[0]);
+
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, inv_desaturate), mintensity), 8);
+				fgcolor = _mm256_mullo_epi16(fgcolor, mlight);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade_fade, fgcolor), 8);
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade_light), 8);
+
+				fgcolor = _mm256_add_epi16(fgcolor, lit_dynlight);
+				fgcolor = _mm256_min_epi16(fgcolor, _mm256_set1_epi16(255));
+				return fgcolor;
+			}
+		}
+
+		// Packs the four pixels back to bytes in drawing order
+		AVX2_TARGET FORCEINLINE static __m128i VECTORCALL Pack(__m256i color)
+		{
+			color = _mm256_packus_epi16(color, _mm256_setzero_si256());
+			return _mm256_castsi256_si128(_mm256_permute4x64_epi64(color, _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+
+		// Repeats one 16-bit value for each of the four pixels
+		AVX2_TARGET FORCEINLINE static __m256i VECTORCALL PerPixel(const unsigned int *v)
+		{
+			return _mm256_set_epi16(
+				v[3], v[3], v[3], v[3], v[2], v[2], v[2], v[2],
+				v[1], v[1], v[1], v[1], v[0], v[0], v[0], v[0]);
+		}
+
+		AVX2_TARGET FORCEINLINE __m128i VECTORCALL Blend(__m256i fgcolor, __m256i bgcolor, const unsigned int *ifgcolor, const unsigned int *ifgshade, uint32_t srcalpha, uint32_t destalpha)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Opaque)
+			{
+				return Pack(fgcolor);
+			}
+			else if (BlendT::Mode == (int)SpriteBlendModes::Shaded)
+			{
+				__m256i alpha = PerPixel(ifgshade);
+				__m256i inv_alpha = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha);
+
+				fgcolor = _mm256_mullo_epi16(fgcolor, alpha);
+				bgcolor = _mm256_mullo_epi16(bgcolor, inv_alpha);
+				__m256i outcolor = _mm256_srli_epi16(_mm256_add_epi16(fgcolor, bgcolor), 8);
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+			else if (BlendT::Mode == (int)SpriteBlendModes::AddClampShaded)
+			{
+				__m256i alpha = PerPixel(ifgshade);
+
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, alpha), 8);
+				__m256i outcolor = _mm256_add_epi16(fgcolor, bgcolor);
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+			else
+			{
+				unsigned int fgalpha[4], bgalpha[4];
+				for (int i = 0; i < 4; i++)
+				{
+					uint32_t alpha = APART(ifgcolor[i]);
+					alpha += alpha >> 7; // 255->256
+					uint32_t inv_alpha = 256 - alpha;
+					bgalpha[i] = (destalpha * alpha + (inv_alpha << 8) + 128) >> 8;
+					fgalpha[i] = (srcalpha * alpha + 128) >> 8;
+				}
+
+				fgcolor = _mm256_mullo_epi16(fgcolor, PerPixel(fgalpha));
+				bgcolor = _mm256_mullo_epi16(bgcolor, PerPixel(bgalpha));
+
+				__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+				__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+				__m256i out_lo, out_hi;
+				if (BlendT::Mode == (int)SpriteBlendModes::AddClamp)
+				{
+					out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+					out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+				}
+				else if (BlendT::Mode == (int)SpriteBlendModes::SubClamp)
+				{
+					out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+					out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+				}
+				else
+				{
+					out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+					out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+				}
+
+				out_lo = _mm256_srai_epi32(out_lo, 8);
+				out_hi = _mm256_srai_epi32(out_hi, 8);
+				__m256i outcolor = _mm256_packs_epi32(out_lo, out_hi);
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+		}
+
+		FString DebugInfo() override { return "DrawSprite32AVX2T"; }
+	};
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TextureSampler> DrawSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::FillSampler> FillSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::FillSampler> FillSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::ShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteShaded32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteAddClampShaded32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslated32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedRevSubClamp32AVX2Command;
+
+	template<typename BlendT, typename SamplerT> struct AVX2Drawer<DrawSprite32T<BlendT, SamplerT>> { typedef DrawSprite32AVX2T<BlendT, SamplerT> Type; };
+}
@@ -33,6 +33,7 @@
 #include "r_thread.h"
 #include "swrenderer/r_memory.h"
 #include "swrenderer/r_renderthread.h"
+#include "workerpool.h"
 #include <chrono>
 
 #ifdef WIN32
@@ -55,7 +56,6 @@ DrawerThreads::DrawerThreads()
 
 DrawerThreads::~DrawerThreads()
 {
-	StopThreads();
 }
 
 void DrawerThreads::Execute(DrawerCommandQueuePtr commands)
@@ -72,16 +72,34 @@ void DrawerThreads::Execute(DrawerCommandQueuePtr commands)
 	queue->active_commands.push_back(commands);
 	queue->tasks_left += queue->threads.size();
 	end_lock.unlock();
+
+	// Each drawer thread must process its queues in order. Only schedule a job for
+	// the threads that are not already draining their queues in the worker pool.
+	for (auto &thread : queue->threads)
+	{
+		if (!thread->scheduled)
+		{
+			DrawerThread *t = thread.get();
+			t->scheduled = true;
+			FWorkerPool::Instance()->Submit([=]() { queue->WorkerMain(t); }, t->core, queue);
+		}
+	}
 	start_lock.unlock();
-	queue->start_condition.notify_all();
 }
 
 void DrawerThreads::WaitForWorkers()
 {
 	using namespace std::chrono_literals;
 
-	// Wait for workers to finish
 	auto queue = Instance();
+
+	// Drain drawer jobs still sitting in the pool ourselves. The workers may be busy
+	// with long running background jobs and the frame should not wait for those.
+	while (FWorkerPool::Instance()->RunPendingJob(queue))
+	{
+	}
+
+	// Wait for workers to finish
 	std::unique_lock<std::mutex> end_lock(queue->end_mutex);
 	if (!queue->end_condition.wait_for(end_lock, 5s, [&]() { return queue->tasks_left == 0; }))
 	{
@@ -97,7 +115,7 @@ void DrawerThreads::WaitForWorkers()
 	// Clean up
 	std::unique_lock<std::mutex> start_lock(queue->start_mutex);
 	for (auto &thread : queue->threads)
-		thread.current_queue = 0;
+		thread->current_queue = 0;
 
 	for (auto &list : queue->active_commands)
 	{
@@ -112,13 +130,13 @@ void DrawerThreads::WorkerMain(DrawerThread *thread)
 {
 	while (true)
 	{
-		// Wait until we are signalled to run:
+		// Grab the next commands, or stop if we caught up:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
-		start_condition.wait(start_lock, [&]() { return thread->current_queue < active_commands.size() || shutdown_flag; });
-		if (shutdown_flag)
+		if (thread->current_queue >= active_commands.size())
+		{
+			thread->scheduled = false;
 			break;
-
-		// Grab the commands
+		}
 		DrawerCommandQueuePtr list = active_commands[thread->current_queue];
 		thread->current_queue++;
 		start_lock.unlock();
@@ -141,38 +159,29 @@ void DrawerThreads::WorkerMain(DrawerThread *thread)
 
 void DrawerThreads::StartThreads()
 {
-	if (!threads.empty())
+	int num_threads = FWorkerPool::Instance()->NumWorkers();
+	if ((int)threads.size() == num_threads)
 		return;
 
-	int num_threads = std::thread::hardware_concurrency();
-	if (num_threads == 0)
-		num_threads = 4;
-
-	threads.resize(num_threads);
+	// The line interleaving may only change when no drawer thread has work left
+	if (!active_commands.empty())
+		return;
+	for (auto &thread : threads)
+	{
+		if (thread->scheduled)
+			return;
+	}
 
+	threads.clear();
 	for (int i = 0; i < num_threads; i++)
 	{
-		DrawerThreads *queue = this;
-		DrawerThread *thread = &threads[i];
+		std::unique_ptr<DrawerThread> thread(new DrawerThread());
 		thread->core = i;
 		thread->num_cores = num_threads;
-		thread->thread = std::thread([=]() { queue->WorkerMain(thread); });
+		threads.push_back(std::move(thread));
 	}
 }
 
-void DrawerThreads::StopThreads()
-{
-	std::unique_lock<std::mutex> lock(start_mutex);
-	shutdown_flag = true;
-	lock.unlock();
-	start_condition.notify_all();
-	for (auto &thread : threads)
-		thread.thread.join();
-	threads.clear();
-	lock.lock();
-	shutdown_flag = false;
-}
-
 #ifndef WIN32
 
 void VectoredTryCatch(void *data, void(*tryBlock)(void *data), void(*catchBlock)(void *data, const char *reason, bool fatal))
@@ -36,9 +36,11 @@ EXTERN_CVAR(Bool, r_multithreaded)
 class DrawerThread
 {
 public:
-	std::thread thread;
 	size_t current_queue = 0;
 
+	// True while a job for this thread is queued or running in the worker pool
+	bool scheduled = false;
+
 	// Thread line index of this thread
 	int core = 0;
 
@@ -111,18 +113,15 @@ private:
 	~DrawerThreads();
 	
 	void StartThreads();
-	void StopThreads();
 	void WorkerMain(DrawerThread *thread);
 
 	static DrawerThreads *Instance();
 	static void ReportDrawerError(DrawerCommand *command, bool worker_thread, const char *reason, bool fatal);
 	
-	std::vector<DrawerThread> threads;
+	std::vector<std::unique_ptr<DrawerThread>> threads;
 
 	std::mutex start_mutex;
-	std::condition_variable start_condition;
 	std::vector<DrawerCommandQueuePtr> active_commands;
-	bool shutdown_flag = false;
 
 	std::mutex end_mutex;
 	std::condition_variable end_condition;
@@ -135,6 +134,8 @@ private:
 
 class RenderMemory;
 
+namespace swrenderer { class DrawerRecording; }
+
 class DrawerCommandQueue
 {
 public:
@@ -170,4 +171,5 @@ private:
 	RenderMemory *FrameMemory;
 	
 	friend class DrawerThreads;
+	friend class swrenderer::DrawerRecording;
 };
@@ -25,6 +25,7 @@
 #include "scene/r_portal.cpp"
 #include "scene/r_scene.cpp"
 #include "scene/r_translucent_pass.cpp"
+#include "scene/r_visible_subsectors.cpp"
 #include "segments/r_clipsegment.cpp"
 #include "segments/r_drawsegment.cpp"
 #include "segments/r_portalsegment.cpp"
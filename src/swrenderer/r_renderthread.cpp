@@ -51,6 +51,7 @@
 #include "swrenderer/drawers/r_draw.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
 #include "swrenderer/drawers/r_draw_pal.h"
+#include "swrenderer/drawers/r_draw_record.h"
 #include "swrenderer/viewport/r_viewport.h"
 #include "r_memory.h"
 
@@ -75,6 +76,8 @@ namespace swrenderer
 		ClipSegments.reset(new RenderClipSegment());
 		tc_drawers.reset(new SWTruecolorDrawers(DrawQueue));
 		pal_drawers.reset(new SWPalDrawers(DrawQueue));
+		tc_recorder.reset(new SWRecordingDrawers(tc_drawers.get()));
+		pal_recorder.reset(new SWRecordingDrawers(pal_drawers.get()));
 	}
 
 	RenderThread::~RenderThread()
@@ -83,6 +86,9 @@ namespace swrenderer
 	
 	SWPixelFormatDrawers *RenderThread::Drawers(RenderViewport *viewport)
 	{
+		if (DrawerRecording::IsCapturing())
+			return viewport->RenderTarget->IsBgra() ? tc_recorder.get() : pal_recorder.get();
+
 		if (viewport->RenderTarget->IsBgra())
 			return tc_drawers.get();
 		else
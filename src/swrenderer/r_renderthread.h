@@ -23,7 +23,8 @@
 #pragma once
 
 #include <memory>
-#include <thread>
+#include <mutex>
+#include "stats.h"
 
 class DrawerCommandQueue;
 typedef std::shared_ptr<DrawerCommandQueue> DrawerCommandQueuePtr;
@@ -47,6 +48,7 @@ namespace swrenderer
 	class SWPixelFormatDrawers;
 	class SWTruecolorDrawers;
 	class SWPalDrawers;
+	class SWRecordingDrawers;
 
 	class RenderThread
 	{
@@ -59,6 +61,15 @@ namespace swrenderer
 		int X2 = MAXWIDTH;
 		bool MainThread = false;
 
+		// Column tiles not yet taken by this thread. Other threads steal from the end.
+		std::mutex TileMutex;
+		int TileStart = 0;
+		int TileEnd = 0;
+
+		// Load balancing statistics for the last frame
+		cycle_t BusyCycles;
+		int TilesRendered = 0;
+
 		std::unique_ptr<RenderMemory> FrameMemory;
 		std::unique_ptr<RenderOpaquePass> OpaquePass;
 		std::unique_ptr<RenderTranslucentPass> TranslucentPass;
@@ -73,8 +84,6 @@ namespace swrenderer
 		std::unique_ptr<LightVisibility> Light;
 		DrawerCommandQueuePtr DrawQueue;
 
-		std::thread thread;
-
 		// VisibleSprite working buffers
 		short clipbot[MAXWIDTH];
 		short cliptop[MAXWIDTH];
@@ -90,5 +99,7 @@ namespace swrenderer
 	private:
 		std::unique_ptr<SWTruecolorDrawers> tc_drawers;
 		std::unique_ptr<SWPalDrawers> pal_drawers;
+		std::unique_ptr<SWRecordingDrawers> tc_recorder;
+		std::unique_ptr<SWRecordingDrawers> pal_recorder;
 	};
 }
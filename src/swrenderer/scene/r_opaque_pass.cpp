@@ -50,6 +50,7 @@
 #include "swrenderer/line/r_farclip_line.h"
 #include "swrenderer/scene/r_scene.h"
 #include "swrenderer/scene/r_light.h"
+#include "swrenderer/scene/r_visible_subsectors.h"
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/r_renderthread.h"
 #include "r_3dfloors.h"
@@ -316,9 +317,14 @@ namespace swrenderer
 
 
 
+	bool RenderOpaquePass::CheckBBox(float *bspcoord)
+	{
+		return CheckBBox(Thread, Thread->ClipSegments.get(), bspcoord);
+	}
+
 	// Checks BSP node/subtree bounding box.
 	// Returns true if some part of the bbox might be visible.
-	bool RenderOpaquePass::CheckBBox(float *bspcoord)
+	bool RenderOpaquePass::CheckBBox(RenderThread *thread, RenderClipSegment *clipsegments, float *bspcoord)
 	{
 		static const int checkcoord[12][4] =
 		{
@@ -345,16 +351,16 @@ namespace swrenderer
 
 		// Find the corners of the box
 		// that define the edges from current viewpoint.
-		if (Thread->Viewport->viewpoint.Pos.X <= bspcoord[BOXLEFT])
+		if (thread->Viewport->viewpoint.Pos.X <= bspcoord[BOXLEFT])
 			boxx = 0;
-		else if (Thread->Viewport->viewpoint.Pos.X < bspcoord[BOXRIGHT])
+		else if (thread->Viewport->viewpoint.Pos.X < bspcoord[BOXRIGHT])
 			boxx = 1;
 		else
 			boxx = 2;
 
-		if (Thread->Viewport->viewpoint.Pos.Y >= bspcoord[BOXTOP])
+		if (thread->Viewport->viewpoint.Pos.Y >= bspcoord[BOXTOP])
 			boxy = 0;
-		else if (Thread->Viewport->viewpoint.Pos.Y > bspcoord[BOXBOTTOM])
+		else if (thread->Viewport->viewpoint.Pos.Y > bspcoord[BOXBOTTOM])
 			boxy = 1;
 		else
 			boxy = 2;
@@ -363,10 +369,10 @@ namespace swrenderer
 		if (boxpos == 5)
 			return true;
 
-		x1 = bspcoord[checkcoord[boxpos][0]] - Thread->Viewport->viewpoint.Pos.X;
-		y1 = bspcoord[checkcoord[boxpos][1]] - Thread->Viewport->viewpoint.Pos.Y;
-		x2 = bspcoord[checkcoord[boxpos][2]] - Thread->Viewport->viewpoint.Pos.X;
-		y2 = bspcoord[checkcoord[boxpos][3]] - Thread->Viewport->viewpoint.Pos.Y;
+		x1 = bspcoord[checkcoord[boxpos][0]] - thread->Viewport->viewpoint.Pos.X;
+		y1 = bspcoord[checkcoord[boxpos][1]] - thread->Viewport->viewpoint.Pos.Y;
+		x2 = bspcoord[checkcoord[boxpos][2]] - thread->Viewport->viewpoint.Pos.X;
+		y2 = bspcoord[checkcoord[boxpos][3]] - thread->Viewport->viewpoint.Pos.Y;
 
 		// check clip list for an open space
 
@@ -374,12 +380,12 @@ namespace swrenderer
 		if (y1 * (x1 - x2) + x1 * (y2 - y1) >= -EQUAL_EPSILON)
 			return true;
 
-		rx1 = x1 * Thread->Viewport->viewpoint.Sin - y1 * Thread->Viewport->viewpoint.Cos;
-		rx2 = x2 * Thread->Viewport->viewpoint.Sin - y2 * Thread->Viewport->viewpoint.Cos;
-		ry1 = x1 * Thread->Viewport->viewpoint.TanCos + y1 * Thread->Viewport->viewpoint.TanSin;
-		ry2 = x2 * Thread->Viewport->viewpoint.TanCos + y2 * Thread->Viewport->viewpoint.TanSin;
+		rx1 = x1 * thread->Viewport->viewpoint.Sin - y1 * thread->Viewport->viewpoint.Cos;
+		rx2 = x2 * thread->Viewport->viewpoint.Sin - y2 * thread->Viewport->viewpoint.Cos;
+		ry1 = x1 * thread->Viewport->viewpoint.TanCos + y1 * thread->Viewport->viewpoint.TanSin;
+		ry2 = x2 * thread->Viewport->viewpoint.TanCos + y2 * thread->Viewport->viewpoint.TanSin;
 
-		if (Thread->Portal->MirrorFlags & RF_XFLIP)
+		if (thread->Portal->MirrorFlags & RF_XFLIP)
 		{
 			double t = -rx1;
 			rx1 = -rx2;
@@ -387,7 +393,7 @@ namespace swrenderer
 			swapvalues(ry1, ry2);
 		}
 		
-		auto viewport = Thread->Viewport.get();
+		auto viewport = thread->Viewport.get();
 
 		if (rx1 >= -ry1)
 		{
@@ -418,7 +424,7 @@ namespace swrenderer
 		// Find the first clippost that touches the source post
 		//	(adjacent pixels are touching).
 
-		return Thread->ClipSegments->IsVisible(sx1, sx2);
+		return clipsegments->IsVisible(sx1, sx2);
 	}
 
 	void RenderOpaquePass::AddPolyobjs(subsector_t *sub)
@@ -754,7 +760,7 @@ namespace swrenderer
 		if ((unsigned int)(sub->Index()) < level.subsectors.Size())
 		{ // Only do it for the main BSP.
 			int shade = LightVisibility::LightLevelToShade((floorlightlevel + ceilinglightlevel) / 2 + LightVisibility::ActualExtraLight(foggy, Thread->Viewport.get()), foggy);
-			for (int i = ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = Particles[i].snext)
+			for (uint32_t i = ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = Particles[i].snext)
 			{
 				RenderParticle::Project(Thread, Particles + i, sub->sector, shade, FakeSide, foggy);
 			}
@@ -817,7 +823,7 @@ namespace swrenderer
 		}
 	}
 
-	void RenderOpaquePass::RenderScene()
+	void RenderOpaquePass::RenderScene(const VisibleSubsectorList *visibleSubsectors)
 	{
 		if (Thread->MainThread)
 			WallCycles.Clock();
@@ -826,7 +832,10 @@ namespace swrenderer
 		SeenActors.clear();
 
 		InSubsector = nullptr;
-		RenderBSPNode(level.HeadNode());	// The head node is the last node output.
+		if (visibleSubsectors && visibleSubsectors->IsValid())
+			RenderVisibleSubsectors(visibleSubsectors);
+		else
+			RenderBSPNode(level.HeadNode());	// The head node is the last node output.
 
 		if (Thread->MainThread)
 			WallCycles.Unclock();
@@ -865,6 +874,31 @@ namespace swrenderer
 		RenderSubsector((subsector_t *)((uint8_t *)node - 1));
 	}
 
+	// Same as RenderBSPNode for the head node, but using the traversal already done for the whole view
+	void RenderOpaquePass::RenderVisibleSubsectors(const VisibleSubsectorList *visibleSubsectors)
+	{
+		const auto &entries = visibleSubsectors->Entries();
+		int count = (int)entries.size();
+		int index = 0;
+		while (index < count)
+		{
+			const VisibleBSPEntry &entry = entries[index];
+			if (entry.Subsector)
+			{
+				RenderSubsector(entry.Subsector);
+				index++;
+			}
+			else if (CheckBBox(entry.BBox))
+			{
+				index++;
+			}
+			else
+			{
+				index = entry.SkipTo;
+			}
+		}
+	}
+
 	void RenderOpaquePass::ClearClip()
 	{
 		// clip ceiling to console bottom
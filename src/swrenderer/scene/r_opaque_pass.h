@@ -33,6 +33,8 @@ struct FVoxelDef;
 namespace swrenderer
 {
 	class RenderThread;
+	class RenderClipSegment;
+	class VisibleSubsectorList;
 	struct VisiblePlane;
 
 	// The 3072 below is just an arbitrary value picked to avoid
@@ -64,13 +66,16 @@ namespace swrenderer
 		RenderOpaquePass(RenderThread *thread);
 
 		void ClearClip();
-		void RenderScene();
+		void RenderScene(const VisibleSubsectorList *visibleSubsectors = nullptr);
 
 		void ResetFakingUnderwater() { r_fakingunderwater = false; }
 		sector_t *FakeFlat(sector_t *sec, sector_t *tempsec, int *floorlightlevel, int *ceilinglightlevel, seg_t *backline, int backx1, int backx2, double frontcz1, double frontcz2);
 		
 		void ClearSeenSprites() { SeenSpriteSectors.clear(); SeenActors.clear(); }
 
+		// Checks BSP node/subtree bounding box against a clip segment list.
+		static bool CheckBBox(RenderThread *thread, RenderClipSegment *clipsegments, float *bspcoord);
+
 		short floorclip[MAXWIDTH];
 		short ceilingclip[MAXWIDTH];
 
@@ -78,6 +83,7 @@ namespace swrenderer
 
 	private:
 		void RenderBSPNode(void *node);
+		void RenderVisibleSubsectors(const VisibleSubsectorList *visibleSubsectors);
 		void RenderSubsector(subsector_t *sub);
 
 		bool CheckBBox(float *bspcoord);
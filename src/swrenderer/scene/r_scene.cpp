@@ -46,6 +46,7 @@
 #include "swrenderer/scene/r_opaque_pass.h"
 #include "swrenderer/scene/r_translucent_pass.h"
 #include "swrenderer/scene/r_portal.h"
+#include "swrenderer/scene/r_visible_subsectors.h"
 #include "swrenderer/segments/r_clipsegment.h"
 #include "swrenderer/segments/r_drawsegment.h"
 #include "swrenderer/segments/r_portalsegment.h"
@@ -53,26 +54,34 @@
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/drawers/r_draw.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw_record.h"
 #include "swrenderer/drawers/r_thread.h"
 #include "swrenderer/r_memory.h"
 #include "swrenderer/r_renderthread.h"
 #include "swrenderer/things/r_playersprite.h"
-#include <chrono>
-
-#ifdef WIN32
-void PeekThreadedErrorPane();
-#endif
+#include "workerpool.h"
 
 EXTERN_CVAR(Bool, r_shadercolormaps)
 EXTERN_CVAR(Int, r_clearbuffer)
 
 CVAR(Bool, r_scene_multithreaded, false, 0);
+CVAR(Int, r_scene_tilesperthread, 4, 0);
+CVAR(Bool, r_scene_sharedbsp, true, 0);
 
 namespace swrenderer
 {
 	cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
+	static cycle_t SliceCycles, BSPCycles;
+	static int SharedSubsectors;
+
+	struct SceneThreadStats
+	{
+		double BusyMS;
+		int Tiles;
+	};
+	static TArray<SceneThreadStats> ThreadStats;
 	
-	RenderScene::RenderScene()
+	RenderScene::RenderScene() : VisibleSubsectors(new VisibleSubsectorList())
 	{
 		Threads.push_back(std::unique_ptr<RenderThread>(new RenderThread(this)));
 	}
@@ -98,6 +107,8 @@ namespace swrenderer
 		ActiveRatio(width, height, &trueratio);
 		viewport->SetViewport(MainThread(), width, height, trueratio);
 
+		DrawerRecording::BeginFrame(viewport);
+
 		if (r_clearbuffer != 0)
 		{
 			if (!viewport->RenderTarget->IsBgra())
@@ -127,6 +138,8 @@ namespace swrenderer
 		DrawerWaitCycles.Clock();
 		DrawerThreads::WaitForWorkers();
 		DrawerWaitCycles.Unclock();
+
+		DrawerRecording::EndFrame();
 	}
 
 	void RenderScene::RenderActorView(AActor *actor, bool dontmaplines)
@@ -191,9 +204,7 @@ namespace swrenderer
 
 	void RenderScene::RenderThreadSlices()
 	{
-		int numThreads = std::thread::hardware_concurrency();
-		if (numThreads == 0)
-			numThreads = 4;
+		int numThreads = FWorkerPool::Instance()->NumWorkers();
 
 		if (!r_scene_multithreaded || !r_multithreaded)
 			numThreads = 1;
@@ -204,43 +215,64 @@ namespace swrenderer
 			StartThreads(numThreads);
 		}
 
+		// Split the view into narrow column tiles. Each thread starts out owning a contiguous
+		// range of them and steals from the other threads once its own range is exhausted.
+		int numTiles = numThreads;
+		if (numThreads > 1)
+			numTiles = clamp(numThreads * (int)r_scene_tilesperthread, numThreads, MAX(viewwidth / 8, numThreads));
+		num_tiles = numTiles;
+
 		// Setup threads:
-		std::unique_lock<std::mutex> start_lock(start_mutex);
 		for (int i = 0; i < numThreads; i++)
 		{
 			*Threads[i]->Viewport = *MainThread()->Viewport;
 			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			Threads[i]->TileStart = numTiles * i / numThreads;
+			Threads[i]->TileEnd = numTiles * (i + 1) / numThreads;
+			Threads[i]->TilesRendered = 0;
+			Threads[i]->BusyCycles.Reset();
 		}
-		run_id++;
-		start_lock.unlock();
 
-		// Notify threads to run
-		if (Threads.size() > 1)
+		// Walk the BSP once for the whole view rather than once per tile
+		BSPCycles.Reset();
+		if (numThreads > 1 && r_scene_sharedbsp)
+		{
+			BSPCycles.Clock();
+			MainThread()->X1 = 0;
+			MainThread()->X2 = viewwidth;
+			MainThread()->Portal->SetMainPortal();
+			VisibleSubsectors->Collect(MainThread());
+			BSPCycles.Unclock();
+			SharedSubsectors = VisibleSubsectors->NumSubsectors();
+		}
+		else
 		{
-			start_condition.notify_all();
+			VisibleSubsectors->Invalidate();
+			SharedSubsectors = 0;
 		}
 
-		// Do the main thread ourselves:
-		RenderThreadSlice(MainThread());
+		SliceCycles.Reset();
+		SliceCycles.Clock();
 
-		// Wait for everyone to finish:
-		if (Threads.size() > 1)
+		// Run the other threads in the worker pool:
+		FJobGroup group;
+		for (int i = 1; i < numThreads; i++)
 		{
-			using namespace std::chrono_literals;
-			std::unique_lock<std::mutex> end_lock(end_mutex);
-			finished_threads++;
-			if (!end_condition.wait_for(end_lock, 5s, [&]() { return finished_threads == Threads.size(); }))
-			{
-#ifdef WIN32
-				PeekThreadedErrorPane();
-#endif
-				// Invoke the crash reporter so that we can capture the call stack of whatever the hung worker thread is doing
-				int *threadCrashed = nullptr;
-				*threadCrashed = 0xdeadbeef;
-			}
-			finished_threads = 0;
+			RenderThread *thread = Threads[i].get();
+			group.Run([=]() { RenderThreadTiles(thread); }, i);
+		}
+
+		// Do the main thread ourselves and wait for everyone to finish:
+		RenderThreadTiles(MainThread());
+		group.Wait();
+
+		SliceCycles.Unclock();
+
+		ThreadStats.Resize(numThreads);
+		for (int i = 0; i < numThreads; i++)
+		{
+			ThreadStats[i].BusyMS = Threads[i]->BusyCycles.TimeMS();
+			ThreadStats[i].Tiles = Threads[i]->TilesRendered;
 		}
 
 		// Change main thread back to covering the whole screen for player sprites
@@ -248,10 +280,69 @@ namespace swrenderer
 		MainThread()->X2 = viewwidth;
 	}
 
-	void RenderScene::RenderThreadSlice(RenderThread *thread)
+	void RenderScene::RenderThreadTiles(RenderThread *thread)
 	{
 		thread->DrawQueue->Clear();
 		thread->FrameMemory->Clear();
+
+		// The frame memory is kept alive until all tiles of this thread are done,
+		// as the queued drawer commands may point into it.
+		int tile;
+		while (NextTile(thread, tile))
+		{
+			thread->BusyCycles.Clock();
+			thread->X1 = viewwidth * tile / num_tiles;
+			thread->X2 = viewwidth * (tile + 1) / num_tiles;
+			RenderThreadSlice(thread);
+			thread->TilesRendered++;
+			thread->BusyCycles.Unclock();
+		}
+
+		DrawerThreads::Execute(thread->DrawQueue);
+	}
+
+	bool RenderScene::NextTile(RenderThread *thread, int &tile)
+	{
+		// Take the next tile from our own range first:
+		{
+			std::unique_lock<std::mutex> lock(thread->TileMutex);
+			if (thread->TileStart < thread->TileEnd)
+			{
+				tile = thread->TileStart++;
+				return true;
+			}
+		}
+
+		// Steal from the end of whichever thread has the most tiles left:
+		while (true)
+		{
+			RenderThread *victim = nullptr;
+			int mostLeft = 0;
+			for (auto &other : Threads)
+			{
+				std::unique_lock<std::mutex> lock(other->TileMutex);
+				int left = other->TileEnd - other->TileStart;
+				if (left > mostLeft)
+				{
+					mostLeft = left;
+					victim = other.get();
+				}
+			}
+
+			if (!victim)
+				return false;
+
+			std::unique_lock<std::mutex> lock(victim->TileMutex);
+			if (victim->TileStart < victim->TileEnd)
+			{
+				tile = --victim->TileEnd;
+				return true;
+			}
+		}
+	}
+
+	void RenderScene::RenderThreadSlice(RenderThread *thread)
+	{
 		thread->Clip3D->Cleanup();
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
 		thread->Portal->CopyStackedViewParameters();
@@ -270,7 +361,7 @@ namespace swrenderer
 		if (thread->X2 < viewwidth)
 			thread->ClipSegments->Clip(thread->X2, viewwidth, true, &visitor);
 
-		thread->OpaquePass->RenderScene();
+		thread->OpaquePass->RenderScene(VisibleSubsectors.get());
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
 
 		if (thread->MainThread)
@@ -291,56 +382,22 @@ namespace swrenderer
 			if (thread->MainThread)
 				NetUpdate();
 		}
-
-		DrawerThreads::Execute(thread->DrawQueue);
 	}
 
 	void RenderScene::StartThreads(size_t numThreads)
 	{
 		while (Threads.size() < (size_t)numThreads)
 		{
-			std::unique_ptr<RenderThread> thread(new RenderThread(this, false));
-			auto renderthread = thread.get();
-			int start_run_id = run_id;
-			thread->thread = std::thread([=]()
-			{
-				int last_run_id = start_run_id;
-				while (true)
-				{
-					// Wait until we are signalled to run:
-					std::unique_lock<std::mutex> start_lock(start_mutex);
-					start_condition.wait(start_lock, [&]() { return run_id != last_run_id || shutdown_flag; });
-					if (shutdown_flag)
-						break;
-					last_run_id = run_id;
-					start_lock.unlock();
-
-					RenderThreadSlice(renderthread);
-
-					// Notify main thread that we finished:
-					std::unique_lock<std::mutex> end_lock(end_mutex);
-					finished_threads++;
-					end_lock.unlock();
-					end_condition.notify_all();
-				}
-			});
-			Threads.push_back(std::move(thread));
+			Threads.push_back(std::unique_ptr<RenderThread>(new RenderThread(this, false)));
 		}
 	}
 
 	void RenderScene::StopThreads()
 	{
-		std::unique_lock<std::mutex> lock(start_mutex);
-		shutdown_flag = true;
-		lock.unlock();
-		start_condition.notify_all();
 		while (Threads.size() > 1)
 		{
-			Threads.back()->thread.join();
 			Threads.pop_back();
 		}
-		lock.lock();
-		shutdown_flag = false;
 	}
 
 	void RenderScene::RenderViewToCanvas(AActor *actor, DCanvas *canvas, int x, int y, int width, int height, bool dontmaplines)
@@ -412,6 +469,21 @@ namespace swrenderer
 		return out;
 	}
 
+	ADD_STAT(scenethreads)
+	{
+		FString out;
+		double total = SliceCycles.TimeMS();
+		out.Format("slices=%04.1f ms", total);
+		if (SharedSubsectors > 0)
+			out.AppendFormat("  bsp=%04.1f ms  subsectors=%d", BSPCycles.TimeMS(), SharedSubsectors);
+		for (unsigned i = 0; i < ThreadStats.Size(); i++)
+		{
+			double busy = ThreadStats[i].BusyMS;
+			out.AppendFormat("\nthread %u: busy=%04.1f ms  idle=%04.1f ms  tiles=%d", i, busy, MAX(total - busy, 0.0), ThreadStats[i].Tiles);
+		}
+		return out;
+	}
+
 	static double f_acc, w_acc, p_acc, m_acc, drawer_acc;
 	static int acc_c;
 
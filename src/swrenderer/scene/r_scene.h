@@ -24,9 +24,6 @@
 #include <stddef.h>
 #include <vector>
 #include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
 #include "r_defs.h"
 #include "d_player.h"
 
@@ -37,6 +34,7 @@ namespace swrenderer
 	extern cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
 
 	class RenderThread;
+	class VisibleSubsectorList;
 	
 	class RenderScene
 	{
@@ -60,7 +58,9 @@ namespace swrenderer
 	private:
 		void RenderActorView(AActor *actor, bool dontmaplines = false);
 		void RenderThreadSlices();
+		void RenderThreadTiles(RenderThread *thread);
 		void RenderThreadSlice(RenderThread *thread);
+		bool NextTile(RenderThread *thread, int &tile);
 		void RenderPSprites();
 
 		void StartThreads(size_t numThreads);
@@ -70,12 +70,7 @@ namespace swrenderer
 		int clearcolor = 0;
 
 		std::vector<std::unique_ptr<RenderThread>> Threads;
-		std::mutex start_mutex;
-		std::condition_variable start_condition;
-		bool shutdown_flag = false;
-		int run_id = 0;
-		std::mutex end_mutex;
-		std::condition_variable end_condition;
-		size_t finished_threads = 0;
+		std::unique_ptr<VisibleSubsectorList> VisibleSubsectors;
+		int num_tiles = 1;
 	};
 }
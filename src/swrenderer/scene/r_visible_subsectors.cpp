@@ -0,0 +1,137 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright 1993-1996 id Software
+// Copyright 1999-2016 Randy Heit
+// Copyright 2016 Magnus Norddahl
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include "templates.h"
+#include "doomdef.h"
+#include "m_bbox.h"
+#include "p_setup.h"
+#include "r_state.h"
+#include "r_utility.h"
+#include "g_levellocals.h"
+#include "swrenderer/viewport/r_viewport.h"
+#include "swrenderer/line/r_line.h"
+#include "swrenderer/segments/r_clipsegment.h"
+#include "swrenderer/scene/r_opaque_pass.h"
+#include "swrenderer/scene/r_visible_subsectors.h"
+#include "swrenderer/r_renderthread.h"
+
+namespace swrenderer
+{
+	VisibleSubsectorList::VisibleSubsectorList() : ClipSegments(new RenderClipSegment())
+	{
+	}
+
+	VisibleSubsectorList::~VisibleSubsectorList()
+	{
+	}
+
+	void VisibleSubsectorList::Collect(RenderThread *thread)
+	{
+		Thread = thread;
+		List.clear();
+		OpenChecks.clear();
+		SubsectorCount = 0;
+
+		ClipSegments->Clear(0, viewwidth);
+		CollectNode(level.HeadNode());
+
+		Valid = true;
+	}
+
+	void VisibleSubsectorList::CollectNode(void *node)
+	{
+		if (level.nodes.Size() == 0)
+		{
+			CollectSubsector(&level.subsectors[0]);
+			return;
+		}
+
+		size_t firstCheck = OpenChecks.size();
+		while (!((size_t)node & 1))  // Keep going until found a subsector
+		{
+			node_t *bsp = (node_t *)node;
+
+			// Decide which side the view point is on.
+			int side = R_PointOnSide(Thread->Viewport->viewpoint.Pos, bsp);
+
+			// Recursively divide front space (toward the viewer).
+			CollectNode(bsp->children[side]);
+
+			// Possibly divide back space (away from the viewer).
+			side ^= 1;
+			if (!RenderOpaquePass::CheckBBox(Thread, ClipSegments.get(), bsp->bbox[side]))
+			{
+				node = nullptr;
+				break;
+			}
+
+			// Each scene thread repeats the check against its own clip segments
+			OpenChecks.push_back((int)List.size());
+			List.push_back({ nullptr, bsp->bbox[side], 0 });
+
+			node = bsp->children[side];
+		}
+
+		if (node)
+			CollectSubsector((subsector_t *)((uint8_t *)node - 1));
+
+		// The rest of this subtree is behind all the checks made by this call
+		for (size_t i = firstCheck; i < OpenChecks.size(); i++)
+			List[OpenChecks[i]].SkipTo = (int)List.size();
+		OpenChecks.resize(firstCheck);
+	}
+
+	void VisibleSubsectorList::CollectSubsector(subsector_t *sub)
+	{
+		List.push_back({ sub, nullptr, 0 });
+		SubsectorCount++;
+
+		// Polyobjects are rendered from their own mini-BSP
+		if (sub->polys)
+			return;
+
+		// Only one-sided walls are solid for every scene thread. Whether a two-sided line
+		// closes the view depends on the sector heights, 3D floors and portals.
+		DVector2 viewpointPos = Thread->Viewport->viewpoint.Pos.XY();
+		VisibleSegmentRenderer visitor;
+		seg_t *line = sub->firstline;
+		for (uint32_t i = 0; i < sub->numlines; i++, line++)
+		{
+			if (line->linedef == nullptr || line->backsector != nullptr || line->sidedef == nullptr || (line->sidedef->Flags & WALLF_POLYOBJ))
+				continue;
+
+			DVector2 pt1 = line->v1->fPos() - viewpointPos;
+			DVector2 pt2 = line->v2->fPos() - viewpointPos;
+
+			// Reject lines not facing viewer
+			if (pt1.Y * (pt1.X - pt2.X) + pt1.X * (pt2.Y - pt1.Y) >= 0)
+				continue;
+
+			// Must match the projection used by SWRenderLine so that the same columns become solid
+			FWallCoords WallC;
+			if (WallC.Init(Thread, pt1, pt2, 32.0 / (1 << 12)))
+				continue;
+
+			ClipSegments->Clip(WallC.sx1, WallC.sx2, true, &visitor);
+		}
+	}
+}
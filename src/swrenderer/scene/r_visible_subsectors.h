@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright 1993-1996 id Software
+// Copyright 1999-2016 Randy Heit
+// Copyright 2016 Magnus Norddahl
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "r_defs.h"
+
+namespace swrenderer
+{
+	class RenderThread;
+	class RenderClipSegment;
+
+	struct VisibleBSPEntry
+	{
+		// Subsector to render, or nullptr if this is a bounding box check
+		subsector_t *Subsector;
+
+		// Back side bounding box of a node. If no part of it is visible, continue at SkipTo.
+		float *BBox;
+		int SkipTo;
+	};
+
+	// Front to back list of the subsectors that can be seen anywhere in the main view.
+	//
+	// The BSP is walked once per frame for the whole view width, clipping only against
+	// one-sided walls. The scene threads then replay the list for their own columns
+	// instead of each of them traversing the nodes again. Node bounding box checks are
+	// kept in the list so that a thread skips the same subtrees it would have skipped
+	// when walking the BSP itself.
+	class VisibleSubsectorList
+	{
+	public:
+		VisibleSubsectorList();
+		~VisibleSubsectorList();
+
+		// Walks the BSP from the viewpoint of the thread, which must be set up for the main view
+		void Collect(RenderThread *thread);
+		void Invalidate() { Valid = false; }
+
+		bool IsValid() const { return Valid; }
+		const std::vector<VisibleBSPEntry> &Entries() const { return List; }
+		int NumSubsectors() const { return SubsectorCount; }
+
+	private:
+		void CollectNode(void *node);
+		void CollectSubsector(subsector_t *sub);
+
+		RenderThread *Thread = nullptr;
+		std::unique_ptr<RenderClipSegment> ClipSegments;
+		std::vector<VisibleBSPEntry> List;
+		std::vector<int> OpenChecks;
+		int SubsectorCount = 0;
+		bool Valid = false;
+	};
+}
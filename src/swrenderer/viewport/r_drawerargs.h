@@ -44,6 +44,8 @@ namespace swrenderer
 		float mLight = 0.0f;
 		int mShade = 0;
 		uint8_t *mTranslation = nullptr;
+
+		friend class DrawerStream;
 	};
 
 	struct ShadeConstants
@@ -58,5 +58,8 @@ namespace swrenderer
 		uint32_t solid_bottom;
 		bool fadeSky;
 		RenderViewport *dc_viewport = nullptr;
+
+		friend class DrawerBenchmark;
+		friend class DrawerStream;
 	};
 }
@@ -83,5 +83,8 @@ namespace swrenderer
 		int ds_color = 0;
 		double ds_lod;
 		RenderViewport *ds_viewport = nullptr;
+
+		friend class DrawerBenchmark;
+		friend class DrawerStream;
 	};
 }
@@ -109,5 +109,7 @@ namespace swrenderer
 
 		friend class DrawVoxelBlocksRGBACommand;
 		friend class DrawVoxelBlocksPalCommand;
+		friend class DrawerBenchmark;
+		friend class DrawerStream;
 	};
 }
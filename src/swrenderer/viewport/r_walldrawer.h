@@ -81,5 +81,8 @@ namespace swrenderer
 		WallDrawerFunc wallfunc = nullptr;
 
 		RenderViewport *dc_viewport = nullptr;
+
+		friend class DrawerBenchmark;
+		friend class DrawerStream;
 	};
 }
@@ -374,6 +374,27 @@ void FTextureManager::UnloadAll ()
 	}
 }
 
+//==========================================================================
+//
+// FTextureManager :: PrefetchTextures
+//
+// Starts decompressing the source lumps of all textures in the hit list
+// in the background so that the renderer's precaching finds them ready.
+//
+//==========================================================================
+
+void FTextureManager::PrefetchTextures (const uint8_t *hitlist)
+{
+	for (unsigned int i = 0; i < Textures.Size(); ++i)
+	{
+		FTexture *tex = Textures[i].Texture;
+		if (hitlist[i] && !tex->bMultiPatch && tex->GetSourceLump() >= 0)
+		{
+			Wads.PrefetchLump(tex->GetSourceLump());
+		}
+	}
+}
+
 //==========================================================================
 //
 // FTextureManager :: AddTexture
@@ -502,6 +502,7 @@ public:
 	void ReplaceTexture (FTextureID picnum, FTexture *newtexture, bool free);
 
 	void UnloadAll ();
+	void PrefetchTextures (const uint8_t *hitlist);
 
 	int NumTextures () const { return (int)Textures.Size(); }
 
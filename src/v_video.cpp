@@ -465,7 +465,7 @@ normal:
 
 FString V_GetColorStringByName (const char *name, FScriptPosition *sc)
 {
-	FMemLump rgbNames;
+	FString rgbNames;
 	char *rgbEnd;
 	char *rgb, *endp;
 	int rgblump;
@@ -482,9 +482,10 @@ FString V_GetColorStringByName (const char *name, FScriptPosition *sc)
 		return FString();
 	}
 
-	rgbNames = Wads.ReadLump (rgblump);
-	rgb = (char *)rgbNames.GetMem();
-	rgbEnd = rgb + Wads.LumpLength (rgblump);
+	// strtoul needs the terminator that the lump data itself does not have
+	rgbNames = Wads.ReadLump (rgblump).GetString();
+	rgb = (char *)rgbNames.GetChars();
+	rgbEnd = rgb + rgbNames.Len();
 	step = 0;
 	namelen = strlen (name);
 
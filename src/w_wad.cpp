@@ -58,6 +58,7 @@
 #include "md5.h"
 #include "doomstat.h"
 #include "vm.h"
+#include "c_cvars.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -85,6 +86,9 @@ static void PrintLastError ();
 
 FWadCollection Wads;
 
+// Memory map resource files so that stored lumps do not need a heap copy.
+CVAR(Bool, w_mmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 // CODE --------------------------------------------------------------------
@@ -242,7 +246,21 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 		}
 		isdir = (info.st_mode & S_IFDIR) != 0;
 
-		if (!isdir)
+		if (!isdir && w_mmap)
+		{
+			// Map the file so that stored lumps can be used without copying them.
+			MappedFileReader *mapped = new MappedFileReader;
+			if (mapped->Map(filename))
+			{
+				wadinfo = mapped;
+			}
+			else
+			{
+				delete mapped;
+			}
+		}
+
+		if (!isdir && wadinfo == NULL)
 		{
 			try
 			{
@@ -1294,9 +1312,37 @@ void FWadCollection::ReadLump (int lump, void *dest)
 
 FMemLump FWadCollection::ReadLump (int lump)
 {
+	if ((unsigned)lump < (unsigned)NumLumps)
+	{
+		// Share the lump's cache instead of making another copy. For lumps stored
+		// uncompressed in a memory mapped archive it points straight into the mapping,
+		// so only compressed lumps end up on the heap.
+		FResourceLump *l = LumpInfo[lump].lump;
+		if (l->LumpSize > 0 && l->CacheLump() != NULL)
+		{
+			return FMemLump(l);
+		}
+	}
 	return FMemLump(FString(ELumpNum(lump)));
 }
 
+//==========================================================================
+//
+// PrefetchLump
+//
+// Lets the lump's archive prepare its data on a worker thread so that a
+// later ReadLump or CacheLump does not have to wait for decompression.
+//
+//==========================================================================
+
+void FWadCollection::PrefetchLump (int lump)
+{
+	if ((unsigned)lump < (unsigned)NumLumps)
+	{
+		LumpInfo[lump].lump->Prefetch();
+	}
+}
+
 DEFINE_ACTION_FUNCTION(_Wads, ReadLump)
 {
 	PARAM_PROLOGUE;
@@ -1641,27 +1687,58 @@ char *FWadLump::Gets(char *strbuf, int len)
 // FMemLump -----------------------------------------------------------------
 
 FMemLump::FMemLump ()
+: Lump(NULL)
 {
 }
 
 FMemLump::FMemLump (const FMemLump &copy)
+: Block(copy.Block), Lump(copy.Lump)
 {
-	Block = copy.Block;
+	if (Lump != NULL) Lump->CacheLump();
 }
 
 FMemLump &FMemLump::operator = (const FMemLump &copy)
 {
+	if (copy.Lump != NULL) copy.Lump->CacheLump();
+	if (Lump != NULL) Lump->ReleaseCache();
 	Block = copy.Block;
+	Lump = copy.Lump;
 	return *this;
 }
 
 FMemLump::FMemLump (const FString &source)
-: Block (source)
+: Block (source), Lump(NULL)
+{
+}
+
+// The lump must already be cached. This takes over that reference.
+FMemLump::FMemLump (FResourceLump *lump)
+: Lump(lump)
 {
 }
 
 FMemLump::~FMemLump ()
 {
+	if (Lump != NULL) Lump->ReleaseCache();
+}
+
+void *FMemLump::GetMem ()
+{
+	if (Lump != NULL) return Lump->Cache;
+	return Block.Len() == 0 ? NULL : (void *)Block.GetChars();
+}
+
+size_t FMemLump::GetSize ()
+{
+	// Copies hold an extra terminating 0 that is not part of the lump.
+	if (Lump != NULL) return Lump->LumpSize;
+	return Block.Len() == 0 ? 0 : Block.Len() - 1;
+}
+
+FString FMemLump::GetString ()
+{
+	if (Lump != NULL) return FString(Lump->Cache, Lump->LumpSize);
+	return Block;
 }
 
 FString::FString (ELumpNum lumpnum)
@@ -106,7 +106,9 @@ private:
 };
 
 
-// A lump in memory.
+// A lump in memory. This is a view of the lump's cache, which for lumps stored
+// uncompressed in a memory mapped archive is the mapping itself. The data is not
+// zero terminated, so use GetString for text.
 class FMemLump
 {
 public:
@@ -115,14 +117,16 @@ public:
 	FMemLump (const FMemLump &copy);
 	FMemLump &operator= (const FMemLump &copy);
 	~FMemLump ();
-	void *GetMem () { return Block.Len() == 0 ? NULL : (void *)Block.GetChars(); }
-	size_t GetSize () { return Block.Len(); }
-	FString GetString () { return Block; }
+	void *GetMem ();
+	size_t GetSize ();
+	FString GetString ();
 
 private:
 	FMemLump (const FString &source);
+	FMemLump (FResourceLump *lump);
 
 	FString Block;
+	FResourceLump *Lump;
 
 	friend class FWadCollection;
 };
@@ -175,6 +179,7 @@ public:
 	void ReadLump (int lump, void *dest);
 	FMemLump ReadLump (int lump);
 	FMemLump ReadLump (const char *name) { return ReadLump (GetNumForName (name)); }
+	void PrefetchLump (int lump);		// Starts decompressing a lump in the background
 
 	FWadLump OpenLumpNum (int lump);
 	FWadLump OpenLumpName (const char *name) { return OpenLumpNum (GetNumForName (name)); }
@@ -0,0 +1,289 @@
+/*
+** workerpool.cpp
+** Engine-wide worker thread pool
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include "workerpool.h"
+#include "c_cvars.h"
+#include "templates.h"
+
+CUSTOM_CVAR(Int, r_threads, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOINITCALL)
+{
+	if (self < 0)
+		self = 0;
+	else
+		FWorkerPool::Instance()->Restart();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+FWorkerPool *FWorkerPool::Instance()
+{
+	static FWorkerPool pool;
+	return &pool;
+}
+
+FWorkerPool::FWorkerPool() : next_worker(0), queued_jobs(0)
+{
+	StartThreads();
+}
+
+FWorkerPool::~FWorkerPool()
+{
+	StopThreads();
+}
+
+int FWorkerPool::NumWorkers()
+{
+	std::unique_lock<std::mutex> lock(workers_mutex);
+	return (int)workers.size();
+}
+
+void FWorkerPool::Submit(Job job, int affinity, const void *owner)
+{
+	std::unique_lock<std::mutex> workers_lock(workers_mutex);
+	int count = (int)workers.size();
+	int index = affinity >= 0 ? affinity % count : (int)(next_worker++ % count);
+
+	std::unique_lock<std::mutex> lock(workers[index]->mutex);
+	workers[index]->jobs.push_back({ std::move(job), owner });
+	lock.unlock();
+	workers_lock.unlock();
+
+	// The counter is only raised while holding the wake mutex so that a worker
+	// about to go to sleep cannot miss the notification.
+	std::unique_lock<std::mutex> wake_lock(wake_mutex);
+	queued_jobs++;
+	wake_lock.unlock();
+	wake_condition.notify_one();
+}
+
+bool FWorkerPool::PopJob(int index, Job &job)
+{
+	std::unique_lock<std::mutex> workers_lock(workers_mutex);
+	int count = (int)workers.size();
+
+	// Own jobs are taken from the front (oldest first):
+	Worker *worker = workers[index].get();
+	std::unique_lock<std::mutex> lock(worker->mutex);
+	if (!worker->jobs.empty())
+	{
+		job = std::move(worker->jobs.front().job);
+		worker->jobs.pop_front();
+		queued_jobs--;
+		return true;
+	}
+	lock.unlock();
+
+	// Steal from the back of the other workers:
+	for (int i = 1; i <= count; i++)
+	{
+		Worker *victim = workers[(index + i) % count].get();
+		std::unique_lock<std::mutex> lock(victim->mutex);
+		if (!victim->jobs.empty())
+		{
+			job = std::move(victim->jobs.back().job);
+			victim->jobs.pop_back();
+			queued_jobs--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FWorkerPool::PopOwnedJob(const void *owner, Job &job)
+{
+	std::unique_lock<std::mutex> workers_lock(workers_mutex);
+	for (auto &worker : workers)
+	{
+		std::unique_lock<std::mutex> lock(worker->mutex);
+		for (auto it = worker->jobs.rbegin(); it != worker->jobs.rend(); ++it)
+		{
+			if (it->owner == owner)
+			{
+				job = std::move(it->job);
+				worker->jobs.erase(std::next(it).base());
+				queued_jobs--;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool FWorkerPool::RunPendingJob(const void *owner)
+{
+	Job job;
+	if (!PopOwnedJob(owner, job))
+		return false;
+	job();
+	return true;
+}
+
+void FWorkerPool::ParallelFor(int count, const std::function<void(int)> &callback)
+{
+	if (count <= 0)
+		return;
+
+	// Split into one contiguous chunk per thread, including the calling thread:
+	int chunks = MIN(count, NumWorkers() + 1);
+	FJobGroup group;
+	for (int chunk = 1; chunk < chunks; chunk++)
+	{
+		int start = count * chunk / chunks;
+		int end = count * (chunk + 1) / chunks;
+		group.Run([=, &callback]()
+		{
+			for (int i = start; i < end; i++)
+				callback(i);
+		});
+	}
+
+	int end = count / chunks;
+	for (int i = 0; i < end; i++)
+		callback(i);
+
+	group.Wait();
+}
+
+void FWorkerPool::WorkerMain(int index)
+{
+	while (true)
+	{
+		Job job;
+		if (PopJob(index, job))
+		{
+			job();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> wake_lock(wake_mutex);
+		wake_condition.wait(wake_lock, [&]() { return queued_jobs > 0 || shutdown_flag; });
+		if (shutdown_flag && queued_jobs <= 0)
+			break;
+	}
+}
+
+void FWorkerPool::Restart()
+{
+	StopThreads();
+	StartThreads();
+}
+
+void FWorkerPool::StartThreads()
+{
+	int num_threads = r_threads;
+	if (num_threads <= 0)
+		num_threads = std::thread::hardware_concurrency();
+	if (num_threads <= 0)
+		num_threads = 4;
+
+	std::unique_lock<std::mutex> workers_lock(workers_mutex);
+
+	// Jobs submitted after the old workers exited are handed to the new ones
+	std::vector<QueuedJob> leftover;
+	for (auto &worker : workers)
+	{
+		for (auto &queued : worker->jobs)
+			leftover.push_back(std::move(queued));
+	}
+	workers.clear();
+
+	for (int i = 0; i < num_threads; i++)
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+	for (size_t i = 0; i < leftover.size(); i++)
+		workers[i % num_threads]->jobs.push_back(std::move(leftover[i]));
+
+	for (int i = 0; i < num_threads; i++)
+		workers[i]->thread = std::thread([=]() { WorkerMain(i); });
+}
+
+void FWorkerPool::StopThreads()
+{
+	std::unique_lock<std::mutex> lock(wake_mutex);
+	shutdown_flag = true;
+	lock.unlock();
+	wake_condition.notify_all();
+
+	// The workers list is left in place until StartThreads, as jobs still running
+	// may submit more work while we wait for them here.
+	std::unique_lock<std::mutex> workers_lock(workers_mutex);
+	std::vector<std::thread> stopping;
+	for (auto &worker : workers)
+		stopping.push_back(std::move(worker->thread));
+	workers_lock.unlock();
+
+	for (auto &thread : stopping)
+		thread.join();
+
+	lock.lock();
+	shutdown_flag = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void FJobGroup::Run(FWorkerPool::Job job, int affinity)
+{
+	pending++;
+	FWorkerPool::Instance()->Submit([=]()
+	{
+		job();
+
+		// Notify while holding the lock as the group may be destroyed as soon as Wait sees zero
+		std::unique_lock<std::mutex> lock(end_mutex);
+		pending--;
+		end_condition.notify_all();
+	}, affinity, this);
+}
+
+void FJobGroup::Wait()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(end_mutex);
+			if (pending == 0)
+				return;
+		}
+
+		// Help out while our jobs are still queued. Jobs of other groups are left
+		// alone, as they may be long running. Once none of ours are left in the
+		// queues they are running and we only have to wait.
+		if (!FWorkerPool::Instance()->RunPendingJob(this))
+		{
+			std::unique_lock<std::mutex> lock(end_mutex);
+			end_condition.wait(lock, [&]() { return pending == 0; });
+			return;
+		}
+	}
+}
@@ -0,0 +1,131 @@
+/*
+** workerpool.h
+** Engine-wide worker thread pool
+**
+**---------------------------------------------------------------------------
+** Copyright 2017 GZDoom Development Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+// One set of worker threads shared by the renderers, the drawers and anything
+// else in the engine that wants to run work in parallel. The worker count is
+// controlled by the r_threads CVAR (0 = one per hardware thread).
+//
+// Every worker owns a job deque. Jobs submitted with an affinity hint go to
+// that worker's deque, other jobs are distributed round robin. A worker that
+// runs out of jobs steals from the other deques.
+class FWorkerPool
+{
+public:
+	typedef std::function<void()> Job;
+
+	static FWorkerPool *Instance();
+
+	// Number of worker threads. The thread submitting work is not included.
+	int NumWorkers();
+
+	// Queue a job. The affinity is a hint for which worker should run it (-1 for any worker).
+	// The owner identifies the jobs a waiting thread may help running (see RunPendingJob).
+	void Submit(Job job, int affinity = -1, const void *owner = nullptr);
+
+	// Runs one queued job submitted with the given owner on the calling thread.
+	// Returns false if no such job was queued.
+	bool RunPendingJob(const void *owner);
+
+	// Runs callback(i) for all i in [0, count) and returns when all of them finished.
+	// The calling thread takes part in the work.
+	void ParallelFor(int count, const std::function<void(int)> &callback);
+
+	// Stops the workers after they finished all queued jobs and starts them again
+	// with the current r_threads setting. Must only be called from the main thread.
+	void Restart();
+
+private:
+	FWorkerPool();
+	~FWorkerPool();
+
+	struct QueuedJob
+	{
+		Job job;
+		const void *owner;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::deque<QueuedJob> jobs;
+	};
+
+	void StartThreads();
+	void StopThreads();
+	void WorkerMain(int index);
+	bool PopJob(int index, Job &job);
+	bool PopOwnedJob(const void *owner, Job &job);
+
+	// Held while the workers list is read or rebuilt. Lock order is workers_mutex before Worker::mutex.
+	std::mutex workers_mutex;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<unsigned int> next_worker;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake_condition;
+	std::atomic<int> queued_jobs;
+	bool shutdown_flag = false;
+};
+
+// Fork/join helper: jobs started through a group can be waited for together.
+// While waiting, the calling thread helps running the group's own queued jobs.
+class FJobGroup
+{
+public:
+	FJobGroup() : pending(0) { }
+	~FJobGroup() { Wait(); }
+
+	void Run(FWorkerPool::Job job, int affinity = -1);
+	void Wait();
+
+private:
+	FJobGroup(const FJobGroup &) = delete;
+	FJobGroup &operator=(const FJobGroup &) = delete;
+
+	std::atomic<int> pending;
+	std::mutex end_mutex;
+	std::condition_variable end_condition;
+};
@@ -66,16 +66,24 @@ void DumpCPUInfo(const CPUInfo *cpu)
 						 "xchgl\t%%ebx, %1\n\t" \
 		: "=a" ((output)[0]), "=r" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) \
 		: "a" (func));
+#define __cpuidex(output, func, subfunc) \
+	__asm__ __volatile__("xchgl\t%%ebx, %1\n\t" \
+						 "cpuid\n\t" \
+						 "xchgl\t%%ebx, %1\n\t" \
+		: "=a" ((output)[0]), "=r" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) \
+		: "a" (func), "c" (subfunc));
 #else
 #define __cpuid(output, func) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
 	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func));
+#define __cpuidex(output, func, subfunc) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
+	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func), "c" (subfunc));
 #endif
 #endif
 
 void CheckCPUID(CPUInfo *cpu)
 {
 	int foo[4];
-	unsigned int maxext;
+	unsigned int maxstd, maxext;
 
 	memset(cpu, 0, sizeof(*cpu));
 
@@ -127,6 +135,7 @@ haveid:
 
 	// Get vendor ID
 	__cpuid(foo, 0);
+	maxstd = (unsigned int)foo[0];
 	cpu->dwVendorID[0] = foo[1];
 	cpu->dwVendorID[1] = foo[3];
 	cpu->dwVendorID[2] = foo[2];
@@ -143,6 +152,25 @@ haveid:
 	cpu->FeatureFlags[1] = foo[2];	// Store extended feature flags
 	cpu->FeatureFlags[2] = foo[3];	// Store feature flags
 
+	// AVX can only be used if the OS preserves the YMM registers (XCR0 bits 1 and 2).
+	if (cpu->bAVX)
+	{
+		unsigned int xcr0 = 0;
+		if (cpu->bOSXSAVE)
+		{
+#ifdef _MSC_VER
+			xcr0 = (unsigned int)_xgetbv(0);
+#else
+			unsigned int xcr0hi;
+			__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));	// xgetbv
+#endif
+		}
+		if ((xcr0 & 6) != 6)
+		{
+			cpu->bAVX = false;
+		}
+	}
+
 	// If CLFLUSH instruction is supported, get the real cache line size.
 	if (foo[3] & (1 << 19))
 	{
@@ -163,6 +191,17 @@ haveid:
 		cpu->Model |= (foo[0] >> 12) & 0xF0;
 	}
 
+	// Get structured extended feature flags. AVX2 needs the same OS support as AVX.
+	if (maxstd >= 7)
+	{
+		__cpuidex(foo, 7, 0);
+		cpu->ExtFeatureFlags = foo[1];
+		if (!cpu->bAVX)
+		{
+			cpu->bAVX2 = false;
+		}
+	}
+
 	// Check for extended functions.
 	__cpuid(foo, 0x80000000);
 	maxext = (unsigned int)foo[0];
@@ -249,6 +288,8 @@ void DumpCPUInfo(const CPUInfo *cpu)
 		if (cpu->bSSSE3)		Printf(" SSSE3");
 		if (cpu->bSSE41)		Printf(" SSE4.1");
 		if (cpu->bSSE42)		Printf(" SSE4.2");
+		if (cpu->bAVX)			Printf(" AVX");
+		if (cpu->bAVX2)			Printf(" AVX2");
 		if (cpu->b3DNow)		Printf(" 3DNow!");
 		if (cpu->b3DNowPlus)	Printf(" 3DNow!+");
 		Printf ("\n");
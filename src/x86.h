@@ -3,7 +3,7 @@
 
 #include "basictypes.h"
 
-struct CPUInfo	// 92 bytes
+struct CPUInfo	// 96 bytes
 {
 	union
 	{
@@ -36,7 +36,10 @@ struct CPUInfo	// 92 bytes
 			uint32_t DontCare1a:9;
 			uint32_t bSSE41:1;
 			uint32_t bSSE42:1;
-			uint32_t DontCare2a:11;
+			uint32_t DontCare2a:6;
+			uint32_t bOSXSAVE:1;
+			uint32_t bAVX:1;			// Only set if the OS also saves the AVX registers
+			uint32_t DontCare2b:3;
 
 			uint32_t bFPU:1;
 			uint32_t bVME:1;
@@ -97,6 +100,17 @@ struct CPUInfo	// 92 bytes
 		};
 		uint32_t AMD_DataL1Info;
 	};
+
+	union
+	{
+		struct
+		{
+			uint32_t DontCare4:5;
+			uint32_t bAVX2:1;			// Only set if AVX is usable too
+			uint32_t DontCare4a:26;
+		};
+		uint32_t ExtFeatureFlags;		// CPUID leaf 7, EBX
+	};
 };
 
 